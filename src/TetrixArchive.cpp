@@ -0,0 +1,337 @@
+#include "TetrixArchive.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char HeaderMagic[4] = { 'T', 'X', 'A', 'R' };
+const char TrailerMagic[4] = { 'T', 'X', 'A', 'I' };
+const size_t WriteBufferSize = 1 << 20;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t keyframeInterval;
+    uint32_t reserved;
+};
+
+struct Trailer {
+    uint64_t indexOffset;
+    uint64_t entryCount;
+    char magic[4];
+    uint32_t version;
+};
+
+static_assert(sizeof(Header) == TetrixArchiveFormat::HeaderSize, "archive header layout");
+static_assert(sizeof(Trailer) == TetrixArchiveFormat::TrailerSize, "archive trailer layout");
+
+bool seekFile(FILE *file, int64_t offset, int origin) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, origin) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), origin) == 0;
+#endif
+}
+
+int64_t tellFile(FILE *file) {
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return static_cast<int64_t>(ftello(file));
+#endif
+}
+
+bool validTrailer(const Trailer &trailer, uint64_t fileSize) {
+    return std::memcmp(trailer.magic, TrailerMagic, 4) == 0 && trailer.version == TetrixArchiveFormat::Version
+        && trailer.indexOffset >= TetrixArchiveFormat::HeaderSize && trailer.indexOffset % 8 == 0
+        && trailer.entryCount <= (fileSize - TetrixArchiveFormat::TrailerSize) / sizeof(TetrixArchiveEntry)
+        && trailer.indexOffset + trailer.entryCount * sizeof(TetrixArchiveEntry) + TetrixArchiveFormat::TrailerSize == fileSize;
+}
+
+} // namespace
+
+bool TetrixArchiveWriter::open(const std::string &path, int keyframeInterval) {
+    close();
+    failed = false;
+    entries.clear();
+    interval = static_cast<uint32_t>(std::max(1, keyframeInterval));
+
+    file = std::fopen(path.c_str(), "r+b");
+    if (file) {
+        std::setvbuf(file, nullptr, _IOFBF, WriteBufferSize);
+        Header header;
+        Trailer trailer;
+        int64_t fileSize = seekFile(file, 0, SEEK_END) ? tellFile(file) : -1;
+        bool valid = fileSize >= TetrixArchiveFormat::HeaderSize + TetrixArchiveFormat::TrailerSize && seekFile(file, 0, SEEK_SET)
+            && std::fread(&header, sizeof(header), 1, file) == 1 && std::memcmp(header.magic, HeaderMagic, 4) == 0
+            && header.version == TetrixArchiveFormat::Version && header.keyframeInterval > 0
+            && seekFile(file, fileSize - TetrixArchiveFormat::TrailerSize, SEEK_SET)
+            && std::fread(&trailer, sizeof(trailer), 1, file) == 1 && validTrailer(trailer, static_cast<uint64_t>(fileSize));
+        if (valid) {
+            entries.resize(trailer.entryCount);
+            valid = seekFile(file, static_cast<int64_t>(trailer.indexOffset), SEEK_SET)
+                && std::fread(entries.data(), sizeof(TetrixArchiveEntry), entries.size(), file) == entries.size()
+                && seekFile(file, static_cast<int64_t>(trailer.indexOffset), SEEK_SET);
+        }
+        if (!valid) {
+            std::fclose(file);
+            file = nullptr;
+            entries.clear();
+            return false;
+        }
+        interval = header.keyframeInterval;
+        writeOffset = trailer.indexOffset;
+        return true;
+    }
+
+    file = std::fopen(path.c_str(), "w+b");
+    if (!file) {
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, WriteBufferSize);
+    writeOffset = 0;
+    Header header{ { HeaderMagic[0], HeaderMagic[1], HeaderMagic[2], HeaderMagic[3] }, TetrixArchiveFormat::Version, interval, 0 };
+    return write(&header, sizeof(header));
+}
+
+bool TetrixArchiveWriter::write(const void *data, size_t size) {
+    if (size > 0 && std::fwrite(data, 1, size, file) != size) {
+        failed = true;
+    }
+    writeOffset += size;
+    return !failed;
+}
+
+bool TetrixArchiveWriter::pad() {
+    static const uint8_t zeros[8] = {};
+    return write(zeros, static_cast<size_t>((8 - writeOffset % 8) % 8));
+}
+
+bool TetrixArchiveWriter::append(const uint8_t *replay, size_t size) {
+    TetrixReplayReader reader;
+    if (!file || failed || !reader.open(replay, size)) {
+        return false;
+    }
+
+    // Same re-simulation as TetrixReplay::verify, keeping the engine state every `interval` pieces
+    TetrixReplay::start(engine, reader.summary());
+    keyframes.clear();
+    int nextKeyframe = static_cast<int>(interval);
+    TetrixReplay::Event event;
+    while (reader.next(event)) {
+        TetrixReplay::apply(engine, event);
+        if (engine.piecesDropped() >= nextKeyframe) {
+            TetrixArchiveKeyframe keyframe;
+            keyframe.replayPosition = static_cast<uint32_t>(reader.position());
+            keyframe.eventTimeMs = reader.eventTime();
+            engine.saveState(keyframe.state);
+            keyframes.push_back(keyframe);
+            nextKeyframe = (engine.piecesDropped() / static_cast<int>(interval) + 1) * static_cast<int>(interval);
+        }
+    }
+    const TetrixReplay::Summary &summary = reader.summary();
+    if (!reader.isValid() || engine.score() != summary.score || engine.linesRemoved() != summary.lines
+        || engine.piecesDropped() != summary.pieces || engine.grid().checksum() != summary.boardChecksum) {
+        return false;
+    }
+
+    TetrixArchiveEntry entry{};
+    entry.seed = summary.seed;
+    entry.replaySize = static_cast<uint32_t>(reader.position()); // Drops anything after the footer
+    entry.keyframeCount = static_cast<uint32_t>(keyframes.size());
+    entry.score = summary.score;
+    entry.lines = summary.lines;
+    entry.pieces = summary.pieces;
+    entry.durationMs = summary.durationMs;
+    entry.mode = static_cast<uint8_t>(summary.mode);
+    return appendRecord(entry, replay, keyframes.data());
+}
+
+bool TetrixArchiveWriter::appendRecord(const TetrixArchiveEntry &entry, const uint8_t *replay, const TetrixArchiveKeyframe *frames) {
+    if (!file || failed) {
+        return false;
+    }
+    TetrixArchiveEntry written = entry;
+    written.offset = writeOffset;
+    write(replay, entry.replaySize);
+    pad();
+    write(frames, entry.keyframeCount * sizeof(TetrixArchiveKeyframe));
+    if (failed) {
+        return false;
+    }
+    entries.push_back(written);
+    return true;
+}
+
+bool TetrixArchiveWriter::close() {
+    if (!file) {
+        return true;
+    }
+    pad();
+    Trailer trailer{ writeOffset, entries.size(), { TrailerMagic[0], TrailerMagic[1], TrailerMagic[2], TrailerMagic[3] },
+                     TetrixArchiveFormat::Version };
+    write(entries.data(), entries.size() * sizeof(TetrixArchiveEntry));
+    write(&trailer, sizeof(trailer));
+    bool ok = std::fclose(file) == 0 && !failed;
+    file = nullptr;
+    entries.clear();
+    return ok;
+}
+
+bool TetrixArchive::open(const std::string &path) {
+    close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    HANDLE mapping = GetFileSizeEx(handle, &size) && size.QuadPart > 0
+        ? CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr)
+        : nullptr;
+    const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(handle);
+        return false;
+    }
+    fileHandle = handle;
+    mappingHandle = mapping;
+    mapped = static_cast<const uint8_t *>(view);
+    mappedSize = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    void *view = fstat(fd, &info) == 0 && info.st_size > 0
+        ? mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0)
+        : MAP_FAILED;
+    ::close(fd); // The mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    mapped = static_cast<const uint8_t *>(view);
+    mappedSize = static_cast<size_t>(info.st_size);
+#endif
+
+    Header header;
+    Trailer trailer;
+    bool valid = mappedSize >= TetrixArchiveFormat::HeaderSize + TetrixArchiveFormat::TrailerSize;
+    if (valid) {
+        std::memcpy(&header, mapped, sizeof(header));
+        std::memcpy(&trailer, mapped + mappedSize - sizeof(trailer), sizeof(trailer));
+        valid = std::memcmp(header.magic, HeaderMagic, 4) == 0 && header.version == TetrixArchiveFormat::Version
+            && header.keyframeInterval > 0 && validTrailer(trailer, mappedSize);
+    }
+    if (valid) {
+        entryTable = reinterpret_cast<const TetrixArchiveEntry *>(mapped + trailer.indexOffset);
+        entryCount = static_cast<size_t>(trailer.entryCount);
+        interval = static_cast<int>(header.keyframeInterval);
+        // Checked once here so the accessors can index the mapping without bounds checks
+        for (size_t i = 0; i < entryCount && valid; ++i) {
+            const TetrixArchiveEntry &entry = entryTable[i];
+            valid = entry.offset >= TetrixArchiveFormat::HeaderSize && entry.offset + entry.replaySize <= trailer.indexOffset
+                && entry.keyframeOffset() + uint64_t(entry.keyframeCount) * sizeof(TetrixArchiveKeyframe) <= trailer.indexOffset;
+        }
+    }
+    if (!valid) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TetrixArchive::close() {
+    if (mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapped);
+        CloseHandle(static_cast<HANDLE>(mappingHandle));
+        CloseHandle(static_cast<HANDLE>(fileHandle));
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+#else
+        munmap(const_cast<uint8_t *>(mapped), mappedSize);
+#endif
+    }
+    mapped = nullptr;
+    mappedSize = 0;
+    entryTable = nullptr;
+    entryCount = 0;
+    interval = 0;
+}
+
+void TetrixArchive::topByScore(size_t n, std::vector<uint32_t> &result) const {
+    // Bounded heap of the best n seen so far, worst at the front: O(count log n), no copy of the index
+    auto better = [this](uint32_t a, uint32_t b) {
+        int scoreA = entryTable[a].score;
+        int scoreB = entryTable[b].score;
+        return scoreA > scoreB || (scoreA == scoreB && a < b);
+    };
+    result.clear();
+    if (n == 0) {
+        return;
+    }
+    result.reserve(std::min(n, entryCount));
+    for (size_t i = 0; i < entryCount; ++i) {
+        uint32_t index = static_cast<uint32_t>(i);
+        if (result.size() < n) {
+            result.push_back(index);
+            std::push_heap(result.begin(), result.end(), better);
+        } else if (better(index, result.front())) {
+            std::pop_heap(result.begin(), result.end(), better);
+            result.back() = index;
+            std::push_heap(result.begin(), result.end(), better);
+        }
+    }
+    std::sort_heap(result.begin(), result.end(), better);
+}
+
+bool TetrixArchive::seek(size_t index, int pieces, TetrixEngine &engine, TetrixReplayReader &reader) const {
+    if (index >= entryCount) {
+        return false;
+    }
+    const TetrixArchiveEntry &game = entryTable[index];
+    if (!reader.open(replay(index), game.replaySize)) {
+        return false;
+    }
+
+    // Latest keyframe strictly before the target, so the result matches a seek from the start
+    const TetrixArchiveKeyframe *first = keyframes(index);
+    const TetrixArchiveKeyframe *last = first + game.keyframeCount;
+    const TetrixArchiveKeyframe *after = std::lower_bound(first, last, pieces, [](const TetrixArchiveKeyframe &keyframe, int target) {
+        return keyframe.state.piecesDropped < target;
+    });
+    if (after != first) {
+        const TetrixArchiveKeyframe &keyframe = *(after - 1);
+        if (!engine.restoreState(keyframe.state) || !reader.seek(keyframe.replayPosition, keyframe.eventTimeMs)) {
+            return false;
+        }
+    } else {
+        TetrixReplay::start(engine, reader.summary());
+    }
+
+    TetrixReplay::Event event;
+    while (engine.piecesDropped() < pieces && reader.next(event)) {
+        TetrixReplay::apply(engine, event);
+    }
+    return reader.isValid();
+}
@@ -0,0 +1,132 @@
+#ifndef TETRIXARCHIVE_H
+#define TETRIXARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "TetrixEngine.h"
+#include "TetrixReplay.h"
+
+// Many replays in one file, queried through a memory mapping without copying or parsing.
+// Layout (little endian, every section 8-byte aligned):
+//   header:  "TXAR", version, keyframe interval (pieces), reserved
+//   records: per game the replay bytes, then its keyframes (engine state every N pieces)
+//   index:   one TetrixArchiveEntry per game
+//   trailer: index offset, entry count, "TXAI", version
+// Appending writes new records over the old index and then rewrites the index and trailer,
+// so records never move; an append interrupted before close() loses the index.
+namespace TetrixArchiveFormat {
+
+enum { Version = 1, DefaultKeyframeInterval = 100, HeaderSize = 16, TrailerSize = 24 };
+
+} // namespace TetrixArchiveFormat
+
+struct TetrixArchiveEntry {
+    uint64_t offset; // Replay bytes; keyframes follow at keyframeOffset()
+    uint64_t seed;
+    uint32_t replaySize;
+    uint32_t keyframeCount;
+    int32_t score;
+    int32_t lines;
+    int32_t pieces;
+    uint32_t durationMs;
+    uint8_t mode; // TetrixRandomizer::Mode
+    uint8_t reserved[7];
+
+    uint64_t keyframeOffset() const { return (offset + replaySize + 7) & ~uint64_t(7); }
+};
+
+// Engine state at an event boundary of the replay, plus where the reader continues from there
+struct TetrixArchiveKeyframe {
+    uint32_t replayPosition; // TetrixReplayReader::position() of the next event
+    uint32_t eventTimeMs; // TetrixReplayReader::eventTime() at that point
+    TetrixEngineState state;
+};
+
+static_assert(sizeof(TetrixArchiveEntry) == 48, "TetrixArchiveEntry is a fixed on-disk layout");
+static_assert(sizeof(TetrixArchiveKeyframe) == 344, "TetrixArchiveKeyframe is a fixed on-disk layout");
+
+class TetrixArchiveWriter {
+public:
+    TetrixArchiveWriter() = default;
+    TetrixArchiveWriter(const TetrixArchiveWriter &) = delete;
+    TetrixArchiveWriter &operator=(const TetrixArchiveWriter &) = delete;
+    ~TetrixArchiveWriter() { close(); }
+
+    // Creates the archive, or reopens an existing one for appending (keeping its keyframe interval)
+    bool open(const std::string &path, int keyframeInterval = TetrixArchiveFormat::DefaultKeyframeInterval);
+    // Re-simulates the replay to check it and take keyframes; false for replays that do not verify
+    bool append(const uint8_t *replay, size_t size);
+    // Copies a record from another archive verbatim; no parsing or simulation
+    bool appendRecord(const TetrixArchiveEntry &entry, const uint8_t *replay, const TetrixArchiveKeyframe *keyframes);
+    // Writes the index and trailer; the archive is only readable after this
+    bool close();
+    bool isOpen() const { return file != nullptr; }
+    size_t count() const { return entries.size(); }
+
+private:
+    bool write(const void *data, size_t size);
+    bool pad();
+
+    FILE *file = nullptr;
+    uint64_t writeOffset = 0;
+    uint32_t interval = TetrixArchiveFormat::DefaultKeyframeInterval;
+    bool failed = false;
+    std::vector<TetrixArchiveEntry> entries;
+    std::vector<TetrixArchiveKeyframe> keyframes; // Scratch for append()
+    TetrixEngine engine;
+};
+
+// Read-only view of a closed archive. Entries, replays and keyframes point straight into the mapping.
+class TetrixArchive {
+public:
+    TetrixArchive() = default;
+    TetrixArchive(const TetrixArchive &) = delete;
+    TetrixArchive &operator=(const TetrixArchive &) = delete;
+    ~TetrixArchive() { close(); }
+
+    // Maps the file and checks the header, trailer and every entry's bounds
+    bool open(const std::string &path);
+    void close();
+
+    size_t count() const { return entryCount; }
+    int keyframeInterval() const { return interval; }
+    size_t fileSize() const { return mappedSize; }
+    const TetrixArchiveEntry &entry(size_t index) const { return entryTable[index]; }
+    const uint8_t *replay(size_t index) const { return mapped + entryTable[index].offset; }
+    const TetrixArchiveKeyframe *keyframes(size_t index) const {
+        return reinterpret_cast<const TetrixArchiveKeyframe *>(mapped + entryTable[index].keyframeOffset());
+    }
+
+    // Indices of the n best games by score, best first
+    void topByScore(size_t n, std::vector<uint32_t> &result) const;
+    // Indices of every game whose entry satisfies predicate, in archive order
+    template <typename Predicate>
+    void select(Predicate predicate, std::vector<uint32_t> &result) const {
+        result.clear();
+        for (size_t i = 0; i < entryCount; ++i) {
+            if (predicate(entryTable[i])) {
+                result.push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+
+    // Restores the engine from the nearest keyframe and simulates to the first event boundary with at
+    // least `pieces` pieces dropped (or the end). The reader is left positioned to continue playback.
+    bool seek(size_t index, int pieces, TetrixEngine &engine, TetrixReplayReader &reader) const;
+
+private:
+    const uint8_t *mapped = nullptr;
+    size_t mappedSize = 0;
+    const TetrixArchiveEntry *entryTable = nullptr;
+    size_t entryCount = 0;
+    int interval = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
+
+#endif // TETRIXARCHIVE_H
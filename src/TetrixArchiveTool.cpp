@@ -0,0 +1,248 @@
+#include "TetrixArchive.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Queries and maintains replay archives (see TetrixArchive.h):
+//   info, top N, lines X: index queries straight from the mapping
+//   seek GAME PIECES:     keyframe seek, checked against a re-simulation from the start
+//   verify:               re-simulates every game and compares each keyframe byte for byte
+//   export OUT [LINES]:   copies games with at least LINES lines into a new archive without parsing
+//   add REPLAY...:        appends .txr replays (tetrix_cli --archive appends while playing)
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void printEntry(const TetrixArchive &archive, uint32_t index) {
+    const TetrixArchiveEntry &entry = archive.entry(index);
+    std::printf("#%-8u seed %-20llu score %-8d lines %-6d pieces %-7d %.1f s\n", index,
+                static_cast<unsigned long long>(entry.seed), entry.score, entry.lines, entry.pieces, entry.durationMs / 1000.0);
+}
+
+int printInfo(const TetrixArchive &archive) {
+    long long pieces = 0;
+    long long replayBytes = 0;
+    long long keyframes = 0;
+    for (size_t i = 0; i < archive.count(); ++i) {
+        pieces += archive.entry(i).pieces;
+        replayBytes += archive.entry(i).replaySize;
+        keyframes += archive.entry(i).keyframeCount;
+    }
+    std::printf("games:             %zu\n", archive.count());
+    std::printf("pieces:            %lld\n", pieces);
+    std::printf("file size:         %zu bytes\n", archive.fileSize());
+    std::printf("replay bytes:      %lld (%.2f bytes/piece)\n", replayBytes, pieces ? double(replayBytes) / pieces : 0.0);
+    std::printf("keyframes:         %lld, every %d pieces\n", keyframes, archive.keyframeInterval());
+    return 0;
+}
+
+int printTop(const TetrixArchive &archive, size_t n) {
+    std::vector<uint32_t> result;
+    auto begin = std::chrono::steady_clock::now();
+    archive.topByScore(n, result);
+    double seconds = secondsSince(begin);
+    for (uint32_t index : result) {
+        printEntry(archive, index);
+    }
+    std::printf("top %zu of %zu games in %.3f ms\n", n, archive.count(), seconds * 1e3);
+    return 0;
+}
+
+int printMinLines(const TetrixArchive &archive, int minLines) {
+    std::vector<uint32_t> result;
+    auto begin = std::chrono::steady_clock::now();
+    archive.select([minLines](const TetrixArchiveEntry &entry) { return entry.lines >= minLines; }, result);
+    double seconds = secondsSince(begin);
+    for (size_t i = 0; i < result.size() && i < 20; ++i) {
+        printEntry(archive, result[i]);
+    }
+    if (result.size() > 20) {
+        std::printf("...\n");
+    }
+    std::printf("%zu of %zu games with at least %d lines in %.3f ms\n", result.size(), archive.count(), minLines, seconds * 1e3);
+    return 0;
+}
+
+int seekGame(const TetrixArchive &archive, size_t index, int pieces) {
+    if (index >= archive.count()) {
+        std::printf("no game #%zu\n", index);
+        return 1;
+    }
+    TetrixEngine engine;
+    TetrixReplayReader reader;
+    auto begin = std::chrono::steady_clock::now();
+    bool ok = archive.seek(index, pieces, engine, reader);
+    double seekSeconds = secondsSince(begin);
+
+    // Reference: the same position reached by simulating from piece 0
+    const TetrixArchiveEntry &entry = archive.entry(index);
+    TetrixEngine reference;
+    TetrixReplayReader referenceReader;
+    begin = std::chrono::steady_clock::now();
+    referenceReader.open(archive.replay(index), entry.replaySize);
+    TetrixReplay::start(reference, referenceReader.summary());
+    TetrixReplay::Event event;
+    while (reference.piecesDropped() < pieces && referenceReader.next(event)) {
+        TetrixReplay::apply(reference, event);
+    }
+    double replaySeconds = secondsSince(begin);
+
+    TetrixEngineState state;
+    TetrixEngineState expected;
+    engine.saveState(state);
+    reference.saveState(expected);
+    bool same = ok && std::memcmp(&state, &expected, sizeof(state)) == 0 && reader.position() == referenceReader.position();
+    std::printf("game #%zu at piece %d: score %d, lines %d, replay offset %zu\n", index, engine.piecesDropped(), engine.score(),
+                engine.linesRemoved(), reader.position());
+    std::printf("keyframe seek %.1f us, from start %.1f us, %s\n", seekSeconds * 1e6, replaySeconds * 1e6,
+                same ? "states match" : "STATE MISMATCH");
+    return same ? 0 : 1;
+}
+
+int verifyArchive(const TetrixArchive &archive) {
+    int failures = 0;
+    long long pieces = 0;
+    TetrixEngine engine;
+    TetrixEngine stored;
+    TetrixEngineState state;
+    TetrixEngineState storedState;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < archive.count(); ++i) {
+        const TetrixArchiveEntry &entry = archive.entry(i);
+        const TetrixArchiveKeyframe *keyframes = archive.keyframes(i);
+        bool ok = TetrixReplay::verify(archive.replay(i), entry.replaySize) == TetrixReplay::VerifyResult::Ok;
+
+        TetrixReplayReader reader;
+        reader.open(archive.replay(i), entry.replaySize);
+        TetrixReplay::start(engine, reader.summary());
+        uint32_t next = 0;
+        TetrixReplay::Event event;
+        while (ok && reader.next(event)) {
+            TetrixReplay::apply(engine, event);
+            if (next < entry.keyframeCount && keyframes[next].replayPosition == reader.position()) {
+                // Compare as restored: keyframes saved before line clears compacted at once are normalized
+                engine.saveState(state);
+                ok = stored.restoreState(keyframes[next].state) && keyframes[next].eventTimeMs == reader.eventTime();
+                stored.saveState(storedState);
+                ok = ok && std::memcmp(&state, &storedState, sizeof(state)) == 0;
+                ++next;
+            }
+        }
+        ok = ok && next == entry.keyframeCount && engine.score() == entry.score && engine.piecesDropped() == entry.pieces;
+        if (!ok) {
+            std::printf("game #%zu: FAILED\n", i);
+            ++failures;
+        }
+        pieces += entry.pieces;
+    }
+    double seconds = secondsSince(begin);
+    std::printf("verified %zu games, %lld pieces (twice each) in %.3f s, %d failures\n", archive.count(), pieces, seconds, failures);
+    return failures == 0 ? 0 : 1;
+}
+
+int exportGames(const TetrixArchive &archive, const char *path, int minLines) {
+    std::vector<uint32_t> games;
+    archive.select([minLines](const TetrixArchiveEntry &entry) { return entry.lines >= minLines; }, games);
+
+    TetrixArchiveWriter writer;
+    if (!writer.open(path, archive.keyframeInterval())) {
+        std::printf("%s: cannot open for writing\n", path);
+        return 1;
+    }
+    auto begin = std::chrono::steady_clock::now();
+    long long bytes = 0;
+    bool ok = true;
+    for (uint32_t index : games) {
+        const TetrixArchiveEntry &entry = archive.entry(index);
+        ok = ok && writer.appendRecord(entry, archive.replay(index), archive.keyframes(index));
+        bytes += entry.replaySize + entry.keyframeCount * sizeof(TetrixArchiveKeyframe);
+    }
+    ok = writer.close() && ok;
+    double seconds = secondsSince(begin);
+    std::printf("exported %zu games, %lld bytes in %.3f s (%.0f MB/s)%s\n", games.size(), bytes, seconds,
+                seconds > 0.0 ? bytes / seconds / 1e6 : 0.0, ok ? "" : ", WRITE FAILED");
+    return ok ? 0 : 1;
+}
+
+int addReplays(const char *path, char **replayPaths, int count) {
+    TetrixArchiveWriter writer;
+    if (!writer.open(path)) {
+        std::printf("%s: cannot open for writing\n", path);
+        return 1;
+    }
+    int failures = 0;
+    std::vector<uint8_t> data;
+    for (int i = 0; i < count; ++i) {
+        FILE *file = std::fopen(replayPaths[i], "rb");
+        data.clear();
+        if (file) {
+            uint8_t buffer[65536];
+            for (size_t n; (n = std::fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+                data.insert(data.end(), buffer, buffer + n);
+            }
+            std::fclose(file);
+        }
+        if (!file || !writer.append(data.data(), data.size())) {
+            std::printf("%s: not added\n", replayPaths[i]);
+            ++failures;
+        }
+    }
+    size_t total = writer.count();
+    if (!writer.close()) {
+        std::printf("%s: write failed\n", path);
+        return 1;
+    }
+    std::printf("%s: %d replays added, %zu games\n", path, count - failures, total);
+    return failures == 0 ? 0 : 1;
+}
+
+void printUsage(const char *program) {
+    std::printf("Usage: %s ARCHIVE info | top N | lines X | seek GAME PIECES | verify | export OUT [MIN_LINES] | add REPLAY...\n",
+                program);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    const char *path = argv[1];
+    const char *command = argv[2];
+    if (std::strcmp(command, "add") == 0) {
+        return addReplays(path, argv + 3, argc - 3);
+    }
+
+    TetrixArchive archive;
+    if (!archive.open(path)) {
+        std::printf("%s: not a readable archive\n", path);
+        return 1;
+    }
+    if (std::strcmp(command, "info") == 0) {
+        return printInfo(archive);
+    }
+    if (std::strcmp(command, "top") == 0 && argc == 4) {
+        return printTop(archive, static_cast<size_t>(std::strtoul(argv[3], nullptr, 10)));
+    }
+    if (std::strcmp(command, "lines") == 0 && argc == 4) {
+        return printMinLines(archive, std::atoi(argv[3]));
+    }
+    if (std::strcmp(command, "seek") == 0 && argc == 5) {
+        return seekGame(archive, static_cast<size_t>(std::strtoul(argv[3], nullptr, 10)), std::atoi(argv[4]));
+    }
+    if (std::strcmp(command, "verify") == 0) {
+        return verifyArchive(archive);
+    }
+    if (std::strcmp(command, "export") == 0 && (argc == 4 || argc == 5)) {
+        return exportGames(archive, argv[3], argc == 5 ? std::atoi(argv[4]) : 0);
+    }
+    printUsage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,133 @@
+#include "TetrixAssets.h"
+#include "TetrixTrace.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QResource>
+
+namespace {
+
+const char *const imagePaths[] = { ":/images/island.jpg", ":/images/gray.jpg" };
+// In TetrixSound order; the background track is not bundled yet
+const char *const soundPaths[] = { ":/sounds/drop.wav", ":/sounds/lineclear.wav", ":/sounds/gameover.wav", ":/sounds/background.wav" };
+
+static_assert(sizeof(imagePaths) / sizeof(imagePaths[0]) == static_cast<size_t>(TetrixAssets::Image::Count), "one path per image");
+static_assert(sizeof(soundPaths) / sizeof(soundPaths[0]) == static_cast<size_t>(TetrixSound::Count), "one path per sound");
+
+// Resource bytes in place, or unpacked if the build compressed them after all
+struct ResourceData {
+    const uchar *data = nullptr;
+    qint64 size = 0;
+    QByteArray unpacked;
+};
+
+bool resourceData(const char *path, ResourceData &resource) {
+    QResource file(QString::fromLatin1(path));
+    if (!file.isValid()) {
+        return false;
+    }
+    if (file.compressionAlgorithm() == QResource::NoCompression) {
+        resource.data = file.data();
+        resource.size = file.size();
+    } else {
+        resource.unpacked = file.uncompressedData();
+        resource.data = reinterpret_cast<const uchar *>(resource.unpacked.constData());
+        resource.size = resource.unpacked.size();
+    }
+    return true;
+}
+
+QElapsedTimer startupClock;
+qint64 firstPaintNs = -1;
+qint64 assetsLoadedNs = -1;
+
+void reportPlayable() {
+    qint64 playableNs = qMax(firstPaintNs, assetsLoadedNs);
+    TETRIX_TRACE_INFO(TetrixTraceId::Startup, 1, static_cast<int32_t>(playableNs / 1000));
+    qDebug() << "Startup: playable after" << playableNs / 1000000.0 << "ms (assets decoded after" << assetsLoadedNs / 1000000.0 << "ms)";
+}
+
+} // namespace
+
+TetrixAssets::TetrixAssets(QObject *parent) : QObject(parent), pending(0) {}
+
+TetrixAssets::~TetrixAssets() {
+    // Results still queued for this object are discarded with it
+    pool.waitForDone();
+}
+
+void TetrixAssets::load() {
+    pending = static_cast<int>(Image::Count) + static_cast<int>(TetrixSound::Count);
+    for (int i = 0; i < static_cast<int>(Image::Count); ++i) {
+        pool.start([this, i] {
+            ResourceData resource;
+            QImage decoded;
+            if (resourceData(imagePaths[i], resource)) {
+                TETRIX_TRACE_SCOPE_INFO(TetrixTraceId::AssetDecode, i, static_cast<int32_t>(resource.size));
+                decoded.loadFromData(resource.data, static_cast<int>(resource.size));
+            }
+            QMetaObject::invokeMethod(this, [this, i, decoded] {
+                if (decoded.isNull()) {
+                    qDebug() << "WARNING: Image missing from the asset pack:" << imagePaths[i];
+                } else {
+                    emit imageDecoded(static_cast<Image>(i), decoded);
+                }
+                finishOne();
+            }, Qt::QueuedConnection);
+        });
+    }
+    for (int i = 0; i < static_cast<int>(TetrixSound::Count); ++i) {
+        pool.start([this, i] {
+            ResourceData resource;
+            auto clip = std::make_shared<TetrixAudioClip>();
+            bool ok = false;
+            if (resourceData(soundPaths[i], resource)) {
+                TETRIX_TRACE_SCOPE_INFO(TetrixTraceId::AssetDecode, static_cast<int>(Image::Count) + i, static_cast<int32_t>(resource.size));
+                ok = TetrixAudio::decodeWav(resource.data, static_cast<size_t>(resource.size), *clip);
+            }
+            QMetaObject::invokeMethod(this, [this, i, ok, clip] {
+                if (ok) {
+                    emit soundDecoded(static_cast<TetrixSound>(i), clip);
+                } else {
+                    qDebug() << "WARNING: Sound missing from the asset pack:" << soundPaths[i];
+                }
+                finishOne();
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void TetrixAssets::finishOne() {
+    if (--pending == 0) {
+        emit loaded();
+    }
+}
+
+namespace TetrixStartup {
+
+void begin() {
+    startupClock.start();
+}
+
+void markFirstPaint() {
+    if (firstPaintNs >= 0 || !startupClock.isValid()) {
+        return;
+    }
+    firstPaintNs = startupClock.nsecsElapsed();
+    TETRIX_TRACE_INFO(TetrixTraceId::Startup, 0, static_cast<int32_t>(firstPaintNs / 1000));
+    qDebug() << "Startup: first paint after" << firstPaintNs / 1000000.0 << "ms";
+    if (assetsLoadedNs >= 0) {
+        reportPlayable();
+    }
+}
+
+void markAssetsLoaded() {
+    if (assetsLoadedNs >= 0 || !startupClock.isValid()) {
+        return;
+    }
+    assetsLoadedNs = startupClock.nsecsElapsed();
+    if (firstPaintNs >= 0) {
+        reportPlayable();
+    }
+}
+
+} // namespace TetrixStartup
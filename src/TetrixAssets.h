@@ -0,0 +1,48 @@
+#ifndef TETRIXASSETS_H
+#define TETRIXASSETS_H
+
+#include <QImage>
+#include <QObject>
+#include <QThreadPool>
+#include <memory>
+#include "TetrixAudio.h"
+
+// Images and sounds compiled into the executable (TetrixGame.qrc, stored uncompressed). load() decodes
+// them on a thread pool straight from the resource data, with no disk I/O or copy; each result is
+// delivered on the GUI thread, so the window paints before anything is decoded.
+class TetrixAssets : public QObject {
+    Q_OBJECT
+
+public:
+    enum class Image { GameBackground, GameOverBackground, Count };
+
+    explicit TetrixAssets(QObject *parent = nullptr);
+    ~TetrixAssets();
+
+    void load();
+    bool isLoaded() const { return pending == 0; }
+
+signals:
+    void imageDecoded(TetrixAssets::Image image, const QImage &decoded);
+    void soundDecoded(TetrixSound sound, std::shared_ptr<TetrixAudioClip> clip);
+    void loaded(); // Every asset delivered (or reported missing)
+
+private:
+    void finishOne();
+
+    QThreadPool pool; // Own pool, so the destructor can wait for its decodes
+    int pending;
+};
+
+// Startup timing from the start of main(), logged once each and traced as Startup events:
+// time to first paint (the board is on screen) and time to playable (painted, and every asset
+// decoded and installed)
+namespace TetrixStartup {
+
+void begin();
+void markFirstPaint();
+void markAssetsLoaded();
+
+} // namespace TetrixStartup
+
+#endif // TETRIXASSETS_H
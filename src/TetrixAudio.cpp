@@ -0,0 +1,368 @@
+#include "TetrixAudio.h"
+#include "TetrixTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+int64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t readLe32(const uint8_t *p) {
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+uint16_t readLe16(const uint8_t *p) {
+    return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+int16_t sampleAt(const uint8_t *data, int bits, size_t index) {
+    switch (bits) {
+    case 8:
+        return static_cast<int16_t>((int(data[index]) - 128) << 8);
+    case 24:
+        return static_cast<int16_t>(readLe16(data + 3 * index + 1)); // Top 16 bits
+    default:
+        return static_cast<int16_t>(readLe16(data + 2 * index));
+    }
+}
+
+} // namespace
+
+namespace TetrixAudio {
+
+bool decodeWav(const uint8_t *data, size_t size, TetrixAudioClip &clip) {
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    int channels = 0;
+    int bits = 0;
+    uint32_t rate = 0;
+    const uint8_t *pcm = nullptr;
+    size_t pcmSize = 0;
+    // Chunks are word aligned; anything but "fmt " and "data" (JUNK, LIST, ...) is skipped
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        const uint8_t *chunk = data + offset;
+        size_t chunkSize = std::min<size_t>(readLe32(chunk + 4), size - offset - 8);
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16) {
+            uint16_t format = readLe16(chunk + 8);
+            if (format != 1 && format != 0xFFFE) {
+                return false;
+            }
+            channels = readLe16(chunk + 10);
+            rate = readLe32(chunk + 12);
+            bits = readLe16(chunk + 22);
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            pcm = chunk + 8;
+            pcmSize = chunkSize;
+        }
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+    if (!pcm || (channels != 1 && channels != 2) || (bits != 8 && bits != 16 && bits != 24) || rate == 0) {
+        return false;
+    }
+
+    size_t sourceFrames = pcmSize / (channels * bits / 8);
+    size_t frames = static_cast<size_t>(uint64_t(sourceFrames) * SampleRate / rate);
+    clip.samples.resize(frames * Channels);
+    // Position in source frames, 32.32 fixed point
+    uint64_t step = (uint64_t(rate) << 32) / SampleRate;
+    uint64_t position = 0;
+    for (size_t i = 0; i < frames; ++i, position += step) {
+        size_t index = static_cast<size_t>(position >> 32);
+        size_t nextIndex = std::min(index + 1, sourceFrames - 1);
+        int32_t fraction = static_cast<int32_t>((position >> 17) & 0x7FFF); // Q15
+        for (int c = 0; c < Channels; ++c) {
+            int channel = channels == 1 ? 0 : c;
+            int32_t a = sampleAt(pcm, bits, index * channels + channel);
+            int32_t b = sampleAt(pcm, bits, nextIndex * channels + channel);
+            clip.samples[i * Channels + c] = static_cast<int16_t>(a + (((b - a) * fraction) >> 15));
+        }
+    }
+    return true;
+}
+
+} // namespace TetrixAudio
+
+TetrixAudioMixer::TetrixAudioMixer() : stolen(0) {
+    std::fill(std::begin(clips), std::end(clips), nullptr);
+}
+
+void TetrixAudioMixer::setClip(TetrixSound sound, const TetrixAudioClip *clip) {
+    clips[static_cast<int>(sound)] = clip;
+}
+
+void TetrixAudioMixer::play(TetrixSound sound, float volume, bool loop) {
+    const TetrixAudioClip *clip = clips[static_cast<int>(sound)];
+    if (!clip || clip->frames() == 0) {
+        return;
+    }
+    Voice *target = nullptr;
+    int leastLeft = 0;
+    for (Voice &voice : voices) {
+        if (!voice.clip) {
+            target = &voice;
+            break;
+        }
+        // Looping voices (music) never end, so they are taken over last
+        int left = voice.loop ? INT_MAX : voice.clip->frames() - voice.position;
+        if (!target || left < leastLeft) {
+            target = &voice;
+            leastLeft = left;
+        }
+    }
+    if (target->clip) {
+        ++stolen;
+    }
+    target->clip = clip;
+    target->sound = sound;
+    target->position = 0;
+    target->gain = static_cast<int32_t>(std::clamp(volume, 0.0f, 1.0f) * 32768.0f);
+    target->loop = loop;
+}
+
+void TetrixAudioMixer::stop(TetrixSound sound) {
+    for (Voice &voice : voices) {
+        if (voice.clip && voice.sound == sound) {
+            voice.clip = nullptr;
+        }
+    }
+}
+
+void TetrixAudioMixer::stopAll() {
+    for (Voice &voice : voices) {
+        voice.clip = nullptr;
+    }
+}
+
+int TetrixAudioMixer::activeVoices() const {
+    int count = 0;
+    for (const Voice &voice : voices) {
+        count += voice.clip != nullptr;
+    }
+    return count;
+}
+
+void TetrixAudioMixer::mix(int16_t *out, int frames) {
+    frames = std::min<int>(frames, TetrixAudio::BlockFrames);
+    const int samples = frames * TetrixAudio::Channels;
+    std::fill(accumulator, accumulator + samples, 0);
+    for (Voice &voice : voices) {
+        int done = 0;
+        while (voice.clip && done < frames) {
+            int count = std::min(frames - done, voice.clip->frames() - voice.position);
+            const int16_t *source = voice.clip->samples.data() + voice.position * TetrixAudio::Channels;
+            int32_t *target = accumulator + done * TetrixAudio::Channels;
+            for (int i = 0; i < count * TetrixAudio::Channels; ++i) {
+                target[i] += (source[i] * voice.gain) >> 15;
+            }
+            done += count;
+            voice.position += count;
+            if (voice.position == voice.clip->frames()) {
+                if (voice.loop) {
+                    voice.position = 0;
+                } else {
+                    voice.clip = nullptr;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < samples; ++i) {
+        out[i] = static_cast<int16_t>(std::clamp(accumulator[i], -32768, 32767));
+    }
+}
+
+TetrixNullAudioSink::TetrixNullAudioSink(bool realTime) : realTime(realTime), startNs(0), written(0), peakLevel(0) {}
+
+int TetrixNullAudioSink::writableFrames() {
+    if (!realTime) {
+        return TetrixAudio::BlockFrames * 16;
+    }
+    // Stay up to four blocks ahead of the clock, like a device buffer
+    int64_t nowNs = steadyNs();
+    if (startNs == 0) {
+        startNs = nowNs;
+    }
+    int64_t due = (nowNs - startNs) * TetrixAudio::SampleRate / 1000000000 + 4 * TetrixAudio::BlockFrames;
+    return static_cast<int>(std::max<int64_t>(due - static_cast<int64_t>(framesWritten()), 0));
+}
+
+void TetrixNullAudioSink::write(const int16_t *samples, int frames) {
+    int peak = peakLevel.load(std::memory_order_relaxed);
+    for (int i = 0; i < frames * TetrixAudio::Channels; ++i) {
+        peak = std::max(peak, std::abs(int(samples[i])));
+    }
+    peakLevel.store(peak, std::memory_order_relaxed);
+    written.fetch_add(static_cast<uint64_t>(frames), std::memory_order_relaxed);
+}
+
+TetrixAudioRing::TetrixAudioRing(int capacityFrames)
+    : buffer(static_cast<size_t>(capacityFrames) * TetrixAudio::Channels), capacity(capacityFrames), head(0), tail(0) {}
+
+int TetrixAudioRing::writableFrames() const {
+    return capacity - static_cast<int>(head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+}
+
+int TetrixAudioRing::readableFrames() const {
+    return static_cast<int>(head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed));
+}
+
+int TetrixAudioRing::write(const int16_t *samples, int frames) {
+    uint64_t writePos = head.load(std::memory_order_relaxed);
+    frames = std::min(frames, writableFrames());
+    for (int done = 0; done < frames;) {
+        int index = static_cast<int>((writePos + done) % capacity);
+        int count = std::min(frames - done, capacity - index);
+        std::memcpy(&buffer[index * TetrixAudio::Channels], samples + done * TetrixAudio::Channels,
+                    count * TetrixAudio::Channels * sizeof(int16_t));
+        done += count;
+    }
+    head.store(writePos + frames, std::memory_order_release);
+    return frames;
+}
+
+int TetrixAudioRing::read(int16_t *samples, int frames) {
+    uint64_t readPos = tail.load(std::memory_order_relaxed);
+    frames = std::min(frames, readableFrames());
+    for (int done = 0; done < frames;) {
+        int index = static_cast<int>((readPos + done) % capacity);
+        int count = std::min(frames - done, capacity - index);
+        std::memcpy(samples + done * TetrixAudio::Channels, &buffer[index * TetrixAudio::Channels],
+                    count * TetrixAudio::Channels * sizeof(int16_t));
+        done += count;
+    }
+    tail.store(readPos + frames, std::memory_order_release);
+    return frames;
+}
+
+TetrixAudioEngine::TetrixAudioEngine()
+    : sink(nullptr), running(false), queueHead(0), queueTail(0), droppedCommands(0), blocks(0), stolenVoices(0), maxMixNs(0) {}
+
+TetrixAudioEngine::~TetrixAudioEngine() {
+    stop();
+}
+
+bool TetrixAudioEngine::setClip(TetrixSound sound, TetrixAudioClip clip) {
+    TetrixAudioClip &slot = clips[static_cast<int>(sound)];
+    if (isRunning()) {
+        // The mixer picks the clip up through the queue, which publishes the PCM written here
+        if (!slot.samples.empty()) {
+            return false;
+        }
+        slot = std::move(clip);
+        if (!post({ CommandType::SetClip, sound, false, 0.0f })) {
+            slot = TetrixAudioClip();
+            return false;
+        }
+        return true;
+    }
+    slot = std::move(clip);
+    mixer.setClip(sound, &slot);
+    return true;
+}
+
+bool TetrixAudioEngine::start(TetrixAudioSink *output) {
+    if (isRunning() || !output) {
+        return false;
+    }
+    sink = output;
+    running.store(true, std::memory_order_relaxed);
+    mixerThread = std::thread(&TetrixAudioEngine::run, this);
+    return true;
+}
+
+void TetrixAudioEngine::stop() {
+    if (!isRunning()) {
+        return;
+    }
+    running.store(false, std::memory_order_relaxed);
+    mixerThread.join();
+    mixer.stopAll();
+    queueTail.store(queueHead.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+bool TetrixAudioEngine::play(TetrixSound sound, float volume, bool loop) {
+    return post({ CommandType::Play, sound, loop, volume });
+}
+
+bool TetrixAudioEngine::stopSound(TetrixSound sound) {
+    return post({ CommandType::Stop, sound, false, 0.0f });
+}
+
+bool TetrixAudioEngine::stopAllSounds() {
+    return post({ CommandType::StopAll, TetrixSound::Drop, false, 0.0f });
+}
+
+TetrixAudioEngine::Stats TetrixAudioEngine::stats() const {
+    Stats stats;
+    stats.blocks = blocks.load(std::memory_order_relaxed);
+    stats.droppedCommands = droppedCommands.load(std::memory_order_relaxed);
+    stats.stolenVoices = stolenVoices.load(std::memory_order_relaxed);
+    stats.maxMixNs = maxMixNs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool TetrixAudioEngine::post(const Command &command) {
+    uint32_t headIndex = queueHead.load(std::memory_order_relaxed);
+    if (headIndex - queueTail.load(std::memory_order_acquire) == QueueCapacity) {
+        droppedCommands.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    queue[headIndex & (QueueCapacity - 1)] = command;
+    queueHead.store(headIndex + 1, std::memory_order_release);
+    return true;
+}
+
+void TetrixAudioEngine::drainCommands() {
+    uint32_t tailIndex = queueTail.load(std::memory_order_relaxed);
+    uint32_t headIndex = queueHead.load(std::memory_order_acquire);
+    for (; tailIndex != headIndex; ++tailIndex) {
+        const Command &command = queue[tailIndex & (QueueCapacity - 1)];
+        switch (command.type) {
+        case CommandType::Play:
+            mixer.play(command.sound, command.volume, command.loop);
+            break;
+        case CommandType::Stop:
+            mixer.stop(command.sound);
+            break;
+        case CommandType::StopAll:
+            mixer.stopAll();
+            break;
+        case CommandType::SetClip:
+            mixer.setClip(command.sound, &clips[static_cast<int>(command.sound)]);
+            break;
+        }
+    }
+    queueTail.store(tailIndex, std::memory_order_release);
+}
+
+void TetrixAudioEngine::run() {
+    int16_t block[TetrixAudio::BlockFrames * TetrixAudio::Channels];
+    // A quarter block: commands start playing within about 1.5 ms plus the sink's buffering
+    const std::chrono::nanoseconds idle(int64_t(TetrixAudio::BlockFrames) * 1000000000 / TetrixAudio::SampleRate / 4);
+    while (running.load(std::memory_order_relaxed)) {
+        drainCommands();
+        if (sink->writableFrames() < TetrixAudio::BlockFrames) {
+            std::this_thread::sleep_for(idle);
+            continue;
+        }
+        int64_t beginNs = steadyNs();
+        {
+            TETRIX_TRACE_SCOPE_DEBUG(TetrixTraceId::AudioMix, mixer.activeVoices());
+            mixer.mix(block, TetrixAudio::BlockFrames);
+        }
+        uint64_t mixNs = static_cast<uint64_t>(steadyNs() - beginNs);
+        sink->write(block, TetrixAudio::BlockFrames);
+        blocks.fetch_add(1, std::memory_order_relaxed);
+        stolenVoices.store(mixer.stolenVoices(), std::memory_order_relaxed);
+        if (mixNs > maxMixNs.load(std::memory_order_relaxed)) {
+            maxMixNs.store(mixNs, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,177 @@
+#ifndef TETRIXAUDIO_H
+#define TETRIXAUDIO_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+enum class TetrixSound : uint8_t { Drop, LineClear, GameOver, Background, Count };
+
+// Every clip is decoded once into the mixer's own format, so playing it is a pointer and a position
+namespace TetrixAudio {
+
+enum { SampleRate = 44100, Channels = 2, BlockFrames = 256, MaxVoices = 16 };
+
+} // namespace TetrixAudio
+
+// Interleaved 16-bit stereo PCM at TetrixAudio::SampleRate
+struct TetrixAudioClip {
+    std::vector<int16_t> samples;
+
+    int frames() const { return static_cast<int>(samples.size() / TetrixAudio::Channels); }
+};
+
+namespace TetrixAudio {
+
+// Decodes an in-memory RIFF/WAVE file (8-, 16- or 24-bit PCM, mono or stereo, any rate) into clip,
+// resampling linearly to SampleRate; false for anything else
+bool decodeWav(const uint8_t *data, size_t size, TetrixAudioClip &clip);
+
+} // namespace TetrixAudio
+
+// Fixed pool of voices summed into blocks of PCM. Not thread-safe: TetrixAudioEngine drives it from
+// its mixer thread, tools call it directly.
+class TetrixAudioMixer {
+public:
+    TetrixAudioMixer();
+
+    // Clips must stay alive and unchanged while the mixer can play them
+    void setClip(TetrixSound sound, const TetrixAudioClip *clip);
+
+    // Starts a voice; with every voice busy the one closest to its end is taken over
+    void play(TetrixSound sound, float volume, bool loop);
+    void stop(TetrixSound sound);
+    void stopAll();
+    // Writes frames (at most BlockFrames) of interleaved output; silence when nothing plays
+    void mix(int16_t *out, int frames);
+
+    int activeVoices() const;
+    uint64_t stolenVoices() const { return stolen; }
+
+private:
+    struct Voice {
+        const TetrixAudioClip *clip = nullptr; // nullptr when free
+        TetrixSound sound = TetrixSound::Drop;
+        int position = 0; // Next frame
+        int32_t gain = 0; // Q15
+        bool loop = false;
+    };
+
+    const TetrixAudioClip *clips[static_cast<int>(TetrixSound::Count)];
+    Voice voices[TetrixAudio::MaxVoices];
+    int32_t accumulator[TetrixAudio::BlockFrames * TetrixAudio::Channels];
+    uint64_t stolen;
+};
+
+// Where the mixer thread sends its output. Both calls come from the mixer thread only.
+class TetrixAudioSink {
+public:
+    virtual ~TetrixAudioSink() = default;
+    // Frames write() can take now without blocking
+    virtual int writableFrames() = 0;
+    virtual void write(const int16_t *samples, int frames) = 0;
+};
+
+// Discards the output, for headless runs. Real-time pacing takes frames as fast as a device
+// would; without it the mixer runs flat out, for throughput measurements.
+class TetrixNullAudioSink : public TetrixAudioSink {
+public:
+    explicit TetrixNullAudioSink(bool realTime = true);
+
+    int writableFrames() override;
+    void write(const int16_t *samples, int frames) override;
+
+    uint64_t framesWritten() const { return written.load(std::memory_order_relaxed); }
+    int peak() const { return peakLevel.load(std::memory_order_relaxed); } // Largest absolute sample so far
+
+private:
+    bool realTime;
+    int64_t startNs; // Pacing clock, from the first writableFrames() call
+    std::atomic<uint64_t> written;
+    std::atomic<int> peakLevel;
+};
+
+// Single-producer single-consumer ring of interleaved PCM frames between the mixer thread and an
+// audio device callback. Fixed capacity, no locks, no allocation after construction.
+class TetrixAudioRing {
+public:
+    explicit TetrixAudioRing(int capacityFrames);
+
+    int writableFrames() const;
+    int readableFrames() const;
+    // Both return the frames actually copied
+    int write(const int16_t *samples, int frames);
+    int read(int16_t *samples, int frames);
+
+private:
+    std::vector<int16_t> buffer;
+    int capacity; // Frames
+    alignas(64) std::atomic<uint64_t> head; // Frames written
+    alignas(64) std::atomic<uint64_t> tail; // Frames read
+};
+
+// Owns the mixer and its thread. Game code posts commands through a lock-free queue and never waits:
+// a full queue drops the command (counted in stats()). Only one thread may post commands.
+class TetrixAudioEngine {
+public:
+    enum { QueueCapacity = 256 }; // Power of two
+
+    struct Stats {
+        uint64_t blocks = 0; // Blocks mixed
+        uint64_t droppedCommands = 0; // Queue full
+        uint64_t stolenVoices = 0; // Voice pool full
+        uint64_t maxMixNs = 0; // Slowest block
+    };
+
+    TetrixAudioEngine();
+    ~TetrixAudioEngine();
+    TetrixAudioEngine(const TetrixAudioEngine &) = delete;
+    TetrixAudioEngine &operator=(const TetrixAudioEngine &) = delete;
+
+    // The engine keeps the decoded PCM for its lifetime. Clips can arrive after start() (assets decoded
+    // in the background), but each sound's only once: false if it already has one.
+    bool setClip(TetrixSound sound, TetrixAudioClip clip);
+    bool hasClip(TetrixSound sound) const { return !clips[static_cast<int>(sound)].samples.empty(); }
+
+    // Starts the mixer thread writing to sink, which must outlive stop()
+    bool start(TetrixAudioSink *sink);
+    void stop();
+    bool isRunning() const { return mixerThread.joinable(); }
+
+    bool play(TetrixSound sound, float volume = 1.0f, bool loop = false);
+    bool stopSound(TetrixSound sound);
+    bool stopAllSounds();
+
+    Stats stats() const;
+
+private:
+    enum class CommandType : uint8_t { Play, Stop, StopAll, SetClip };
+
+    struct Command {
+        CommandType type;
+        TetrixSound sound;
+        bool loop;
+        float volume;
+    };
+
+    bool post(const Command &command);
+    void run();
+    void drainCommands();
+
+    TetrixAudioClip clips[static_cast<int>(TetrixSound::Count)];
+    TetrixAudioMixer mixer; // Mixer thread only
+    TetrixAudioSink *sink;
+    std::thread mixerThread;
+    std::atomic<bool> running;
+    Command queue[QueueCapacity];
+    alignas(64) std::atomic<uint32_t> queueHead; // Commands posted
+    alignas(64) std::atomic<uint32_t> queueTail; // Commands taken by the mixer
+    std::atomic<uint64_t> droppedCommands;
+    std::atomic<uint64_t> blocks;
+    std::atomic<uint64_t> stolenVoices;
+    std::atomic<uint64_t> maxMixNs;
+};
+
+#endif // TETRIXAUDIO_H
@@ -0,0 +1,74 @@
+#include "TetrixAudioOutput.h"
+#include <QAudioDevice>
+#include <QAudioFormat>
+#include <QAudioSink>
+#include <QDebug>
+#include <QIODevice>
+#include <QMediaDevices>
+#include <cstring>
+
+// Pull-mode source for the QAudioSink: hands out whatever the mixer has queued
+class TetrixAudioOutput::Device : public QIODevice {
+public:
+    Device(TetrixAudioRing &ring, std::atomic<qint64> &underruns) : ring(ring), underruns(underruns) {}
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override { return ring.readableFrames() * FrameBytes + QIODevice::bytesAvailable(); }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override {
+        int frames = static_cast<int>(maxSize / FrameBytes);
+        int16_t *samples = reinterpret_cast<int16_t *>(data);
+        int copied = ring.read(samples, frames);
+        if (copied < frames) {
+            std::memset(samples + copied * TetrixAudio::Channels, 0, (frames - copied) * FrameBytes);
+            underruns.fetch_add(frames - copied, std::memory_order_relaxed);
+        }
+        return qint64(frames) * FrameBytes;
+    }
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    enum { FrameBytes = TetrixAudio::Channels * sizeof(int16_t) };
+
+    TetrixAudioRing &ring;
+    std::atomic<qint64> &underruns;
+};
+
+TetrixAudioOutput::TetrixAudioOutput() : ring(RingFrames), underruns(0) {}
+
+TetrixAudioOutput::~TetrixAudioOutput() {
+    close();
+}
+
+bool TetrixAudioOutput::open() {
+    QAudioDevice output = QMediaDevices::defaultAudioOutput();
+    QAudioFormat format;
+    format.setSampleRate(TetrixAudio::SampleRate);
+    format.setChannelCount(TetrixAudio::Channels);
+    format.setSampleFormat(QAudioFormat::Int16);
+    if (output.isNull() || !output.isFormatSupported(format)) {
+        qDebug() << "No audio output for" << TetrixAudio::SampleRate << "Hz stereo 16-bit";
+        return false;
+    }
+    device = std::make_unique<Device>(ring, underruns);
+    device->open(QIODevice::ReadOnly);
+    sink = std::make_unique<QAudioSink>(output, format);
+    sink->setBufferSize(RingFrames * TetrixAudio::Channels * sizeof(int16_t));
+    sink->start(device.get());
+    if (sink->error() != QAudio::NoError) {
+        qDebug() << "Audio output failed to start:" << sink->error();
+        close();
+        return false;
+    }
+    qDebug() << "Audio output:" << output.description();
+    return true;
+}
+
+void TetrixAudioOutput::close() {
+    if (sink) {
+        sink->stop();
+        sink.reset();
+    }
+    device.reset();
+}
@@ -0,0 +1,40 @@
+#ifndef TETRIXAUDIOOUTPUT_H
+#define TETRIXAUDIOOUTPUT_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+#include "TetrixAudio.h"
+
+class QAudioSink;
+class QIODevice;
+
+// TetrixAudioEngine output through one QAudioSink on the default device. The mixer thread fills a
+// PCM ring; the sink pulls from it on Qt's side with a copy and nothing else, padding with silence
+// (counted as underrun frames) when the mixer is late.
+class TetrixAudioOutput : public TetrixAudioSink {
+public:
+    enum { RingFrames = 2048 }; // About 46 ms between the mixer and the device
+
+    TetrixAudioOutput();
+    ~TetrixAudioOutput() override;
+
+    // GUI thread; false when there is no output device or it rejects the mixer's format
+    bool open();
+    void close();
+
+    int writableFrames() override { return ring.writableFrames(); }
+    void write(const int16_t *samples, int frames) override { ring.write(samples, frames); }
+
+    qint64 underrunFrames() const { return underruns.load(std::memory_order_relaxed); }
+
+private:
+    class Device;
+
+    TetrixAudioRing ring;
+    std::atomic<qint64> underruns;
+    std::unique_ptr<Device> device;
+    std::unique_ptr<QAudioSink> sink;
+};
+
+#endif // TETRIXAUDIOOUTPUT_H
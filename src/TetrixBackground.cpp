@@ -0,0 +1,83 @@
+#include "TetrixBackground.h"
+#include "TetrixTrace.h"
+#include <QPaintEvent>
+#include <QPainter>
+
+namespace {
+
+// Scales image to cover size exactly, cropping the overflow evenly on both sides
+QImage coverScaled(const QImage &image, const QSize &size) {
+    QImage scaled = image.scaled(size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+    return scaled.copy((scaled.width() - size.width()) / 2, (scaled.height() - size.height()) / 2, size.width(), size.height());
+}
+
+} // namespace
+
+TetrixBackground::TetrixBackground(QWidget *parent) : QWidget(parent), generation(0) {
+    pool.setMaxThreadCount(1);
+    rescaleTimer.setSingleShot(true);
+    rescaleTimer.setInterval(RescaleDelayMs);
+    connect(&rescaleTimer, &QTimer::timeout, this, &TetrixBackground::rescale);
+}
+
+TetrixBackground::~TetrixBackground() {
+    // Results still queued for this widget are discarded with it
+    pool.clear();
+    pool.waitForDone();
+}
+
+void TetrixBackground::setImage(const QImage &image) {
+    source = image;
+    cache = QPixmap();
+    cacheSize = QSize();
+    rescale();
+}
+
+QSize TetrixBackground::targetSize() const {
+    return size() * devicePixelRatioF();
+}
+
+void TetrixBackground::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    if (!source.isNull()) {
+        rescaleTimer.start(); // Restarted by every resize of a drag
+    }
+}
+
+void TetrixBackground::rescale() {
+    QSize size = targetSize();
+    if (source.isNull() || size.isEmpty() || size == cacheSize) {
+        return;
+    }
+    quint64 request = ++generation;
+    QImage image = source; // Shared, not copied
+    qreal pixelRatio = devicePixelRatioF();
+    pool.start([this, request, image, size, pixelRatio] {
+        TETRIX_TRACE_SCOPE_INFO(TetrixTraceId::BackgroundScale, size.width(), size.height());
+        QImage scaled = coverScaled(image, size);
+        scaled.setDevicePixelRatio(pixelRatio);
+        QMetaObject::invokeMethod(this, [this, request, scaled, size] {
+            if (request != generation) {
+                return;
+            }
+            cache = QPixmap::fromImage(scaled);
+            cacheSize = size;
+            update();
+        }, Qt::QueuedConnection);
+    });
+}
+
+void TetrixBackground::paintEvent(QPaintEvent *event) {
+    QWidget::paintEvent(event);
+    if (cache.isNull()) {
+        return;
+    }
+    QPainter painter(this);
+    if (cacheSize == targetSize()) {
+        painter.drawPixmap(0, 0, cache);
+        return;
+    }
+    // Mid-resize: stretch the last smooth result without filtering until the rescale lands
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter.drawPixmap(rect(), cache);
+}
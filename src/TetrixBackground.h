@@ -0,0 +1,41 @@
+#ifndef TETRIXBACKGROUND_H
+#define TETRIXBACKGROUND_H
+
+#include <QImage>
+#include <QPixmap>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWidget>
+
+// Container widget that draws a decoded image behind its children, scaled to cover it and centered.
+// Paints only blit a pixmap cached at the widget's size. A resize is debounced; while it lasts the
+// stale cache is stretched with a fast, unfiltered scale, and once it settles a worker thread
+// rescales the source image smoothly. Transparent until setImage().
+class TetrixBackground : public QWidget {
+    Q_OBJECT
+
+public:
+    enum { RescaleDelayMs = 120 }; // Quiet time after the last resize before a smooth rescale
+
+    explicit TetrixBackground(QWidget *parent = nullptr);
+    ~TetrixBackground();
+
+    void setImage(const QImage &image);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    QSize targetSize() const; // Device pixels
+    void rescale();
+
+    QImage source; // Full-size decoded image, kept for every rescale
+    QPixmap cache; // Source scaled to cover cacheSize
+    QSize cacheSize;
+    QTimer rescaleTimer;
+    QThreadPool pool; // One thread; a rescale never waits behind others
+    quint64 generation; // Latest rescale request; older results are dropped
+};
+
+#endif // TETRIXBACKGROUND_H
@@ -1,125 +1,273 @@
 #include "TetrixBoard.h"
+#include "TetrixAssets.h"
+#include "TetrixBot.h"
+#include "TetrixPreview.h"
+#include "TetrixTrace.h"
 #include <QPainter>
 #include <QKeyEvent>
-#include <QLabel>
 #include <QTimer>
 #include <QDebug>
 #include <QCoreApplication>
-#include <QUrl>
+#include <QFile>
 #include <QDir>
+#include <QDateTime>
+#include <QRandomGenerator>
+#include <QtMath>
+#include <algorithm>
+#include <iterator>
 
-TetrixBoard::TetrixBoard(QWidget *parent)
-    : QFrame(parent), nextPieceLabel(nullptr), isStarted(false), isPaused(false), isWaitingAfterLine(false), isDropping(false), flashTimer(nullptr), soundDelayTimer(nullptr), flashState(false),
-      dropCycleCount(0), lineClearCycleCount(0), gameOverCycleCount(0), backgroundCycleCount(0),
-      dropSound(nullptr), lineClearSound(nullptr), gameOverSound(nullptr), backgroundSound(nullptr)
+namespace {
+
+bool inputForKey(int key, TetrixInput &input) {
+    switch (key) {
+    case Qt::Key_Left:
+        input = TetrixInput::Left;
+        return true;
+    case Qt::Key_Right:
+        input = TetrixInput::Right;
+        return true;
+    case Qt::Key_Down:
+    case Qt::Key_D:
+        input = TetrixInput::SoftDrop;
+        return true;
+    case Qt::Key_Up:
+        input = TetrixInput::RotateRight;
+        return true;
+    case Qt::Key_Space:
+        input = TetrixInput::HardDrop;
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+TetrixBoard::TetrixBoard(QWidget *parent, Role role)
+    : QFrame(parent), preview(nullptr), role(role), ownLoop(ownEngine), engine(&ownEngine), loop(&ownLoop), versus(nullptr),
+      versusPlayer(0), broadcast(nullptr), flashTimer(nullptr), isPaused(false), flashState(false),
+      practice(false), rewound(false), scrubbing(false), scrubPosition(0), scrubDirection(0), botContext(nullptr), bot(nullptr),
+      aiPlay(false), botRequestId(0), layerSquareSize(0), layerPixelRatio(0), lockedLayerDirty(true)
 {
     // Remove default frame to avoid extra margins
     setFrameStyle(QFrame::NoFrame);
-    setFocusPolicy(Qt::StrongFocus);
-    clearBoard();
+    setFocusPolicy(role == Role::Player ? Qt::StrongFocus : Qt::NoFocus);
 
     // Ensure no maximum size constraint
     setMaximumSize(QWIDGETSIZE_MAX, QWIDGETSIZE_MAX);
 
-    nextPiece.setRandomShape();
-    newPiece();
-
-    // Initialize sound effects with absolute paths
-    QString soundDir = "/home/time/introCode/c++/TetrixGame/sounds/";
-    qDebug() << "Loading sounds from absolute path:" << soundDir;
+    // Held-key timing; TETRIX_DAS_MS, TETRIX_ARR_MS and TETRIX_SOFT_DROP_MS override the defaults
+    TetrixRepeatSettings repeat;
+    bool ok;
+    int value = qEnvironmentVariableIntValue("TETRIX_DAS_MS", &ok);
+    if (ok) repeat.dasMs = value;
+    value = qEnvironmentVariableIntValue("TETRIX_ARR_MS", &ok);
+    if (ok) repeat.arrMs = value;
+    value = qEnvironmentVariableIntValue("TETRIX_SOFT_DROP_MS", &ok);
+    if (ok) repeat.softDropMs = value;
+    loop->setRepeatSettings(repeat);
+    // Pause before the next piece after a line clear; TETRIX_LINE_CLEAR_DELAY_MS, none by default
+    value = qEnvironmentVariableIntValue("TETRIX_LINE_CLEAR_DELAY_MS", &ok);
+    if (ok) engine->setLineClearDelay(value);
+    loop->setRecorder(&recorder);
+    practice = role == Role::Player && qEnvironmentVariableIntValue("TETRIX_PRACTICE") != 0;
+    if (practice) {
+        ownLoop.setRewind(&rewind);
+    }
 
-    QStringList soundFiles = {"drop.wav", "lineclear.wav", "gameover.wav", "background.wav"};
-    QSoundEffect **sounds[] = {&dropSound, &lineClearSound, &gameOverSound, &backgroundSound};
-    bool isLooping[] = {false, false, true, true};
-    int *cycleCounts[] = {&dropCycleCount, &lineClearCycleCount, &gameOverCycleCount, &backgroundCycleCount};
+    latencyClock.start();
+    std::fill(std::begin(pendingInputNs), std::end(pendingInputNs), -1);
+    if (role == Role::Player) {
+        latencyReportPath = qEnvironmentVariable("TETRIX_LATENCY");
+    }
 
-    for (int i = 0; i < 4; ++i) {
-        QString filePath = soundDir + soundFiles[i];
-        resetSound(sounds[i], filePath, isLooping[i], *cycleCounts[i]);
-        soundFilePaths[*sounds[i]] = filePath;
-        // Use lambda to adapt signal to slot
-        connect(*sounds[i], &QSoundEffect::statusChanged, this, [this, sound = *sounds[i]]() {
-            onSoundStatusChanged(sound->status());
-        });
+    // Sounds arrive through installSound() as they are decoded; until then they play as silence
+    // TETRIX_AUDIO=null mixes into nothing, for headless and offscreen runs
+    if (role == Role::Opponent || qgetenv("TETRIX_AUDIO") == "null" || !audioOutput.open()) {
+        audio.start(&nullAudio);
+    } else {
+        audio.start(&audioOutput);
     }
 
     // Initialize flash timer for line-clear animation
     flashTimer = new QTimer(this);
     connect(flashTimer, &QTimer::timeout, this, [this]() {
         flashState = !flashState;
-        update();
+        updateLineFlash();
+        if (++lineFlash.toggles >= FlashToggles) {
+            flashTimer->stop();
+            lineFlash.count = 0;
+        }
     });
 
-    // Initialize sound delay timer (not used in simplified playback for testing)
-    soundDelayTimer = new QTimer(this);
-    soundDelayTimer->setSingleShot(true);
+    // Bot search runs on its own thread; the GUI thread only receives the chosen inputs
+    if (role == Role::Player) {
+        bot = new TetrixBot;
+        botContext = new QObject;
+        botContext->moveToThread(&botThread);
+        botThread.start();
+    }
 }
 
 TetrixBoard::~TetrixBoard() {
-    delete dropSound;
-    delete lineClearSound;
-    delete gameOverSound;
-    delete backgroundSound;
-}
-
-void TetrixBoard::onSoundStatusChanged(QSoundEffect::Status status) {
-    // Log status changes for debugging
-    QSoundEffect *sound = qobject_cast<QSoundEffect*>(sender());
-    QString filePath = soundFilePaths.value(sound, "unknown");
-    qDebug() << "Sound status changed for" << filePath << ": status=" << status
-             << ", isLoaded=" << (sound ? sound->isLoaded() : false)
-             << ", isPlaying=" << (sound ? sound->isPlaying() : false);
-}
-
-void TetrixBoard::resetSound(QSoundEffect **sound, const QString &filePath, bool isLooping, int &cycleCount) {
-    // Delete existing sound instance and create a new one to reset GStreamer pipeline
-    if (*sound) {
-        (*sound)->stop();
-        delete *sound;
-    }
-    *sound = new QSoundEffect(this);
-    (*sound)->setSource(QUrl::fromLocalFile(filePath));
-    if (!QFile::exists(filePath)) {
-        qDebug() << "ERROR: Sound file not found:" << filePath;
-    } else {
-        qDebug() << "Sound file loaded:" << filePath;
+    if (!latencyReportPath.isEmpty()) {
+        writeLatencyReport();
     }
-    // Set volume: 0.7f for drop.wav, 0.3f for background.wav, 0.5f for others
-    (*sound)->setVolume(filePath.endsWith("drop.wav") ? 0.7f : (filePath.endsWith("background.wav") ? 0.3f : 0.5f));
-    if (isLooping) {
-        (*sound)->setLoopCount(QSoundEffect::Infinite);
-        qDebug() << "Sound set to loop indefinitely:" << filePath;
+    botThread.quit();
+    botThread.wait();
+    delete botContext;
+    delete bot;
+    audio.stop();
+    audioOutput.close();
+}
+
+void TetrixBoard::setPreview(TetrixPreview *widget) {
+    preview = widget;
+    preview->setSquareSize(previewSquareSize());
+    preview->showPieces(*engine);
+}
+
+void TetrixBoard::setVersus(TetrixVersusMatch *match, int player) {
+    timer.stop();
+    loop->releaseAll();
+    ++botRequestId;
+    versus = match;
+    versusPlayer = player;
+    engine = match ? &match->engine(player) : &ownEngine;
+    loop = match ? &match->loop(player) : &ownLoop;
+    isPaused = false;
+    flashTimer->stop();
+    lineFlash.count = 0;
+    lockedLayerDirty = true;
+    scrubbing = false;
+    scrubTimer.stop();
+    if (match && role == Role::Player) {
+        // Runs through the handshake and countdown too, which need polling
+        timer.start(FrameIntervalMs, Qt::PreciseTimer, this);
+        audio.stopSound(TetrixSound::Background);
+        audio.play(TetrixSound::Background, 0.3f, true);
     }
-    // Check if the sound is loaded
-    if (!(*sound)->isLoaded()) {
-        qDebug() << "WARNING: QSoundEffect reports not loaded for:" << filePath << "(may still play)";
+    refreshVersus();
+    update();
+}
+
+void TetrixBoard::setBroadcast(TetrixBroadcastServer *server) {
+    broadcast = server;
+    if (broadcast) {
+        broadcastClock.start();
+        broadcastTimer.start(TetrixBroadcastEncoder::MinKeyframeGapMs, this);
+        publishBroadcast();
     } else {
-        qDebug() << "QSoundEffect successfully loaded for:" << filePath;
+        broadcastTimer.stop();
     }
-    soundFilePaths[*sound] = filePath; // Update sound file path
-    cycleCount = 0; // Reset cycle count
 }
 
-void TetrixBoard::playSoundWithDelay(QSoundEffect *sound, int &cycleCount, const QString &filePath, bool isLooping) {
-    // Simplified playback for testing: play sound directly without delay
-    if (cycleCount >= MaxSoundCycles || sound->status() == QSoundEffect::Error) {
-        qDebug() << "Sound reached cycle limit or error, reinitializing, cycle count:" << cycleCount << ", file:" << filePath;
-        resetSound(&sound, filePath, isLooping, cycleCount);
+void TetrixBoard::publishBroadcast() {
+    if (!broadcast) {
+        return;
+    }
+    // Only what changed since the last frame is encoded; the server thread does the sending
+    uint32_t timeMs = static_cast<uint32_t>(broadcastClock.elapsed());
+    if (TetrixBroadcastFramePtr frame = broadcastEncoder.encode(*engine, timeMs, broadcast->wantsKeyframe())) {
+        broadcast->publish(std::move(frame));
     }
-    if (sound->isPlaying()) {
-        sound->stop();
-        qDebug() << "Sound was playing, stopped before restart, file:" << filePath;
+}
+
+void TetrixBoard::startScrub(int direction) {
+    if (versus || isPaused || !engine->isStarted() || rewind.isEmpty()) {
+        return;
+    }
+    if (!scrubbing) {
+        // The game stops where it is; the history holds every position since the start, or the last Capacity
+        scrubbing = true;
+        timer.stop();
+        loop->releaseAll();
+        // Every position starts a fresh gravity interval, so the piece is drawn at its row
+        TetrixGameLoopState state;
+        loop->saveState(state);
+        state.gravityNs = 0;
+        loop->restoreState(state);
+        ++botRequestId;
+        flashTimer->stop();
+        lineFlash.count = 0;
+        audio.stopSound(TetrixSound::Background);
+        scrubPosition = engine->piecesDropped();
+        if (!rewound) {
+            rewound = true;
+            loop->setRecorder(nullptr);
+            recorder = TetrixReplayRecorder();
+            qDebug() << "Rewinding: this game will not be recorded; history holds pieces" << rewind.first() << "to"
+                     << rewind.last() << "in" << rewind.memoryBytes() << "bytes";
+        }
     }
-    // Play sound immediately and log details
-    sound->play();
-    cycleCount++;
-    qDebug() << "Attempting to play sound, cycle count:" << cycleCount << ", file:" << filePath
-             << ", status:" << sound->status() << ", isLoaded:" << sound->isLoaded()
-             << ", isPlaying:" << sound->isPlaying();
+    scrubDirection = direction;
+    stepScrub();
+    scrubTimer.start(ScrubIntervalMs, Qt::PreciseTimer, this);
 }
 
-void TetrixBoard::setNextPieceLabel(QLabel *label) {
-    nextPieceLabel = label;
+void TetrixBoard::stepScrub() {
+    // Each position is the board as the piece after it spawned; the history's ends hold the scrub still
+    int target = std::clamp(scrubPosition + scrubDirection, rewind.first(), rewind.last());
+    if (target == scrubPosition) {
+        return;
+    }
+    if (!rewind.seek(target, *engine)) {
+        qDebug() << "Rewind: cannot rebuild piece" << target;
+        return;
+    }
+    scrubPosition = target;
+    lockedLayerDirty = true;
+    if (preview) {
+        preview->showPieces(*engine);
+    }
+    emit scoreChanged(engine->score());
+    emit levelChanged(engine->level());
+    emit linesRemovedChanged(engine->linesRemoved());
+    publishBroadcast();
+    update();
+}
+
+void TetrixBoard::stopScrub() {
+    // Later positions are another game now
+    scrubbing = false;
+    scrubDirection = 0;
+    scrubTimer.stop();
+    rewind.truncate(scrubPosition);
+    loop->resync(gameClock.nsecsElapsed()); // The time spent rewinding is not simulated
+    timer.start(FrameIntervalMs, Qt::PreciseTimer, this);
+    audio.play(TetrixSound::Background, 0.3f, true);
+    requestBotMove();
+}
+
+void TetrixBoard::refreshVersus() {
+    if (!versus) {
+        if (preview) {
+            preview->showPieces(*engine);
+        }
+        return;
+    }
+    handleEvents(versus->takeEvents(versusPlayer));
+    // Gravity interpolation moves the piece between rows even when no event happened
+    QRect piece = pieceRect(boardRect());
+    if (piece != paintedPieceRect) {
+        update(paintedPieceRect);
+        update(piece);
+    }
+}
+
+int TetrixBoard::previewSquareSize() const {
+    // The board's own square size, from the space it has to share with the panel
+    QSize parentSize = parentWidget() ? parentWidget()->size() : QSize(600, 450);
+    int squareSize = qMin(parentSize.width() / BoardWidth, parentSize.height() / BoardHeight);
+    return qMax(15, squareSize); // Minimum square size
+}
+
+void TetrixBoard::resizeEvent(QResizeEvent *event) {
+    QFrame::resizeEvent(event);
+    // A no-op unless the square size stepped, so the panel relayouts rarely
+    if (preview) {
+        preview->setSquareSize(previewSquareSize());
+    }
 }
 
 QSize TetrixBoard::sizeHint() const {
@@ -127,47 +275,105 @@ QSize TetrixBoard::sizeHint() const {
     QSize parentSize = parentWidget() ? parentWidget()->size() : QSize(600, 450);
     int scaleFactor = qMin(parentSize.width() / BoardWidth, parentSize.height() / BoardHeight);
     if (scaleFactor < 15) scaleFactor = 15; // Minimum square size
-    qDebug() << "Board sizeHint: parentSize=" << parentSize << ", scaleFactor=" << scaleFactor
-             << ", suggested size=" << QSize(BoardWidth * scaleFactor, BoardHeight * scaleFactor);
+    TETRIX_TRACE_DEBUG(TetrixTraceId::SizeHint, BoardWidth * scaleFactor, BoardHeight * scaleFactor);
     return QSize(BoardWidth * scaleFactor, BoardHeight * scaleFactor);
 }
 
 QSize TetrixBoard::minimumSizeHint() const {
     // Minimum size for visibility (10x22 grid at 15px per square)
-    qDebug() << "Board minimumSizeHint: width=" << BoardWidth * 15 << ", height=" << BoardHeight * 15;
     return QSize(BoardWidth * 15, BoardHeight * 15);
 }
 
 void TetrixBoard::start() {
-    if (isPaused) {
+    if (isPaused || versus) {
         return;
     }
+    scrubbing = false;
+    scrubTimer.stop();
+    rewound = false;
+    loop->setRecorder(&recorder); // A resumed or rewound game may have played without one
+
+    // Every game gets its own seed so the replay can reproduce it exactly
+    quint64 seed = QRandomGenerator::global()->generate64();
+    gameClock.start();
+    unsigned events = loop->start(seed, TetrixRandomizer::Mode::Uniform, gameClock.nsecsElapsed());
+    lockedLayerDirty = true;
+    flashTimer->stop();
+    lineFlash.count = 0;
+    fullPaints = PaintStats();
+    piecePaints = PaintStats();
+
+    emit linesRemovedChanged(engine->linesRemoved());
+    emit scoreChanged(engine->score());
+    emit levelChanged(engine->level());
+    emit pauseStateChanged(false); // Ensure pause state is reset
 
-    isStarted = true;
-    isWaitingAfterLine = false;
-    isDropping = false; // Reset dropping state
-    numLinesRemoved = 0;
-    numPiecesDropped = 0;
-    score = 0;
-    level = 1;
-    clearBoard();
-    flashingLines.clear();
+    timer.start(FrameIntervalMs, Qt::PreciseTimer, this);
+    audio.stopSound(TetrixSound::Background);
+    audio.play(TetrixSound::Background, 0.3f, true);
+    handleEvents(events);
+}
 
-    emit linesRemovedChanged(numLinesRemoved);
-    emit scoreChanged(score);
-    emit levelChanged(level);
-    emit pauseStateChanged(false); // Ensure pause state is reset
+bool TetrixBoard::captureGame(TetrixSaveGame &save) const {
+    if (versus || !engine->isStarted()) {
+        return false;
+    }
+    save.capture(*engine, *loop, &recorder, rewound ? TetrixSaveHeader::Rewound : 0);
+    return true;
+}
 
-    newPiece();
-    timer.start(1000 / level, this);
-    playSoundWithDelay(backgroundSound, backgroundCycleCount, "/home/time/introCode/c++/TetrixGame/sounds/background.wav", true);
+bool TetrixBoard::resumeGame(const TetrixSaveGame &save) {
+    if (versus || !save.restoreEngine(*engine)) {
+        return false;
+    }
+    timer.stop();
+    ++botRequestId;
+    gameClock.start();
+    save.restoreLoop(*loop, gameClock.nsecsElapsed());
+    // Rewound before it was saved, or saved without a replay to continue: play on unrecorded and unranked
+    rewound = !save.isRanked() || !save.restoreReplay(recorder);
+    if (rewound) {
+        qDebug() << "Resumed game was rewound or has no replay to continue; it will not be recorded or ranked";
+        recorder = TetrixReplayRecorder();
+        loop->setRecorder(nullptr);
+    }
+    lockedLayerDirty = true;
+    lineFlash.count = 0;
+    if (engine->isWaitingAfterLine() && engine->clearedLineCount() > 0) {
+        startLineFlash(); // Plays once the game is unpaused
+    }
+    flashTimer->stop();
+    fullPaints = PaintStats();
+    piecePaints = PaintStats();
+    if (preview) {
+        preview->showPieces(*engine);
+    }
+
+    if (practice) {
+        rewind.begin(*engine); // History starts at the saved position
+    }
+    scrubbing = false;
+    scrubTimer.stop();
+    isPaused = true;
+    qDebug() << "Resumed saved game: score" << engine->score() << ", pieces" << engine->piecesDropped();
+    emit linesRemovedChanged(engine->linesRemoved());
+    emit scoreChanged(engine->score());
+    emit levelChanged(engine->level());
+    emit pauseStateChanged(true);
+    publishBroadcast();
+    update();
+    return true;
 }
 
 void TetrixBoard::pause() {
-    if (!isStarted) {
+    // A versus match runs on both sides' clocks and cannot stop for one of them
+    if (!engine->isStarted() || versus) {
         qDebug() << "Pause ignored: game not started";
         return;
     }
+    if (scrubbing) {
+        stopScrub(); // Paused where the rewind stopped
+    }
 
     isPaused = !isPaused;
     qDebug() << "Pause state changed: isPaused=" << isPaused;
@@ -175,28 +381,92 @@ void TetrixBoard::pause() {
 
     if (isPaused) {
         timer.stop();
+        loop->releaseAll();
         flashTimer->stop();
-        backgroundSound->stop();
-        backgroundCycleCount++;
-        qDebug() << "Game paused, background music stopped, cycle count:" << backgroundCycleCount
-                 << ", status:" << backgroundSound->status() << ", isPlaying:" << backgroundSound->isPlaying();
+        audio.stopSound(TetrixSound::Background);
+        qDebug() << "Game paused, background music stopped";
     } else {
-        timer.start(1000 / level, this);
-        if (!flashingLines.isEmpty()) {
-            flashTimer->start(200);
+        // The paused time is not simulated
+        loop->resync(gameClock.nsecsElapsed());
+        timer.start(FrameIntervalMs, Qt::PreciseTimer, this);
+        if (lineFlash.count > 0) {
+            flashTimer->start(FlashIntervalMs);
             qDebug() << "Resumed with active line flash";
         }
-        playSoundWithDelay(backgroundSound, backgroundCycleCount, "/home/time/introCode/c++/TetrixGame/sounds/background.wav", true);
+        audio.play(TetrixSound::Background, 0.3f, true);
+        requestBotMove();
     }
     update();
 }
 
-void TetrixBoard::paintEvent(QPaintEvent *event) {
-    QFrame::paintEvent(event);
+void TetrixBoard::setAiPlay(bool enabled) {
+    aiPlay = enabled;
+    ++botRequestId; // Drop any result still in flight
+    qDebug() << "AI play" << (aiPlay ? "enabled" : "disabled");
+    requestBotMove();
+}
 
-    QPainter painter(this);
+void TetrixBoard::requestBotMove() {
+    if (!aiPlay || isPaused || scrubbing || !engine->isStarted() || engine->isWaitingAfterLine()
+        || engine->currentPiece().shape() == TetrixShape::NoShape) {
+        return;
+    }
+
+    // Keep the search well inside one gravity interval so the timer never waits on the bot
+    int budgetMs = static_cast<int>(qBound<qint64>(1, engine->tickIntervalNs() / 2000000, MaxBotBudgetMs));
+    quint64 requestId = ++botRequestId;
+    TetrixGrid grid = engine->grid();
+    TetrixPiece piece = engine->currentPiece();
+    TetrixPiece next = engine->nextPiece();
+    int x = engine->currentX();
+    int y = engine->currentY();
+    TetrixBot *searchBot = bot;
+
+    QMetaObject::invokeMethod(botContext, [this, searchBot, requestId, grid, piece, next, x, y, budgetMs]() {
+        TetrixBotMove move = searchBot->chooseMove(grid, piece, x, y, next, std::chrono::milliseconds(budgetMs));
+        if (!move.valid) {
+            return;
+        }
+        std::vector<TetrixInput> inputs = std::move(move.inputs);
+        QMetaObject::invokeMethod(this, [this, requestId, y, inputs]() {
+            applyBotMove(requestId, y, inputs);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+void TetrixBoard::applyBotMove(quint64 requestId, int requestY, const std::vector<TetrixInput> &inputs) {
+    // Stale if the piece locked, the game paused or AI play was toggled since the request
+    if (requestId != botRequestId || !aiPlay || isPaused || scrubbing || !engine->isStarted()) {
+        return;
+    }
+
+    // Gravity may have pulled the piece down while the bot was thinking; those rows count as soft drops,
+    // but only the path's leading ones: moves planned from a higher row can be blocked or tuck elsewhere
+    int fallen = requestY - engine->currentY();
+    int leadingDrops = 0;
+    while (leadingDrops < int(inputs.size()) && inputs[leadingDrops] == TetrixInput::SoftDrop) {
+        ++leadingDrops;
+    }
+    if (fallen > leadingDrops) {
+        requestBotMove(); // Plan again from where the piece is now
+        return;
+    }
+    unsigned events = TetrixEngine::NoEvent;
+    for (TetrixInput input : inputs) {
+        if (input == TetrixInput::SoftDrop && fallen > 0) {
+            --fallen;
+            continue;
+        }
+        events |= sendInput(input);
+        if (events & TetrixEngine::PieceLocked) {
+            break;
+        }
+    }
+    handleEvents(events);
+}
+
+QRect TetrixBoard::boardRect() const {
     QRect rect = contentsRect();
-    qDebug() << "Board paintEvent: contentsRect=" << rect << ", widget size=" << size();
 
     // Calculate square size based on available space, maintaining aspect ratio
     int squareSize = qMin(rect.width() / BoardWidth, rect.height() / BoardHeight);
@@ -205,313 +475,467 @@ void TetrixBoard::paintEvent(QPaintEvent *event) {
     int boardHeightPx = BoardHeight * squareSize;
 
     // Center the grid
-    int boardLeft = rect.left() + (rect.width() - boardWidthPx) / 2;
-    int boardTop = rect.top() + (rect.height() - boardHeightPx) / 2;
-    qDebug() << "Board rendering: squareSize=" << squareSize << ", boardWidthPx=" << boardWidthPx
-             << ", boardHeightPx=" << boardHeightPx << ", boardLeft=" << boardLeft << ", boardTop=" << boardTop;
+    return QRect(rect.left() + (rect.width() - boardWidthPx) / 2, rect.top() + (rect.height() - boardHeightPx) / 2,
+                 boardWidthPx, boardHeightPx);
+}
+
+QRect TetrixBoard::cellRect(const QRect &board, int x, int y) const {
+    // Engine rows count up from the bottom
+    int squareSize = board.width() / BoardWidth;
+    return QRect(board.left() + x * squareSize, board.top() + (BoardHeight - y - 1) * squareSize, squareSize, squareSize);
+}
+
+QRect TetrixBoard::pieceRect(const QRect &board) const {
+    const TetrixPiece &currentPiece = engine->currentPiece();
+    QRect footprint;
+    // While waiting after a line clear the locked piece is still current but no longer drawn
+    if (currentPiece.shape() != TetrixShape::NoShape && !engine->isWaitingAfterLine()) {
+        for (int i = 0; i < 4; ++i) {
+            footprint |= cellRect(board, engine->currentX() + currentPiece.x(i), engine->currentY() - currentPiece.y(i));
+        }
+    }
+    return footprint.translated(0, fallOffset(board.width() / BoardWidth));
+}
+
+int TetrixBoard::fallOffset(int squareSize) const {
+    // Between gravity rows the piece is drawn part of the way down, if the row below is free
+    double progress = loop->gravityProgress();
+    if (progress <= 0.0 || !engine->canPlace(engine->currentPiece(), engine->currentX(), engine->currentY() - 1)) {
+        return 0;
+    }
+    return static_cast<int>(progress * squareSize);
+}
+
+void TetrixBoard::updateBoard(unsigned events) {
+    if (events & (TetrixEngine::PieceLocked | TetrixEngine::LinesCollapsed)) {
+        lockedLayerDirty = true;
+    }
+    if (events == TetrixEngine::PieceMoved) {
+        // Only the falling piece changed: repaint where it was drawn and where it is now
+        update(paintedPieceRect);
+        update(pieceRect(boardRect()));
+    } else {
+        update();
+    }
+}
+
+void TetrixBoard::startLineFlash() {
+    lineFlash.count = engine->clearedLineCount();
+    lineFlash.toggles = 0;
+    for (int i = 0; i < lineFlash.count; ++i) {
+        lineFlash.rows[i] = engine->clearedLine(i);
+        std::copy(engine->clearedRow(i), engine->clearedRow(i) + BoardWidth, lineFlash.cells[i]);
+    }
+    flashState = true;
+    flashTimer->start(FlashIntervalMs);
+    updateLineFlash();
+}
+
+void TetrixBoard::updateLineFlash() {
+    QRect board = boardRect();
+    for (int i = 0; i < lineFlash.count; ++i) {
+        int y = lineFlash.rows[i];
+        update(cellRect(board, 0, y).united(cellRect(board, BoardWidth - 1, y)));
+    }
+}
+
+void TetrixBoard::rebuildGridLayer(const QRect &board) {
+    int squareSize = board.width() / BoardWidth;
+    qreal pixelRatio = devicePixelRatioF();
+    QSize size(board.width() + 2 * OutlineMargin, board.height() + 2 * OutlineMargin);
+    gridLayer = QPixmap(size * pixelRatio);
+    gridLayer.setDevicePixelRatio(pixelRatio);
+    gridLayer.fill(Qt::transparent);
+
+    QPainter painter(&gridLayer);
+    painter.translate(OutlineMargin, OutlineMargin);
 
     // Draw grid background
     painter.setPen(QPen(QColor("#585b70"), 1)); // Subtle gray color for grid lines
     for (int i = 0; i <= BoardHeight; ++i) {
         // Draw horizontal lines
-        painter.drawLine(boardLeft, boardTop + i * squareSize, boardLeft + boardWidthPx, boardTop + i * squareSize);
+        painter.drawLine(0, i * squareSize, board.width(), i * squareSize);
     }
     for (int j = 0; j <= BoardWidth; ++j) {
         // Draw vertical lines
-        painter.drawLine(boardLeft + j * squareSize, boardTop, boardLeft + j * squareSize, boardTop + boardHeightPx);
+        painter.drawLine(j * squareSize, 0, j * squareSize, board.height());
     }
 
     // Draw custom outline exactly around the 10x22 grid
     painter.setPen(QPen(QColor("#89b4fa"), 4));
-    painter.drawRect(boardLeft, boardTop, boardWidthPx, boardHeightPx);
+    painter.drawRect(0, 0, board.width(), board.height());
 
-    // Draw the 10x22 grid
-    for (int i = 0; i < BoardHeight; ++i) {
-        for (int j = 0; j < BoardWidth; ++j) {
-            TetrixShape shape = shapeAt(j, BoardHeight - i - 1);
+    layerSquareSize = squareSize;
+    layerPixelRatio = pixelRatio;
+    lockedLayerDirty = true;
+}
+
+void TetrixBoard::rebuildLockedLayer(const QRect &board) {
+    qreal pixelRatio = devicePixelRatioF();
+    if (lockedLayer.size() != board.size() * pixelRatio) {
+        lockedLayer = QPixmap(board.size() * pixelRatio);
+        lockedLayer.setDevicePixelRatio(pixelRatio);
+    }
+    lockedLayer.fill(Qt::transparent);
+
+    QPainter painter(&lockedLayer);
+    QRect origin(0, 0, board.width(), board.height());
+    fragments.clear();
+    for (int y = 0; y < BoardHeight; ++y) {
+        for (int x = 0; x < BoardWidth; ++x) {
+            TetrixShape shape = engine->shapeAt(x, y);
             if (shape != TetrixShape::NoShape) {
-                if (flashingLines.contains(BoardHeight - i - 1) && flashState) {
-                    drawSquare(painter, boardLeft + j * squareSize, boardTop + i * squareSize, TetrixShape::ZShape, squareSize);
-                } else {
-                    drawSquare(painter, boardLeft + j * squareSize, boardTop + i * squareSize, shape, squareSize);
-                }
+                addTile(fragments, boardTiles, static_cast<int>(shape), cellRect(origin, x, y));
             }
         }
     }
+    painter.drawPixmapFragments(fragments.data(), static_cast<int>(fragments.size()), boardTiles.pixmap);
+    lockedLayerDirty = false;
+}
+
+void TetrixBoard::drawLayer(QPainter &painter, const QPixmap &layer, const QPoint &origin, const QRegion &exposed) {
+    // Copy only the exposed parts; a piece move exposes a few squares, not the whole board
+    QRect bounds(origin, layer.deviceIndependentSize().toSize());
+    qreal pixelRatio = layer.devicePixelRatio();
+    for (const QRect &rect : exposed) {
+        QRect target = rect & bounds;
+        if (target.isEmpty()) {
+            continue;
+        }
+        QRectF source(QPointF(target.topLeft() - origin) * pixelRatio, QSizeF(target.size()) * pixelRatio);
+        painter.drawPixmap(QRectF(target), layer, source);
+    }
+}
 
-    // Draw the current piece
-    if (currentPiece.shape() != TetrixShape::NoShape) {
+void TetrixBoard::paintEvent(QPaintEvent *event) {
+    QElapsedTimer paintClock;
+    paintClock.start();
+    QRect board = boardRect();
+    int squareSize = board.width() / BoardWidth;
+    TETRIX_TRACE_SCOPE_INFO(TetrixTraceId::Paint, event->rect().width(), event->rect().height(), squareSize);
+    QFrame::paintEvent(event);
+
+    QPainter painter(this);
+
+    // Static layers are cached; only the falling piece and the line-clear flash are drawn per frame
+    ensureTiles(boardTiles, squareSize, devicePixelRatioF());
+    if (squareSize != layerSquareSize || devicePixelRatioF() != layerPixelRatio) {
+        rebuildGridLayer(board);
+    }
+    if (lockedLayerDirty) {
+        rebuildLockedLayer(board);
+    }
+    QRegion exposed = event->region();
+    drawLayer(painter, gridLayer, board.topLeft() - QPoint(OutlineMargin, OutlineMargin), exposed);
+    drawLayer(painter, lockedLayer, board.topLeft(), exposed);
+
+    // The flash (cleared rows where they were, alternating with the flash tile) and the current piece
+    // go out as one batch of atlas blits
+    fragments.clear();
+    for (int i = 0; i < lineFlash.count; ++i) {
+        int y = lineFlash.rows[i];
+        for (int x = 0; x < BoardWidth; ++x) {
+            int tile = flashState ? int(FlashTile) : static_cast<int>(lineFlash.cells[i][x]);
+            addTile(fragments, boardTiles, tile, cellRect(board, x, y));
+        }
+    }
+    const TetrixPiece &currentPiece = engine->currentPiece();
+    if (currentPiece.shape() != TetrixShape::NoShape && !engine->isWaitingAfterLine()) {
+        int offset = fallOffset(squareSize);
         for (int i = 0; i < 4; ++i) {
-            int x = curX + currentPiece.x(i);
-            int y = curY - currentPiece.y(i);
-            drawSquare(painter, boardLeft + x * squareSize, boardTop + (BoardHeight - y - 1) * squareSize, currentPiece.shape(), squareSize);
+            addTile(fragments, boardTiles, static_cast<int>(currentPiece.shape()),
+                    cellRect(board, engine->currentX() + currentPiece.x(i), engine->currentY() - currentPiece.y(i)).translated(0, offset));
         }
     }
+    if (!fragments.empty()) {
+        painter.drawPixmapFragments(fragments.data(), static_cast<int>(fragments.size()), boardTiles.pixmap);
+    }
+    paintedPieceRect = pieceRect(board);
 
     // Draw "PAUSED" text when game is paused
     if (isPaused) {
         painter.setPen(QColor("#cdd6f4"));
         painter.setFont(QFont("Arial", qMax(16, squareSize / 2), QFont::Bold)); // Scale PAUSED text
-        painter.drawText(rect, Qt::AlignCenter, tr("PAUSED"));
+        painter.drawText(contentsRect(), Qt::AlignCenter, tr("PAUSED"));
+    }
+
+    PaintStats &stats = exposed.boundingRect().contains(board) ? fullPaints : piecePaints;
+    ++stats.frames;
+    stats.nanoseconds += paintClock.nsecsElapsed();
+
+    // Every key whose effect this frame shows is done; the compositor's share is not included
+    qint64 paintedNs = latencyClock.nsecsElapsed();
+    for (int i = 0; i < InputTypes; ++i) {
+        if (pendingInputNs[i] >= 0) {
+            inputLatency[i].record(static_cast<quint64>(paintedNs - pendingInputNs[i]));
+            pendingInputNs[i] = -1;
+        }
     }
+    TetrixStartup::markFirstPaint();
 }
 
 void TetrixBoard::keyPressEvent(QKeyEvent *event) {
-    // Ignore input if game is not started, paused, no piece exists, waiting after line clear, or dropping
-    if (!isStarted || isPaused || currentPiece.shape() == TetrixShape::NoShape || isWaitingAfterLine || isDropping) {
-        qDebug() << "Key press ignored: isStarted=" << isStarted
-                 << ", isPaused=" << isPaused
-                 << ", hasPiece=" << (currentPiece.shape() != TetrixShape::NoShape)
-                 << ", isWaitingAfterLine=" << isWaitingAfterLine
-                 << ", isDropping=" << isDropping
-                 << ", key=" << event->key();
+    qint64 receivedNs = latencyClock.nsecsElapsed();
+    if (practice && (event->key() == Qt::Key_Z || event->key() == Qt::Key_X)) {
+        if (!event->isAutoRepeat()) {
+            startScrub(event->key() == Qt::Key_Z ? -1 : 1);
+        }
+        return;
+    }
+    TetrixInput input;
+    if (!inputForKey(event->key(), input)) {
         QFrame::keyPressEvent(event);
         return;
     }
+    // Ignore input if game is not started or paused; the loop repeats held keys, so OS auto-repeat is dropped
+    if (!engine->isStarted() || isPaused || event->isAutoRepeat()) {
+        TETRIX_TRACE_INFO(TetrixTraceId::KeyPress, event->key(), 0);
+        return;
+    }
 
     // Process key input for game control
-    qDebug() << "Processing key press: key=" << event->key();
-    switch (event->key()) {
-    case Qt::Key_Left:
-        tryMove(currentPiece, curX - 1, curY);
-        break;
-    case Qt::Key_Right:
-        tryMove(currentPiece, curX + 1, curY);
-        break;
-    case Qt::Key_Down:
-        oneLineDown();
-        break;
-    case Qt::Key_Up:
-        tryMove(currentPiece.rotatedRight(), curX, curY);
-        break;
-    case Qt::Key_Space:
-        qDebug() << "Space bar pressed, initiating dropDown";
-        dropDown();
-        break;
-    case Qt::Key_D:
-        oneLineDown();
-        break;
-    default:
-        QFrame::keyPressEvent(event);
+    TETRIX_TRACE_INFO(TetrixTraceId::KeyPress, event->key(), 1);
+    if (scrubbing) {
+        stopScrub(); // Play on from the position shown
     }
+    unsigned events = pressKey(input);
+    // Only keys that changed something get a frame to wait for; the earliest unpainted press counts
+    int type = static_cast<int>(input);
+    if (events != TetrixEngine::NoEvent && pendingInputNs[type] < 0) {
+        pendingInputNs[type] = receivedNs;
+    }
+    handleEvents(events);
 }
 
-void TetrixBoard::timerEvent(QTimerEvent *event) {
-    if (event->timerId() == timer.timerId()) {
-        if (isWaitingAfterLine) {
-            qDebug() << "Processing line clear: flashingLines=" << flashingLines;
-            isWaitingAfterLine = false;
-            for (int i : qAsConst(flashingLines)) {
-                for (int k = i; k < BoardHeight - 1; ++k) {
-                    for (int j = 0; j < BoardWidth; ++j) {
-                        shapeAt(j, k) = shapeAt(j, k + 1);
-                    }
-                }
-                for (int j = 0; j < BoardWidth; ++j) {
-                    shapeAt(j, BoardHeight - 1) = TetrixShape::NoShape;
-                }
-            }
-            flashingLines.clear();
-            flashTimer->stop();
-            qDebug() << "Lines cleared, animation stopped";
-            newPiece();
-            timer.start(1000 / level, this);
-        } else {
-            oneLineDown();
+void TetrixBoard::keyReleaseEvent(QKeyEvent *event) {
+    if (practice && (event->key() == Qt::Key_Z || event->key() == Qt::Key_X)) {
+        if (!event->isAutoRepeat()) {
+            // Stays at this position until a game key is pressed
+            scrubDirection = 0;
+            scrubTimer.stop();
         }
-    } else {
-        QFrame::timerEvent(event);
+        return;
     }
-}
-
-void TetrixBoard::clearBoard() {
-    for (int i = 0; i < BoardHeight * BoardWidth; ++i) {
-        board[i] = TetrixShape::NoShape;
+    TetrixInput input;
+    if (!inputForKey(event->key(), input)) {
+        QFrame::keyReleaseEvent(event);
+        return;
+    }
+    if (engine->isStarted() && !isPaused && !scrubbing && !event->isAutoRepeat()) {
+        handleEvents(releaseKey(input));
     }
 }
 
-void TetrixBoard::dropDown() {
-    // Prevent multiple drops
-    if (isDropping) {
-        qDebug() << "DropDown ignored: already dropping";
-        return;
+void TetrixBoard::focusOutEvent(QFocusEvent *event) {
+    // Releases that happen elsewhere never arrive; stop repeating rather than shift forever
+    if (versus) {
+        versus->releaseAll(TetrixVersusMatch::clockNs());
+    } else {
+        loop->releaseAll();
     }
-    isDropping = true;
-    qDebug() << "Starting dropDown: curX=" << curX << ", curY=" << curY;
+    scrubDirection = 0;
+    scrubTimer.stop();
+    QFrame::focusOutEvent(event);
+}
 
-    int dropHeight = 0;
-    int newY = curY;
-    while (newY > 0) {
-        if (!tryMove(currentPiece, curX, newY - 1)) {
-            break;
+void TetrixBoard::timerEvent(QTimerEvent *event) {
+    if (event->timerId() == timer.timerId() && versus) {
+        TetrixVersusMatch::Phase before = versus->phase();
+        int64_t nowNs = TetrixVersusMatch::clockNs();
+        versus->advance(nowNs);
+        versus->poll(nowNs);
+        refreshVersus();
+        emit versusUpdated();
+        TetrixVersusMatch::Phase after = versus->phase();
+        auto running = [](TetrixVersusMatch::Phase phase) {
+            return phase == TetrixVersusMatch::Phase::Handshake || phase == TetrixVersusMatch::Phase::Playing;
+        };
+        if (running(before) && !running(after)) {
+            audio.stopSound(TetrixSound::Background);
+            emit versusEnded();
+        }
+        // Finished still says goodbye to the peer
+        if (after == TetrixVersusMatch::Phase::Closed || after == TetrixVersusMatch::Phase::Failed) {
+            timer.stop();
         }
-        --newY;
-        ++dropHeight;
+    } else if (event->timerId() == timer.timerId()) {
+        handleEvents(loop->advance(gameClock.nsecsElapsed()));
+        // Gravity interpolation moves the piece between rows even when no event happened
+        QRect piece = pieceRect(boardRect());
+        if (piece != paintedPieceRect) {
+            update(paintedPieceRect);
+            update(piece);
+        }
+    } else if (event->timerId() == scrubTimer.timerId()) {
+        stepScrub();
+    } else if (event->timerId() == broadcastTimer.timerId()) {
+        publishBroadcast();
+    } else {
+        QFrame::timerEvent(event);
     }
-    qDebug() << "Piece dropped: dropHeight=" << dropHeight << ", curX=" << curX << ", curY=" << newY;
-    pieceDropped(dropHeight);
-    isDropping = false; // Reset after drop completes
 }
 
-void TetrixBoard::oneLineDown() {
-    if (!tryMove(currentPiece, curX, curY - 1)) {
-        pieceDropped(0);
+unsigned TetrixBoard::sendInput(TetrixInput input) {
+    if (versus) {
+        // The match only carries key changes: a tap is a press and a release in the same step
+        int64_t nowNs = TetrixVersusMatch::clockNs();
+        versus->press(input, nowNs);
+        versus->release(input, nowNs);
+        return versus->takeEvents(versusPlayer);
     }
+    return loop->input(input, gameClock.nsecsElapsed());
 }
 
-void TetrixBoard::pieceDropped(int dropHeight) {
-    // Place piece on board
-    for (int i = 0; i < 4; ++i) {
-        int x = curX + currentPiece.x(i);
-        int y = curY - currentPiece.y(i);
-        // Safety check to prevent out-of-bounds access
-        if (x < 0 || x >= BoardWidth || y < 0 || y >= BoardHeight) {
-            qDebug() << "ERROR: Invalid board access in pieceDropped: x=" << x << ", y=" << y;
-            return;
-        }
-        shapeAt(x, y) = currentPiece.shape();
+unsigned TetrixBoard::pressKey(TetrixInput input) {
+    if (versus) {
+        versus->press(input, TetrixVersusMatch::clockNs());
+        return versus->takeEvents(versusPlayer);
     }
+    return loop->press(input, gameClock.nsecsElapsed());
+}
 
-    playSoundWithDelay(dropSound, dropCycleCount, "/home/time/introCode/c++/TetrixGame/sounds/drop.wav", false);
-
-    ++numPiecesDropped;
-    if (numPiecesDropped % 25 == 0) {
-        ++level;
-        timer.start(1000 / level, this);
-        emit levelChanged(level);
-        qDebug() << "Level increased to:" << level;
+unsigned TetrixBoard::releaseKey(TetrixInput input) {
+    if (versus) {
+        versus->release(input, TetrixVersusMatch::clockNs());
+        return versus->takeEvents(versusPlayer);
     }
+    return loop->release(input, gameClock.nsecsElapsed());
+}
 
-    score += dropHeight + 7;
-    emit scoreChanged(score);
-    qDebug() << "Score updated: score=" << score;
-    removeFullLines();
-
-    if (!isWaitingAfterLine) {
-        newPiece();
+void TetrixBoard::saveReplay() {
+    if (recorder.data().empty()) {
+        return; // Not recording
+    }
+    const std::vector<uint8_t> &data = recorder.finish(*engine, loop->timeMs());
+    QDir().mkpath("replays");
+    QString path = QString("replays/replay-%1.txr").arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"));
+    QFile file(path);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(reinterpret_cast<const char *>(data.data()), static_cast<qint64>(data.size()));
+        qDebug() << "Replay saved:" << path << ", bytes=" << data.size();
+    } else {
+        qDebug() << "Failed to save replay:" << path;
     }
 }
 
-void TetrixBoard::removeFullLines() {
-    int numFullLines = 0;
-    flashingLines.clear();
-
-    for (int i = BoardHeight - 1; i >= 0; --i) {
-        bool lineIsFull = true;
-        for (int j = 0; j < BoardWidth; ++j) {
-            if (shapeAt(j, i) == TetrixShape::NoShape) {
-                lineIsFull = false;
-                break;
-            }
-        }
-        if (lineIsFull) {
-            ++numFullLines;
-            flashingLines.append(i);
+void TetrixBoard::writeLatencyReport() const {
+    static const char *const inputNames[InputTypes] = { "left", "right", "rotate", "soft drop", "hard drop" };
+    QString report = QString("%1 %2 %3 %4 %5 %6\n").arg("input", -10).arg("count", 8).arg("p50 ms", 9).arg("p99 ms", 9)
+                         .arg("p999 ms", 9).arg("max ms", 9);
+    TetrixLatencyHistogram all;
+    for (int i = 0; i <= InputTypes; ++i) {
+        const TetrixLatencyHistogram &histogram = i < InputTypes ? inputLatency[i] : all;
+        report += QString("%1 %2 %3 %4 %5 %6\n").arg(i < InputTypes ? inputNames[i] : "all", -10)
+                      .arg(histogram.count(), 8)
+                      .arg(histogram.percentile(50) / 1e6, 9, 'f', 3)
+                      .arg(histogram.percentile(99) / 1e6, 9, 'f', 3)
+                      .arg(histogram.percentile(99.9) / 1e6, 9, 'f', 3)
+                      .arg(histogram.max() / 1e6, 9, 'f', 3);
+        if (i < InputTypes) {
+            all.merge(inputLatency[i]);
         }
     }
 
-    if (numFullLines > 0) {
-        playSoundWithDelay(lineClearSound, lineClearCycleCount, "/home/time/introCode/c++/TetrixGame/sounds/lineclear.wav", false);
-        numLinesRemoved += numFullLines;
-        score += 10 * numFullLines;
-        emit linesRemovedChanged(numLinesRemoved);
-        emit scoreChanged(score);
-        isWaitingAfterLine = true;
-        flashTimer->start(200);
-        timer.start(1000, this);
-        qDebug() << "Starting line flash animation for" << numFullLines << "lines";
+    if (latencyReportPath == "-") {
+        qDebug().noquote() << "Input-to-paint latency:\n" + report;
+        return;
     }
-}
-
-void TetrixBoard::newPiece() {
-    currentPiece = nextPiece;
-    nextPiece.setRandomShape();
-    showNextPiece();
-
-    curX = BoardWidth / 2 + 1;
-    curY = BoardHeight - 1 + currentPiece.minY();
-    qDebug() << "New piece created: curX=" << curX << ", curY=" << curY << ", shape=" << static_cast<int>(currentPiece.shape());
-
-    if (!tryMove(currentPiece, curX, curY)) {
-        currentPiece.setShape(TetrixShape::NoShape);
-        timer.stop();
-        isStarted = false;
-        isDropping = false; // Reset dropping state
-        backgroundSound->stop();
-        backgroundCycleCount++;
-        qDebug() << "Background music stopped, cycle count:" << backgroundCycleCount
-                 << ", status:" << backgroundSound->status() << ", isPlaying:" << backgroundSound->isPlaying();
-        playSoundWithDelay(gameOverSound, gameOverCycleCount, "/home/time/introCode/c++/TetrixGame/sounds/gameover.wav", true);
-        emit gameOver(score);
-        emit pauseStateChanged(false); // Disable pause button on game over
-        qDebug() << "Game over, final score:" << score;
+    QFile file(latencyReportPath);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        file.write(report.toUtf8());
+    } else {
+        qDebug() << "Failed to write latency report:" << latencyReportPath;
     }
 }
 
-void TetrixBoard::showNextPiece() {
-    if (!nextPieceLabel) {
+void TetrixBoard::handleEvents(unsigned events) {
+    if (events == TetrixEngine::NoEvent) {
         return;
     }
 
-    // Calculate bounding box of the next piece
-    int dx = nextPiece.maxX() - nextPiece.minX() + 1;
-    int dy = nextPiece.maxY() - nextPiece.minY() + 1;
-
-    // Scale based on parent's available space
-    QSize parentSize = parentWidget() ? parentWidget()->size() : QSize(600, 450);
-    int squareSize = qMin(parentSize.width() / BoardWidth, parentSize.height() / BoardHeight);
-    if (squareSize < 15) squareSize = 15; // Minimum square size
-
-    // Create pixmap exactly matching the piece's bounding box
-    QPixmap pixmap(dx * squareSize, dy * squareSize);
-    pixmap.fill(Qt::transparent);
-    QPainter painter(&pixmap);
-
-    for (int i = 0; i < 4; ++i) {
-        int x = nextPiece.x(i) - nextPiece.minX();
-        int y = nextPiece.y(i) - nextPiece.minY();
-        drawSquare(painter, x * squareSize, y * squareSize, nextPiece.shape(), squareSize);
-    }
-
-    // Set pixmap and enforce exact size to avoid dead space
-    nextPieceLabel->setPixmap(pixmap);
-    nextPieceLabel->setFixedSize(dx * squareSize, dy * squareSize);
-    qDebug() << "Next piece updated: piece extent dx=" << dx << ", dy=" << dy
-             << ", squareSize=" << squareSize << ", pixmap size=" << pixmap.size()
-             << ", nextPieceLabel size=" << nextPieceLabel->size();
-}
-
-bool TetrixBoard::tryMove(const TetrixPiece &newPiece, int newX, int newY) {
-    // Check if move is valid
-    for (int i = 0; i < 4; ++i) {
-        int x = newX + newPiece.x(i);
-        int y = newY - newPiece.y(i);
-        // Stricter bounds checking
-        if (x < 0 || x >= BoardWidth || y < 0 || y >= BoardHeight) {
-            qDebug() << "Move rejected: out of bounds, x=" << x << ", y=" << y;
-            return false;
+    if (events & TetrixVersusMatch::Resimulated) {
+        // A rollback may have changed anything: the locked cells, the queue and the counters
+        lockedLayerDirty = true;
+        if (preview) {
+            preview->showPieces(*engine);
         }
-        if (shapeAt(x, y) != TetrixShape::NoShape) {
-            qDebug() << "Move rejected: collision at x=" << x << ", y=" << y;
-            return false;
+        emit scoreChanged(engine->score());
+        emit levelChanged(engine->level());
+        emit linesRemovedChanged(engine->linesRemoved());
+    }
+    if (events & TetrixEngine::PieceLocked) {
+        audio.play(TetrixSound::Drop, 0.7f);
+        emit scoreChanged(engine->score());
+    }
+    if (events & TetrixEngine::LevelUp) {
+        emit levelChanged(engine->level());
+    }
+    if (events & TetrixEngine::LinesCleared) {
+        audio.play(TetrixSound::LineClear, 0.5f);
+        emit linesRemovedChanged(engine->linesRemoved());
+        startLineFlash();
+    }
+    if (events & TetrixEngine::PieceSpawned) {
+        if (preview) {
+            preview->showPieces(*engine);
         }
+        requestBotMove();
     }
-
-    currentPiece = newPiece;
-    curX = newX;
-    curY = newY;
-    qDebug() << "Move accepted: newX=" << newX << ", newY=" << newY;
-    update();
-    return true;
+    // In versus the match decides when it is over: a predicted top-out can still be rolled back
+    if ((events & TetrixEngine::GameOver) && !versus) {
+        timer.stop();
+        audio.stopSound(TetrixSound::Background);
+        audio.play(TetrixSound::GameOver, 0.5f, true);
+        saveReplay();
+        emit gameOver(engine->score());
+        emit pauseStateChanged(false); // Disable pause button on game over
+        qDebug() << "Game over, final score:" << engine->score();
+        qDebug() << "Paint: full board" << fullPaints.frames << "frames, avg"
+                 << (fullPaints.frames ? fullPaints.nanoseconds / 1000 / fullPaints.frames : 0) << "us; piece only"
+                 << piecePaints.frames << "frames, avg" << (piecePaints.frames ? piecePaints.nanoseconds / 1000 / piecePaints.frames : 0)
+                 << "us";
+        TetrixAudioEngine::Stats audioStats = audio.stats();
+        qDebug() << "Audio:" << audioStats.blocks << "blocks, slowest" << audioStats.maxMixNs / 1000 << "us,"
+                 << audioOutput.underrunFrames() << "underrun frames," << audioStats.droppedCommands << "dropped commands,"
+                 << audioStats.stolenVoices << "voices taken over";
+    }
+    updateBoard(events);
+    publishBroadcast();
 }
 
-void TetrixBoard::drawSquare(QPainter &painter, int x, int y, TetrixShape shape, int squareSize) {
+void TetrixBoard::ensureTiles(TileAtlas &atlas, int squareSize, qreal pixelRatio) {
+    if (atlas.squareSize == squareSize && atlas.pixelRatio == pixelRatio) {
+        return;
+    }
     static const QColor colors[] = {
-        Qt::black, Qt::red, Qt::green, Qt::blue, Qt::cyan, Qt::magenta, Qt::yellow, Qt::gray
+        Qt::black, Qt::red, Qt::green, Qt::blue, Qt::cyan, Qt::magenta, Qt::yellow, Qt::gray,
+        Qt::red // Flash: alternates with the cleared rows after a line clear
     };
-    QColor color = colors[static_cast<int>(shape)];
+    static_assert(sizeof(colors) / sizeof(colors[0]) == TileCount, "one color per atlas tile");
 
-    painter.fillRect(x + 1, y + 1, squareSize - 2, squareSize - 2, color);
+    // Tiles start on whole device pixels so fragments never sample a neighbour, even at fractional ratios
+    atlas.tilePixels = qCeil(squareSize * pixelRatio);
+    atlas.pixmap = QPixmap(atlas.tilePixels * TileCount, atlas.tilePixels);
+    atlas.pixmap.fill(Qt::transparent);
+    QPainter painter(&atlas.pixmap);
     painter.setPen(QPen(Qt::black, 1));
-    painter.drawRect(x, y, squareSize - 1, squareSize - 1);
-}
\ No newline at end of file
+    for (int tile = 0; tile < TileCount; ++tile) {
+        painter.resetTransform();
+        painter.translate(tile * atlas.tilePixels, 0);
+        painter.scale(pixelRatio, pixelRatio);
+        painter.fillRect(1, 1, squareSize - 2, squareSize - 2, colors[tile]);
+        painter.drawRect(0, 0, squareSize - 1, squareSize - 1);
+    }
+    painter.end();
+    atlas.pixmap.setDevicePixelRatio(pixelRatio);
+    atlas.squareSize = squareSize;
+    atlas.pixelRatio = pixelRatio;
+}
+
+void TetrixBoard::addTile(std::vector<QPainter::PixmapFragment> &fragments, const TileAtlas &atlas, int tile, const QRect &cell) {
+    // Fragment sizes are in atlas pixels; scale them back to the cell's logical size
+    qreal scale = qreal(cell.width()) / atlas.tilePixels;
+    fragments.push_back(QPainter::PixmapFragment::create(QRectF(cell).center(),
+                                                         QRectF(tile * atlas.tilePixels, 0, atlas.tilePixels, atlas.tilePixels),
+                                                         scale, scale));
+}
@@ -3,45 +3,80 @@
 
 #include <QFrame>
 #include <QBasicTimer>
-#include <QSoundEffect>
 #include <QVector>
 #include <QTimer>
-#include <QMap>
-#include "TetrixPiece.h"
-
-class QLabel;
+#include <QThread>
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QPixmap>
+#include <vector>
+#include "TetrixAudio.h"
+#include "TetrixAudioOutput.h"
+#include "TetrixBroadcast.h"
+#include "TetrixEngine.h"
+#include "TetrixGameLoop.h"
+#include "TetrixLatency.h"
+#include "TetrixReplay.h"
+#include "TetrixRewind.h"
+#include "TetrixSave.h"
+#include "TetrixVersus.h"
+
+class TetrixBot;
+class TetrixPreview;
 
 class TetrixBoard : public QFrame {
     Q_OBJECT
 
 public:
-    explicit TetrixBoard(QWidget *parent = nullptr);
+    // An opponent board only shows the other side of a versus match: no sound, keys or bot
+    enum class Role { Player, Opponent };
+
+    explicit TetrixBoard(QWidget *parent = nullptr, Role role = Role::Player);
     ~TetrixBoard();
 
-    void setNextPieceLabel(QLabel *label);
-    QLabel *nextPieceLabel;
+    // Shows the engine's upcoming pieces, sized from the space around the board
+    void setPreview(TetrixPreview *widget);
+
+    // Versus: shows and plays the match's board of player instead of a game of its own; null goes back
+    // to single-player. The local player's board drives the match from its frame timer.
+    void setVersus(TetrixVersusMatch *match, int player);
+    // What a versus match needs from this player's settings
+    const TetrixRepeatSettings &repeatSettings() const { return ownLoop.repeatSettings(); }
+    int lineClearDelay() const { return ownEngine.lineClearDelay(); }
+    // Streams this board to the server's spectators (null stops); the server outlives the board's use of it
+    void setBroadcast(TetrixBroadcastServer *server);
 
     QSize sizeHint() const override;
     QSize minimumSizeHint() const override;
 
     // Public method to stop game-over sound
-    void stopGameOverSound() {
-        if (gameOverSound) {
-            gameOverSound->stop();
-            gameOverCycleCount++;
-            qDebug() << "Game-over sound stopped, cycle count:" << gameOverCycleCount << ", status:" << gameOverSound->status() << ", isPlaying:" << gameOverSound->isPlaying();
-            if (gameOverCycleCount >= MaxSoundCycles) {
-                resetSound(&gameOverSound, "/home/time/introCode/c++/TetrixGame/sounds/gameover.wav", true, gameOverCycleCount);
-            }
-        }
-    }
+    void stopGameOverSound() { audio.stopSound(TetrixSound::GameOver); }
+    void installSound(TetrixSound sound, TetrixAudioClip clip) { audio.setClip(sound, std::move(clip)); }
 
     // Getter for game started state
-    bool isGameStarted() const { return isStarted; }
+    bool isGameStarted() const { return engine->isStarted(); }
+    // Results of the current game, or the last one after game over
+    int linesRemoved() const { return engine->linesRemoved(); }
+    int level() const { return engine->level(); }
+    int piecesDropped() const { return engine->piecesDropped(); }
+    bool isAiPlay() const { return aiPlay; }
+    // Practice mode (TETRIX_PRACTICE=1): holding Z steps back through the game a piece per frame, X forward
+    // again, and any game key plays on from there. A game rewound even once is not recorded or ranked, nor is
+    // one resumed from a save that was (or that has no replay to show it was not).
+    bool wasRewound() const { return rewound; }
+
+    // Snapshot of the game in play; false when there is none to continue (not started, over, or versus)
+    bool captureGame(TetrixSaveGame &save) const;
+    // Continues a saved game, paused; false (board untouched) when the snapshot cannot be restored
+    bool resumeGame(const TetrixSaveGame &save);
 
 public slots:
     void start();
     void pause();
+    // AI play: a bot on a worker thread picks each piece's key sequence
+    void setAiPlay(bool enabled);
+    // Takes the versus match's events for this board and repaints what they changed
+    void refreshVersus();
 
 signals:
     void scoreChanged(int score);
@@ -49,60 +84,130 @@ signals:
     void linesRemovedChanged(int linesRemoved);
     void gameOver(int score);
     void pauseStateChanged(bool isPaused); // Signal to notify pause state changes
+    void versusUpdated(); // The match advanced; the opponent board refreshes on it
+    void versusEnded(); // The match has a result, or failed
 
 protected:
     void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
+    void keyReleaseEvent(QKeyEvent *event) override;
+    void focusOutEvent(QFocusEvent *event) override;
     void timerEvent(QTimerEvent *event) override;
 
-private slots:
-    void onSoundStatusChanged(QSoundEffect::Status status);
-
 private:
-    enum { BoardWidth = 10, BoardHeight = 22, MaxSoundCycles = 5 }; // 10x22 grid, max 5 sound cycles
-
-    TetrixShape &shapeAt(int x, int y) { return board[y * BoardWidth + x]; }
-    const TetrixShape &shapeAt(int x, int y) const { return board[y * BoardWidth + x]; }
-    void clearBoard();
-    void dropDown();
-    void oneLineDown();
-    void pieceDropped(int dropHeight);
-    void removeFullLines();
-    void newPiece();
-    void showNextPiece();
-    bool tryMove(const TetrixPiece &newPiece, int newX, int newY);
-    void drawSquare(QPainter &painter, int x, int y, TetrixShape shape, int squareSize);
-    void resetSound(QSoundEffect **sound, const QString &filePath, bool isLooping, int &cycleCount);
-    void playSoundWithDelay(QSoundEffect *sound, int &cycleCount, const QString &filePath, bool isLooping);
-
-    QBasicTimer timer;
+    enum { BoardWidth = TetrixEngine::BoardWidth, BoardHeight = TetrixEngine::BoardHeight }; // 10x22 grid
+
+    enum { MaxBotBudgetMs = 50 }; // Upper bound on the bot's thinking time per piece
+
+    enum { FrameIntervalMs = 4 }; // Simulation and interpolated redraws at 250 Hz, faster than a 144 Hz display
+
+    enum { OutlineMargin = 3 }; // The 4px outline straddles the board edge
+
+    enum { FlashTile = 8, TileCount = 9 }; // Atlas slots: one per TetrixShape, then the line-clear flash
+
+    enum { FlashIntervalMs = 100, FlashToggles = 6 }; // Line-clear flash: 600 ms, independent of the game clock
+
+    enum { ScrubIntervalMs = 16 }; // One piece per frame at 60 Hz while a rewind key is held
+
+    // Rows removed by the latest clear, copied from the engine; the board has already compacted, so
+    // the flash plays over their former place without holding up the game
+    struct LineFlash {
+        int count = 0;
+        int toggles = 0;
+        int rows[TetrixGrid::MaxLinesPerLock];
+        TetrixShape cells[TetrixGrid::MaxLinesPerLock][BoardWidth];
+    };
+
+    // Every cell tile pre-rendered at one square size and pixel ratio, laid out in a row
+    struct TileAtlas {
+        QPixmap pixmap;
+        int squareSize = 0;
+        qreal pixelRatio = 0;
+        int tilePixels = 0; // Tile width in device pixels
+    };
+
+    enum { InputTypes = 5 }; // TetrixInput values
+
+    struct PaintStats {
+        int frames = 0;
+        qint64 nanoseconds = 0;
+    };
+
+    unsigned sendInput(TetrixInput input);
+    unsigned pressKey(TetrixInput input);
+    unsigned releaseKey(TetrixInput input);
+    void handleEvents(unsigned events);
+    void publishBroadcast();
+    void startScrub(int direction);
+    void stepScrub();
+    void stopScrub();
+    void updateBoard(unsigned events);
+    void startLineFlash();
+    void updateLineFlash();
+    QRect boardRect() const;
+    QRect cellRect(const QRect &board, int x, int y) const;
+    QRect pieceRect(const QRect &board) const;
+    int fallOffset(int squareSize) const;
+    void rebuildGridLayer(const QRect &board);
+    void rebuildLockedLayer(const QRect &board);
+    void drawLayer(QPainter &painter, const QPixmap &layer, const QPoint &origin, const QRegion &exposed);
+    void saveReplay();
+    void writeLatencyReport() const;
+    void requestBotMove();
+    void applyBotMove(quint64 requestId, int requestY, const std::vector<TetrixInput> &inputs);
+    int previewSquareSize() const;
+    static void ensureTiles(TileAtlas &atlas, int squareSize, qreal pixelRatio);
+    static void addTile(std::vector<QPainter::PixmapFragment> &fragments, const TileAtlas &atlas, int tile, const QRect &cell);
+
+    TetrixPreview *preview; // Owned by the window's panel; null until setPreview()
+    Role role;
+    TetrixEngine ownEngine; // Game rules; this widget only renders it and forwards input and ticks
+    TetrixGameLoop ownLoop; // Fixed-timestep clock: gravity, held-key repeat and replay recording
+    TetrixEngine *engine; // ownEngine, or a board of the versus match
+    TetrixGameLoop *loop;
+    TetrixVersusMatch *versus; // Null outside versus play; owned by the window
+    int versusPlayer;
+    TetrixBroadcastServer *broadcast; // Null unless spectators may watch; owned by the window
+    TetrixBroadcastEncoder broadcastEncoder;
+    QElapsedTimer broadcastClock; // Stream time
+    QBasicTimer broadcastTimer; // Keyframes while nothing moves (paused, game over)
+    QBasicTimer timer; // Frame timer driving the loop
     QTimer *flashTimer; // Timer for line-clear animation
-    QTimer *soundDelayTimer; // Timer for sound playback delay
-    TetrixPiece currentPiece;
-    TetrixPiece nextPiece;
-    bool isStarted;
+    LineFlash lineFlash;
     bool isPaused;
-    bool isWaitingAfterLine;
-    bool isDropping; // Flag to prevent multiple dropDown calls
     bool flashState; // Toggle for flashing effect
-    int curX;
-    int curY;
-    int numLinesRemoved;
-    int numPiecesDropped;
-    int score;
-    int level;
-    TetrixShape board[BoardWidth * BoardHeight];
-    QSoundEffect *dropSound;
-    QSoundEffect *lineClearSound;
-    QSoundEffect *gameOverSound;
-    QSoundEffect *backgroundSound; // Background music
-    QVector<int> flashingLines; // Lines to animate
-    // Counters for tracking play/stop cycles
-    int dropCycleCount;
-    int lineClearCycleCount;
-    int gameOverCycleCount;
-    int backgroundCycleCount;
-    QMap<QSoundEffect*, QString> soundFilePaths; // Map to track sound file paths
+    TetrixAudioOutput audioOutput; // Speakers, when there is a device
+    TetrixNullAudioSink nullAudio; // Otherwise, or with TETRIX_AUDIO=null
+    TetrixAudioEngine audio; // Sounds decoded once; play() only queues a command for the mixer thread
+    TetrixReplayRecorder recorder; // Seed, inputs and ticks of the current game
+    TetrixRewind rewind; // Practice mode: every lock of the current game, fed by ownLoop
+    bool practice;
+    bool rewound; // The current game went back at least once, before or after a save: its replay would not verify
+    bool scrubbing; // Stopped at a rewound position until a game key is pressed
+    int scrubPosition; // Pieces dropped at the position shown
+    int scrubDirection; // -1 while Z is held, 1 while X is, 0 when neither
+    QBasicTimer scrubTimer;
+    QElapsedTimer gameClock; // Wall clock the loop advances to
+    QThread botThread; // Runs the bot search off the GUI thread
+    QObject *botContext; // Lives on botThread; queued calls through it run there
+    TetrixBot *bot; // Only used from botThread
+    bool aiPlay;
+    quint64 botRequestId; // Identifies the latest request; older results are dropped
+    QPixmap gridLayer; // Grid lines and outline; redrawn only when the square size changes
+    QPixmap lockedLayer; // Locked cells; redrawn on lock, line collapse and new game
+    int layerSquareSize;
+    qreal layerPixelRatio;
+    bool lockedLayerDirty;
+    QRect paintedPieceRect; // Falling piece footprint on screen, repainted when it moves
+    PaintStats fullPaints; // Whole-board repaints, reported at game over
+    PaintStats piecePaints; // Repaints limited to the falling piece
+    TileAtlas boardTiles;
+    std::vector<QPainter::PixmapFragment> fragments; // Cells of one batched draw, reused across frames
+    QElapsedTimer latencyClock;
+    qint64 pendingInputNs[InputTypes]; // When a key whose effect is not painted yet arrived, or -1
+    TetrixLatencyHistogram inputLatency[InputTypes]; // Key press to the end of the paint showing it
+    QString latencyReportPath; // TETRIX_LATENCY: written at exit, "-" for the debug log
 };
 
 #endif // TETRIXBOARD_H
\ No newline at end of file
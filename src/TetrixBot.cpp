@@ -0,0 +1,132 @@
+#include "TetrixBot.h"
+#include "TetrixTrace.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const double ToppedOutScore = -1e9; // Next piece has nowhere to go
+
+} // namespace
+
+TetrixBot::TetrixBot(const TetrixEvalWeights &weights, int beamWidth)
+    : weights(weights), beamWidth(beamWidth < 1 ? 1 : beamWidth), useTable(true)
+{
+    candidates.reserve(TetrixPlacementGenerator::StateCount);
+}
+
+void TetrixBot::setWeights(const TetrixEvalWeights &newWeights) {
+    if (std::memcmp(&weights, &newWeights, sizeof(weights)) != 0) {
+        weights = newWeights;
+        table.clear();
+    }
+}
+
+TetrixBotMove TetrixBot::chooseMove(const TetrixGrid &grid, const TetrixPiece &piece, int x, int y, const TetrixPiece &next,
+                                    std::chrono::steady_clock::duration budget) {
+    using Clock = std::chrono::steady_clock;
+    using Probe = TetrixTranspositionTable::Probe;
+    const bool hasDeadline = budget != Clock::duration::max();
+    const Clock::time_point deadline = hasDeadline ? Clock::now() + budget : Clock::time_point::max();
+
+    TETRIX_TRACE_SCOPE_INFO(TetrixTraceId::BotMove, beamWidth);
+    TetrixBotMove move;
+    int count = currentPlacements.generate(grid, piece, x, y);
+    if (count == 0) {
+        return move;
+    }
+    table.newSearch();
+
+    // First ply: score every placement of the current piece. Scores are linear in cleared lines, so the
+    // table caches the board-only part and the lines term is added back here.
+    candidates.clear();
+    for (int i = 0; i < count; ++i) {
+        const TetrixPlacement &placement = currentPlacements.placement(i);
+        Candidate candidate;
+        candidate.grid = grid;
+        candidate.grid.place(currentPlacements.piece(placement), placement.x, placement.y);
+        candidate.lines = candidate.grid.clearFullLines();
+        candidate.placement = i;
+        double boardScore;
+        Probe probe = useTable ? table.probe(candidate.grid.hash(), boardScore) : Probe::Miss;
+        if (probe == Probe::HitThisSearch) {
+            // Same board as an earlier placement, whose path is no longer
+            ++move.skipped;
+            continue;
+        }
+        if (probe == Probe::Hit) {
+            ++move.skipped;
+        } else {
+            boardScore = TetrixEvaluator::evaluate(candidate.grid, 0, weights);
+            ++move.nodes;
+            if (useTable) {
+                table.store(candidate.grid.hash(), boardScore, 0);
+            }
+        }
+        candidate.score = boardScore + weights.lines * candidate.lines;
+        candidates.push_back(candidate);
+    }
+
+    int beam = std::min(beamWidth, static_cast<int>(candidates.size()));
+    std::partial_sort(candidates.begin(), candidates.begin() + beam, candidates.end(),
+                      [](const Candidate &a, const Candidate &b) { return a.score > b.score; });
+
+    // Second ply: expand the beam with the next piece from its spawn position
+    int bestPlacement = candidates[0].placement;
+    double bestScore = candidates[0].score;
+    if (next.shape() != TetrixShape::NoShape) {
+        bool expanded = false;
+        for (int c = 0; c < beam; ++c) {
+            if (hasDeadline && Clock::now() >= deadline) {
+                move.complete = false;
+                break;
+            }
+            const Candidate &candidate = candidates[c];
+            // Best next-piece score on this board, excluding the candidate's own lines
+            double expandedBest = ToppedOutScore;
+            uint64_t expandedHash = candidate.grid.hash() ^ TetrixZobrist::expandedKey(next.shape());
+            if (useTable && table.probe(expandedHash, expandedBest) != Probe::Miss) {
+                ++move.skipped;
+            } else {
+                int nextCount = nextPlacements.generate(candidate.grid, next, TetrixEngine::spawnX(), TetrixEngine::spawnY(next));
+                batch.clear();
+                for (int i = 0; i < nextCount; ++i) {
+                    const TetrixPlacement &placement = nextPlacements.placement(i);
+                    TetrixGrid after = candidate.grid;
+                    after.place(nextPlacements.piece(placement), placement.x, placement.y);
+                    int lines = after.clearFullLines();
+                    int slot = batch.add(after, 0);
+                    batchHashes[slot] = after.hash();
+                    batchLines[slot] = lines;
+                }
+                TetrixEvaluator::scoreBatch(batch, weights, batchScores);
+                for (int i = 0; i < batch.size(); ++i) {
+                    if (useTable) {
+                        table.store(batchHashes[i], batchScores[i], 0);
+                    }
+                    expandedBest = std::max(expandedBest, batchScores[i] + weights.lines * batchLines[i]);
+                }
+                move.nodes += batch.size();
+                if (useTable) {
+                    table.store(expandedHash, expandedBest, 1);
+                }
+            }
+            double candidateBest = expandedBest <= ToppedOutScore ? ToppedOutScore : expandedBest + weights.lines * candidate.lines;
+            if (!expanded || candidateBest > bestScore) {
+                bestScore = candidateBest;
+                bestPlacement = candidate.placement;
+                expanded = true;
+            }
+        }
+    }
+
+    const TetrixPlacement &chosen = currentPlacements.placement(bestPlacement);
+    const TetrixInput *path = currentPlacements.path(chosen);
+    move.valid = true;
+    move.inputs.assign(path, path + chosen.pathLength);
+    move.x = chosen.x;
+    move.y = chosen.y;
+    move.rotation = chosen.rotation;
+    move.score = bestScore;
+    return move;
+}
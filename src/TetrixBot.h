@@ -0,0 +1,64 @@
+#ifndef TETRIXBOT_H
+#define TETRIXBOT_H
+
+#include <chrono>
+#include <vector>
+#include "TetrixEvaluator.h"
+#include "TetrixPlacements.h"
+#include "TetrixTransposition.h"
+
+// Result of one bot decision: the key sequence for the current piece and where it lands
+struct TetrixBotMove {
+    bool valid = false;
+    std::vector<TetrixInput> inputs;
+    int x = 0;
+    int y = 0;
+    int rotation = 0;
+    double score = 0.0;
+    int nodes = 0; // Boards evaluated
+    int skipped = 0; // Boards not evaluated: answered by the transposition table or dropped as duplicates
+    bool complete = true; // False when the time budget cut the next-piece lookahead short
+};
+
+// Beam search over the current and next piece: every reachable placement of the current piece is
+// scored, the best beamWidth boards are expanded with every placement of the next piece, and the
+// current-piece move leading to the best two-piece board wins. Board scores and expanded lookaheads
+// are cached by Zobrist hash across moves, and placements that reach an already scored board are
+// dropped, so the beam holds distinct boards. Qt-free and single-threaded; run one instance per thread.
+class TetrixBot {
+public:
+    explicit TetrixBot(const TetrixEvalWeights &weights = TetrixEvalWeights(), int beamWidth = 8);
+
+    // Clears the transposition table when the weights change, since it caches scores
+    void setWeights(const TetrixEvalWeights &newWeights);
+    const TetrixEvalWeights &evalWeights() const { return weights; }
+    void setBeamWidth(int width) { beamWidth = width < 1 ? 1 : width; }
+    void setTranspositionEnabled(bool enabled) { useTable = enabled; }
+    const TetrixTranspositionTable &transpositionTable() const { return table; }
+
+    // Picks a move for piece at (x, y); stops expanding the lookahead once budget has elapsed
+    TetrixBotMove chooseMove(const TetrixGrid &grid, const TetrixPiece &piece, int x, int y, const TetrixPiece &next,
+                             std::chrono::steady_clock::duration budget = std::chrono::steady_clock::duration::max());
+
+private:
+    struct Candidate {
+        TetrixGrid grid;
+        double score;
+        int lines;
+        int placement;
+    };
+
+    TetrixEvalWeights weights;
+    int beamWidth;
+    bool useTable;
+    TetrixTranspositionTable table; // Board-only scores (lines term excluded) and expanded best scores
+    TetrixPlacementGenerator currentPlacements;
+    TetrixPlacementGenerator nextPlacements;
+    std::vector<Candidate> candidates;
+    TetrixBoardBatch batch; // Next-piece boards of one beam entry, scored together by the vector kernels
+    double batchScores[TetrixBoardBatch::Capacity];
+    uint64_t batchHashes[TetrixBoardBatch::Capacity];
+    int batchLines[TetrixBoardBatch::Capacity];
+};
+
+#endif // TETRIXBOT_H
@@ -0,0 +1,527 @@
+#include "TetrixBroadcast.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+using namespace TetrixBroadcastProtocol;
+
+const int CellCount = TetrixGrid::Width * TetrixGrid::Height;
+const int ShapeCount = 8;
+
+void putVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool getVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && data < end; shift += 7) {
+        uint8_t byte = *data++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool getVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value, uint64_t limit) {
+    return getVarint(data, end, value) && value <= limit;
+}
+
+// Signed values as small varints: 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+void putSigned(std::vector<uint8_t> &out, int value) {
+    putVarint(out, (uint32_t(value) << 1) ^ uint32_t(value >> 31));
+}
+
+bool getSigned(const uint8_t *&data, const uint8_t *end, int &value) {
+    uint64_t encoded;
+    if (!getVarint(data, end, encoded, 0xFFFFFFFFu)) {
+        return false;
+    }
+    value = static_cast<int>(uint32_t(encoded >> 1) ^ (0u - uint32_t(encoded & 1)));
+    return true;
+}
+
+// Shapes two per byte, low nibble first; count is even
+void putShapes(std::vector<uint8_t> &out, const TetrixShape *shapes, int count) {
+    for (int i = 0; i < count; i += 2) {
+        out.push_back(static_cast<uint8_t>(static_cast<unsigned>(shapes[i]) | static_cast<unsigned>(shapes[i + 1]) << 4));
+    }
+}
+
+bool getShapes(const uint8_t *&data, const uint8_t *end, TetrixShape *shapes, int count) {
+    if (end - data < count / 2) {
+        return false;
+    }
+    for (int i = 0; i < count; i += 2) {
+        uint8_t byte = *data++;
+        if ((byte & 0xF) >= ShapeCount || (byte >> 4) >= ShapeCount) {
+            return false;
+        }
+        shapes[i] = static_cast<TetrixShape>(byte & 0xF);
+        shapes[i + 1] = static_cast<TetrixShape>(byte >> 4);
+    }
+    return true;
+}
+
+static_assert(TetrixGrid::Width % 2 == 0 && TetrixEngine::PreviewCapacity % 2 == 0, "Shapes are packed in pairs");
+
+bool rowEmpty(const TetrixShape *row) {
+    for (int x = 0; x < TetrixGrid::Width; ++x) {
+        if (row[x] != TetrixShape::NoShape) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+void TetrixBroadcastBoard::clear() {
+    std::fill(cells, cells + CellCount, TetrixShape::NoShape);
+    std::fill(preview, preview + TetrixEngine::PreviewCapacity, TetrixShape::NoShape);
+    piece = TetrixPiece();
+    x = 0;
+    y = 0;
+    score = 0;
+    level = 0;
+    lines = 0;
+    started = false;
+}
+
+void TetrixBroadcastBoard::capture(const TetrixEngine &engine) {
+    std::memcpy(cells, engine.grid().cellData(), sizeof(cells));
+    for (int i = 0; i < TetrixEngine::PreviewCapacity; ++i) {
+        preview[i] = engine.upcomingPiece(i).shape();
+    }
+    piece = engine.currentPiece();
+    x = engine.currentX();
+    y = engine.currentY();
+    score = engine.score();
+    level = engine.level();
+    lines = engine.linesRemoved();
+    started = engine.isStarted();
+}
+
+uint64_t TetrixBroadcastBoard::checksum() const {
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&hash](uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            hash = (hash ^ ((value >> (8 * i)) & 0xFF)) * 1099511628211ull;
+        }
+    };
+    for (TetrixShape cell : cells) {
+        hash = (hash ^ static_cast<uint8_t>(cell)) * 1099511628211ull;
+    }
+    for (TetrixShape shape : preview) {
+        hash = (hash ^ static_cast<uint8_t>(shape)) * 1099511628211ull;
+    }
+    mix(static_cast<uint64_t>(piece.shape()) << 8 | static_cast<uint64_t>(piece.rotation()));
+    mix(uint32_t(x));
+    mix(uint32_t(y));
+    mix(uint32_t(score));
+    mix(uint32_t(level));
+    mix(uint32_t(lines));
+    mix(started);
+    return hash;
+}
+
+TetrixBroadcastEncoder::TetrixBroadcastEncoder()
+    : nextSequence(0), keyframeSent(false), lastKeyframeMs(0)
+{
+    payload.reserve(MaxPayload);
+}
+
+TetrixBroadcastFramePtr TetrixBroadcastEncoder::encode(const TetrixEngine &engine, uint32_t timeMs, bool keyframeWanted) {
+    current.capture(engine);
+    uint32_t sinceKeyframe = timeMs - lastKeyframeMs;
+    if (!keyframeSent || sinceKeyframe >= KeyframeIntervalMs || (keyframeWanted && sinceKeyframe >= MinKeyframeGapMs)) {
+        return encodeFrame(true, AllFields, timeMs);
+    }
+    uint8_t fields = 0;
+    if (current.piece != sent.piece || current.x != sent.x || current.y != sent.y) {
+        fields |= Piece;
+    }
+    if (std::memcmp(current.preview, sent.preview, sizeof(current.preview)) != 0) {
+        fields |= Preview;
+    }
+    if (current.score != sent.score || current.level != sent.level || current.lines != sent.lines) {
+        fields |= Counters;
+    }
+    if (std::memcmp(current.cells, sent.cells, sizeof(current.cells)) != 0) {
+        fields |= Rows;
+    }
+    if (current.started != sent.started) {
+        fields |= Status;
+    }
+    return fields ? encodeFrame(false, fields, timeMs) : nullptr;
+}
+
+TetrixBroadcastFramePtr TetrixBroadcastEncoder::keyframe(const TetrixEngine &engine, uint32_t timeMs) {
+    current.capture(engine);
+    return encodeFrame(true, AllFields, timeMs);
+}
+
+TetrixBroadcastFramePtr TetrixBroadcastEncoder::encodeFrame(bool isKeyframe, uint8_t fields, uint32_t timeMs) {
+    payload.clear();
+    putVarint(payload, nextSequence);
+    putVarint(payload, timeMs);
+    payload.push_back(fields);
+    if (fields & Piece) {
+        payload.push_back(static_cast<uint8_t>(static_cast<unsigned>(current.piece.shape()) << 2 | current.piece.rotation()));
+        putSigned(payload, current.x);
+        putSigned(payload, current.y);
+    }
+    if (fields & Preview) {
+        putShapes(payload, current.preview, TetrixEngine::PreviewCapacity);
+    }
+    if (fields & Counters) {
+        putVarint(payload, uint32_t(current.score));
+        putVarint(payload, uint32_t(current.level));
+        putVarint(payload, uint32_t(current.lines));
+    }
+    if (fields & Rows) {
+        // A keyframe starts from an empty board; a delta lists the rows that differ from the last frame
+        size_t countAt = payload.size();
+        payload.push_back(0);
+        for (int y = 0; y < TetrixGrid::Height; ++y) {
+            const TetrixShape *row = current.cells + y * TetrixGrid::Width;
+            bool changed = isKeyframe ? !rowEmpty(row)
+                                    : std::memcmp(row, sent.cells + y * TetrixGrid::Width, TetrixGrid::Width * sizeof(TetrixShape)) != 0;
+            if (changed) {
+                ++payload[countAt];
+                payload.push_back(static_cast<uint8_t>(y));
+                putShapes(payload, row, TetrixGrid::Width);
+            }
+        }
+    }
+    if (fields & Status) {
+        payload.push_back(current.started ? Started : 0);
+    }
+
+    std::shared_ptr<TetrixBroadcastFrame> frame = takeFrame();
+    frame->sequence = nextSequence++;
+    frame->keyframe = isKeyframe;
+    frame->bytes.clear();
+    frame->bytes.push_back(isKeyframe ? Keyframe : Delta);
+    putVarint(frame->bytes, payload.size());
+    frame->bytes.insert(frame->bytes.end(), payload.begin(), payload.end());
+    sent = current;
+    if (isKeyframe) {
+        keyframeSent = true;
+        lastKeyframeMs = timeMs;
+    }
+    return frame;
+}
+
+std::shared_ptr<TetrixBroadcastFrame> TetrixBroadcastEncoder::takeFrame() {
+    // A pooled frame no subscriber holds any more is reused with its buffer
+    for (std::shared_ptr<TetrixBroadcastFrame> &frame : pool) {
+        if (frame.use_count() == 1) {
+            return frame;
+        }
+    }
+    auto frame = std::make_shared<TetrixBroadcastFrame>();
+    frame->bytes.reserve(64);
+    if (pool.size() < PoolSize) {
+        pool.push_back(frame);
+    }
+    return frame;
+}
+
+TetrixSpectator::TetrixSpectator()
+    : synced(false), lastSequence(0), lastTimeMs(0), frameCount(0), keyframeCount(0), gapCount(0)
+{
+}
+
+bool TetrixSpectator::consume(std::vector<uint8_t> &buffer) {
+    const uint8_t *begin = buffer.data();
+    const uint8_t *data = begin;
+    const uint8_t *end = begin + buffer.size();
+    bool ok = true;
+    while (data < end) {
+        const uint8_t *message = data + 1;
+        uint64_t size;
+        if (!getVarint(message, end, size)) {
+            // An unfinished length is at most a few bytes; anything longer is not one
+            ok = end - data <= 10;
+            break;
+        }
+        if (size > MaxPayload) {
+            ok = false;
+            break;
+        }
+        if (uint64_t(end - message) < size) {
+            break;
+        }
+        if (!apply(*data, message, message + size)) {
+            ok = false;
+            break;
+        }
+        data = message + size;
+    }
+    buffer.erase(buffer.begin(), buffer.begin() + (data - begin));
+    return ok;
+}
+
+bool TetrixSpectator::apply(uint8_t type, const uint8_t *data, const uint8_t *end) {
+    if (type != Keyframe && type != Delta) {
+        return false;
+    }
+    uint64_t sequence;
+    uint64_t timeMs;
+    if (!getVarint(data, end, sequence, 0xFFFFFFFFu) || !getVarint(data, end, timeMs, 0xFFFFFFFFu) || data == end) {
+        return false;
+    }
+    if (type == Delta && (!synced || uint32_t(sequence) != lastSequence + 1)) {
+        if (synced) {
+            gapCount += uint32_t(sequence) - lastSequence - 1;
+            synced = false;
+        }
+        return true;
+    }
+
+    uint8_t fields = *data++;
+    if (type == Keyframe) {
+        if (fields != AllFields) {
+            return false;
+        }
+        view.clear();
+        ++keyframeCount;
+    }
+    // A malformed message may leave the view half updated; it waits for the next keyframe
+    synced = false;
+    if (fields & Piece) {
+        if (data == end || (*data >> 2) >= ShapeCount) {
+            return false;
+        }
+        view.piece = TetrixPiece(static_cast<TetrixShape>(*data >> 2), *data & 3);
+        ++data;
+        if (!getSigned(data, end, view.x) || !getSigned(data, end, view.y)) {
+            return false;
+        }
+    }
+    if ((fields & Preview) && !getShapes(data, end, view.preview, TetrixEngine::PreviewCapacity)) {
+        return false;
+    }
+    if (fields & Counters) {
+        uint64_t score;
+        uint64_t level;
+        uint64_t lines;
+        if (!getVarint(data, end, score, 0xFFFFFFFFu) || !getVarint(data, end, level, 0xFFFFFFFFu)
+            || !getVarint(data, end, lines, 0xFFFFFFFFu)) {
+            return false;
+        }
+        view.score = static_cast<int>(uint32_t(score));
+        view.level = static_cast<int>(uint32_t(level));
+        view.lines = static_cast<int>(uint32_t(lines));
+    }
+    if (fields & Rows) {
+        if (data == end || *data > TetrixGrid::Height) {
+            return false;
+        }
+        int count = *data++;
+        for (int i = 0; i < count; ++i) {
+            if (data == end || *data >= TetrixGrid::Height) {
+                return false;
+            }
+            int y = *data++;
+            if (!getShapes(data, end, view.cells + y * TetrixGrid::Width, TetrixGrid::Width)) {
+                return false;
+            }
+        }
+    }
+    if (fields & Status) {
+        if (data == end) {
+            return false;
+        }
+        view.started = (*data++ & Started) != 0;
+    }
+    if (data != end) {
+        return false;
+    }
+    synced = true;
+    lastSequence = uint32_t(sequence);
+    lastTimeMs = uint32_t(timeMs);
+    ++frameCount;
+    return true;
+}
+
+TetrixBroadcastServer::TetrixBroadcastServer()
+    : keyframeWanted(false), running(false)
+{
+}
+
+TetrixBroadcastServer::~TetrixBroadcastServer() {
+    stop();
+}
+
+bool TetrixBroadcastServer::listen(uint16_t port) {
+    return listener.listen(port);
+}
+
+void TetrixBroadcastServer::publish(TetrixBroadcastFramePtr frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    incoming.push_back(std::move(frame));
+}
+
+void TetrixBroadcastServer::pump(int64_t nowNs) {
+    int64_t startNs = steadyNs();
+    Stats pumped; // Merged into counters at the end, so publish() never waits for the writes
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pumping.swap(incoming);
+    }
+
+    while (subscribers.size() < MaxSubscribers) {
+        auto subscriber = std::make_unique<Subscriber>();
+        if (!listener.accept(subscriber->link)) {
+            break;
+        }
+        subscriber->link.setBufferSizes(SendBufferBytes, 0);
+        subscriber->lastProgressNs = nowNs;
+        subscribers.push_back(std::move(subscriber));
+        ++pumped.accepted;
+    }
+
+    for (const TetrixBroadcastFramePtr &frame : pumping) {
+        ++pumped.framesPublished;
+        pumped.keyframesPublished += frame->keyframe;
+        pumped.bytesPublished += frame->bytes.size();
+    }
+
+    bool waiting = false;
+    for (size_t i = 0; i < subscribers.size();) {
+        Subscriber &subscriber = *subscribers[i];
+        for (const TetrixBroadcastFramePtr &frame : pumping) {
+            bool wasWaiting = subscriber.waitingForKeyframe;
+            pumped.framesSkipped += enqueue(subscriber, frame);
+            pumped.resyncs += !wasWaiting && subscriber.waitingForKeyframe;
+        }
+        uint64_t sentBefore = subscriber.link.bytesSent();
+        bool alive = write(subscriber, nowNs);
+        pumped.bytesSent += subscriber.link.bytesSent() - sentBefore;
+        if (!alive) {
+            if (subscriber.link.isOpen()) {
+                ++pumped.cutOff;
+            } else {
+                ++pumped.closed;
+            }
+            subscribers[i] = std::move(subscribers.back());
+            subscribers.pop_back();
+            continue;
+        }
+        if (subscriber.blocked && subscriber.count == 0) {
+            subscriber.blocked = !subscriber.link.waitWritable(0); // Nothing queued to find out by writing
+        }
+        // A stalled viewer could not take a keyframe yet either; asking for one would only cost the others
+        waiting = waiting || (subscriber.waitingForKeyframe && !subscriber.blocked);
+        ++i;
+    }
+    pumping.clear();
+    keyframeWanted.store(waiting, std::memory_order_relaxed);
+
+    uint64_t elapsedNs = static_cast<uint64_t>(steadyNs() - startNs);
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.subscribers = subscribers.size();
+    counters.peakSubscribers = std::max<uint64_t>(counters.peakSubscribers, subscribers.size());
+    counters.accepted += pumped.accepted;
+    counters.closed += pumped.closed;
+    counters.cutOff += pumped.cutOff;
+    counters.framesPublished += pumped.framesPublished;
+    counters.keyframesPublished += pumped.keyframesPublished;
+    counters.bytesPublished += pumped.bytesPublished;
+    counters.bytesSent += pumped.bytesSent;
+    counters.framesSkipped += pumped.framesSkipped;
+    counters.resyncs += pumped.resyncs;
+    ++counters.pumps;
+    counters.pumpNs += elapsedNs;
+    counters.maxPumpNs = std::max(counters.maxPumpNs, elapsedNs);
+}
+
+size_t TetrixBroadcastServer::enqueue(Subscriber &subscriber, const TetrixBroadcastFramePtr &frame) {
+    size_t lost = 0;
+    if (frame->keyframe || subscriber.count == MaxQueuedFrames) {
+        // A keyframe makes the queued frames redundant, and a full queue means they are stale. The front
+        // frame stays if it is partly written, so the stream stays whole.
+        size_t keep = subscriber.offset > 0 ? 1 : 0;
+        for (size_t i = keep; i < subscriber.count; ++i) {
+            subscriber.queue[(subscriber.head + i) % MaxQueuedFrames].reset();
+        }
+        lost = subscriber.count - keep;
+        subscriber.count = keep;
+        subscriber.waitingForKeyframe = subscriber.waitingForKeyframe || !frame->keyframe;
+    }
+    if (subscriber.waitingForKeyframe && !frame->keyframe) {
+        return lost + 1;
+    }
+    subscriber.queue[(subscriber.head + subscriber.count) % MaxQueuedFrames] = frame;
+    ++subscriber.count;
+    subscriber.waitingForKeyframe = false;
+    return lost;
+}
+
+bool TetrixBroadcastServer::write(Subscriber &subscriber, int64_t nowNs) {
+    while (subscriber.count > 0) {
+        const std::vector<uint8_t> &bytes = subscriber.queue[subscriber.head]->bytes;
+        long written = subscriber.link.write(bytes.data() + subscriber.offset, bytes.size() - subscriber.offset);
+        if (written < 0) {
+            return false;
+        }
+        subscriber.blocked = written == 0;
+        if (written == 0) {
+            break;
+        }
+        subscriber.lastProgressNs = nowNs;
+        subscriber.offset += static_cast<size_t>(written);
+        if (subscriber.offset == bytes.size()) {
+            subscriber.queue[subscriber.head].reset();
+            subscriber.head = (subscriber.head + 1) % MaxQueuedFrames;
+            --subscriber.count;
+            subscriber.offset = 0;
+        }
+    }
+    if (subscriber.count == 0) {
+        subscriber.lastProgressNs = nowNs;
+    }
+    return nowNs - subscriber.lastProgressNs < int64_t(StallTimeoutMs) * 1000000;
+}
+
+bool TetrixBroadcastServer::start() {
+    if (running.load() || !listener.isListening()) {
+        return false;
+    }
+    running.store(true);
+    pumpThread = std::thread(&TetrixBroadcastServer::run, this);
+    return true;
+}
+
+void TetrixBroadcastServer::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    pumpThread.join();
+}
+
+void TetrixBroadcastServer::run() {
+    while (running.load(std::memory_order_relaxed)) {
+        pump(steadyNs());
+        // Wakes early for a new spectator
+        listener.waitAcceptable(PumpIntervalMs);
+    }
+}
+
+TetrixBroadcastServer::Stats TetrixBroadcastServer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
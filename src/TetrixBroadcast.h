@@ -0,0 +1,201 @@
+#ifndef TETRIXBROADCAST_H
+#define TETRIXBROADCAST_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "TetrixEngine.h"
+#include "TetrixSocket.h"
+
+// Spectator stream, server to viewers only. Each message is a type byte, a varint payload length and the
+// payload: varint sequence, varint game time (ms), a field mask and the fields it names, in this order:
+//   Piece:    shape << 2 | rotation, zigzag varint x, zigzag varint y
+//   Preview:  PreviewCapacity shapes, two per byte (low nibble first)
+//   Counters: varint score, level, lines
+//   Rows:     row count, then per row y and its Width cells, two per byte
+//   Status:   flags (Started)
+// A keyframe carries every field and the rows that hold anything; a delta only what changed since the
+// previous frame, so a piece move is about a dozen bytes.
+namespace TetrixBroadcastProtocol {
+
+enum { DefaultPort = 7651, MaxPayload = 1 << 12 };
+
+enum Message : uint8_t {
+    Keyframe = 1,
+    Delta = 2
+};
+
+enum Field : uint8_t { Piece = 1, Preview = 2, Counters = 4, Rows = 8, Status = 16, AllFields = 31 };
+
+enum : uint8_t { Started = 1 }; // Status flags
+
+} // namespace TetrixBroadcastProtocol
+
+// What a spectator sees of a game: the encoder keeps the copy last sent, a viewer the copy rebuilt
+struct TetrixBroadcastBoard {
+    TetrixShape cells[TetrixGrid::Width * TetrixGrid::Height];
+    TetrixShape preview[TetrixEngine::PreviewCapacity];
+    TetrixPiece piece;
+    int x;
+    int y;
+    int score;
+    int level;
+    int lines;
+    bool started;
+
+    TetrixBroadcastBoard() { clear(); }
+    void clear();
+    void capture(const TetrixEngine &engine);
+    // FNV-1a over every field, for checking a viewer against the game
+    uint64_t checksum() const;
+};
+
+// One encoded message, shared read-only by every subscriber that sends it
+struct TetrixBroadcastFrame {
+    uint32_t sequence = 0;
+    bool keyframe = false;
+    std::vector<uint8_t> bytes; // Header and payload, as sent
+};
+
+using TetrixBroadcastFramePtr = std::shared_ptr<const TetrixBroadcastFrame>;
+
+// Turns a game into frames by comparing the engine with what was last sent, so moves, locks, line
+// clears and garbage all come out as the rows and fields they changed. Frames are recycled once every
+// subscriber has written them. Not thread-safe: the game's thread encodes.
+class TetrixBroadcastEncoder {
+public:
+    enum { KeyframeIntervalMs = 2000, MinKeyframeGapMs = 100, PoolSize = 64 };
+
+    TetrixBroadcastEncoder();
+
+    // A frame of what changed since the previous one, or null when nothing did. A keyframe every
+    // KeyframeIntervalMs, or sooner when one is wanted (a viewer joined or fell behind), at most every MinKeyframeGapMs.
+    TetrixBroadcastFramePtr encode(const TetrixEngine &engine, uint32_t timeMs, bool keyframeWanted = false);
+    // Always a keyframe, e.g. the final position of a game
+    TetrixBroadcastFramePtr keyframe(const TetrixEngine &engine, uint32_t timeMs);
+    uint32_t sequence() const { return nextSequence; }
+
+private:
+    TetrixBroadcastFramePtr encodeFrame(bool isKeyframe, uint8_t fields, uint32_t timeMs);
+    std::shared_ptr<TetrixBroadcastFrame> takeFrame();
+
+    TetrixBroadcastBoard sent;
+    TetrixBroadcastBoard current;
+    uint32_t nextSequence;
+    bool keyframeSent;
+    uint32_t lastKeyframeMs;
+    std::vector<std::shared_ptr<TetrixBroadcastFrame>> pool;
+    std::vector<uint8_t> payload; // Reused for every frame
+};
+
+// Rebuilds the board from a stream. A delta after a gap is ignored until the next keyframe.
+class TetrixSpectator {
+public:
+    TetrixSpectator();
+
+    // Decodes and applies every complete message at the front of buffer and removes them; false on a
+    // malformed one (the stream cannot be trusted after it)
+    bool consume(std::vector<uint8_t> &buffer);
+    const TetrixBroadcastBoard &board() const { return view; }
+    bool isSynced() const { return synced; }
+    uint32_t sequence() const { return lastSequence; }
+    uint32_t timeMs() const { return lastTimeMs; }
+    uint64_t frames() const { return frameCount; }
+    uint64_t keyframes() const { return keyframeCount; }
+    uint64_t gaps() const { return gapCount; } // Frames missed, waited out until a keyframe
+
+private:
+    bool apply(uint8_t type, const uint8_t *data, const uint8_t *end);
+
+    TetrixBroadcastBoard view;
+    bool synced;
+    uint32_t lastSequence;
+    uint32_t lastTimeMs;
+    uint64_t frameCount;
+    uint64_t keyframeCount;
+    uint64_t gapCount;
+};
+
+// Fans frames out to every connected spectator. Each frame is encoded once and each subscriber keeps
+// references to the shared buffers with how much of the front one it wrote. Writes never block: a
+// subscriber whose queue is full loses its queued deltas and gets only keyframes until it catches up,
+// and one that takes nothing for StallTimeoutMs is cut off, so viewers never slow the game.
+// publish() and wantsKeyframe() may be called from any thread; the rest from the one that pumps.
+class TetrixBroadcastServer {
+public:
+    enum { MaxQueuedFrames = 32, SendBufferBytes = 4096, StallTimeoutMs = 5000, MaxSubscribers = 4096 };
+    enum { PumpIntervalMs = 1 }; // Of the thread run by start()
+
+    struct Stats {
+        uint64_t subscribers = 0; // Connected now
+        uint64_t peakSubscribers = 0;
+        uint64_t accepted = 0;
+        uint64_t closed = 0; // By the viewer, or the connection failed
+        uint64_t cutOff = 0; // Stalled past StallTimeoutMs
+        uint64_t framesPublished = 0;
+        uint64_t keyframesPublished = 0;
+        uint64_t bytesPublished = 0; // Encoded once per frame
+        uint64_t bytesSent = 0; // Summed over subscribers
+        uint64_t framesSkipped = 0; // Not sent to a subscriber that fell behind
+        uint64_t resyncs = 0; // Subscribers moved to keyframes
+        uint64_t pumps = 0;
+        uint64_t pumpNs = 0;
+        uint64_t maxPumpNs = 0;
+    };
+
+    TetrixBroadcastServer();
+    ~TetrixBroadcastServer();
+    TetrixBroadcastServer(const TetrixBroadcastServer &) = delete;
+    TetrixBroadcastServer &operator=(const TetrixBroadcastServer &) = delete;
+
+    // Port 0 picks a free one (see port())
+    bool listen(uint16_t port);
+    uint16_t port() const { return listener.port(); }
+
+    // Queues the frame for every subscriber at the next pump
+    void publish(TetrixBroadcastFramePtr frame);
+    // A subscriber waits for a keyframe; pass it to TetrixBroadcastEncoder::encode()
+    bool wantsKeyframe() const { return keyframeWanted.load(std::memory_order_relaxed); }
+
+    // Accepts new spectators and writes what each one's socket takes
+    void pump(int64_t nowNs);
+    // Pumps on a thread of its own every PumpIntervalMs until stop()
+    bool start();
+    void stop();
+
+    Stats stats() const;
+
+private:
+    struct Subscriber {
+        TetrixConnection link;
+        TetrixBroadcastFramePtr queue[MaxQueuedFrames]; // Ring
+        size_t head = 0;
+        size_t count = 0;
+        size_t offset = 0; // Bytes of the front frame already written
+        bool waitingForKeyframe = true; // Joined, or fell behind
+        bool blocked = false; // The socket took nothing at the last write
+        int64_t lastProgressNs = 0;
+    };
+
+    // Returns how many frames the subscriber will now never get
+    size_t enqueue(Subscriber &subscriber, const TetrixBroadcastFramePtr &frame);
+    // False once the subscriber is gone
+    bool write(Subscriber &subscriber, int64_t nowNs);
+    void run();
+
+    TetrixListener listener;
+    std::vector<std::unique_ptr<Subscriber>> subscribers; // Pumping thread only
+    std::vector<TetrixBroadcastFramePtr> incoming; // Published, not pumped yet
+    std::vector<TetrixBroadcastFramePtr> pumping; // Swapped with incoming by pump()
+    std::atomic<bool> keyframeWanted;
+    std::thread pumpThread;
+    std::atomic<bool> running;
+    mutable std::mutex mutex; // Guards incoming and counters
+    Stats counters;
+};
+
+#endif // TETRIXBROADCAST_H
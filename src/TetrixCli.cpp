@@ -0,0 +1,1658 @@
+#include "TetrixArchive.h"
+#include "TetrixAudio.h"
+#include "TetrixBot.h"
+#include "TetrixBroadcast.h"
+#include "TetrixEngine.h"
+#include "TetrixGameLoop.h"
+#include "TetrixLatency.h"
+#include "TetrixLeaderboard.h"
+#include "TetrixPlacements.h"
+#include "TetrixReplay.h"
+#include "TetrixRewind.h"
+#include "TetrixSave.h"
+#include "TetrixTrace.h"
+#include "TetrixVersus.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Headless driver for TetrixEngine: plays games with a random "rotate, shift, drop" policy
+// as fast as possible and reports throughput, so rules can be simulated and benchmarked without a display.
+// --bot plays with the beam-search bot instead (--no-tt turns off its transposition table); --bench-placements compares the reachable-placement
+// search against the naive enumerator; --verify-eval checks the batch evaluator kernels bit for bit
+// against the scalar reference and times them. Games are seeded (game i uses seed + i) and can be
+// recorded as replays with --record or appended to a replay archive with --archive; --verify-replay re-simulates replays and checks their results.
+// --verify-loop plays jittered press/release sessions through the fixed-timestep loop and checks that
+// their replays and its sub-millisecond gravity hold up.
+// --trace writes a Chrome trace of the run (what is recorded depends on TETRIX_TRACE_LEVEL).
+// --verify-audio checks WAV decoding and the mixer, and times the mixer thread on a null sink.
+// --line-clear-delay sets the pause before the piece after a line clear (0 spawns it at once).
+// --verify-leaderboard N fills a scratch leaderboard with N games and checks its ranks against a sorted
+// copy, through the snapshot, a crash-torn log tail and a full log replay, timing each step.
+// --versus-host PORT and --versus-join HOST:PORT play one networked versus match in real time (random
+// player, or --bot), with --latency MS of simulated one-way delay, and report round trips, bandwidth,
+// rollbacks and the final checksum, which both sides print identically. The host's --versus-seconds
+// (default 60) caps the match.
+// --broadcast-bench N plays a fast game (an input every 16 ms frame) streamed to N loopback spectators,
+// one in ten a stalled viewer on a tiny receive buffer, over --broadcast-seconds of game time (default 60), and
+// reports the server's cost per frame and checks every spectator's final board. --spectate HOST:PORT
+// watches a stream (the GUI serves one with TETRIX_BROADCAST=PORT).
+// --resume FILE starts every game from a saved position (the GUI's savegame.txsv, or one written with
+// --save-at PIECES FILE, which plays one game that far). --verify-save snapshots games at random points,
+// resumes them from the file and checks they finish bit for bit like the originals, replays included.
+// --verify-rewind records games into practice-mode rewind histories, seeks to every position held and
+// compares it with the game that was there, plays on from rewound positions and times a held rewind key.
+
+namespace {
+
+struct GameStats {
+    long long score = 0;
+    long long lines = 0;
+    long long pieces = 0;
+    long long nodes = 0; // Bot games: boards evaluated
+    long long skipped = 0; // Bot games: boards the transposition table saved
+    TetrixLatencyHistogram thinkNs; // Bot games: time per chooseMove
+};
+
+// Feeds inputs and gravity ticks to the engine on a simulated clock, recording them when asked
+struct GameDriver {
+    TetrixEngine &engine;
+    TetrixReplayRecorder *recorder;
+    uint32_t clockMs;
+
+    void start(uint64_t seed, TetrixRandomizer::Mode mode) {
+        engine.start(seed, mode);
+        clockMs = 0;
+        if (recorder) {
+            recorder->begin(seed, mode, engine.lineClearDelay());
+        }
+    }
+    // Continues a saved game; recording needs the replay it was saved with
+    bool resume(const TetrixSaveGame &save) {
+        if (!save.restoreEngine(engine) || (recorder && !save.restoreReplay(*recorder))) {
+            return false;
+        }
+        clockMs = save.timeMs();
+        return true;
+    }
+    void input(TetrixInput input) {
+        if (recorder) {
+            recorder->recordInput(input, clockMs);
+        }
+        engine.input(input);
+    }
+    void tick() {
+        clockMs += engine.tickInterval();
+        if (recorder) {
+            recorder->recordTick(clockMs);
+        }
+        engine.tick();
+    }
+    void finish(GameStats &stats) {
+        if (recorder) {
+            recorder->finish(engine, clockMs);
+        }
+        stats.score += engine.score();
+        stats.lines += engine.linesRemoved();
+        stats.pieces += engine.piecesDropped();
+    }
+};
+
+void playRandomGame(GameDriver &driver, std::mt19937 &gen, int maxPieces) {
+    std::uniform_int_distribution<> rotations(0, 3);
+    std::uniform_int_distribution<> shift(-TetrixEngine::BoardWidth / 2, TetrixEngine::BoardWidth / 2);
+
+    TetrixEngine &engine = driver.engine;
+    while (engine.isStarted() && engine.piecesDropped() < maxPieces) {
+        for (int r = rotations(gen); r > 0; --r) {
+            driver.input(TetrixInput::RotateRight);
+        }
+        int dx = shift(gen);
+        TetrixInput direction = dx < 0 ? TetrixInput::Left : TetrixInput::Right;
+        for (int i = std::abs(dx); i > 0; --i) {
+            driver.input(direction);
+        }
+        driver.input(TetrixInput::HardDrop);
+        // Collapse cleared lines and spawn the next piece
+        if (engine.isWaitingAfterLine()) {
+            driver.tick();
+        }
+    }
+}
+
+void playBotGame(GameDriver &driver, TetrixBot &bot, int maxPieces, GameStats &stats) {
+    TetrixEngine &engine = driver.engine;
+    while (engine.isStarted() && engine.piecesDropped() < maxPieces) {
+        auto begin = std::chrono::steady_clock::now();
+        TetrixBotMove move = bot.chooseMove(engine.grid(), engine.currentPiece(), engine.currentX(), engine.currentY(),
+                                            engine.nextPiece());
+        stats.thinkNs.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count()));
+        if (!move.valid) {
+            break;
+        }
+        stats.nodes += move.nodes;
+        stats.skipped += move.skipped;
+        for (TetrixInput input : move.inputs) {
+            driver.input(input);
+        }
+        if (engine.isWaitingAfterLine()) {
+            driver.tick();
+        }
+    }
+}
+
+bool readFile(const char *path, std::vector<uint8_t> &data) {
+    FILE *file = std::fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    data.clear();
+    uint8_t buffer[65536];
+    for (size_t n; (n = std::fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    std::fclose(file);
+    return true;
+}
+
+bool writeFile(const std::string &path, const std::vector<uint8_t> &data) {
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+int verifyReplays(const std::vector<const char *> &paths) {
+    int failures = 0;
+    long long pieces = 0;
+    double seconds = 0.0;
+    std::vector<uint8_t> data;
+    for (const char *path : paths) {
+        if (!readFile(path, data)) {
+            std::printf("%s: cannot read\n", path);
+            ++failures;
+            continue;
+        }
+        TetrixReplay::Summary summary;
+        auto begin = std::chrono::steady_clock::now();
+        TetrixReplay::VerifyResult result = TetrixReplay::verify(data.data(), data.size(), &summary);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        pieces += summary.pieces;
+        std::printf("%s: %s, seed %llu, score %d, lines %d, pieces %d, %zu bytes (%.2f bytes/piece)\n", path,
+                    TetrixReplay::resultName(result), static_cast<unsigned long long>(summary.seed), summary.score,
+                    summary.lines, summary.pieces, data.size(), summary.pieces ? double(data.size()) / summary.pieces : 0.0);
+        if (result != TetrixReplay::VerifyResult::Ok) {
+            ++failures;
+        }
+    }
+    if (seconds > 0.0) {
+        std::printf("verified %lld pieces at %.0f pieces/sec\n", pieces, pieces / seconds);
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+const char *saveStatusName(TetrixSaveGame::Status status) {
+    switch (status) {
+    case TetrixSaveGame::Status::Loaded:
+        return "loaded";
+    case TetrixSaveGame::Status::Missing:
+        return "missing";
+    case TetrixSaveGame::Status::Unsupported:
+        return "unsupported version";
+    case TetrixSaveGame::Status::Corrupt:
+        return "corrupt";
+    }
+    return "?";
+}
+
+// Snapshots random games part way, resumes copies from the file and plays both on with the same inputs
+int verifySave(int games, unsigned seed, TetrixRandomizer::Mode mode, int maxPieces, int lineClearDelayMs) {
+    std::mt19937 pick(seed);
+    std::string path = (std::filesystem::temp_directory_path() / ("tetrix-save-" + std::to_string(pick()) + ".txsv")).string();
+    TetrixEngine original;
+    TetrixEngine resumed;
+    original.setLineClearDelay(lineClearDelayMs);
+    TetrixReplayRecorder originalReplay;
+    TetrixReplayRecorder resumedReplay;
+    GameDriver originalDriver{ original, &originalReplay, 0 };
+    GameDriver resumedDriver{ resumed, &resumedReplay, 0 };
+    TetrixSaveGame save;
+    TetrixSaveGame loaded;
+    int failures = 0;
+    uint64_t loadNs = 0;
+    uint64_t maxLoadNs = 0;
+    uint64_t bytes = 0;
+    for (int i = 0; i < games; ++i) {
+        std::mt19937 gen(seed + i);
+        originalDriver.start(uint64_t(seed) + i, mode);
+        playRandomGame(originalDriver, gen, std::uniform_int_distribution<>(0, maxPieces)(pick));
+        save.capture(original, originalDriver.clockMs, &originalReplay);
+        if (!save.write(path)) {
+            std::printf("%s: cannot write\n", path.c_str());
+            return 1;
+        }
+        bytes += save.size();
+
+        auto begin = std::chrono::steady_clock::now();
+        TetrixSaveGame::Status status = loaded.read(path);
+        bool restored = status == TetrixSaveGame::Status::Loaded && resumedDriver.resume(loaded);
+        uint64_t elapsedNs = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+        loadNs += elapsedNs;
+        maxLoadNs = std::max(maxLoadNs, elapsedNs);
+        TetrixEngineState expected;
+        TetrixEngineState actual;
+        original.saveState(expected);
+        resumed.saveState(actual);
+        if (!restored || std::memcmp(&expected, &actual, sizeof(expected)) != 0) {
+            std::printf("game %d: resumed at piece %d does not match (%s)\n", i, original.piecesDropped(), saveStatusName(status));
+            ++failures;
+            continue;
+        }
+
+        // The rest of the game, with the same inputs on both
+        std::mt19937 resumedGen = gen;
+        playRandomGame(originalDriver, gen, maxPieces);
+        playRandomGame(resumedDriver, resumedGen, maxPieces);
+        GameStats ignored;
+        originalDriver.finish(ignored);
+        resumedDriver.finish(ignored);
+        if (originalReplay.data() != resumedReplay.data() || original.grid().checksum() != resumed.grid().checksum()
+            || TetrixReplay::verify(resumedReplay.data().data(), resumedReplay.data().size(), nullptr) != TetrixReplay::VerifyResult::Ok) {
+            std::printf("game %d: resumed game ended differently\n", i);
+            ++failures;
+        }
+    }
+
+    // Damaged and foreign files are refused, not misread
+    std::vector<uint8_t> file;
+    readFile(path.c_str(), file);
+    std::vector<uint8_t> damaged = file;
+    damaged[damaged.size() / 2] ^= 0x40;
+    std::vector<uint8_t> newer = file;
+    newer[offsetof(TetrixSaveHeader, version)] = TetrixSaveFormat::Version + 1;
+    struct Case {
+        const char *name;
+        TetrixSaveGame::Status status;
+        TetrixSaveGame::Status expected;
+    } cases[] = {
+        { "flipped bit", loaded.parse(damaged.data(), damaged.size()), TetrixSaveGame::Status::Corrupt },
+        { "truncated", loaded.parse(file.data(), file.size() - 1), TetrixSaveGame::Status::Corrupt },
+        { "newer version", loaded.parse(newer.data(), newer.size()), TetrixSaveGame::Status::Unsupported },
+        { "missing file", loaded.read(path + ".missing"), TetrixSaveGame::Status::Missing },
+    };
+    for (const Case &test : cases) {
+        std::printf("%-14s %s%s\n", test.name, saveStatusName(test.status), test.status == test.expected ? "" : " (unexpected)");
+        failures += test.status != test.expected;
+    }
+
+    // A version 1 save (the same header without flags) still loads, ranked, into the same game
+    const size_t oldHeader = TetrixSaveFormat::Version1HeaderSize;
+    std::vector<uint8_t> older(file.begin(), file.begin() + oldHeader);
+    older.insert(older.end(), file.begin() + sizeof(TetrixSaveHeader), file.end());
+    uint16_t oldVersion = 1;
+    uint16_t oldSize = static_cast<uint16_t>(oldHeader);
+    std::memcpy(older.data() + offsetof(TetrixSaveHeader, version), &oldVersion, sizeof(oldVersion));
+    std::memcpy(older.data() + offsetof(TetrixSaveHeader, headerSize), &oldSize, sizeof(oldSize));
+    uint64_t oldChecksum = TetrixSaveGame::checksumOf(older.data(), older.size());
+    std::memcpy(older.data() + offsetof(TetrixSaveHeader, checksum), &oldChecksum, sizeof(oldChecksum));
+    TetrixSaveGame::Status oldStatus = loaded.parse(older.data(), older.size());
+    bool oldMatches = oldStatus == TetrixSaveGame::Status::Loaded && loaded.isRanked() && loaded.restoreEngine(resumed)
+        && save.parse(file.data(), file.size()) == TetrixSaveGame::Status::Loaded && save.restoreEngine(original);
+    TetrixEngineState expected;
+    TetrixEngineState actual;
+    original.saveState(expected);
+    resumed.saveState(actual);
+    oldMatches = oldMatches && std::memcmp(&expected, &actual, sizeof(expected)) == 0;
+    std::printf("%-14s %s%s\n", "version 1", saveStatusName(oldStatus), oldMatches ? "" : " (unexpected)");
+    failures += !oldMatches;
+    std::remove(path.c_str());
+
+    std::printf("resumed:      %d games, %d mismatches\n", games, failures);
+    std::printf("save size:    %.0f bytes avg (%zu header + replay so far)\n", games ? double(bytes) / games : 0.0,
+                sizeof(TetrixSaveHeader));
+    std::printf("load:         %.1f us avg, %.1f us max (read, check, restore)\n", games ? loadNs / 1e3 / games : 0.0, maxLoadNs / 1e3);
+    return failures == 0 ? 0 : 1;
+}
+
+// One input as TetrixGameLoop applies it in practice mode
+void rewindInput(TetrixEngine &engine, TetrixRewind &history, TetrixInput input) {
+    if (engine.input(input) & TetrixEngine::PieceLocked) {
+        history.recordLock(engine);
+    }
+}
+
+// One piece, from the bot or at random: hard drops, soft drops all the way and soft drops cut short
+void playRewindPiece(TetrixEngine &engine, TetrixRewind &history, std::mt19937 &gen, TetrixBot *bot) {
+    int pieces = engine.piecesDropped();
+    if (bot) {
+        TetrixBotMove move = bot->chooseMove(engine.grid(), engine.currentPiece(), engine.currentX(), engine.currentY(),
+                                             engine.nextPiece());
+        for (size_t i = 0; move.valid && i < move.inputs.size(); ++i) {
+            rewindInput(engine, history, move.inputs[i]);
+        }
+    } else {
+        for (int r = std::uniform_int_distribution<>(0, 3)(gen); r > 0; --r) {
+            rewindInput(engine, history, TetrixInput::RotateRight);
+        }
+        int dx = std::uniform_int_distribution<>(-TetrixEngine::BoardWidth / 2, TetrixEngine::BoardWidth / 2)(gen);
+        for (int i = std::abs(dx); i > 0; --i) {
+            rewindInput(engine, history, dx < 0 ? TetrixInput::Left : TetrixInput::Right);
+        }
+        int rows = std::uniform_int_distribution<>(0, 2 * TetrixEngine::BoardHeight)(gen);
+        for (; rows > 0 && engine.piecesDropped() == pieces; --rows) {
+            rewindInput(engine, history, TetrixInput::SoftDrop);
+        }
+    }
+    if (engine.isStarted() && engine.piecesDropped() == pieces) {
+        rewindInput(engine, history, TetrixInput::HardDrop);
+    }
+    // Collapse cleared lines and spawn the next piece
+    if (engine.isWaitingAfterLine()) {
+        engine.tick();
+    }
+}
+
+// Seeks to every position the history holds and compares the engine with the game's own at that piece
+int checkRewindPositions(const TetrixRewind &history, const std::vector<TetrixEngineState> &played, TetrixEngine &seeker) {
+    int mismatches = 0;
+    for (int position = history.first(); position <= history.last(); ++position) {
+        TetrixEngineState state;
+        if (history.seek(position, seeker)) {
+            seeker.saveState(state);
+        }
+        mismatches += !history.seek(position, seeker) || std::memcmp(&state, &played[position], sizeof(state)) != 0;
+    }
+    return mismatches;
+}
+
+int verifyRewind(int games, unsigned seed, TetrixRandomizer::Mode mode, int maxPieces, int lineClearDelayMs) {
+    TetrixEngine engine;
+    TetrixEngine seeker;
+    engine.setLineClearDelay(lineClearDelayMs);
+    TetrixRewind history;
+    TetrixBot bot;
+    std::vector<TetrixEngineState> played; // The game's state at every piece count, for comparing
+    std::mt19937 gen(seed);
+    long long positions = 0;
+    int mismatches = 0;
+    int branchMismatches = 0;
+    uint64_t scrubNs = 0;
+    uint64_t maxScrubNs = 0;
+    long long scrubSteps = 0;
+    for (int i = 0; i < games; ++i) {
+        // The first game is the bot's, long enough for the history to wrap around
+        TetrixBot *player = i == 0 ? &bot : nullptr;
+        int pieces = i == 0 ? TetrixRewind::Capacity + 3 * TetrixRewind::SnapshotInterval + 17 : maxPieces;
+        engine.start(uint64_t(seed) + i, mode);
+        history.begin(engine);
+        played.assign(1, TetrixEngineState());
+        engine.saveState(played[0]);
+        while (engine.isStarted() && engine.piecesDropped() < pieces) {
+            playRewindPiece(engine, history, gen, player);
+            played.resize(engine.piecesDropped() + 1);
+            engine.saveState(played.back());
+        }
+        if (history.last() != engine.piecesDropped() || history.last() - history.first() > TetrixRewind::Capacity) {
+            std::printf("game %d: history holds %d-%d after %d pieces\n", i, history.first(), history.last(), engine.piecesDropped());
+            ++mismatches;
+        }
+        positions += history.last() - history.first() + 1;
+        mismatches += checkRewindPositions(history, played, seeker);
+
+        // Holding the rewind key: one step back per frame, from the end to the oldest position held
+        for (int position = history.last(); position >= history.first(); --position) {
+            auto begin = std::chrono::steady_clock::now();
+            history.seek(position, seeker);
+            uint64_t elapsedNs = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+            scrubNs += elapsedNs;
+            maxScrubNs = std::max(maxScrubNs, elapsedNs);
+            ++scrubSteps;
+        }
+
+        // Play on from a rewound position: the history follows the new line and still holds the old start
+        int from = std::uniform_int_distribution<>(history.first(), history.last())(gen);
+        history.seek(from, engine);
+        history.truncate(from);
+        played.resize(from + 1);
+        for (int piece = 0; engine.isStarted() && piece < 50; ++piece) {
+            playRewindPiece(engine, history, gen, nullptr);
+            played.resize(engine.piecesDropped() + 1);
+            engine.saveState(played.back());
+        }
+        branchMismatches += history.last() != engine.piecesDropped() || checkRewindPositions(history, played, seeker) != 0;
+    }
+
+    // Fed by the loop, as in the GUI: gravity and held-key locks, several per frame at high levels
+    int loopMismatches = 0;
+    TetrixGameLoop loop(engine);
+    loop.setRewind(&history);
+    std::uniform_int_distribution<int64_t> frameNs(500000, 12000000);
+    const TetrixInput keys[] = { TetrixInput::Left, TetrixInput::Right, TetrixInput::RotateRight, TetrixInput::SoftDrop,
+                                 TetrixInput::HardDrop };
+    for (int i = 0; i < games; ++i) {
+        int64_t nowNs = 0;
+        loop.start(uint64_t(seed) + i, mode, nowNs);
+        bool held[5] = {};
+        while (engine.isStarted() && engine.piecesDropped() < maxPieces) {
+            nowNs += frameNs(gen);
+            int a = std::uniform_int_distribution<>(0, 15)(gen);
+            if (a < 5) {
+                held[a] = !held[a];
+                if (held[a]) {
+                    loop.press(keys[a], nowNs);
+                } else {
+                    loop.release(keys[a], nowNs);
+                }
+            } else {
+                loop.advance(nowNs);
+            }
+        }
+        // Every position has to replay; the last one is the game as it ended
+        TetrixEngineState expected;
+        TetrixEngineState actual;
+        engine.saveState(expected);
+        bool ok = history.last() == engine.piecesDropped() && !engine.isStarted();
+        for (int position = history.first(); ok && position <= history.last(); ++position) {
+            ok = history.seek(position, seeker) && seeker.piecesDropped() == position;
+        }
+        seeker.saveState(actual);
+        loopMismatches += engine.isStarted() ? 0 : !ok || std::memcmp(&expected, &actual, sizeof(expected)) != 0;
+    }
+
+    // Through a save and resume as the GUI's board makes them: a rewound game (its recorder dropped) stays
+    // unranked, and so does one saved without a replay; one saved with its replay is ranked
+    int rankMismatches = 0;
+    std::string path = (std::filesystem::temp_directory_path() / ("tetrix-rewind-" + std::to_string(gen()) + ".txsv")).string();
+    TetrixSaveGame save;
+    TetrixSaveGame loaded;
+    auto roundTrip = [&](const TetrixReplayRecorder *recorder, uint32_t flags, bool ranked) {
+        save.capture(engine, 0, recorder, flags);
+        bool ok = save.write(path) && loaded.read(path) == TetrixSaveGame::Status::Loaded && loaded.isRanked() == ranked
+            && loaded.restoreEngine(seeker);
+        TetrixEngineState expected;
+        TetrixEngineState actual;
+        engine.saveState(expected);
+        seeker.saveState(actual);
+        rankMismatches += !ok || std::memcmp(&expected, &actual, sizeof(expected)) != 0;
+    };
+    for (int i = 0; i < games; ++i) {
+        engine.start(uint64_t(seed) + i, mode);
+        history.begin(engine);
+        while (engine.isStarted() && engine.piecesDropped() < 10) {
+            playRewindPiece(engine, history, gen, nullptr);
+        }
+        if (!engine.isStarted() || !history.seek((history.first() + history.last()) / 2, engine)) {
+            continue;
+        }
+        history.truncate(engine.piecesDropped());
+        TetrixReplayRecorder recorded;
+        recorded.begin(uint64_t(seed) + i, mode, engine.lineClearDelay());
+        TetrixReplayRecorder dropped;
+        roundTrip(&recorded, 0, true);
+        roundTrip(&dropped, TetrixSaveHeader::Rewound, false);
+        roundTrip(nullptr, 0, false);
+    }
+    std::remove(path.c_str());
+
+    std::printf("positions:    %lld over %d games, %d mismatches\n", positions, games, mismatches);
+    std::printf("played on:    %d games rewound and continued, %d mismatches\n", games, branchMismatches);
+    std::printf("loop games:   %d, %d mismatches\n", games, loopMismatches);
+    std::printf("saved:        rewound and replay-less games unranked after resuming, %d mismatches\n", rankMismatches);
+    std::printf("rewind step:  %.1f us avg, %.1f us max (a 60 Hz frame is 16667 us)\n",
+                scrubSteps ? scrubNs / 1e3 / scrubSteps : 0.0, maxScrubNs / 1e3);
+    std::printf("memory:       %zu bytes for %d pieces (4 per lock, a %zu-byte snapshot every %d)\n", history.memoryBytes(),
+                int(TetrixRewind::Capacity), sizeof(TetrixEngineState), int(TetrixRewind::SnapshotInterval));
+    return mismatches == 0 && branchMismatches == 0 && loopMismatches == 0 && rankMismatches == 0 ? 0 : 1;
+}
+
+// One game played to a piece count and saved there, for --resume
+int saveAt(int pieces, const char *path, unsigned seed, TetrixRandomizer::Mode mode, int lineClearDelayMs) {
+    TetrixEngine engine;
+    engine.setLineClearDelay(lineClearDelayMs);
+    TetrixReplayRecorder recorder;
+    GameDriver driver{ engine, &recorder, 0 };
+    std::mt19937 gen(seed);
+    driver.start(seed, mode);
+    playRandomGame(driver, gen, pieces);
+    TetrixSaveGame save;
+    save.capture(engine, driver.clockMs, &recorder);
+    if (!save.write(path)) {
+        std::printf("%s: cannot write\n", path);
+        return 1;
+    }
+    std::printf("%s: seed %u, piece %d, score %d, %zu bytes\n", path, seed, engine.piecesDropped(), engine.score(), save.size());
+    return 0;
+}
+
+struct Position {
+    TetrixGrid grid;
+    TetrixPiece piece;
+    int x;
+    int y;
+};
+
+// Collects spawn positions from random games so the placement search runs on realistic boards
+std::vector<Position> collectPositions(int count, std::mt19937 &gen) {
+    std::vector<Position> positions;
+    positions.reserve(count);
+    TetrixEngine engine;
+    std::uniform_int_distribution<> rotations(0, 3);
+    std::uniform_int_distribution<> shift(-TetrixEngine::BoardWidth / 2, TetrixEngine::BoardWidth / 2);
+
+    while (static_cast<int>(positions.size()) < count) {
+        engine.start();
+        while (engine.isStarted() && static_cast<int>(positions.size()) < count) {
+            positions.push_back({ engine.grid(), engine.currentPiece(), engine.currentX(), engine.currentY() });
+            for (int r = rotations(gen); r > 0; --r) {
+                engine.input(TetrixInput::RotateRight);
+            }
+            int dx = shift(gen);
+            for (int i = std::abs(dx); i > 0; --i) {
+                engine.input(dx < 0 ? TetrixInput::Left : TetrixInput::Right);
+            }
+            engine.input(TetrixInput::HardDrop);
+            if (engine.isWaitingAfterLine()) {
+                engine.tick();
+            }
+        }
+    }
+    return positions;
+}
+
+// Replays a placement's key sequence on the grid and checks it lands where reported
+bool replayMatches(const TetrixPlacementGenerator &generator, const TetrixPlacement &placement, const Position &position) {
+    TetrixPiece piece = position.piece;
+    int x = position.x;
+    int y = position.y;
+    const TetrixInput *path = generator.path(placement);
+    for (int i = 0; i < placement.pathLength; ++i) {
+        TetrixPiece nextPiece = piece;
+        int nx = x;
+        int ny = y;
+        switch (path[i]) {
+        case TetrixInput::Left: --nx; break;
+        case TetrixInput::Right: ++nx; break;
+        case TetrixInput::RotateRight: nextPiece = piece.rotatedRight(); break;
+        case TetrixInput::SoftDrop: --ny; break;
+        case TetrixInput::HardDrop:
+            while (position.grid.fits(piece, x, ny - 1)) {
+                --ny;
+            }
+            return i == placement.pathLength - 1 && x == placement.x && ny == placement.y && piece.rotation() == placement.rotation;
+        }
+        if (!position.grid.fits(nextPiece, nx, ny)) {
+            return false;
+        }
+        piece = nextPiece;
+        x = nx;
+        y = ny;
+    }
+    return false;
+}
+
+int benchPlacements(int count, std::mt19937 &gen) {
+    std::vector<Position> positions = collectPositions(count, gen);
+    TetrixPlacementGenerator generator;
+
+    long long reachable = 0;
+    long long pathInputs = 0;
+    int mismatches = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (const Position &position : positions) {
+        reachable += generator.generate(position.grid, position.piece, position.x, position.y);
+    }
+    double searchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    // Verify the paths outside the timed loop
+    for (const Position &position : positions) {
+        generator.generate(position.grid, position.piece, position.x, position.y);
+        for (int i = 0; i < generator.count(); ++i) {
+            pathInputs += generator.placement(i).pathLength;
+            if (!replayMatches(generator, generator.placement(i), position)) {
+                ++mismatches;
+            }
+        }
+    }
+
+    long long naive = 0;
+    begin = std::chrono::steady_clock::now();
+    for (const Position &position : positions) {
+        naive += generator.generateNaive(position.grid, position.piece, position.x, position.y);
+    }
+    double naiveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::printf("positions:              %d\n", count);
+    std::printf("reachable placements:   %lld (avg path %.2f inputs, %d replay mismatches)\n",
+                reachable, reachable ? double(pathInputs) / reachable : 0.0, mismatches);
+    std::printf("reachable placements/s: %.0f\n", reachable / searchSeconds);
+    std::printf("naive placements:       %lld\n", naive);
+    std::printf("naive placements/s:     %.0f\n", naive / naiveSeconds);
+    return mismatches == 0 ? 0 : 1;
+}
+
+bool sameFeatures(const TetrixBoardFeatures &a, const TetrixBoardFeatures &b) {
+    return a.aggregateHeight == b.aggregateHeight && a.holes == b.holes && a.bumpiness == b.bumpiness
+        && a.rowTransitions == b.rowTransitions && a.columnTransitions == b.columnTransitions && a.wellDepth == b.wellDepth;
+}
+
+int verifyEvaluator(int count, std::mt19937 &gen) {
+    // Every placement of every spawn from random play, i.e. the boards the bot scores
+    std::vector<Position> positions = collectPositions(count, gen);
+    std::vector<TetrixGrid> boards;
+    TetrixPlacementGenerator generator;
+    for (const Position &position : positions) {
+        generator.generate(position.grid, position.piece, position.x, position.y);
+        for (int i = 0; i < generator.count(); ++i) {
+            const TetrixPlacement &placement = generator.placement(i);
+            TetrixGrid board = position.grid;
+            board.place(generator.piece(placement), placement.x, placement.y);
+            board.clearFullLines();
+            boards.push_back(board);
+        }
+    }
+    const int boardCount = static_cast<int>(boards.size());
+
+    std::vector<TetrixBoardFeatures> reference(boardCount);
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < boardCount; ++i) {
+        reference[i] = TetrixEvaluator::computeFeatures(boards[i].rowData());
+    }
+    double referenceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::printf("boards:          %d\n", boardCount);
+    std::printf("scalar reference: %.1f ns/board\n", referenceSeconds * 1e9 / boardCount);
+
+    int failures = 0;
+    const TetrixEvaluator::Kernel kernels[] = { TetrixEvaluator::Kernel::Scalar, TetrixEvaluator::Kernel::Sse42, TetrixEvaluator::Kernel::Avx2 };
+    const int batchSizes[] = { 64, TetrixBoardBatch::Capacity };
+    std::vector<TetrixBoardFeatures> features(TetrixBoardBatch::Capacity);
+    auto batch = std::make_unique<TetrixBoardBatch>();
+    for (TetrixEvaluator::Kernel kernel : kernels) {
+        if (!TetrixEvaluator::isSupported(kernel)) {
+            std::printf("%-7s unsupported on this CPU\n", TetrixEvaluator::kernelName(kernel));
+            continue;
+        }
+        for (int batchSize : batchSizes) {
+            int mismatches = 0;
+            double kernelSeconds = 0.0;
+            for (int first = 0; first < boardCount; first += batchSize) {
+                int last = std::min(boardCount, first + batchSize);
+                batch->clear();
+                for (int i = first; i < last; ++i) {
+                    batch->add(boards[i], 0);
+                }
+                auto kernelBegin = std::chrono::steady_clock::now();
+                TetrixEvaluator::computeFeaturesBatch(*batch, features.data(), kernel);
+                kernelSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - kernelBegin).count();
+                for (int i = first; i < last; ++i) {
+                    if (!sameFeatures(features[i - first], reference[i])) {
+                        ++mismatches;
+                    }
+                }
+            }
+            failures += mismatches;
+            std::printf("%-7s batch %3d: %.1f ns/board, %.2fx vs scalar reference, %d mismatches\n",
+                        TetrixEvaluator::kernelName(kernel), batchSize, kernelSeconds * 1e9 / boardCount,
+                        referenceSeconds / kernelSeconds, mismatches);
+        }
+    }
+    std::printf("%s\n", failures == 0 ? "all kernels bit-exact" : "KERNEL MISMATCH");
+    return failures == 0 ? 0 : 1;
+}
+
+// Rows the piece falls from wall-clock advances of the given sizes, starting from a fresh level
+int loopRows(int level, const int64_t *advancesNs, int count) {
+    TetrixEngine engine(1);
+    TetrixGameLoop loop(engine);
+    loop.start(1, TetrixRandomizer::Mode::Uniform, 0);
+    TetrixEngineState state;
+    engine.saveState(state);
+    state.level = level;
+    engine.restoreState(state);
+    int startY = engine.currentY();
+    int64_t nowNs = 0;
+    for (int i = 0; i < count; ++i) {
+        nowNs += advancesNs[i];
+        loop.advance(nowNs);
+    }
+    return startY - engine.currentY();
+}
+
+// The preview queue must show exactly the shapes the randomizer deals next, and survive a save and restore
+bool upcomingMatches(const TetrixEngine &engine, TetrixRandomizer &dealer, std::vector<TetrixShape> &dealt) {
+    // Every lock spawns at once, except the one waiting out a line-clear delay
+    size_t next = static_cast<size_t>(engine.piecesDropped()) + (engine.isWaitingAfterLine() ? 0 : 1);
+    while (dealt.size() < next + TetrixEngine::PreviewCapacity) {
+        dealt.push_back(dealer.next());
+    }
+    for (int i = 0; i < TetrixEngine::PreviewCapacity; ++i) {
+        if (engine.upcomingPiece(i).shape() != dealt[next + i]) {
+            return false;
+        }
+    }
+    return engine.upcomingPiece(0) == engine.nextPiece();
+}
+
+int verifyLoop(int games, uint64_t seed, TetrixRandomizer::Mode mode, int maxPieces, int lineClearDelayMs) {
+    int failures = 0;
+
+    // Level 1000 falls a row per millisecond: three 0.4 ms frames add up to one row, not zero
+    const int64_t subMillisecond[] = { 400000, 400000, 400000 };
+    int rows = loopRows(1000, subMillisecond, 3);
+    std::printf("sub-ms frames at level 1000: %d row%s (expected 1)\n", rows, rows == 1 ? "" : "s");
+    failures += rows != 1;
+    // Level 5000 falls a row every 0.2 ms: one 1 ms step moves five rows
+    const int64_t oneStep[] = { TetrixGameLoop::StepNs };
+    rows = loopRows(5000, oneStep, 1);
+    std::printf("one step at level 5000:      %d rows (expected 5)\n", rows);
+    failures += rows != 5;
+
+    // Random players pressing and releasing keys between jittered frames around 144 Hz
+    std::mt19937 gen(static_cast<unsigned>(seed));
+    std::uniform_int_distribution<int64_t> frameNs(500000, 12000000);
+    std::uniform_int_distribution<> action(0, 15);
+    const TetrixInput keys[] = { TetrixInput::Left, TetrixInput::Right, TetrixInput::RotateRight, TetrixInput::SoftDrop,
+                                 TetrixInput::HardDrop };
+    TetrixEngine engine(seed);
+    engine.setLineClearDelay(lineClearDelayMs);
+    TetrixGameLoop loop(engine);
+    TetrixReplayRecorder recorder;
+    loop.setRecorder(&recorder);
+    long long pieces = 0;
+    long long bytes = 0;
+    int previewFailures = 0;
+    TetrixRandomizer dealer;
+    std::vector<TetrixShape> dealt;
+    TetrixEngine restored;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < games; ++i) {
+        int64_t nowNs = 0;
+        loop.start(seed + i, mode, nowNs);
+        dealer.seed(seed + i, mode);
+        dealt.clear();
+        bool held[5] = {};
+        while (engine.isStarted() && engine.piecesDropped() < maxPieces) {
+            nowNs += frameNs(gen);
+            int a = action(gen);
+            if (a < 5) {
+                held[a] = !held[a];
+                if (held[a]) {
+                    loop.press(keys[a], nowNs);
+                } else {
+                    loop.release(keys[a], nowNs);
+                }
+            } else {
+                loop.advance(nowNs);
+            }
+            previewFailures += !upcomingMatches(engine, dealer, dealt);
+        }
+        TetrixEngineState state;
+        engine.saveState(state);
+        restored.restoreState(state);
+        for (int p = 0; p < TetrixEngine::PreviewCapacity; ++p) {
+            previewFailures += restored.upcomingPiece(p) != engine.upcomingPiece(p);
+        }
+        const std::vector<uint8_t> &data = recorder.finish(engine, loop.timeMs());
+        TetrixReplay::Summary summary;
+        TetrixReplay::VerifyResult result = TetrixReplay::verify(data.data(), data.size(), &summary);
+        if (result != TetrixReplay::VerifyResult::Ok || summary.pieces != engine.piecesDropped()) {
+            std::printf("game %d (seed %llu): %s\n", i, static_cast<unsigned long long>(seed + i), TetrixReplay::resultName(result));
+            ++failures;
+        }
+        pieces += engine.piecesDropped();
+        bytes += static_cast<long long>(data.size());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::printf("loop games:  %d, %lld pieces, %.2f replay bytes/piece, %.3f s\n", games, pieces,
+                pieces ? double(bytes) / pieces : 0.0, seconds);
+    std::printf("preview:     %d mismatches against the dealt pieces\n", previewFailures);
+    failures += previewFailures;
+    std::printf("%s\n", failures == 0 ? "loop replays verified" : "LOOP VERIFICATION FAILED");
+    return failures == 0 ? 0 : 1;
+}
+
+// A WAV file in memory, with a JUNK chunk before "fmt " as some editors write
+std::vector<uint8_t> makeWav(int channels, int bits, int rate, const std::vector<int> &samples) {
+    std::vector<uint8_t> wav;
+    auto put = [&wav](uint32_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            wav.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    };
+    auto tag = [&wav](const char *id) { wav.insert(wav.end(), id, id + 4); };
+    uint32_t dataSize = static_cast<uint32_t>(samples.size() * bits / 8);
+    tag("RIFF");
+    put(4 + 12 + 24 + 8 + dataSize, 4);
+    tag("WAVE");
+    tag("JUNK");
+    put(4, 4);
+    put(0, 4);
+    tag("fmt ");
+    put(16, 4);
+    put(1, 2);
+    put(channels, 2);
+    put(rate, 4);
+    put(rate * channels * bits / 8, 4);
+    put(channels * bits / 8, 2);
+    put(bits, 2);
+    tag("data");
+    put(dataSize, 4);
+    for (int sample : samples) {
+        put(bits == 8 ? static_cast<uint32_t>(sample + 128) : static_cast<uint32_t>(sample), bits / 8);
+    }
+    return wav;
+}
+
+int verifyAudio() {
+    int failures = 0;
+
+    // Stereo 16-bit at the mixer rate decodes unchanged; mono 8-bit at half the rate doubles in length
+    std::vector<int> stereo;
+    for (int i = 0; i < 2000; ++i) {
+        stereo.push_back((i * 37) % 60000 - 30000);
+    }
+    std::vector<uint8_t> wav = makeWav(2, 16, TetrixAudio::SampleRate, stereo);
+    TetrixAudioClip drop;
+    bool ok = TetrixAudio::decodeWav(wav.data(), wav.size(), drop) && drop.frames() == 1000;
+    for (size_t i = 0; ok && i < stereo.size(); ++i) {
+        ok = drop.samples[i] == stereo[i];
+    }
+    std::printf("16-bit stereo decode:  %s\n", ok ? "exact" : "MISMATCH");
+    failures += !ok;
+    std::vector<int> mono(500, 64);
+    wav = makeWav(1, 8, TetrixAudio::SampleRate / 2, mono);
+    TetrixAudioClip music;
+    ok = TetrixAudio::decodeWav(wav.data(), wav.size(), music) && music.frames() == 1000
+        && music.samples[0] == 64 << 8 && music.samples[1] == 64 << 8;
+    std::printf("8-bit mono resample:   %s (%d frames)\n", ok ? "ok" : "MISMATCH", music.frames());
+    failures += !ok;
+
+    // Mixing sums the voices at their gain and saturates
+    TetrixAudioMixer mixer;
+    mixer.setClip(TetrixSound::Drop, &drop);
+    mixer.setClip(TetrixSound::Background, &music);
+    mixer.play(TetrixSound::Drop, 1.0f, false);
+    mixer.play(TetrixSound::Drop, 1.0f, false);
+    mixer.play(TetrixSound::Background, 0.5f, true);
+    int16_t block[TetrixAudio::BlockFrames * TetrixAudio::Channels];
+    int mismatches = 0;
+    for (int b = 0; b < 8; ++b) {
+        mixer.mix(block, TetrixAudio::BlockFrames);
+        for (int i = 0; i < TetrixAudio::BlockFrames * TetrixAudio::Channels; ++i) {
+            int frame = b * TetrixAudio::BlockFrames + i / TetrixAudio::Channels;
+            int expected = (frame < drop.frames() ? 2 * drop.samples[b * TetrixAudio::BlockFrames * 2 + i] : 0)
+                + music.samples[(frame % music.frames()) * 2 + i % 2] / 2;
+            mismatches += block[i] != std::clamp(expected, -32768, 32767);
+        }
+    }
+    std::printf("mixer:                 %d mismatches, %d voice%s left\n", mismatches, mixer.activeVoices(),
+                mixer.activeVoices() == 1 ? "" : "s");
+    failures += mismatches != 0 || mixer.activeVoices() != 1;
+
+    // The mixer thread flat out on a null sink, fed commands from this thread as a game would post them
+    TetrixAudioEngine audio;
+    audio.setClip(TetrixSound::Drop, drop);
+    audio.setClip(TetrixSound::Background, music);
+    TetrixNullAudioSink sink(false);
+    audio.start(&sink);
+    auto begin = std::chrono::steady_clock::now();
+    audio.play(TetrixSound::Background, 0.3f, true);
+    const int commands = 100000;
+    for (int i = 0; i < commands; ++i) {
+        audio.play(TetrixSound::Drop, 0.7f);
+        if (i % 64 == 0) {
+            std::this_thread::yield();
+        }
+    }
+    audio.stop();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    TetrixAudioEngine::Stats stats = audio.stats();
+    double audioSeconds = double(sink.framesWritten()) / TetrixAudio::SampleRate;
+    std::printf("mixer thread:          %llu blocks, %.0fx real time, slowest block %.1f us\n",
+                static_cast<unsigned long long>(stats.blocks), seconds > 0 ? audioSeconds / seconds : 0.0, stats.maxMixNs / 1000.0);
+    std::printf("commands:              %d posted, %llu dropped (queue full), %llu voices taken over\n", commands + 1,
+                static_cast<unsigned long long>(stats.droppedCommands), static_cast<unsigned long long>(stats.stolenVoices));
+    failures += stats.blocks == 0 || sink.peak() == 0;
+
+    // Real-time pacing: a null sink takes audio no faster than a device would
+    TetrixNullAudioSink paced;
+    audio.start(&paced);
+    audio.play(TetrixSound::Background, 0.3f, true);
+    begin = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    audio.stop();
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    double pacedSeconds = double(paced.framesWritten()) / TetrixAudio::SampleRate;
+    std::printf("paced null sink:       %.3f s of audio in %.3f s\n", pacedSeconds, seconds);
+    failures += pacedSeconds > seconds + 0.05 || pacedSeconds < seconds * 0.5;
+
+    std::printf("%s\n", failures == 0 ? "audio verified" : "AUDIO VERIFICATION FAILED");
+    return failures == 0 ? 0 : 1;
+}
+
+// Leaderboard queries against the same games sorted by brute force
+int checkLeaderboard(const TetrixLeaderboard &board, const std::vector<std::pair<int, uint32_t>> &games, std::mt19937 &gen) {
+    std::vector<std::pair<int, uint32_t>> ranked = games;
+    std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    int mismatches = board.count() != games.size();
+    std::vector<uint32_t> top;
+    board.top(100, top);
+    for (size_t i = 0; i < top.size(); ++i) {
+        mismatches += top[i] != ranked[i].second;
+    }
+    mismatches += top.size() != std::min<size_t>(100, ranked.size());
+    std::vector<size_t> rankOfGame(games.size());
+    for (size_t i = 0; i < ranked.size(); ++i) {
+        rankOfGame[ranked[i].second] = i + 1;
+    }
+    std::uniform_int_distribution<size_t> pick(0, games.size() - 1);
+    for (int i = 0; i < 1000 && !games.empty(); ++i) {
+        uint32_t index = static_cast<uint32_t>(pick(gen));
+        mismatches += board.rankOf(index) != rankOfGame[index];
+        int score = games[index].first + 1;
+        size_t better = std::lower_bound(ranked.begin(), ranked.end(), std::make_pair(score, uint32_t(0)),
+                                         [](const auto &a, const auto &b) { return a.first > b.first; })
+            - ranked.begin();
+        mismatches += board.rankForScore(score) != better + 1;
+    }
+    // Best game per player: the first one met in rank order
+    std::vector<bool> seen(board.playerCount());
+    for (const auto &game : ranked) {
+        uint32_t player = board.entry(game.second).player;
+        if (!seen[player]) {
+            seen[player] = true;
+            uint32_t best;
+            mismatches += !board.playerBest(board.playerName(player), best) || best != game.second;
+        }
+    }
+    return mismatches;
+}
+
+int verifyLeaderboard(int games, std::mt19937 &gen) {
+    using Clock = std::chrono::steady_clock;
+    auto msSince = [](Clock::time_point begin) { return std::chrono::duration<double, std::milli>(Clock::now() - begin).count(); };
+    std::string path = (std::filesystem::temp_directory_path() / ("tetrix-leaderboard-" + std::to_string(gen()))).string();
+    std::string logPath = path + ".log";
+    std::string snapPath = path + ".snap";
+    int failures = 0;
+
+    // Scores cluster so ties are common; one name ends in a two-byte character straddling the record's
+    // name field, which has to be cut before it
+    std::uniform_int_distribution<int> score(0, 50000);
+    std::uniform_int_distribution<int> player(0, 999);
+    std::vector<std::pair<int, uint32_t>> played;
+    auto addGames = [&](TetrixLeaderboard &board, int count, uint64_t &maxAddNs) {
+        for (int i = 0; i < count; ++i) {
+            int points = score(gen);
+            std::string name = i == 0 ? std::string(35, 'x') + "\xc3\xa9" : "player" + std::to_string(player(gen));
+            auto begin = Clock::now();
+            uint32_t index = board.add(name, points, points / 100, 1 + points / 2000, points / 7, 1700000000000 + i);
+            maxAddNs = std::max<uint64_t>(maxAddNs, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count());
+            played.emplace_back(points, index);
+        }
+    };
+
+    TetrixLeaderboard board;
+    if (!board.open(path)) {
+        std::printf("%s: cannot open\n", path.c_str());
+        return 1;
+    }
+    uint64_t maxAddNs = 0;
+    auto begin = Clock::now();
+    addGames(board, games, maxAddNs);
+    double addMs = msSince(begin);
+    begin = Clock::now();
+    board.flush();
+    double flushMs = msSince(begin);
+    TetrixLeaderboard::Stats stats = board.stats();
+    std::printf("add:          %d games in %.1f ms (slowest %.1f us), %d players; flush waited %.1f ms\n", games, addMs,
+                maxAddNs / 1000.0, static_cast<int>(board.playerCount()), flushMs);
+    std::printf("log:          %llu records in %llu batches, slowest batch %.1f ms\n", static_cast<unsigned long long>(stats.records),
+                static_cast<unsigned long long>(stats.batches), stats.maxFlushNs / 1e6);
+    failures += stats.records != uint64_t(games) || stats.failedRecords != 0;
+    begin = Clock::now();
+    int mismatches = checkLeaderboard(board, played, gen);
+    std::printf("queries:      %d mismatches (%.1f ms for 1000 ranks, top 100 and every player's best)\n", mismatches, msSince(begin));
+    failures += mismatches;
+    uint32_t cut;
+    failures += !board.playerBest(std::string(35, 'x'), cut);
+    begin = Clock::now();
+    failures += !board.close();
+    std::printf("close:        %.1f ms, snapshot %.1f MB\n", msSince(begin), std::filesystem::file_size(snapPath) / 1048576.0);
+
+    // Startup from the snapshot alone
+    begin = Clock::now();
+    failures += !board.open(path);
+    double openMs = msSince(begin);
+    mismatches = checkLeaderboard(board, played, gen);
+    std::printf("snapshot:     opened in %.1f ms, %llu records replayed, %d mismatches\n", openMs,
+                static_cast<unsigned long long>(board.loadInfo().replayedRecords), mismatches);
+    failures += mismatches + !board.loadInfo().snapshotUsed + (board.loadInfo().replayedRecords != 0);
+
+    // A crash: games logged after the snapshot, the last record torn halfway
+    std::filesystem::copy_file(snapPath, snapPath + ".old", std::filesystem::copy_options::overwrite_existing);
+    addGames(board, 1000, maxAddNs);
+    board.close();
+    std::filesystem::rename(snapPath + ".old", snapPath);
+    FILE *log = std::fopen(logPath.c_str(), "ab");
+    const char torn[30] = { 1, 2, 3 };
+    failures += !log || std::fwrite(torn, 1, sizeof(torn), log) != sizeof(torn);
+    if (log) {
+        std::fclose(log);
+    }
+    begin = Clock::now();
+    failures += !board.open(path);
+    openMs = msSince(begin);
+    mismatches = checkLeaderboard(board, played, gen);
+    std::printf("crash:        opened in %.1f ms, %llu records replayed, %llu torn bytes cut, %d mismatches\n", openMs,
+                static_cast<unsigned long long>(board.loadInfo().replayedRecords),
+                static_cast<unsigned long long>(board.loadInfo().discardedBytes), mismatches);
+    failures += mismatches + (board.loadInfo().replayedRecords != 1000) + (board.loadInfo().discardedBytes != sizeof(torn));
+    board.close();
+
+    // No snapshot at all: the whole log is replayed
+    std::filesystem::remove(snapPath);
+    begin = Clock::now();
+    failures += !board.open(path);
+    openMs = msSince(begin);
+    mismatches = checkLeaderboard(board, played, gen);
+    std::printf("log replay:   opened in %.1f ms, %llu records replayed, %d mismatches\n", openMs,
+                static_cast<unsigned long long>(board.loadInfo().replayedRecords), mismatches);
+    failures += mismatches + board.loadInfo().snapshotUsed;
+    board.close();
+
+    std::filesystem::remove(logPath);
+    std::filesystem::remove(snapPath);
+    std::printf("%s\n", failures == 0 ? "leaderboard verified" : "LEADERBOARD VERIFICATION FAILED");
+    return failures == 0 ? 0 : 1;
+}
+
+struct VersusOptions {
+    bool hosting = false;
+    std::string host;
+    uint16_t port = TetrixVersusProtocol::DefaultPort;
+    int latencyMs = 0;
+    int seconds = 60;
+    bool useBot = false;
+};
+
+// Plays one side of a match at roughly human speed: a pause to "think" after each spawn (MinThinkMs to
+// MaxThinkMs), then one key every InputGapMs, each pressed and released in the same frame
+class VersusPlayer {
+public:
+    enum { MinThinkMs = 50, MaxThinkMs = 300, InputGapMs = 25, BotBudgetMs = 5 };
+
+    VersusPlayer(bool useBot, uint64_t seed) : useBot(useBot), gen(static_cast<std::mt19937::result_type>(seed)), plannedPiece(-1),
+        planY(0), next(0), nextNs(0) {}
+
+    void play(TetrixVersusMatch &match, int64_t nowNs) {
+        TetrixEngine &engine = match.engine(match.localPlayer());
+        if (!match.isPlaying(nowNs) || !engine.isStarted() || engine.isWaitingAfterLine()
+            || engine.currentPiece().shape() == TetrixShape::NoShape) {
+            return;
+        }
+        if (engine.piecesDropped() != plannedPiece) {
+            plan(engine);
+            nextNs = nowNs + int64_t(std::uniform_int_distribution<>(MinThinkMs, MaxThinkMs)(gen)) * 1000000;
+        }
+        if (nowNs < nextNs || next >= inputs.size()) {
+            return;
+        }
+        TetrixInput input = inputs[next++];
+        // Gravity may have pulled the piece down since the plan; those rows count as soft drops
+        if (input == TetrixInput::SoftDrop && planY > engine.currentY()) {
+            --planY;
+            return;
+        }
+        match.press(input, nowNs);
+        match.release(input, nowNs);
+        nextNs = nowNs + int64_t(InputGapMs) * 1000000;
+    }
+
+private:
+    void plan(const TetrixEngine &engine) {
+        plannedPiece = engine.piecesDropped();
+        planY = engine.currentY();
+        next = 0;
+        inputs.clear();
+        if (useBot) {
+            TetrixBotMove move = bot.chooseMove(engine.grid(), engine.currentPiece(), engine.currentX(), engine.currentY(),
+                                                engine.nextPiece(), std::chrono::milliseconds(BotBudgetMs));
+            if (move.valid) {
+                inputs = std::move(move.inputs);
+            }
+            return;
+        }
+        std::uniform_int_distribution<> rotations(0, 3);
+        std::uniform_int_distribution<> shift(-TetrixEngine::BoardWidth / 2, TetrixEngine::BoardWidth / 2);
+        inputs.insert(inputs.end(), rotations(gen), TetrixInput::RotateRight);
+        int dx = shift(gen);
+        inputs.insert(inputs.end(), std::abs(dx), dx < 0 ? TetrixInput::Left : TetrixInput::Right);
+        inputs.push_back(TetrixInput::HardDrop);
+    }
+
+    bool useBot;
+    TetrixBot bot;
+    std::mt19937 gen;
+    std::vector<TetrixInput> inputs;
+    int plannedPiece;
+    int planY;
+    size_t next;
+    int64_t nextNs;
+};
+
+int playVersus(const VersusOptions &options, unsigned seed, TetrixRandomizer::Mode mode, int lineClearDelayMs) {
+    TetrixVersusMatch match;
+    TetrixConnection &connection = match.connection();
+    if (options.hosting) {
+        TetrixListener listener;
+        if (!listener.listen(options.port)) {
+            std::printf("cannot listen on port %u\n", options.port);
+            return 1;
+        }
+        std::printf("waiting for a player on port %u\n", listener.port());
+        std::fflush(stdout);
+        while (!listener.accept(connection)) {
+            listener.waitAcceptable(1000);
+        }
+    } else if (!connection.connect(options.host, options.port, 5000)) {
+        std::printf("cannot connect to %s:%u\n", options.host.c_str(), options.port);
+        return 1;
+    }
+    connection.setLatency(options.latencyMs);
+
+    TetrixRepeatSettings repeat;
+    if (options.hosting) {
+        TetrixVersusMatch::Settings settings;
+        settings.seed = seed;
+        settings.mode = mode;
+        settings.lineClearDelayMs = lineClearDelayMs;
+        settings.frameLimit = static_cast<uint32_t>(std::max(options.seconds, 1)) * 1000;
+        match.host(settings, repeat, TetrixVersusMatch::clockNs());
+    } else {
+        match.join(repeat, TetrixVersusMatch::clockNs());
+    }
+
+    VersusPlayer player(options.useBot, uint64_t(seed) * 2 + (options.hosting ? 0 : 1));
+    while (match.phase() != TetrixVersusMatch::Phase::Closed && match.phase() != TetrixVersusMatch::Phase::Failed) {
+        int64_t nowNs = TetrixVersusMatch::clockNs();
+        match.advance(nowNs);
+        match.takeEvents(0);
+        match.takeEvents(1);
+        player.play(match, nowNs);
+        match.poll(nowNs);
+        // Wake for the next frame or as soon as the peer sends something
+        connection.waitReadable(1);
+    }
+    if (match.phase() == TetrixVersusMatch::Phase::Failed) {
+        std::printf("match failed at frame %u: %s\n", match.frame(), match.error().c_str());
+        return 1;
+    }
+
+    int local = match.localPlayer();
+    const TetrixEngine &mine = match.engine(local);
+    const TetrixEngine &theirs = match.engine(match.remotePlayer());
+    TetrixVersusMatch::Stats stats = match.stats();
+    double seconds = match.confirmedFrame() / 1000.0;
+    std::printf("role:         %s, player %d, seed %llu\n", options.hosting ? "host" : "join", local,
+                static_cast<unsigned long long>(match.settings().seed));
+    std::printf("result:       %s after %.3f s\n", match.winner() < 0 ? "draw" : (match.winner() == local ? "won" : "lost"), seconds);
+    std::printf("score:        %d (%d lines, %d pieces) vs %d (%d lines, %d pieces)\n", mine.score(), mine.linesRemoved(),
+                mine.piecesDropped(), theirs.score(), theirs.linesRemoved(), theirs.piecesDropped());
+    std::printf("rtt:          last %.2f ms, avg %.2f ms, min %.2f ms, max %.2f ms (%llu pings)\n", stats.rttNs / 1e6,
+                stats.rttSamples ? stats.totalRttNs / 1e6 / double(stats.rttSamples) : 0.0, stats.minRttNs / 1e6, stats.maxRttNs / 1e6,
+                static_cast<unsigned long long>(stats.rttSamples));
+    std::printf("bandwidth:    sent %.0f B/s (%.3f B/frame, %llu messages), received %.0f B/s (%.3f B/frame)\n",
+                stats.bytesSent / std::max(seconds, 0.001), stats.bytesSent / std::max(seconds * 1000, 1.0),
+                static_cast<unsigned long long>(stats.messagesSent), stats.bytesReceived / std::max(seconds, 0.001),
+                stats.bytesReceived / std::max(seconds * 1000, 1.0));
+    std::printf("rollbacks:    %llu, %llu frames re-simulated (max %u), %.1f us avg, %.1f us max\n",
+                static_cast<unsigned long long>(stats.rollbacks), static_cast<unsigned long long>(stats.resimulatedFrames),
+                stats.maxRollbackFrames, stats.rollbacks ? stats.rollbackNs / 1e3 / double(stats.rollbacks) : 0.0,
+                stats.maxRollbackNs / 1e3);
+    std::printf("stalls:       %llu\n", static_cast<unsigned long long>(stats.stalls));
+    std::printf("checksums:    %llu compared, %llu desyncs\n", static_cast<unsigned long long>(stats.checksums),
+                static_cast<unsigned long long>(stats.desyncs));
+    std::printf("final:        %016llx\n", static_cast<unsigned long long>(match.finalChecksum()));
+    return stats.desyncs == 0 ? 0 : 1;
+}
+
+// Spectator streams: a fast game broadcast to many loopback viewers, all in this process
+int benchBroadcast(int spectators, int seconds, unsigned seed, TetrixRandomizer::Mode mode, int lineClearDelayMs) {
+    enum { FrameMs = 16, SlowEvery = 10, SlowReadMs = 20000, SlowReceiveBytes = 2048, DrainTimeoutMs = 5000 };
+    auto clockNs = [] {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+    TetrixBroadcastServer server;
+    if (!server.listen(0)) {
+        std::printf("cannot listen\n");
+        return 1;
+    }
+
+    struct Viewer {
+        TetrixConnection link;
+        TetrixSpectator spectator;
+        std::vector<uint8_t> buffer;
+        bool slow = false;
+        bool failed = false;
+    };
+    std::vector<std::unique_ptr<Viewer>> viewers;
+    for (int i = 0; i < spectators; ++i) {
+        auto viewer = std::make_unique<Viewer>();
+        viewer->slow = i % SlowEvery == SlowEvery - 1;
+        if (!viewer->link.connect("127.0.0.1", server.port(), 5000)) {
+            std::printf("spectator %d cannot connect\n", i);
+            return 1;
+        }
+        if (viewer->slow) {
+            viewer->link.setBufferSizes(0, SlowReceiveBytes);
+        }
+        viewers.push_back(std::move(viewer));
+        server.pump(clockNs()); // Accepts as they come; the listen backlog is short
+    }
+    auto drain = [](Viewer &viewer) {
+        if (!viewer.failed) {
+            bool open = viewer.link.receive(viewer.buffer);
+            viewer.failed = !viewer.spectator.consume(viewer.buffer) || !open;
+        }
+    };
+
+    // Random "rotate, shift, drop" plans played one input per frame, with no thinking time
+    TetrixEngine engine;
+    engine.setLineClearDelay(lineClearDelayMs);
+    TetrixGameLoop loop(engine);
+    TetrixBroadcastEncoder encoder;
+    std::mt19937 gen(seed);
+    std::vector<TetrixInput> inputs;
+    size_t next = 0;
+    int plannedPiece = -1;
+    int gamesPlayed = 0;
+    int64_t gameStartNs = 0;
+    uint64_t readerNs = 0;
+    uint64_t deltaBytes = 0;
+    uint64_t deltas = 0;
+    const int frames = std::max(seconds, 1) * 1000 / FrameMs;
+    for (int frame = 0; frame < frames; ++frame) {
+        int64_t simNs = int64_t(frame) * FrameMs * 1000000;
+        if (!engine.isStarted()) {
+            gameStartNs = simNs;
+            loop.start(seed + gamesPlayed++, mode, 0);
+            plannedPiece = -1;
+        }
+        if (!engine.isWaitingAfterLine() && engine.currentPiece().shape() != TetrixShape::NoShape) {
+            if (engine.piecesDropped() != plannedPiece) {
+                plannedPiece = engine.piecesDropped();
+                inputs.assign(std::uniform_int_distribution<>(0, 3)(gen), TetrixInput::RotateRight);
+                int dx = std::uniform_int_distribution<>(-TetrixEngine::BoardWidth / 2, TetrixEngine::BoardWidth / 2)(gen);
+                inputs.insert(inputs.end(), std::abs(dx), dx < 0 ? TetrixInput::Left : TetrixInput::Right);
+                inputs.insert(inputs.end(), 4, TetrixInput::SoftDrop);
+                inputs.push_back(TetrixInput::HardDrop);
+                next = 0;
+            }
+            if (next < inputs.size()) {
+                loop.input(inputs[next++], simNs - gameStartNs);
+            }
+        }
+        loop.advance(simNs - gameStartNs);
+
+        uint32_t timeMs = static_cast<uint32_t>(simNs / 1000000);
+        if (TetrixBroadcastFramePtr encoded = encoder.encode(engine, timeMs, server.wantsKeyframe())) {
+            if (!encoded->keyframe) {
+                deltaBytes += encoded->bytes.size();
+                ++deltas;
+            }
+            server.publish(std::move(encoded));
+        }
+        server.pump(clockNs());
+
+        int64_t readStartNs = clockNs();
+        bool slowRead = (frame + 1) % (SlowReadMs / FrameMs) == 0;
+        for (std::unique_ptr<Viewer> &viewer : viewers) {
+            if (!viewer->slow || slowRead) {
+                drain(*viewer);
+            }
+        }
+        readerNs += static_cast<uint64_t>(clockNs() - readStartNs);
+    }
+
+    // Every viewer, slow ones too, ends on the final position
+    uint32_t endMs = static_cast<uint32_t>(int64_t(frames) * FrameMs);
+    server.publish(encoder.keyframe(engine, endMs));
+    TetrixBroadcastBoard expected;
+    expected.capture(engine);
+    uint32_t finalSequence = encoder.sequence() - 1;
+    int matched = 0;
+    int64_t drainStartNs = clockNs();
+    while (clockNs() - drainStartNs < int64_t(DrainTimeoutMs) * 1000000) {
+        server.pump(clockNs());
+        matched = 0;
+        for (std::unique_ptr<Viewer> &viewer : viewers) {
+            drain(*viewer);
+            const TetrixSpectator &spectator = viewer->spectator;
+            matched += spectator.isSynced() && spectator.sequence() == finalSequence
+                && spectator.board().checksum() == expected.checksum();
+        }
+        if (matched == spectators) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    TetrixBroadcastServer::Stats stats = server.stats();
+    uint64_t keyframes = 0;
+    uint64_t gaps = 0;
+    int failed = 0;
+    for (std::unique_ptr<Viewer> &viewer : viewers) {
+        keyframes += viewer->spectator.keyframes();
+        gaps += viewer->spectator.gaps();
+        failed += viewer->failed;
+    }
+    double gameSeconds = frames * FrameMs / 1000.0;
+    double pumpUs = stats.pumps ? stats.pumpNs / 1e3 / double(stats.pumps) : 0.0;
+    std::printf("spectators:   %d (%d stalled), %d games, %d frames over %.0f s of game time\n", spectators,
+                spectators / SlowEvery, gamesPlayed, frames, gameSeconds);
+    std::printf("stream:       %llu frames, %llu keyframes, %.1f B per delta, %.0f B/s per spectator\n",
+                static_cast<unsigned long long>(stats.framesPublished), static_cast<unsigned long long>(stats.keyframesPublished),
+                deltas ? double(deltaBytes) / double(deltas) : 0.0, stats.bytesPublished / gameSeconds);
+    std::printf("server:       %.1f us per frame avg, %.1f us max, %.1f%% of one core in real time, %.1f MB sent\n", pumpUs,
+                stats.maxPumpNs / 1e3, stats.pumpNs / 1e7 / gameSeconds, stats.bytesSent / 1e6);
+    std::printf("fell behind:  %llu resyncs, %llu frames skipped, %llu cut off; viewers missed %llu frames, got %llu keyframes\n",
+                static_cast<unsigned long long>(stats.resyncs), static_cast<unsigned long long>(stats.framesSkipped),
+                static_cast<unsigned long long>(stats.cutOff), static_cast<unsigned long long>(gaps),
+                static_cast<unsigned long long>(keyframes));
+    std::printf("viewers:      %.1f us per frame reading all streams (this process only)\n", readerNs / 1e3 / frames);
+    std::printf("final board:  %d/%d spectators match%s\n", matched, spectators, failed ? ", some streams failed" : "");
+    return matched == spectators ? 0 : 1;
+}
+
+int spectate(const std::string &host, uint16_t port) {
+    TetrixConnection link;
+    if (!link.connect(host, port, 5000)) {
+        std::printf("cannot connect to %s:%u\n", host.c_str(), port);
+        return 1;
+    }
+    TetrixSpectator spectator;
+    std::vector<uint8_t> buffer;
+    uint32_t printedMs = 0;
+    bool printed = false;
+    for (bool open = true; open;) {
+        link.waitReadable(1000);
+        open = link.receive(buffer);
+        if (!spectator.consume(buffer)) {
+            std::printf("malformed stream\n");
+            return 1;
+        }
+        if (spectator.isSynced() && (!printed || spectator.timeMs() - printedMs >= 1000 || !open)) {
+            const TetrixBroadcastBoard &board = spectator.board();
+            std::printf("%8.1f s  score %d  level %d  lines %d%s  (%llu frames, %llu keyframes, %llu missed)\n",
+                        spectator.timeMs() / 1000.0, board.score, board.level, board.lines, board.started ? "" : "  game over",
+                        static_cast<unsigned long long>(spectator.frames()), static_cast<unsigned long long>(spectator.keyframes()),
+                        static_cast<unsigned long long>(spectator.gaps()));
+            std::fflush(stdout);
+            printedMs = spectator.timeMs();
+            printed = true;
+        }
+    }
+    std::printf("stream closed\n");
+    return 0;
+}
+
+void printUsage(const char *program) {
+    std::printf("Usage: %s [--games N] [--seed S] [--bot] [--no-tt] [--max-pieces N] [--bag] [--record DIR] [--archive FILE]\n"
+                "       %*s [--line-clear-delay MS] [--trace FILE]\n"
+                "       %s --bench-placements POSITIONS | --verify-eval POSITIONS | --verify-replay FILE... | --verify-loop\n"
+                "       %*s | --verify-audio | --verify-leaderboard GAMES\n"
+                "       %s --versus-host PORT | --versus-join HOST:PORT [--latency MS] [--versus-seconds S] [--bot] [--seed S] [--bag]\n"
+                "       %s --broadcast-bench SPECTATORS [--broadcast-seconds S] [--seed S] | --spectate HOST:PORT\n"
+                "       %s --verify-save | --save-at PIECES FILE | --resume FILE [--games N] [--bot] [--record DIR]\n"
+                "       %s --verify-rewind [--games N] [--max-pieces N]\n",
+                program, static_cast<int>(std::strlen(program)), "", program, static_cast<int>(std::strlen(program)), "", program,
+                program, program, program);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    int games = 10000;
+    int placementPositions = 0;
+    int evalPositions = 0;
+    int leaderboardGames = 0;
+    int maxPieces = 1000;
+    int lineClearDelayMs = 0;
+    bool useBot = false;
+    bool useTable = true;
+    const char *recordDir = nullptr;
+    const char *archivePath = nullptr;
+    const char *tracePath = nullptr;
+    std::vector<const char *> replayPaths;
+    bool checkLoop = false;
+    bool checkAudio = false;
+    bool versus = false;
+    VersusOptions versusOptions;
+    int broadcastSpectators = 0;
+    int broadcastSeconds = 60;
+    std::string spectateAddress;
+    bool checkSave = false;
+    bool checkRewind = false;
+    int saveAtPieces = -1;
+    const char *savePath = nullptr;
+    const char *resumePath = nullptr;
+    TetrixRandomizer::Mode mode = TetrixRandomizer::Mode::Uniform;
+    unsigned seed = std::random_device{}();
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            games = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--bot") == 0) {
+            useBot = true;
+        } else if (std::strcmp(argv[i], "--no-tt") == 0) {
+            useTable = false;
+        } else if (std::strcmp(argv[i], "--max-pieces") == 0 && i + 1 < argc) {
+            maxPieces = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--line-clear-delay") == 0 && i + 1 < argc) {
+            lineClearDelayMs = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--bag") == 0) {
+            mode = TetrixRandomizer::Mode::SevenBag;
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordDir = argv[++i];
+        } else if (std::strcmp(argv[i], "--archive") == 0 && i + 1 < argc) {
+            archivePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--verify-replay") == 0 && i + 1 < argc) {
+            while (i + 1 < argc && argv[i + 1][0] != '-') {
+                replayPaths.push_back(argv[++i]);
+            }
+        } else if (std::strcmp(argv[i], "--verify-loop") == 0) {
+            checkLoop = true;
+        } else if (std::strcmp(argv[i], "--verify-audio") == 0) {
+            checkAudio = true;
+        } else if (std::strcmp(argv[i], "--verify-leaderboard") == 0 && i + 1 < argc) {
+            leaderboardGames = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--versus-host") == 0 && i + 1 < argc) {
+            versus = true;
+            versusOptions.hosting = true;
+            versusOptions.port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--versus-join") == 0 && i + 1 < argc) {
+            std::string address = argv[++i];
+            size_t colon = address.rfind(':');
+            versus = true;
+            versusOptions.host = colon == std::string::npos ? address : address.substr(0, colon);
+            if (colon != std::string::npos) {
+                versusOptions.port = static_cast<uint16_t>(std::atoi(address.c_str() + colon + 1));
+            }
+        } else if (std::strcmp(argv[i], "--latency") == 0 && i + 1 < argc) {
+            versusOptions.latencyMs = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--versus-seconds") == 0 && i + 1 < argc) {
+            versusOptions.seconds = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--broadcast-bench") == 0 && i + 1 < argc) {
+            broadcastSpectators = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--broadcast-seconds") == 0 && i + 1 < argc) {
+            broadcastSeconds = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--spectate") == 0 && i + 1 < argc) {
+            spectateAddress = argv[++i];
+        } else if (std::strcmp(argv[i], "--verify-rewind") == 0) {
+            checkRewind = true;
+        } else if (std::strcmp(argv[i], "--verify-save") == 0) {
+            checkSave = true;
+        } else if (std::strcmp(argv[i], "--save-at") == 0 && i + 2 < argc) {
+            saveAtPieces = std::atoi(argv[++i]);
+            savePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            resumePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--verify-eval") == 0 && i + 1 < argc) {
+            evalPositions = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--bench-placements") == 0 && i + 1 < argc) {
+            placementPositions = std::atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (games <= 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::mt19937 gen(seed);
+    if (placementPositions > 0) {
+        return benchPlacements(placementPositions, gen);
+    }
+    if (evalPositions > 0) {
+        return verifyEvaluator(evalPositions, gen);
+    }
+    if (!replayPaths.empty()) {
+        return verifyReplays(replayPaths);
+    }
+    if (checkAudio) {
+        return verifyAudio();
+    }
+    if (leaderboardGames > 0) {
+        return verifyLeaderboard(leaderboardGames, gen);
+    }
+    if (broadcastSpectators > 0) {
+        return benchBroadcast(broadcastSpectators, broadcastSeconds, seed, mode, lineClearDelayMs);
+    }
+    if (!spectateAddress.empty()) {
+        size_t colon = spectateAddress.rfind(':');
+        uint16_t port = TetrixBroadcastProtocol::DefaultPort;
+        if (colon != std::string::npos) {
+            port = static_cast<uint16_t>(std::atoi(spectateAddress.c_str() + colon + 1));
+        }
+        return spectate(colon == std::string::npos ? spectateAddress : spectateAddress.substr(0, colon), port);
+    }
+    if (versus) {
+        versusOptions.useBot = useBot;
+        return playVersus(versusOptions, seed, mode, lineClearDelayMs);
+    }
+    if (checkLoop) {
+        return verifyLoop(games, seed, mode, maxPieces, lineClearDelayMs);
+    }
+    if (checkRewind) {
+        return verifyRewind(games, seed, mode, maxPieces, lineClearDelayMs);
+    }
+    if (checkSave) {
+        return verifySave(games, seed, mode, maxPieces, lineClearDelayMs);
+    }
+    if (savePath) {
+        return saveAt(saveAtPieces, savePath, seed, mode, lineClearDelayMs);
+    }
+    TetrixSaveGame resumeFrom;
+    if (resumePath) {
+        TetrixSaveGame::Status status = resumeFrom.read(resumePath);
+        if (status != TetrixSaveGame::Status::Loaded) {
+            std::printf("%s: %s\n", resumePath, saveStatusName(status));
+            return 1;
+        }
+    }
+
+    TetrixEngine engine(seed);
+    engine.setLineClearDelay(lineClearDelayMs);
+    TetrixBot bot;
+    bot.setTranspositionEnabled(useTable);
+    TetrixReplayRecorder recorder;
+    GameDriver driver{ engine, recordDir || archivePath ? &recorder : nullptr, 0 };
+    GameStats stats;
+    int recordFailures = 0;
+    TetrixArchiveWriter archive;
+    if (archivePath && !archive.open(archivePath)) {
+        std::printf("%s: cannot open archive\n", archivePath);
+        return 1;
+    }
+    if (tracePath && !TetrixTrace::start(tracePath)) {
+        std::printf("%s: cannot open trace\n", tracePath);
+        return 1;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < games; ++i) {
+        TetrixTraceScope gameScope(TetrixTraceId::Game, static_cast<int32_t>(seed + i), i);
+        if (!resumePath) {
+            driver.start(uint64_t(seed) + i, mode);
+        } else if (!driver.resume(resumeFrom)) {
+            std::printf("%s: cannot resume%s\n", resumePath, driver.recorder ? " (recording needs the replay it was saved with)" : "");
+            return 1;
+        }
+        if (useBot) {
+            playBotGame(driver, bot, maxPieces, stats);
+        } else {
+            playRandomGame(driver, gen, maxPieces);
+        }
+        driver.finish(stats);
+        if (recordDir && !writeFile(std::string(recordDir) + "/game-" + std::to_string(i) + ".txr", recorder.data())) {
+            ++recordFailures;
+        }
+        if (archivePath && !archive.append(recorder.data().data(), recorder.data().size())) {
+            ++recordFailures;
+        }
+    }
+    if (archivePath && !archive.close()) {
+        ++recordFailures;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    TetrixTrace::Stats trace = TetrixTrace::stop();
+
+    std::printf("games:        %d\n", games);
+    std::printf("avg score:    %.1f\n", double(stats.score) / games);
+    std::printf("avg lines:    %.2f\n", double(stats.lines) / games);
+    std::printf("avg pieces:   %.1f\n", double(stats.pieces) / games);
+    std::printf("elapsed:      %.3f s\n", seconds);
+    std::printf("games/sec:    %.0f\n", games / seconds);
+    std::printf("pieces/sec:   %.0f\n", stats.pieces / seconds);
+    if (useBot) {
+        const TetrixTranspositionTable::Stats &table = bot.transpositionTable().stats();
+        std::printf("think time:   p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us\n", stats.thinkNs.percentile(50) / 1000.0,
+                    stats.thinkNs.percentile(99) / 1000.0, stats.thinkNs.percentile(99.9) / 1000.0, stats.thinkNs.max() / 1000.0);
+        std::printf("boards/piece: %.1f evaluated, %.1f skipped (%.1f%%)\n", double(stats.nodes) / stats.pieces,
+                    double(stats.skipped) / stats.pieces, 100.0 * stats.skipped / std::max(1LL, stats.nodes + stats.skipped));
+        std::printf("tt:           %llu probes, %.1f%% hits, %llu stores, %llu replacements, %zu entries\n",
+                    static_cast<unsigned long long>(table.probes), table.probes ? 100.0 * table.hits / table.probes : 0.0,
+                    static_cast<unsigned long long>(table.stores), static_cast<unsigned long long>(table.replacements),
+                    bot.transpositionTable().capacity());
+    }
+    if (tracePath) {
+        std::printf("trace:        %llu events, %llu dropped\n", static_cast<unsigned long long>(trace.written),
+                    static_cast<unsigned long long>(trace.dropped));
+    }
+    if (recordFailures > 0) {
+        std::printf("failed to record %d replays\n", recordFailures);
+        return 1;
+    }
+    return 0;
+}
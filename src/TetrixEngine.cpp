@@ -0,0 +1,338 @@
+#include "TetrixEngine.h"
+#include "TetrixTrace.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+TetrixEngine::TetrixEngine()
+    : TetrixEngine([] {
+          std::random_device rd;
+          return (uint64_t(rd()) << 32) | rd();
+      }())
+{
+}
+
+TetrixEngine::TetrixEngine(uint64_t seed)
+    : started(false), waitingAfterLine(false), curX(0), curY(0), numLinesRemoved(0), numPiecesDropped(0),
+      curScore(0), curLevel(1), lineClearDelayMs(0), pendingGarbageRows(0), garbageHole(0),
+      numClearedLines(0), lastLockedX(0), lastLockedY(0), lastDropHeight(0), upcomingHead(0)
+{
+    randomizer.seed(seed);
+    nxtPiece.setRandomShape(randomizer);
+    refillUpcoming();
+    newPiece();
+}
+
+unsigned TetrixEngine::start() {
+    started = true;
+    waitingAfterLine = false;
+    numLinesRemoved = 0;
+    numPiecesDropped = 0;
+    curScore = 0;
+    curLevel = 1;
+    pendingGarbageRows = 0;
+    numClearedLines = 0;
+    board.clear();
+    return newPiece();
+}
+
+unsigned TetrixEngine::start(uint64_t seed, TetrixRandomizer::Mode mode) {
+    randomizer.seed(seed, mode);
+    nxtPiece.setRandomShape(randomizer);
+    refillUpcoming();
+    return start();
+}
+
+unsigned TetrixEngine::input(TetrixInput input) {
+    // Ignore input if game is not started, no piece exists or waiting after line clear
+    if (!started || curPiece.shape() == TetrixShape::NoShape || waitingAfterLine) {
+        return NoEvent;
+    }
+
+    switch (input) {
+    case TetrixInput::Left:
+        return tryMove(curPiece, curX - 1, curY) ? PieceMoved : NoEvent;
+    case TetrixInput::Right:
+        return tryMove(curPiece, curX + 1, curY) ? PieceMoved : NoEvent;
+    case TetrixInput::RotateRight:
+        return tryMove(curPiece.rotatedRight(), curX, curY) ? PieceMoved : NoEvent;
+    case TetrixInput::SoftDrop:
+        return oneLineDown();
+    case TetrixInput::HardDrop:
+        return dropDown();
+    }
+    return NoEvent;
+}
+
+unsigned TetrixEngine::tick() {
+    if (!started) {
+        return NoEvent;
+    }
+    if (waitingAfterLine) {
+        waitingAfterLine = false;
+        return newPiece();
+    }
+    return oneLineDown();
+}
+
+unsigned TetrixEngine::lockPiece(int rotation, int x, int y, int dropHeight) {
+    if (!started || curPiece.shape() == TetrixShape::NoShape || waitingAfterLine) {
+        return NoEvent;
+    }
+    TetrixPiece piece(curPiece.shape(), rotation);
+    if (!canPlace(piece, x, y)) {
+        return NoEvent;
+    }
+    curPiece = piece;
+    curX = x;
+    curY = y;
+    return pieceDropped(dropHeight);
+}
+
+void TetrixEngine::setLineClearDelay(int delayMs) {
+    lineClearDelayMs = delayMs < 0 ? 0 : (delayMs > MaxLineClearDelayMs ? int(MaxLineClearDelayMs) : delayMs);
+}
+
+void TetrixEngine::addGarbage(int rows, int holeColumn) {
+    if (rows <= 0) {
+        return;
+    }
+    if (pendingGarbageRows == 0) {
+        garbageHole = std::clamp(holeColumn, 0, BoardWidth - 1);
+    }
+    pendingGarbageRows = std::min(pendingGarbageRows + rows, int(BoardHeight));
+}
+
+int TetrixEngine::cancelGarbage(int rows) {
+    int cancelled = std::min(rows, pendingGarbageRows);
+    pendingGarbageRows -= cancelled;
+    return rows - cancelled;
+}
+
+int TetrixEngine::dropHeight() const {
+    int height = 0;
+    while (canPlace(curPiece, curX, curY - height - 1)) {
+        ++height;
+    }
+    return height;
+}
+
+bool TetrixEngine::tryMove(const TetrixPiece &newPiece, int newX, int newY) {
+    if (!canPlace(newPiece, newX, newY)) {
+        TETRIX_TRACE_DEBUG(TetrixTraceId::TryMove, newX, newY, 0);
+        return false;
+    }
+    TETRIX_TRACE_DEBUG(TetrixTraceId::TryMove, newX, newY, 1);
+    curPiece = newPiece;
+    curX = newX;
+    curY = newY;
+    return true;
+}
+
+unsigned TetrixEngine::oneLineDown() {
+    if (tryMove(curPiece, curX, curY - 1)) {
+        return PieceMoved;
+    }
+    return pieceDropped(0);
+}
+
+unsigned TetrixEngine::dropDown() {
+    int height = dropHeight();
+    curY -= height;
+    return (height > 0 ? PieceMoved : NoEvent) | pieceDropped(height);
+}
+
+unsigned TetrixEngine::pieceDropped(int dropHeight) {
+    unsigned events = PieceLocked;
+
+    board.place(curPiece, curX, curY);
+    lastLockedPiece = curPiece;
+    lastLockedX = curX;
+    lastLockedY = curY;
+    lastDropHeight = dropHeight;
+
+    ++numPiecesDropped;
+    if (numPiecesDropped % PiecesPerLevel == 0) {
+        ++curLevel;
+        events |= LevelUp;
+    }
+
+    curScore += dropHeight + 7;
+    TETRIX_TRACE_INFO(TetrixTraceId::PieceLocked, numPiecesDropped, curScore);
+    events |= removeFullLines();
+
+    if (numClearedLines == 0 && pendingGarbageRows > 0) {
+        bool fits = board.insertRows(pendingGarbageRows, garbageHole, GarbageShape);
+        pendingGarbageRows = 0;
+        events |= GarbageAdded;
+        if (!fits) {
+            // Pushed over the top
+            curPiece.setShape(TetrixShape::NoShape);
+            started = false;
+            TETRIX_TRACE_INFO(TetrixTraceId::GameOver, curScore, numPiecesDropped);
+            return events | GameOver;
+        }
+    }
+    if (!waitingAfterLine) {
+        events |= newPiece();
+    }
+    return events;
+}
+
+unsigned TetrixEngine::removeFullLines() {
+    numClearedLines = board.findFullLines(clearedLines);
+    if (numClearedLines == 0) {
+        return NoEvent;
+    }
+    // Keep the rows for the view's animation, then compact the board right away
+    for (int i = 0; i < numClearedLines; ++i) {
+        std::memcpy(clearedCells[i], board.cellData() + clearedLines[i] * BoardWidth, sizeof(clearedCells[i]));
+    }
+    board.removeLines(clearedLines, numClearedLines);
+    numLinesRemoved += numClearedLines;
+    curScore += 10 * numClearedLines;
+    waitingAfterLine = lineClearDelayMs > 0;
+    TETRIX_TRACE_INFO(TetrixTraceId::LinesCleared, numClearedLines, numLinesRemoved);
+    return LinesCleared | LinesCollapsed;
+}
+
+unsigned TetrixEngine::newPiece() {
+    curPiece = nxtPiece;
+    nxtPiece.setRandomShape(randomizer);
+    // The old head becomes the tail: one more piece dealt ahead, nothing moved
+    upcoming[upcomingHead].setRandomShape(lookahead);
+    upcomingHead = (upcomingHead + 1) % PreviewCapacity;
+
+    curX = spawnX();
+    curY = spawnY(curPiece);
+
+    if (!tryMove(curPiece, curX, curY)) {
+        curPiece.setShape(TetrixShape::NoShape);
+        started = false;
+        TETRIX_TRACE_INFO(TetrixTraceId::GameOver, curScore, numPiecesDropped);
+        return PieceSpawned | GameOver;
+    }
+    return PieceSpawned;
+}
+
+void TetrixEngine::refillUpcoming() {
+    lookahead = randomizer;
+    upcomingHead = 0;
+    upcoming[0] = nxtPiece;
+    for (int i = 1; i < PreviewCapacity; ++i) {
+        upcoming[i].setRandomShape(lookahead);
+    }
+}
+
+void TetrixEngine::saveState(TetrixEngineState &state) const {
+    state = TetrixEngineState{};
+    state.random = randomizer.saveState();
+    state.score = curScore;
+    state.level = curLevel;
+    state.linesRemoved = numLinesRemoved;
+    state.piecesDropped = numPiecesDropped;
+    std::memcpy(state.rows, board.rowData(), sizeof(state.rows));
+    std::memcpy(state.cells, board.cellData(), sizeof(state.cells));
+    state.x = static_cast<int8_t>(curX);
+    state.y = static_cast<int8_t>(curY);
+    state.currentShape = static_cast<uint8_t>(curPiece.shape());
+    state.currentRotation = static_cast<uint8_t>(curPiece.rotation());
+    state.nextShape = static_cast<uint8_t>(nxtPiece.shape());
+    state.nextRotation = static_cast<uint8_t>(nxtPiece.rotation());
+    state.flags = (started ? TetrixEngineState::Started : 0) | (waitingAfterLine ? TetrixEngineState::WaitingAfterLine : 0)
+        | (lineClearDelayMs == 0 ? TetrixEngineState::ImmediateSpawn : 0);
+    state.lineClearDelayMs = static_cast<uint16_t>(lineClearDelayMs);
+    state.pendingGarbage = static_cast<uint8_t>(pendingGarbageRows);
+    state.garbageHole = static_cast<uint8_t>(garbageHole);
+    state.clearedLineCount = static_cast<uint8_t>(numClearedLines);
+    for (int i = 0; i < numClearedLines; ++i) {
+        state.clearedLines[i] = static_cast<int8_t>(clearedLines[i]);
+    }
+}
+
+bool TetrixEngine::restoreState(const TetrixEngineState &state, const TetrixShape *clearedRowCells) {
+    const int lastShape = static_cast<int>(TetrixShape::MirroredLShape);
+    if (state.currentShape > lastShape || state.nextShape > lastShape || state.currentRotation > 3 || state.nextRotation > 3
+        || state.clearedLineCount > TetrixGrid::MaxLinesPerLock || state.level < 1 || state.piecesDropped < 0
+        || state.pendingGarbage > BoardHeight || state.garbageHole >= BoardWidth) {
+        return false;
+    }
+    for (int i = 0; i < state.clearedLineCount; ++i) {
+        if (state.clearedLines[i] < 0 || state.clearedLines[i] >= BoardHeight) {
+            return false;
+        }
+    }
+    for (int i = 0; clearedRowCells && i < state.clearedLineCount * BoardWidth; ++i) {
+        if (static_cast<int>(clearedRowCells[i]) > lastShape) {
+            return false;
+        }
+    }
+    // The row masks must describe exactly the occupied cells
+    for (int y = 0; y < BoardHeight; ++y) {
+        unsigned mask = 0;
+        for (int x = 0; x < BoardWidth; ++x) {
+            int shape = static_cast<int>(state.cells[y * BoardWidth + x]);
+            if (shape > lastShape) {
+                return false;
+            }
+            mask |= (shape != 0 ? 1u : 0u) << x;
+        }
+        if (state.rows[y] != mask) {
+            return false;
+        }
+    }
+    TetrixRandomizer restoredRandomizer = randomizer;
+    if (!restoredRandomizer.restoreState(state.random)) {
+        return false;
+    }
+
+    TetrixGrid restoredBoard;
+    restoredBoard.assign(state.rows, state.cells);
+    TetrixPiece restoredPiece(static_cast<TetrixShape>(state.currentShape), state.currentRotation);
+    bool isStarted = state.flags & TetrixEngineState::Started;
+    bool isWaiting = state.flags & TetrixEngineState::WaitingAfterLine;
+    if (isWaiting) {
+        // Saved before line clears compacted the board at once: the cleared rows are still full
+        int fullLines[TetrixGrid::MaxLinesPerLock];
+        int fullCount = restoredBoard.findFullLines(fullLines);
+        if (fullCount > 0) {
+            restoredBoard.removeLines(fullLines, fullCount);
+        }
+    }
+    // A live falling piece has to be on the board
+    if (isStarted && !isWaiting && restoredPiece.shape() != TetrixShape::NoShape && !restoredBoard.fits(restoredPiece, state.x, state.y)) {
+        return false;
+    }
+
+    randomizer = restoredRandomizer;
+    board = restoredBoard;
+    curPiece = restoredPiece;
+    nxtPiece = TetrixPiece(static_cast<TetrixShape>(state.nextShape), state.nextRotation);
+    refillUpcoming();
+    started = isStarted;
+    waitingAfterLine = isWaiting;
+    curX = state.x;
+    curY = state.y;
+    curScore = state.score;
+    curLevel = state.level;
+    numLinesRemoved = state.linesRemoved;
+    numPiecesDropped = state.piecesDropped;
+    pendingGarbageRows = state.pendingGarbage;
+    garbageHole = state.garbageHole;
+    if (state.flags & TetrixEngineState::ImmediateSpawn) {
+        lineClearDelayMs = 0;
+    } else {
+        lineClearDelayMs = state.lineClearDelayMs != 0 ? state.lineClearDelayMs : int(LegacyLineClearDelayMs);
+    }
+    // The cells of cleared rows are for animation only and not in the state
+    numClearedLines = state.clearedLineCount;
+    for (int i = 0; i < numClearedLines; ++i) {
+        clearedLines[i] = state.clearedLines[i];
+        if (clearedRowCells) {
+            std::copy(clearedRowCells + i * BoardWidth, clearedRowCells + (i + 1) * BoardWidth, clearedCells[i]);
+        } else {
+            std::fill(clearedCells[i], clearedCells[i] + BoardWidth, TetrixShape::NoShape);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,173 @@
+#ifndef TETRIXENGINE_H
+#define TETRIXENGINE_H
+
+#include "TetrixGrid.h"
+#include "TetrixRandom.h"
+
+// Input commands understood by the engine, matching the keys handled in TetrixBoard::keyPressEvent
+enum class TetrixInput : uint8_t { Left, Right, RotateRight, SoftDrop, HardDrop };
+
+// Everything needed to resume a game, in fixed-width fields (stored little-endian), for replay
+// keyframes and save files. A restored engine continues bit-identically to the one that saved it.
+struct TetrixEngineState {
+    enum : uint8_t { Started = 1, WaitingAfterLine = 2, ImmediateSpawn = 4 }; // flags
+
+    TetrixRandomizerState random;
+    int32_t score;
+    int32_t level;
+    int32_t linesRemoved;
+    int32_t piecesDropped;
+    uint16_t rows[TetrixGrid::Height];
+    int8_t x;
+    int8_t y;
+    uint8_t currentShape;
+    uint8_t currentRotation;
+    uint8_t nextShape;
+    uint8_t nextRotation;
+    uint8_t flags;
+    uint8_t clearedLineCount;
+    int8_t clearedLines[TetrixGrid::MaxLinesPerLock];
+    TetrixShape cells[TetrixGrid::Width * TetrixGrid::Height];
+    uint16_t lineClearDelayMs; // 0 without ImmediateSpawn: saved before the delay was stored, so the legacy one
+    uint8_t pendingGarbage; // Versus rows waiting to rise; 0 in single-player games and older saves
+    uint8_t garbageHole;
+};
+
+static_assert(sizeof(TetrixEngineState) == 336, "TetrixEngineState is a fixed on-disk layout");
+
+// Qt-free game rules: board, current/next piece, score/level/line bookkeeping.
+// Driven by explicit inputs and gravity ticks; each step returns a mask of Event flags
+// so a view (TetrixBoard) or a headless driver (tetrix_cli) can react to what happened.
+class TetrixEngine {
+public:
+    enum { BoardWidth = TetrixGrid::Width, BoardHeight = TetrixGrid::Height, PiecesPerLevel = 25 }; // Level up every 25 pieces
+    enum { LegacyLineClearDelayMs = 1000 }; // The original pause before the next piece, for old replays and saves
+    enum { MaxLineClearDelayMs = 0xFFFF };
+    enum { PreviewCapacity = 6 }; // Upcoming pieces known ahead of the spawn, nextPiece() first
+
+    enum Event : unsigned {
+        NoEvent = 0,
+        PieceMoved = 1 << 0,
+        PieceLocked = 1 << 1,
+        LinesCleared = 1 << 2, // Full lines removed; clearedRow() keeps their cells for the view to animate
+        LinesCollapsed = 1 << 3, // The board above them moved down, always together with LinesCleared
+        LevelUp = 1 << 4,
+        PieceSpawned = 1 << 5,
+        GameOver = 1 << 6,
+        GarbageAdded = 1 << 7 // Versus: rows pushed in under the board, which moved up
+    };
+
+    static constexpr TetrixShape GarbageShape = TetrixShape::MirroredLShape; // Cells of garbage rows (gray)
+
+    TetrixEngine(); // Seeded from std::random_device
+    explicit TetrixEngine(uint64_t seed);
+
+    unsigned start();
+    // Reseeds the piece randomizer first, so the whole game is reproducible from seed and inputs
+    unsigned start(uint64_t seed, TetrixRandomizer::Mode mode = TetrixRandomizer::Mode::Uniform);
+    unsigned input(TetrixInput input);
+    unsigned tick();
+    // Locks the current piece, turned to rotation, at x, y as if dropped dropHeight rows, to replay a
+    // lock from a rewind history (TetrixRewind); NoEvent when no piece is falling or it does not fit there
+    unsigned lockPiece(int rotation, int x, int y, int dropHeight);
+
+    // Pause between a line clear and the next piece. The board compacts at once either way; with 0 (the
+    // default) the next piece spawns in the same step, otherwise on the tick after the delay. Takes effect from the
+    // next line clear and is part of the game's rules, so replays record it.
+    void setLineClearDelay(int delayMs);
+    int lineClearDelay() const { return lineClearDelayMs; }
+
+    // Versus: queues rows with one open column to rise from the bottom at the next lock that clears nothing.
+    // Rows queued together share the first one's hole; at most BoardHeight rows wait.
+    void addGarbage(int rows, int holeColumn);
+    // Takes up to rows off the queue (lines sent back cancel lines received); returns the rest
+    int cancelGarbage(int rows);
+    int pendingGarbage() const { return pendingGarbageRows; }
+
+    bool isStarted() const { return started; }
+    uint64_t seed() const { return randomizer.seedValue(); }
+    TetrixRandomizer::Mode randomMode() const { return randomizer.mode(); }
+    bool isWaitingAfterLine() const { return waitingAfterLine; }
+    const TetrixGrid &grid() const { return board; }
+    TetrixShape shapeAt(int x, int y) const { return board.shapeAt(x, y); }
+    const TetrixPiece &currentPiece() const { return curPiece; }
+    const TetrixPiece &nextPiece() const { return nxtPiece; }
+    // The index-th piece after the current one, index < PreviewCapacity; upcomingPiece(0) is nextPiece().
+    // Dealt from a copy of the randomizer running ahead, so looking does not change the game.
+    const TetrixPiece &upcomingPiece(int index) const { return upcoming[(upcomingHead + index) % PreviewCapacity]; }
+    int currentX() const { return curX; }
+    int currentY() const { return curY; }
+    int score() const { return curScore; }
+    int level() const { return curLevel; }
+    int linesRemoved() const { return numLinesRemoved; }
+    int piecesDropped() const { return numPiecesDropped; }
+    // Rows removed by the latest clear, top row first, where they were before the board compacted,
+    // with the cells they held; kept until the next lock so a view can animate them
+    int clearedLineCount() const { return numClearedLines; }
+    int clearedLine(int index) const { return clearedLines[index]; }
+    const TetrixShape *clearedRow(int index) const { return clearedCells[index]; }
+    // The piece the latest lock wrote into the board, where, and how far it was dropped for the score
+    const TetrixPiece &lockedPiece() const { return lastLockedPiece; }
+    int lockedX() const { return lastLockedX; }
+    int lockedY() const { return lastLockedY; }
+    int lockedDropHeight() const { return lastDropHeight; }
+    // Zobrist hash of the board plus the active and preview shapes; the board part follows every lock
+    // and line collapse incrementally
+    uint64_t positionHash() const {
+        return board.hash() ^ TetrixZobrist::activeKey(curPiece.shape()) ^ TetrixZobrist::previewKey(nxtPiece.shape());
+    }
+    // Gravity interval until the next tick; below a millisecond past level 1000
+    int64_t tickIntervalNs() const { return waitingAfterLine ? int64_t(lineClearDelayMs) * 1000000 : 1000000000 / curLevel; }
+    // Whole milliseconds of tickIntervalNs(), for simulated clocks that do not need sub-millisecond timing
+    int tickInterval() const { return static_cast<int>(tickIntervalNs() / 1000000); }
+
+    // Where newPiece() puts a fresh piece
+    static int spawnX() { return BoardWidth / 2 + 1; }
+    static int spawnY(const TetrixPiece &piece) { return BoardHeight - 1 + piece.minY(); }
+
+    bool canPlace(const TetrixPiece &piece, int x, int y) const { return board.fits(piece, x, y); }
+    int dropHeight() const;
+
+    void saveState(TetrixEngineState &state) const;
+    // Rejects (leaving the engine untouched) states that no engine could have saved. clearedRowCells, when
+    // given, holds clearedLineCount rows of BoardWidth cells as clearedRow() returned them (save files keep
+    // them for the line flash); otherwise those rows come back blank.
+    bool restoreState(const TetrixEngineState &state, const TetrixShape *clearedRowCells = nullptr);
+
+private:
+    bool tryMove(const TetrixPiece &newPiece, int newX, int newY);
+    unsigned oneLineDown();
+    unsigned dropDown();
+    unsigned pieceDropped(int dropHeight);
+    unsigned removeFullLines();
+    unsigned newPiece();
+    void refillUpcoming();
+
+    TetrixPiece curPiece;
+    TetrixPiece nxtPiece;
+    bool started;
+    bool waitingAfterLine;
+    int curX;
+    int curY;
+    int numLinesRemoved;
+    int numPiecesDropped;
+    int curScore;
+    int curLevel;
+    int lineClearDelayMs;
+    int pendingGarbageRows;
+    int garbageHole;
+    int numClearedLines;
+    int clearedLines[TetrixGrid::MaxLinesPerLock];
+    TetrixShape clearedCells[TetrixGrid::MaxLinesPerLock][TetrixGrid::Width];
+    TetrixPiece lastLockedPiece;
+    int lastLockedX;
+    int lastLockedY;
+    int lastDropHeight;
+    TetrixGrid board;
+    TetrixRandomizer randomizer; // Per-engine piece stream; engines share no state
+    TetrixRandomizer lookahead; // The same stream, PreviewCapacity - 1 pieces further on
+    TetrixPiece upcoming[PreviewCapacity]; // Ring starting at upcomingHead
+    int upcomingHead;
+};
+
+#endif // TETRIXENGINE_H
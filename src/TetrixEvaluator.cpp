@@ -0,0 +1,289 @@
+#include "TetrixEvaluator.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TETRIX_EVAL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline int bitCount(unsigned value) {
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt(value));
+#else
+    return __builtin_popcount(value);
+#endif
+}
+
+inline int lowestBit(unsigned value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+enum { Width = TetrixGrid::Width, Height = TetrixGrid::Height, FullRow = TetrixGrid::FullRow };
+
+void computeFeaturesScalar(const TetrixBoardBatch &batch, int begin, int end, TetrixBoardFeatures *features) {
+    uint16_t rows[Height];
+    for (int board = begin; board < end; ++board) {
+        for (int y = 0; y < Height; ++y) {
+            rows[y] = batch.row(board, y);
+        }
+        features[board] = TetrixEvaluator::computeFeatures(rows);
+    }
+}
+
+#ifdef TETRIX_EVAL_X86
+
+// The vector kernels count per row instead of per column, which gives the same integers:
+// a column's height is the number of rows at or below its top, and because coverage only
+// grows going down, |h[c] - h[c + 1]| is the number of rows where exactly one of the two is covered.
+
+__attribute__((target("sse4.2"))) inline __m128i popcount16(__m128i v) {
+    const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i bytes = _mm_add_epi8(_mm_shuffle_epi8(lut, _mm_and_si128(v, nibble)),
+                                 _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), nibble)));
+    return _mm_add_epi16(_mm_and_si128(bytes, _mm_set1_epi16(0x00FF)), _mm_srli_epi16(bytes, 8));
+}
+
+__attribute__((target("sse4.2"))) void computeFeaturesSse42(const TetrixBoardBatch &batch, int begin, TetrixBoardFeatures *features) {
+    const __m128i fullRow = _mm_set1_epi16(FullRow);
+    const __m128i bumpMask = _mm_set1_epi16(FullRow >> 1);
+    const __m128i transitionMask = _mm_set1_epi16((1 << (Width + 1)) - 1);
+    const __m128i walls = _mm_set1_epi16(1 | (1 << (Width + 1)));
+    const __m128i leftWall = _mm_set1_epi16(1);
+    const __m128i rightWall = _mm_set1_epi16(1 << (Width - 1));
+
+    __m128i height = _mm_setzero_si128();
+    __m128i holes = _mm_setzero_si128();
+    __m128i bumpiness = _mm_setzero_si128();
+    __m128i rowTransitions = _mm_setzero_si128();
+    __m128i columnTransitions = _mm_setzero_si128();
+    __m128i wells = _mm_setzero_si128();
+    __m128i covered = _mm_setzero_si128();
+    __m128i above = _mm_setzero_si128();
+
+    for (int y = Height - 1; y >= 0; --y) {
+        __m128i row = _mm_load_si128(reinterpret_cast<const __m128i *>(batch.rowLane(y) + begin));
+        covered = _mm_or_si128(covered, row);
+        holes = _mm_add_epi16(holes, popcount16(_mm_andnot_si128(row, covered)));
+        height = _mm_add_epi16(height, popcount16(covered));
+        bumpiness = _mm_add_epi16(bumpiness, popcount16(_mm_and_si128(_mm_xor_si128(covered, _mm_srli_epi16(covered, 1)), bumpMask)));
+
+        __m128i withWalls = _mm_or_si128(_mm_slli_epi16(row, 1), walls);
+        rowTransitions = _mm_add_epi16(rowTransitions,
+                                       popcount16(_mm_and_si128(_mm_xor_si128(withWalls, _mm_srli_epi16(withWalls, 1)), transitionMask)));
+        columnTransitions = _mm_add_epi16(columnTransitions, popcount16(_mm_xor_si128(row, above)));
+        above = row;
+
+        __m128i leftFilled = _mm_or_si128(_mm_slli_epi16(row, 1), leftWall);
+        __m128i rightFilled = _mm_or_si128(_mm_srli_epi16(row, 1), rightWall);
+        __m128i open = _mm_andnot_si128(covered, fullRow); // Excludes the row's own cells too
+        wells = _mm_add_epi16(wells, popcount16(_mm_and_si128(open, _mm_and_si128(leftFilled, rightFilled))));
+    }
+    columnTransitions = _mm_add_epi16(columnTransitions, popcount16(_mm_xor_si128(above, fullRow)));
+
+    alignas(16) uint16_t lanes[6][8];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes[0]), height);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes[1]), holes);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes[2]), bumpiness);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes[3]), rowTransitions);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes[4]), columnTransitions);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes[5]), wells);
+    for (int i = 0; i < 8; ++i) {
+        features[begin + i] = { lanes[0][i], lanes[1][i], lanes[2][i], lanes[3][i], lanes[4][i], lanes[5][i] };
+    }
+}
+
+__attribute__((target("avx2"))) inline __m256i popcount16(__m256i v) {
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(v, nibble)),
+                                    _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)));
+    return _mm256_add_epi16(_mm256_and_si256(bytes, _mm256_set1_epi16(0x00FF)), _mm256_srli_epi16(bytes, 8));
+}
+
+__attribute__((target("avx2"))) void computeFeaturesAvx2(const TetrixBoardBatch &batch, int begin, TetrixBoardFeatures *features) {
+    const __m256i fullRow = _mm256_set1_epi16(FullRow);
+    const __m256i bumpMask = _mm256_set1_epi16(FullRow >> 1);
+    const __m256i transitionMask = _mm256_set1_epi16((1 << (Width + 1)) - 1);
+    const __m256i walls = _mm256_set1_epi16(1 | (1 << (Width + 1)));
+    const __m256i leftWall = _mm256_set1_epi16(1);
+    const __m256i rightWall = _mm256_set1_epi16(1 << (Width - 1));
+
+    __m256i height = _mm256_setzero_si256();
+    __m256i holes = _mm256_setzero_si256();
+    __m256i bumpiness = _mm256_setzero_si256();
+    __m256i rowTransitions = _mm256_setzero_si256();
+    __m256i columnTransitions = _mm256_setzero_si256();
+    __m256i wells = _mm256_setzero_si256();
+    __m256i covered = _mm256_setzero_si256();
+    __m256i above = _mm256_setzero_si256();
+
+    for (int y = Height - 1; y >= 0; --y) {
+        __m256i row = _mm256_load_si256(reinterpret_cast<const __m256i *>(batch.rowLane(y) + begin));
+        covered = _mm256_or_si256(covered, row);
+        holes = _mm256_add_epi16(holes, popcount16(_mm256_andnot_si256(row, covered)));
+        height = _mm256_add_epi16(height, popcount16(covered));
+        bumpiness = _mm256_add_epi16(bumpiness,
+                                     popcount16(_mm256_and_si256(_mm256_xor_si256(covered, _mm256_srli_epi16(covered, 1)), bumpMask)));
+
+        __m256i withWalls = _mm256_or_si256(_mm256_slli_epi16(row, 1), walls);
+        rowTransitions = _mm256_add_epi16(rowTransitions,
+                                          popcount16(_mm256_and_si256(_mm256_xor_si256(withWalls, _mm256_srli_epi16(withWalls, 1)), transitionMask)));
+        columnTransitions = _mm256_add_epi16(columnTransitions, popcount16(_mm256_xor_si256(row, above)));
+        above = row;
+
+        __m256i leftFilled = _mm256_or_si256(_mm256_slli_epi16(row, 1), leftWall);
+        __m256i rightFilled = _mm256_or_si256(_mm256_srli_epi16(row, 1), rightWall);
+        __m256i open = _mm256_andnot_si256(covered, fullRow);
+        wells = _mm256_add_epi16(wells, popcount16(_mm256_and_si256(open, _mm256_and_si256(leftFilled, rightFilled))));
+    }
+    columnTransitions = _mm256_add_epi16(columnTransitions, popcount16(_mm256_xor_si256(above, fullRow)));
+
+    alignas(32) uint16_t lanes[6][16];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[0]), height);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[1]), holes);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[2]), bumpiness);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[3]), rowTransitions);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[4]), columnTransitions);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[5]), wells);
+    for (int i = 0; i < 16; ++i) {
+        features[begin + i] = { lanes[0][i], lanes[1][i], lanes[2][i], lanes[3][i], lanes[4][i], lanes[5][i] };
+    }
+}
+
+#endif // TETRIX_EVAL_X86
+
+TetrixEvaluator::Kernel detectKernel() {
+#ifdef TETRIX_EVAL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return TetrixEvaluator::Kernel::Avx2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return TetrixEvaluator::Kernel::Sse42;
+    }
+#endif
+    return TetrixEvaluator::Kernel::Scalar;
+}
+
+} // namespace
+
+int TetrixBoardBatch::add(const TetrixGrid &grid, int lines) {
+    int board = count++;
+    for (int y = 0; y < Height; ++y) {
+        rows[y][board] = grid.row(y);
+    }
+    clearedLines[board] = lines;
+    return board;
+}
+
+namespace TetrixEvaluator {
+
+Kernel bestKernel() {
+    static const Kernel kernel = detectKernel();
+    return kernel;
+}
+
+const char *kernelName(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Avx2: return "avx2";
+    case Kernel::Sse42: return "sse4.2";
+    case Kernel::Scalar: break;
+    }
+    return "scalar";
+}
+
+bool isSupported(Kernel kernel) {
+    return static_cast<int>(kernel) <= static_cast<int>(bestKernel());
+}
+
+void computeFeaturesBatch(const TetrixBoardBatch &batch, TetrixBoardFeatures *features, Kernel kernel) {
+    int begin = 0;
+    int end = batch.size();
+#ifdef TETRIX_EVAL_X86
+    if (kernel == Kernel::Avx2 && isSupported(kernel)) {
+        for (; begin + 16 <= end; begin += 16) {
+            computeFeaturesAvx2(batch, begin, features);
+        }
+    }
+    if (kernel != Kernel::Scalar && isSupported(Kernel::Sse42)) {
+        for (; begin + 8 <= end; begin += 8) {
+            computeFeaturesSse42(batch, begin, features);
+        }
+    }
+#else
+    (void)kernel;
+#endif
+    // Leftover boards that do not fill a vector
+    computeFeaturesScalar(batch, begin, end, features);
+}
+
+void scoreBatch(const TetrixBoardBatch &batch, const TetrixEvalWeights &weights, double *scores, Kernel kernel) {
+    TetrixBoardFeatures features[TetrixBoardBatch::Capacity];
+    computeFeaturesBatch(batch, features, kernel);
+    for (int i = 0; i < batch.size(); ++i) {
+        scores[i] = score(features[i], batch.lines(i), weights);
+    }
+}
+
+TetrixBoardFeatures computeFeatures(const uint16_t *rows) {
+    TetrixBoardFeatures features{};
+
+    int heights[Width] = {};
+    unsigned covered = 0; // Columns with a filled cell at or above the current row
+    unsigned above = 0; // Previous row scanned from the top; the open sky counts as empty
+    for (int y = Height - 1; y >= 0; --y) {
+        unsigned row = rows[y];
+        for (unsigned newTops = row & ~covered; newTops; newTops &= newTops - 1) {
+            heights[lowestBit(newTops)] = y + 1;
+        }
+        features.holes += bitCount(covered & ~row);
+        covered |= row;
+
+        // Walls are filled: compare each cell with its left neighbour plus the right wall
+        unsigned withWalls = (row << 1) | 1u | (1u << (Width + 1));
+        features.rowTransitions += bitCount((withWalls ^ (withWalls >> 1)) & ((1u << (Width + 1)) - 1));
+        features.columnTransitions += bitCount(row ^ above);
+        above = row;
+
+        // Well cells: open (not covered) cells with filled cells or walls on both sides
+        unsigned empty = ~row & FullRow;
+        unsigned leftFilled = (row << 1) | 1u;
+        unsigned rightFilled = (row >> 1) | (1u << (Width - 1));
+        features.wellDepth += bitCount(empty & leftFilled & rightFilled & ~covered);
+    }
+    // The floor counts as filled
+    features.columnTransitions += bitCount(above ^ FullRow);
+
+    for (int x = 0; x < Width; ++x) {
+        features.aggregateHeight += heights[x];
+        if (x > 0) {
+            int diff = heights[x] - heights[x - 1];
+            features.bumpiness += diff < 0 ? -diff : diff;
+        }
+    }
+    return features;
+}
+
+double score(const TetrixBoardFeatures &features, int lines, const TetrixEvalWeights &weights) {
+    return weights.aggregateHeight * features.aggregateHeight
+        + weights.lines * lines
+        + weights.holes * features.holes
+        + weights.bumpiness * features.bumpiness
+        + weights.rowTransitions * features.rowTransitions
+        + weights.columnTransitions * features.columnTransitions
+        + weights.wellDepth * features.wellDepth;
+}
+
+} // namespace TetrixEvaluator
@@ -0,0 +1,71 @@
+#ifndef TETRIXEVALUATOR_H
+#define TETRIXEVALUATOR_H
+
+#include <cstdint>
+#include "TetrixGrid.h"
+
+// Board shape features used by the bot, computed from the row masks only
+struct TetrixBoardFeatures {
+    int aggregateHeight; // Sum of column heights
+    int holes; // Empty cells with an occupied cell somewhere above in the same column
+    int bumpiness; // Sum of height differences between neighbouring columns
+    int rowTransitions; // Filled/empty changes along each row, walls count as filled
+    int columnTransitions; // Filled/empty changes down each column, floor counts as filled
+    int wellDepth; // Open cells with a filled cell or wall on both sides
+};
+
+// Linear evaluation weights; lines is the number of rows cleared by the placement being scored
+struct TetrixEvalWeights {
+    double aggregateHeight = -0.510066;
+    double lines = 0.760666;
+    double holes = -0.35663;
+    double bumpiness = -0.184483;
+    double rowTransitions = 0.0;
+    double columnTransitions = 0.0;
+    double wellDepth = 0.0;
+};
+
+// Many boards stored row-major across boards (row y of every board is contiguous), so the
+// batch kernels can load the same row of 8 or 16 boards into one vector register
+class TetrixBoardBatch {
+public:
+    enum { Height = TetrixGrid::Height, Lanes = 16, Capacity = 896 }; // Capacity covers every placement of one piece
+
+    TetrixBoardBatch() : count(0) {}
+
+    void clear() { count = 0; }
+    int size() const { return count; }
+    bool isFull() const { return count == Capacity; }
+    // Appends the board's row masks and the lines its placement cleared; returns the board index
+    int add(const TetrixGrid &grid, int lines);
+    uint16_t row(int board, int y) const { return rows[y][board]; }
+    const uint16_t *rowLane(int y) const { return rows[y]; }
+    int lines(int board) const { return clearedLines[board]; }
+
+private:
+    alignas(32) uint16_t rows[Height][Capacity];
+    int clearedLines[Capacity];
+    int count;
+};
+
+namespace TetrixEvaluator {
+
+enum class Kernel { Scalar, Sse42, Avx2 };
+
+TetrixBoardFeatures computeFeatures(const uint16_t *rows);
+double score(const TetrixBoardFeatures &features, int lines, const TetrixEvalWeights &weights);
+inline double evaluate(const TetrixGrid &grid, int lines, const TetrixEvalWeights &weights) {
+    return score(computeFeatures(grid.rowData()), lines, weights);
+}
+
+// Best kernel the CPU supports, detected once at startup
+Kernel bestKernel();
+const char *kernelName(Kernel kernel);
+bool isSupported(Kernel kernel);
+// Features of every board in the batch; all kernels give bit-identical results to computeFeatures
+void computeFeaturesBatch(const TetrixBoardBatch &batch, TetrixBoardFeatures *features, Kernel kernel = bestKernel());
+void scoreBatch(const TetrixBoardBatch &batch, const TetrixEvalWeights &weights, double *scores, Kernel kernel = bestKernel());
+
+} // namespace TetrixEvaluator
+
+#endif // TETRIXEVALUATOR_H
@@ -0,0 +1,216 @@
+#include "TetrixGameLoop.h"
+#include "TetrixReplay.h"
+#include "TetrixRewind.h"
+#include <algorithm>
+
+namespace {
+
+// A new piece, a level change or a line clear starts a fresh gravity interval
+const unsigned RestartsGravity = TetrixEngine::PieceSpawned | TetrixEngine::LevelUp | TetrixEngine::LinesCleared
+                                 | TetrixEngine::LinesCollapsed | TetrixEngine::GameOver;
+
+int64_t millisToNs(int ms) { return int64_t(std::max(ms, 0)) * 1000000; }
+
+} // namespace
+
+TetrixGameLoop::TetrixGameLoop(TetrixEngine &engine)
+    : engine(engine), recorder(nullptr), rewind(nullptr), simNs(0), wallOffsetNs(0), gravityNs(0), pendingNs(0), shiftHeld{ false, false },
+      shiftDirection(TetrixInput::Left), shiftTimerNs(0), softDropHeld(false), softDropTimerNs(0)
+{
+}
+
+void TetrixGameLoop::setRepeatSettings(const TetrixRepeatSettings &settings) {
+    repeat = settings;
+    repeat.dasMs = std::max(repeat.dasMs, 0);
+    repeat.arrMs = std::max(repeat.arrMs, 0);
+    repeat.softDropMs = std::max(repeat.softDropMs, 0);
+}
+
+unsigned TetrixGameLoop::start(uint64_t seed, TetrixRandomizer::Mode mode, int64_t nowNs) {
+    unsigned events = engine.start(seed, mode);
+    if (recorder) {
+        recorder->begin(seed, mode, engine.lineClearDelay());
+    }
+    if (rewind) {
+        rewind->begin(engine);
+    }
+    simNs = 0;
+    wallOffsetNs = nowNs;
+    gravityNs = 0;
+    pendingNs = 0;
+    releaseAll();
+    return events;
+}
+
+unsigned TetrixGameLoop::advance(int64_t nowNs) {
+    int64_t targetNs = nowNs - wallOffsetNs;
+    if (targetNs - simNs > MaxCatchUpNs) {
+        wallOffsetNs += targetNs - simNs - MaxCatchUpNs;
+        targetNs = simNs + MaxCatchUpNs;
+    }
+    unsigned events = TetrixEngine::NoEvent;
+    while (engine.isStarted() && targetNs - simNs >= StepNs) {
+        events |= step();
+    }
+    pendingNs = std::max<int64_t>(targetNs - simNs, 0);
+    return events;
+}
+
+void TetrixGameLoop::resync(int64_t nowNs) {
+    wallOffsetNs = nowNs - simNs;
+    pendingNs = 0;
+}
+
+unsigned TetrixGameLoop::press(TetrixInput input, int64_t nowNs) {
+    unsigned events = advance(nowNs);
+    switch (input) {
+    case TetrixInput::Left:
+    case TetrixInput::Right:
+        shiftHeld[input == TetrixInput::Right] = true;
+        shiftDirection = input;
+        shiftTimerNs = millisToNs(repeat.dasMs);
+        break;
+    case TetrixInput::SoftDrop:
+        softDropHeld = true;
+        softDropTimerNs = millisToNs(repeat.softDropMs);
+        break;
+    case TetrixInput::RotateRight:
+    case TetrixInput::HardDrop:
+        break;
+    }
+    return events | apply(input);
+}
+
+unsigned TetrixGameLoop::release(TetrixInput input, int64_t nowNs) {
+    unsigned events = advance(nowNs);
+    if (input == TetrixInput::Left || input == TetrixInput::Right) {
+        bool right = input == TetrixInput::Right;
+        shiftHeld[right] = false;
+        // Still holding the other direction: it takes over and charges its own delay
+        if (shiftHeld[!right] && shiftDirection == input) {
+            shiftDirection = right ? TetrixInput::Left : TetrixInput::Right;
+            shiftTimerNs = millisToNs(repeat.dasMs);
+        }
+    } else if (input == TetrixInput::SoftDrop) {
+        softDropHeld = false;
+    }
+    return events;
+}
+
+void TetrixGameLoop::releaseAll() {
+    shiftHeld[0] = shiftHeld[1] = false;
+    softDropHeld = false;
+}
+
+unsigned TetrixGameLoop::input(TetrixInput input, int64_t nowNs) {
+    return advance(nowNs) | apply(input);
+}
+
+void TetrixGameLoop::saveState(TetrixGameLoopState &state) const {
+    state.simNs = simNs;
+    state.wallOffsetNs = wallOffsetNs;
+    state.gravityNs = gravityNs;
+    state.shiftTimerNs = shiftTimerNs;
+    state.softDropTimerNs = softDropTimerNs;
+    state.shiftHeld[0] = shiftHeld[0];
+    state.shiftHeld[1] = shiftHeld[1];
+    state.shiftDirection = shiftDirection;
+    state.softDropHeld = softDropHeld;
+}
+
+void TetrixGameLoop::restoreState(const TetrixGameLoopState &state) {
+    simNs = state.simNs;
+    wallOffsetNs = state.wallOffsetNs;
+    gravityNs = state.gravityNs;
+    shiftTimerNs = state.shiftTimerNs;
+    softDropTimerNs = state.softDropTimerNs;
+    shiftHeld[0] = state.shiftHeld[0];
+    shiftHeld[1] = state.shiftHeld[1];
+    shiftDirection = state.shiftDirection;
+    softDropHeld = state.softDropHeld;
+    pendingNs = 0;
+}
+
+double TetrixGameLoop::gravityProgress() const {
+    int64_t intervalNs = engine.tickIntervalNs();
+    if (intervalNs <= StepNs || !canMove()) {
+        return 0.0;
+    }
+    return std::min(double(gravityNs + pendingNs) / intervalNs, 1.0);
+}
+
+unsigned TetrixGameLoop::step() {
+    simNs += StepNs;
+    unsigned events = TetrixEngine::NoEvent;
+    if (shiftHeld[0] || shiftHeld[1]) {
+        events |= repeatInput(shiftDirection, shiftTimerNs, millisToNs(repeat.arrMs));
+    }
+    if (softDropHeld) {
+        events |= repeatInput(TetrixInput::SoftDrop, softDropTimerNs, millisToNs(repeat.softDropMs));
+    }
+
+    // Gravity: as many rows as whole intervals fit, so levels past 1000 fall several rows per step
+    gravityNs += StepNs;
+    for (int rows = 0; engine.isStarted() && gravityNs >= engine.tickIntervalNs(); ) {
+        gravityNs -= engine.tickIntervalNs();
+        unsigned tickEvents = tick();
+        events |= tickEvents;
+        if ((tickEvents & RestartsGravity) || ++rows == MaxRowsPerStep) {
+            gravityNs = 0;
+            break;
+        }
+    }
+    return events;
+}
+
+unsigned TetrixGameLoop::repeatInput(TetrixInput input, int64_t &timerNs, int64_t intervalNs) {
+    timerNs -= StepNs;
+    if (timerNs > 0) {
+        return TetrixEngine::NoEvent;
+    }
+    // Stays charged while there is nothing to move, so the repeat fires as soon as the next piece can
+    unsigned events = TetrixEngine::NoEvent;
+    int dx = input == TetrixInput::Left ? -1 : input == TetrixInput::Right ? 1 : 0;
+    while (timerNs <= 0) {
+        if (!canMove() || (dx != 0 && !engine.canPlace(engine.currentPiece(), engine.currentX() + dx, engine.currentY()))) {
+            timerNs = 0;
+            break;
+        }
+        events |= apply(input);
+        timerNs += intervalNs;
+        if (events & TetrixEngine::PieceLocked) {
+            timerNs = std::max<int64_t>(timerNs, intervalNs);
+            break;
+        }
+    }
+    return events;
+}
+
+unsigned TetrixGameLoop::apply(TetrixInput input) {
+    if (recorder) {
+        recorder->recordInput(input, timeMs());
+    }
+    unsigned events = engine.input(input);
+    if (rewind && (events & TetrixEngine::PieceLocked)) {
+        rewind->recordLock(engine);
+    }
+    if (events & RestartsGravity) {
+        gravityNs = 0;
+    }
+    return events;
+}
+
+unsigned TetrixGameLoop::tick() {
+    if (recorder) {
+        recorder->recordTick(timeMs());
+    }
+    unsigned events = engine.tick();
+    if (rewind && (events & TetrixEngine::PieceLocked)) {
+        rewind->recordLock(engine);
+    }
+    return events;
+}
+
+bool TetrixGameLoop::canMove() const {
+    return engine.isStarted() && !engine.isWaitingAfterLine() && engine.currentPiece().shape() != TetrixShape::NoShape;
+}
@@ -0,0 +1,93 @@
+#ifndef TETRIXGAMELOOP_H
+#define TETRIXGAMELOOP_H
+
+#include <cstdint>
+#include "TetrixEngine.h"
+
+class TetrixReplayRecorder;
+class TetrixRewind;
+
+// Held-key repeat timing: Left/Right shift once on press, again after dasMs, then every arrMs
+// (0 = straight to the wall). Soft drop repeats every softDropMs while held.
+struct TetrixRepeatSettings {
+    int dasMs = 167;
+    int arrMs = 33;
+    int softDropMs = 33;
+};
+
+// The loop's own part of a game in progress (the engine saves the rest), for rolling a versus match back
+struct TetrixGameLoopState {
+    int64_t simNs;
+    int64_t wallOffsetNs;
+    int64_t gravityNs;
+    int64_t shiftTimerNs;
+    int64_t softDropTimerNs;
+    bool shiftHeld[2];
+    TetrixInput shiftDirection;
+    bool softDropHeld;
+};
+
+// Fixed-timestep driver for TetrixEngine. The caller passes wall-clock time in nanoseconds; the loop
+// runs whole StepNs simulation steps up to it and carries the remainder, so timing never rounds to
+// milliseconds. Each step applies gravity (several rows per step when the level calls for it) and
+// turns held keys into repeated inputs. Every input and tick is recorded at its simulation time, so
+// replays reproduce the game exactly. Qt-free; rendering reads gravityProgress() to interpolate.
+class TetrixGameLoop {
+public:
+    enum { StepNs = 1000000 }; // 1 ms simulation step
+    enum { MaxCatchUpNs = 250000000 }; // Longer stalls (window drags, breakpoints) are skipped, not replayed
+    enum { MaxRowsPerStep = TetrixEngine::BoardHeight }; // Enough for any piece to reach the floor in one step
+
+    explicit TetrixGameLoop(TetrixEngine &engine);
+
+    void setRecorder(TetrixReplayRecorder *replayRecorder) { recorder = replayRecorder; }
+    // Practice mode: every lock goes into the history, which start() begins anew
+    void setRewind(TetrixRewind *history) { rewind = history; }
+    void setRepeatSettings(const TetrixRepeatSettings &settings);
+    const TetrixRepeatSettings &repeatSettings() const { return repeat; }
+
+    // Starts a new game at wall-clock time nowNs
+    unsigned start(uint64_t seed, TetrixRandomizer::Mode mode, int64_t nowNs);
+    // Simulates up to nowNs and returns the events of every step taken
+    unsigned advance(int64_t nowNs);
+    // Continues from nowNs without simulating the time since the last advance (pause, resume)
+    void resync(int64_t nowNs);
+
+    // Key handling; each call first advances to nowNs
+    unsigned press(TetrixInput input, int64_t nowNs);
+    unsigned release(TetrixInput input, int64_t nowNs);
+    void releaseAll();
+    // One input with no repeat, for the bot
+    unsigned input(TetrixInput input, int64_t nowNs);
+
+    void saveState(TetrixGameLoopState &state) const;
+    void restoreState(const TetrixGameLoopState &state);
+
+    uint32_t timeMs() const { return static_cast<uint32_t>(simNs / 1000000); }
+    // Fraction of the current gravity interval already elapsed, for drawing the piece between rows;
+    // 0 when gravity moves a row or more per step
+    double gravityProgress() const;
+
+private:
+    unsigned step();
+    unsigned repeatInput(TetrixInput input, int64_t &timerNs, int64_t intervalNs);
+    unsigned apply(TetrixInput input);
+    unsigned tick();
+    bool canMove() const;
+
+    TetrixEngine &engine;
+    TetrixReplayRecorder *recorder;
+    TetrixRewind *rewind;
+    TetrixRepeatSettings repeat;
+    int64_t simNs; // Simulation time since start()
+    int64_t wallOffsetNs; // Wall-clock time at simulation time 0
+    int64_t gravityNs; // Progress into the current gravity interval
+    int64_t pendingNs; // Wall-clock time past the last step, less than StepNs
+    bool shiftHeld[2]; // Left, Right
+    TetrixInput shiftDirection; // Most recently pressed of the held directions
+    int64_t shiftTimerNs; // Until the next auto shift
+    bool softDropHeld;
+    int64_t softDropTimerNs;
+};
+
+#endif // TETRIXGAMELOOP_H
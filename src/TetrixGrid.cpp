@@ -0,0 +1,145 @@
+#include "TetrixGrid.h"
+#include <cstring>
+
+void TetrixGrid::clear() {
+    std::memset(rows, 0, sizeof(rows));
+    for (int i = 0; i < Width * Height; ++i) {
+        cells[i] = TetrixShape::NoShape;
+    }
+    zobristHash = 0;
+}
+
+void TetrixGrid::assign(const uint16_t *rowData, const TetrixShape *cellData) {
+    std::memcpy(rows, rowData, sizeof(rows));
+    std::memcpy(cells, cellData, sizeof(cells));
+    zobristHash = computeHash();
+}
+
+bool TetrixGrid::fits(const TetrixPiece &piece, int x, int y) const {
+    const TetrixPieceLayout &layout = piece.layout();
+    int left = x + layout.minX;
+    int top = y - layout.minY; // Board row of the piece's first mask row
+    if (left < 0 || x + layout.maxX >= Width || y - layout.maxY < 0 || top >= Height) {
+        return false;
+    }
+    for (int k = 0; k < layout.rowCount; ++k) {
+        if (rows[top - k] & (unsigned(layout.rowMasks[k]) << left)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TetrixGrid::place(const TetrixPiece &piece, int x, int y) {
+    const TetrixPieceLayout &layout = piece.layout();
+    int left = x + layout.minX;
+    int top = y - layout.minY;
+    for (int k = 0; k < layout.rowCount; ++k) {
+        rows[top - k] |= uint16_t(unsigned(layout.rowMasks[k]) << left);
+    }
+    for (int i = 0; i < 4; ++i) {
+        int cellX = x + layout.coords[i][0];
+        int cellY = y - layout.coords[i][1];
+        cells[cellY * Width + cellX] = piece.shape();
+        zobristHash ^= TetrixZobrist::cellKey(cellX, cellY);
+    }
+}
+
+int TetrixGrid::findFullLines(int *lines) const {
+    int count = 0;
+    for (int i = Height - 1; i >= 0 && count < MaxLinesPerLock; --i) {
+        if (rows[i] == FullRow) {
+            lines[count++] = i;
+        }
+    }
+    return count;
+}
+
+uint64_t TetrixGrid::checksum() const {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto mix = [&hash](unsigned byte) {
+        hash ^= byte;
+        hash *= 0x100000001B3ull;
+    };
+    for (int y = 0; y < Height; ++y) {
+        mix(rows[y] & 0xFF);
+        mix(rows[y] >> 8);
+    }
+    for (int i = 0; i < Width * Height; ++i) {
+        mix(static_cast<unsigned>(cells[i]));
+    }
+    return hash;
+}
+
+uint64_t TetrixGrid::computeHash() const {
+    uint64_t hash = 0;
+    for (int y = 0; y < Height; ++y) {
+        hash ^= TetrixZobrist::rowKey(y, rows[y]);
+    }
+    return hash;
+}
+
+int TetrixGrid::clearFullLines() {
+    int lines[MaxLinesPerLock];
+    int count = findFullLines(lines);
+    removeLines(lines, count);
+    return count;
+}
+
+bool TetrixGrid::insertRows(int count, int hole, TetrixShape cell) {
+    if (count <= 0) {
+        return true;
+    }
+    count = count < Height ? count : int(Height);
+    bool fits = true;
+    for (int y = Height - count; y < Height; ++y) {
+        fits = fits && rows[y] == 0;
+    }
+    std::memmove(rows + count, rows, (Height - count) * sizeof(rows[0]));
+    std::memmove(cells + count * Width, cells, (Height - count) * Width * sizeof(cells[0]));
+    for (int y = 0; y < count; ++y) {
+        rows[y] = uint16_t(FullRow & ~(1u << hole));
+        for (int x = 0; x < Width; ++x) {
+            cells[y * Width + x] = x == hole ? TetrixShape::NoShape : cell;
+        }
+    }
+    // Every row moved
+    zobristHash = computeHash();
+    return fits;
+}
+
+void TetrixGrid::removeLines(const int *lines, int count) {
+    if (count == 0) {
+        return;
+    }
+    // Every row from the lowest removed one up changes; rehash only those
+    int lowest = lines[count - 1];
+    for (int y = lowest; y < Height; ++y) {
+        zobristHash ^= TetrixZobrist::rowKey(y, rows[y]);
+    }
+    // One compaction pass: every surviving row moves down by the number of removed rows below it
+    uint32_t removed = 0;
+    for (int n = 0; n < count; ++n) {
+        removed |= 1u << lines[n];
+    }
+    int to = lowest;
+    for (int from = lowest; from < Height; ++from) {
+        if (removed & (1u << from)) {
+            continue;
+        }
+        if (to != from) {
+            rows[to] = rows[from];
+            std::memcpy(cells + to * Width, cells + from * Width, Width * sizeof(cells[0]));
+        }
+        ++to;
+    }
+    for (; to < Height; ++to) {
+        rows[to] = 0;
+        for (int j = 0; j < Width; ++j) {
+            cells[to * Width + j] = TetrixShape::NoShape;
+        }
+    }
+    for (int y = lowest; y < Height; ++y) {
+        zobristHash ^= TetrixZobrist::rowKey(y, rows[y]);
+    }
+}
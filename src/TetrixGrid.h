@@ -0,0 +1,50 @@
+#ifndef TETRIXGRID_H
+#define TETRIXGRID_H
+
+#include <cstdint>
+#include "TetrixPiece.h"
+#include "TetrixZobrist.h"
+
+// 10x22 playfield stored twice: one bitmask per row (bit x set when column x is occupied)
+// for collision and line tests, plus the per-cell shape layer used for drawing. A Zobrist hash of
+// the occupancy is kept up to date by place(), removeLines() and insertRows() for transposition lookups.
+class TetrixGrid {
+public:
+    enum { Width = 10, Height = 22, FullRow = (1 << Width) - 1, MaxLinesPerLock = 4 };
+
+    TetrixGrid() { clear(); }
+
+    void clear();
+    uint16_t row(int y) const { return rows[y]; }
+    const uint16_t *rowData() const { return rows; }
+    const TetrixShape *cellData() const { return cells; }
+    // Replaces both layers; the caller keeps them consistent (see TetrixEngine::restoreState)
+    void assign(const uint16_t *rowData, const TetrixShape *cellData);
+    TetrixShape shapeAt(int x, int y) const { return cells[y * Width + x]; }
+
+    bool fits(const TetrixPiece &piece, int x, int y) const;
+    void place(const TetrixPiece &piece, int x, int y);
+    // Writes the full rows into lines (at most MaxLinesPerLock), top row first, and returns their count
+    int findFullLines(int *lines) const;
+    // Removes the given rows (top row first, as returned by findFullLines) and shifts the rows above down,
+    // all in one pass over the board
+    void removeLines(const int *lines, int count);
+    // Finds and removes full rows in one step; returns how many were cleared
+    int clearFullLines();
+    // Pushes every row up by count and fills the bottom count rows with cell, except column hole (versus
+    // garbage); returns false when occupied rows went off the top
+    bool insertRows(int count, int hole, TetrixShape cell);
+    // FNV-1a over both layers, for checking that two boards are identical
+    uint64_t checksum() const;
+    // Incremental Zobrist hash of the occupied cells (see TetrixZobrist.h)
+    uint64_t hash() const { return zobristHash; }
+    // The same hash recomputed from scratch
+    uint64_t computeHash() const;
+
+private:
+    uint16_t rows[Height];
+    TetrixShape cells[Width * Height];
+    uint64_t zobristHash;
+};
+
+#endif // TETRIXGRID_H
@@ -0,0 +1,56 @@
+#include "TetrixInputInjector.h"
+#include "TetrixBoard.h"
+#include <QCoreApplication>
+#include <QKeyEvent>
+#include <QPushButton>
+#include <QTimer>
+
+namespace {
+
+const int Keys[] = { Qt::Key_Left, Qt::Key_Right, Qt::Key_Up, Qt::Key_Down, Qt::Key_Space };
+const int KeyWeights[] = { 3, 3, 3, 2, 1 }; // Hard drops end pieces; keep them rarer so pieces get moved first
+const int TotalWeight = 12;
+
+} // namespace
+
+TetrixInputInjector::TetrixInputInjector(QWidget *window, int presses, QObject *parent)
+    : QObject(parent), window(window), board(window->findChild<TetrixBoard *>()), remaining(presses), random(1)
+{
+    QTimer::singleShot(500, this, &TetrixInputInjector::injectNext); // Let the window lay out and paint first
+}
+
+void TetrixInputInjector::injectNext() {
+    if (!board) {
+        QCoreApplication::quit();
+        return;
+    }
+    if (remaining <= 0) {
+        QTimer::singleShot(200, qApp, &QCoreApplication::quit); // Let the last frames paint
+        return;
+    }
+
+    if (!board->isGameStarted()) {
+        QPushButton *restart = window->findChild<QPushButton *>("restartButton");
+        QPushButton *start = window->findChild<QPushButton *>("startButton");
+        if (restart && restart->isVisible()) {
+            restart->click();
+        } else if (start) {
+            start->click();
+        }
+        QTimer::singleShot(100, this, &TetrixInputInjector::injectNext);
+        return;
+    }
+
+    int pick = random.bounded(TotalWeight);
+    int index = 0;
+    while (pick >= KeyWeights[index]) {
+        pick -= KeyWeights[index++];
+    }
+    int key = Keys[index];
+    QCoreApplication::postEvent(board, new QKeyEvent(QEvent::KeyPress, key, Qt::NoModifier));
+    QTimer::singleShot(20 + random.bounded(130), board, [board = board, key]() {
+        QCoreApplication::postEvent(board, new QKeyEvent(QEvent::KeyRelease, key, Qt::NoModifier));
+    });
+    --remaining;
+    QTimer::singleShot(30 + random.bounded(90), this, &TetrixInputInjector::injectNext);
+}
@@ -0,0 +1,28 @@
+#ifndef TETRIXINPUTINJECTOR_H
+#define TETRIXINPUTINJECTOR_H
+
+#include <QObject>
+#include <QRandomGenerator>
+
+class QWidget;
+class TetrixBoard;
+
+// Synthetic player for unattended latency runs (TETRIX_INJECT_INPUTS, works under QT_QPA_PLATFORM=offscreen):
+// posts key press/release pairs to the board at human-like intervals, starts or restarts games through the
+// window's buttons, and quits the application after the requested number of key presses.
+class TetrixInputInjector : public QObject {
+    Q_OBJECT
+
+public:
+    TetrixInputInjector(QWidget *window, int presses, QObject *parent = nullptr);
+
+private:
+    void injectNext();
+
+    QWidget *window;
+    TetrixBoard *board;
+    int remaining;
+    QRandomGenerator random; // Fixed seed so runs are comparable
+};
+
+#endif // TETRIXINPUTINJECTOR_H
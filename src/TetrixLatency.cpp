@@ -0,0 +1,78 @@
+#include "TetrixLatency.h"
+#include <algorithm>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+inline int highestBit(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+} // namespace
+
+void TetrixLatencyHistogram::record(uint64_t value) {
+    ++counts[bucketIndex(value)];
+    ++total;
+    minValue = std::min(minValue, value);
+    maxValue = std::max(maxValue, value);
+}
+
+void TetrixLatencyHistogram::merge(const TetrixLatencyHistogram &other) {
+    for (int i = 0; i < BucketCount; ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+}
+
+void TetrixLatencyHistogram::clear() {
+    std::memset(counts, 0, sizeof(counts));
+    total = 0;
+    minValue = UINT64_MAX;
+    maxValue = 0;
+}
+
+uint64_t TetrixLatencyHistogram::percentile(double percent) const {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::max(1.0, percent / 100.0 * double(total) + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // The bucket bound can overshoot the largest value actually seen
+            return std::min(bucketUpperBound(i), maxValue);
+        }
+    }
+    return maxValue;
+}
+
+int TetrixLatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < SubBuckets) {
+        return static_cast<int>(value);
+    }
+    // Keep the top SubBucketBits bits: the leading one picks the power of two, the rest the linear bucket
+    int shift = highestBit(value) - (SubBucketBits - 1);
+    int sub = static_cast<int>(value >> shift) - HalfBuckets;
+    return SubBuckets + (shift - 1) * HalfBuckets + sub;
+}
+
+uint64_t TetrixLatencyHistogram::bucketUpperBound(int index) {
+    if (index < SubBuckets) {
+        return static_cast<uint64_t>(index);
+    }
+    int shift = (index - SubBuckets) / HalfBuckets + 1;
+    uint64_t sub = static_cast<uint64_t>((index - SubBuckets) % HalfBuckets + HalfBuckets);
+    return (sub << shift) + ((uint64_t(1) << shift) - 1);
+}
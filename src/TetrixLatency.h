@@ -0,0 +1,36 @@
+#ifndef TETRIXLATENCY_H
+#define TETRIXLATENCY_H
+
+#include <cstdint>
+
+// Latency histogram in the HdrHistogram style: values below SubBuckets are counted exactly, larger ones in
+// SubBuckets / 2 linear buckets per power of two, so every recorded value keeps about 3% precision from
+// nanoseconds to minutes. Fixed size; record() never allocates, so it can sit on input and paint paths.
+class TetrixLatencyHistogram {
+public:
+    enum { SubBucketBits = 6, SubBuckets = 1 << SubBucketBits, HalfBuckets = SubBuckets / 2 };
+    enum { BucketCount = SubBuckets + (64 - SubBucketBits) * HalfBuckets };
+
+    TetrixLatencyHistogram() { clear(); }
+
+    void record(uint64_t value);
+    void merge(const TetrixLatencyHistogram &other);
+    void clear();
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? minValue : 0; }
+    uint64_t max() const { return maxValue; }
+    // Smallest bucket bound at or below which percentile percent of the values fall (0 when empty)
+    uint64_t percentile(double percent) const;
+
+private:
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(int index);
+
+    uint64_t counts[BucketCount];
+    uint64_t total;
+    uint64_t minValue;
+    uint64_t maxValue;
+};
+
+#endif // TETRIXLATENCY_H
@@ -0,0 +1,549 @@
+#include "TetrixLeaderboard.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char SnapshotMagic[4] = { 'T', 'X', 'L', 'S' };
+const size_t ReadBatchRecords = 4096;
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t logBytes; // Log prefix the snapshot covers
+    uint32_t entryCount;
+    uint32_t playerCount;
+};
+
+static_assert(sizeof(SnapshotHeader) == 24, "snapshot header layout");
+
+uint64_t fnv1a(const void *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint32_t recordChecksum(const TetrixScoreRecord &record) {
+    return static_cast<uint32_t>(fnv1a(&record, offsetof(TetrixScoreRecord, checksum)));
+}
+
+std::string recordName(const TetrixScoreRecord &record) {
+    size_t length = 0;
+    while (length < sizeof(record.name) && record.name[length] != '\0') {
+        ++length;
+    }
+    return std::string(record.name, length);
+}
+
+int64_t fileSize(FILE *file) {
+#ifdef _WIN32
+    if (_fseeki64(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    return _ftelli64(file);
+#else
+    if (fseeko(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    return static_cast<int64_t>(ftello(file));
+#endif
+}
+
+bool seekFile(FILE *file, int64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+bool truncateFile(FILE *file, int64_t size) {
+    std::fflush(file);
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), size) == 0;
+#else
+    return ftruncate(fileno(file), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+// Down to the device, not just the OS cache
+bool syncFile(FILE *file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+template <typename T>
+void append(std::vector<uint8_t> &bytes, const T *data, size_t count) {
+    const uint8_t *begin = reinterpret_cast<const uint8_t *>(data);
+    bytes.insert(bytes.end(), begin, begin + sizeof(T) * count);
+}
+
+} // namespace
+
+TetrixLeaderboard::TetrixLeaderboard()
+    : root(-1), randomState(0x9e3779b97f4a7c15ull), log(nullptr), queuedRecords(0), writtenRecords(0), stopping(false),
+      flushNow(false)
+{
+}
+
+TetrixLeaderboard::~TetrixLeaderboard() {
+    close();
+}
+
+void TetrixLeaderboard::reset() {
+    entries.clear();
+    nodes.clear();
+    root = -1;
+    players.clear();
+    playerIds.clear();
+}
+
+bool TetrixLeaderboard::open(const std::string &path) {
+    close();
+    reset();
+    info = LoadInfo();
+    basePath = path;
+    std::string logPath = path + ".log";
+    log = std::fopen(logPath.c_str(), "r+b");
+    if (!log) {
+        log = std::fopen(logPath.c_str(), "w+b");
+    }
+    if (!log) {
+        return false;
+    }
+    int64_t size = fileSize(log);
+    if (size < 0) {
+        std::fclose(log);
+        log = nullptr;
+        return false;
+    }
+
+    // The snapshot is only a shortcut: without a usable one the whole log is replayed
+    uint64_t logBytes = 0;
+    info.snapshotUsed = loadSnapshot(path + ".snap", logBytes) && logBytes <= static_cast<uint64_t>(size);
+    if (!info.snapshotUsed) {
+        reset();
+        logBytes = 0;
+    }
+
+    std::vector<TetrixScoreRecord> records(ReadBatchRecords);
+    int64_t goodEnd = static_cast<int64_t>(logBytes);
+    bool corrupt = !seekFile(log, goodEnd);
+    while (!corrupt) {
+        size_t read = std::fread(records.data(), sizeof(TetrixScoreRecord), records.size(), log);
+        for (size_t i = 0; i < read; ++i) {
+            if (records[i].checksum != recordChecksum(records[i])) {
+                corrupt = true;
+                break;
+            }
+            insert(records[i]);
+            goodEnd += sizeof(TetrixScoreRecord);
+            ++info.replayedRecords;
+        }
+        if (read < records.size()) {
+            break;
+        }
+    }
+    // Whatever follows the last good record was being written when the game stopped
+    if (goodEnd < size) {
+        info.discardedBytes = static_cast<uint64_t>(size - goodEnd);
+        truncateFile(log, goodEnd);
+    }
+    if (!seekFile(log, goodEnd)) {
+        std::fclose(log);
+        log = nullptr;
+        return false;
+    }
+
+    // Growing the index copies all of it; leave room so a session's games never trigger that
+    entries.reserve(entries.size() * 2 + 1024);
+    nodes.reserve(nodes.size() * 2 + 1024);
+
+    stopping = false;
+    flushNow = false;
+    counters = Stats();
+    flusher = std::thread(&TetrixLeaderboard::flushLoop, this);
+    return true;
+}
+
+bool TetrixLeaderboard::close() {
+    if (!log) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    flusher.join();
+    bool ok = counters.failedRecords == 0;
+    ok = std::fclose(log) == 0 && ok;
+    log = nullptr;
+    // A log that lost records no longer lines up with the index; the next open replays it instead
+    return ok && writeSnapshot(basePath + ".snap");
+}
+
+uint32_t TetrixLeaderboard::add(const std::string &name, int score, int lines, int level, int pieces, int64_t timeMs) {
+    TetrixScoreRecord record{};
+    record.score = score;
+    record.lines = lines;
+    record.level = level;
+    record.pieces = pieces;
+    record.timeMs = timeMs;
+    size_t length = name.size();
+    if (length > sizeof(record.name)) {
+        // Never split a UTF-8 sequence
+        length = sizeof(record.name);
+        while (length > 0 && (static_cast<uint8_t>(name[length]) & 0xC0) == 0x80) {
+            --length;
+        }
+    }
+    std::memcpy(record.name, name.data(), length);
+    record.checksum = recordChecksum(record);
+    uint32_t index = insert(record);
+    if (log) {
+        bool notify;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(record);
+            ++queuedRecords;
+            // The flusher only needs waking to start a batch or to cut a full one short
+            notify = queue.size() == 1 || queue.size() == MaxBatchRecords;
+        }
+        if (notify) {
+            wake.notify_one();
+        }
+    }
+    return index;
+}
+
+bool TetrixLeaderboard::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t target = queuedRecords;
+    uint64_t failedBefore = counters.failedRecords;
+    flushNow = true;
+    wake.notify_one();
+    flushed.wait(lock, [&] { return writtenRecords >= target || !log; });
+    return counters.failedRecords == failedBefore;
+}
+
+void TetrixLeaderboard::flushLoop() {
+    std::vector<TetrixScoreRecord> batch;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            break; // Stopping with nothing left
+        }
+        // Give a burst of games a moment to share one write and one sync
+        wake.wait_for(lock, std::chrono::milliseconds(FlushDelayMs),
+                      [this] { return stopping || flushNow || queue.size() >= MaxBatchRecords; });
+        flushNow = false;
+        batch.swap(queue);
+        lock.unlock();
+
+        auto begin = std::chrono::steady_clock::now();
+        bool ok = std::fwrite(batch.data(), sizeof(TetrixScoreRecord), batch.size(), log) == batch.size() && syncFile(log);
+        uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+
+        lock.lock();
+        ++counters.batches;
+        (ok ? counters.records : counters.failedRecords) += batch.size();
+        counters.maxFlushNs = std::max(counters.maxFlushNs, ns);
+        writtenRecords += batch.size();
+        batch.clear();
+        flushed.notify_all();
+    }
+}
+
+TetrixLeaderboard::Stats TetrixLeaderboard::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+uint32_t TetrixLeaderboard::playerId(const std::string &name) {
+    auto found = playerIds.find(name);
+    if (found != playerIds.end()) {
+        return found->second;
+    }
+    uint32_t id = static_cast<uint32_t>(players.size());
+    players.push_back(Player{ name, 0, 0 });
+    playerIds.emplace(name, id);
+    return id;
+}
+
+uint32_t TetrixLeaderboard::insert(const TetrixScoreRecord &record) {
+    uint32_t index = static_cast<uint32_t>(entries.size());
+    TetrixLeaderboardEntry entry{};
+    entry.score = record.score;
+    entry.lines = record.lines;
+    entry.level = record.level;
+    entry.pieces = record.pieces;
+    entry.timeMs = record.timeMs;
+    entry.player = playerId(recordName(record));
+    entries.push_back(entry);
+
+    Player &player = players[entry.player];
+    if (player.games++ == 0 || entry.score > entries[player.best].score) {
+        player.best = index;
+    }
+
+    nodes.push_back(Node{ entry.score, index, nextPriority(), 1, -1, -1 });
+    root = insertNode(root, static_cast<int32_t>(index));
+    return index;
+}
+
+uint32_t TetrixLeaderboard::nextPriority() {
+    // splitmix64
+    uint64_t z = (randomState += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return static_cast<uint32_t>((z ^ (z >> 31)) >> 32);
+}
+
+void TetrixLeaderboard::split(int32_t tree, int score, uint32_t index, int32_t &left, int32_t &right) {
+    if (tree < 0) {
+        left = right = -1;
+        return;
+    }
+    Node &t = nodes[tree];
+    if (before(t.score, t.index, score, index)) {
+        split(t.right, score, index, t.right, right);
+        left = tree;
+    } else {
+        split(t.left, score, index, left, t.left);
+        right = tree;
+    }
+    t.size = 1 + nodeSize(t.left) + nodeSize(t.right);
+}
+
+int32_t TetrixLeaderboard::insertNode(int32_t tree, int32_t node) {
+    if (tree < 0) {
+        return node;
+    }
+    Node &n = nodes[node];
+    Node &t = nodes[tree];
+    if (n.priority > t.priority) {
+        split(tree, n.score, n.index, n.left, n.right);
+        n.size = 1 + nodeSize(n.left) + nodeSize(n.right);
+        return node;
+    }
+    if (before(n.score, n.index, t.score, t.index)) {
+        t.left = insertNode(t.left, node);
+    } else {
+        t.right = insertNode(t.right, node);
+    }
+    ++t.size;
+    return tree;
+}
+
+int32_t TetrixLeaderboard::buildBalanced(const uint32_t *order, size_t count, int depth) {
+    if (count == 0) {
+        return -1;
+    }
+    size_t middle = count / 2;
+    Node &n = nodes[order[middle]];
+    // Priorities fall with depth, so the perfectly balanced tree is already a valid treap
+    n.priority = (uint32_t(255 - std::min(depth, 255)) << 24) | (nextPriority() >> 8);
+    n.left = buildBalanced(order, middle, depth + 1);
+    n.right = buildBalanced(order + middle + 1, count - middle - 1, depth + 1);
+    n.size = static_cast<uint32_t>(count);
+    return static_cast<int32_t>(order[middle]);
+}
+
+size_t TetrixLeaderboard::rankForScore(int score) const {
+    size_t better = 0;
+    for (int32_t node = root; node >= 0;) {
+        const Node &n = nodes[node];
+        if (n.score > score) {
+            better += nodeSize(n.left) + 1;
+            node = n.right;
+        } else {
+            node = n.left;
+        }
+    }
+    return better + 1;
+}
+
+size_t TetrixLeaderboard::rankOf(uint32_t index) const {
+    const Node &key = nodes[index];
+    size_t better = 0;
+    for (int32_t node = root; node >= 0;) {
+        const Node &n = nodes[node];
+        if (before(n.score, n.index, key.score, key.index)) {
+            better += nodeSize(n.left) + 1;
+            node = n.right;
+        } else if (n.index == key.index) {
+            return better + nodeSize(n.left) + 1;
+        } else {
+            node = n.left;
+        }
+    }
+    return better + 1;
+}
+
+int TetrixLeaderboard::bestScore() const {
+    int32_t node = root;
+    if (node < 0) {
+        return 0;
+    }
+    while (nodes[node].left >= 0) {
+        node = nodes[node].left;
+    }
+    return nodes[node].score;
+}
+
+void TetrixLeaderboard::top(size_t n, std::vector<uint32_t> &result) const {
+    result.clear();
+    // In-order walk that stops after n nodes: O(log size + n)
+    std::vector<int32_t> path;
+    int32_t node = root;
+    while ((node >= 0 || !path.empty()) && result.size() < n) {
+        while (node >= 0) {
+            path.push_back(node);
+            node = nodes[node].left;
+        }
+        node = path.back();
+        path.pop_back();
+        result.push_back(nodes[node].index);
+        node = nodes[node].right;
+    }
+}
+
+bool TetrixLeaderboard::playerBest(const std::string &name, uint32_t &index) const {
+    auto found = playerIds.find(name);
+    if (found == playerIds.end()) {
+        return false;
+    }
+    index = players[found->second].best;
+    return true;
+}
+
+bool TetrixLeaderboard::writeSnapshot(const std::string &path) const {
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SnapshotMagic, 4);
+    header.version = TetrixLeaderboardFormat::Version;
+    header.logBytes = uint64_t(entries.size()) * sizeof(TetrixScoreRecord);
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.playerCount = static_cast<uint32_t>(players.size());
+
+    std::vector<uint8_t> bytes;
+    bytes.reserve(sizeof(header) + entries.size() * (sizeof(uint32_t) + sizeof(TetrixLeaderboardEntry)) + players.size() * 16 + 8);
+    append(bytes, &header, 1);
+    for (const Player &player : players) {
+        uint8_t length = static_cast<uint8_t>(player.name.size()); // At most NameBytes
+        append(bytes, &length, 1);
+        append(bytes, player.name.data(), length);
+    }
+    std::vector<uint32_t> order;
+    top(entries.size(), order);
+    append(bytes, order.data(), order.size());
+    append(bytes, entries.data(), entries.size());
+    uint64_t checksum = fnv1a(bytes.data(), bytes.size());
+    append(bytes, &checksum, 1);
+
+    // Never leave a half-written snapshot under the real name
+    std::string temporary = path + ".tmp";
+    FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size() && syncFile(file);
+    ok = std::fclose(file) == 0 && ok;
+#ifdef _WIN32
+    if (ok) {
+        std::remove(path.c_str());
+    }
+#endif
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TetrixLeaderboard::loadSnapshot(const std::string &path, uint64_t &logBytes) {
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    int64_t size = fileSize(file);
+    std::vector<uint8_t> bytes(size > 0 ? static_cast<size_t>(size) : 0);
+    bool ok = size >= int64_t(sizeof(SnapshotHeader) + sizeof(uint64_t)) && seekFile(file, 0)
+        && std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    std::fclose(file);
+    if (!ok) {
+        return false;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    uint64_t checksum;
+    size_t body = bytes.size() - sizeof(checksum);
+    std::memcpy(&checksum, bytes.data() + body, sizeof(checksum));
+    if (std::memcmp(header.magic, SnapshotMagic, 4) != 0 || header.version != TetrixLeaderboardFormat::Version
+        || header.logBytes != uint64_t(header.entryCount) * sizeof(TetrixScoreRecord) || checksum != fnv1a(bytes.data(), body)) {
+        return false;
+    }
+
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.playerCount; ++i) {
+        if (offset >= body || offset + 1 + bytes[offset] > body || bytes[offset] > TetrixLeaderboardFormat::NameBytes) {
+            return false;
+        }
+        std::string name(reinterpret_cast<const char *>(bytes.data() + offset + 1), bytes[offset]);
+        offset += 1 + bytes[offset];
+        if (playerId(name) != i) {
+            return false; // Duplicate name
+        }
+    }
+    size_t count = header.entryCount;
+    if (body - offset != count * (sizeof(uint32_t) + sizeof(TetrixLeaderboardEntry))) {
+        return false;
+    }
+    std::vector<uint32_t> order(count);
+    std::memcpy(order.data(), bytes.data() + offset, count * sizeof(uint32_t));
+    offset += count * sizeof(uint32_t);
+    entries.resize(count);
+    std::memcpy(entries.data(), bytes.data() + offset, count * sizeof(TetrixLeaderboardEntry));
+
+    // The order has to be a permutation sorted by rank, or the tree built from it is not a search tree
+    std::vector<bool> seen(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t index = order[i];
+        if (index >= count || seen[index] || entries[index].player >= header.playerCount
+            || (i > 0 && !before(entries[order[i - 1]].score, order[i - 1], entries[index].score, index))) {
+            return false;
+        }
+        seen[index] = true;
+    }
+
+    nodes.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const TetrixLeaderboardEntry &entry = entries[i];
+        nodes[i] = Node{ entry.score, static_cast<uint32_t>(i), 0, 1, -1, -1 };
+        Player &player = players[entry.player];
+        if (player.games++ == 0 || entry.score > entries[player.best].score) {
+            player.best = static_cast<uint32_t>(i);
+        }
+    }
+    root = buildBalanced(order.data(), count, 0);
+    logBytes = header.logBytes;
+    return true;
+}
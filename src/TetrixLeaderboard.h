@@ -0,0 +1,162 @@
+#ifndef TETRIXLEADERBOARD_H
+#define TETRIXLEADERBOARD_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Every finished game, kept in two files next to each other (little endian):
+//   <path>.log   append-only records, each a fixed 64 bytes with its own checksum. Appends are queued
+//                and written in batches by a flusher thread; a record torn by a crash fails its
+//                checksum and is cut off on the next open, together with anything after it.
+//   <path>.snap  the whole index as of some log length: "TXLS", version, log bytes covered, counts,
+//                player names, games in rank order and in log order, checksum. Written on close() (to a
+//                temporary file, then renamed); open() loads it and replays only the log after it.
+namespace TetrixLeaderboardFormat {
+
+enum { Version = 1, NameBytes = 36, RecordSize = 64 };
+
+} // namespace TetrixLeaderboardFormat
+
+struct TetrixScoreRecord {
+    int32_t score;
+    int32_t lines;
+    int32_t level;
+    int32_t pieces;
+    int64_t timeMs; // Unix time the game ended
+    char name[TetrixLeaderboardFormat::NameBytes]; // UTF-8, zero padded; not terminated when full
+    uint32_t checksum; // FNV-1a of the bytes before it
+};
+
+static_assert(sizeof(TetrixScoreRecord) == TetrixLeaderboardFormat::RecordSize, "TetrixScoreRecord is a fixed on-disk layout");
+
+// One game as the index keeps it; the player's name is in the player table
+struct TetrixLeaderboardEntry {
+    int32_t score;
+    int32_t lines;
+    int32_t level;
+    int32_t pieces;
+    int64_t timeMs;
+    uint32_t player;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TetrixLeaderboardEntry) == 32, "TetrixLeaderboardEntry is a fixed snapshot layout");
+
+// Leaderboard over the log, answering rank, top-N and per-player best in O(log n) from memory.
+// add() only queues the record for the flusher, so callers never wait on the disk. Not thread-safe
+// apart from that: one thread opens, adds and queries.
+class TetrixLeaderboard {
+public:
+    enum { FlushDelayMs = 50, MaxBatchRecords = 4096 }; // A batch waits this long for company, at most
+
+    struct Stats {
+        uint64_t batches = 0; // Writes to the log, each followed by a flush to the device
+        uint64_t records = 0; // Records written
+        uint64_t failedRecords = 0; // Lost to write errors
+        uint64_t maxFlushNs = 0; // Slowest batch
+    };
+
+    // How open() found the files
+    struct LoadInfo {
+        bool snapshotUsed = false;
+        uint64_t replayedRecords = 0; // Read from the log after the snapshot (all of it without one)
+        uint64_t discardedBytes = 0; // Torn or corrupt tail cut off the log
+    };
+
+    TetrixLeaderboard();
+    ~TetrixLeaderboard();
+    TetrixLeaderboard(const TetrixLeaderboard &) = delete;
+    TetrixLeaderboard &operator=(const TetrixLeaderboard &) = delete;
+
+    // Loads (or creates) path.log and path.snap and starts the flusher
+    bool open(const std::string &path);
+    // Flushes what is queued, writes the snapshot and stops the flusher
+    bool close();
+    bool isOpen() const { return log != nullptr; }
+    const LoadInfo &loadInfo() const { return info; }
+
+    // Names longer than NameBytes are cut at a character boundary; returns the game's index
+    uint32_t add(const std::string &name, int score, int lines, int level, int pieces, int64_t timeMs);
+    // Blocks until everything add()ed so far is on disk
+    bool flush();
+
+    size_t count() const { return entries.size(); }
+    size_t playerCount() const { return players.size(); }
+    const TetrixLeaderboardEntry &entry(uint32_t index) const { return entries[index]; }
+    const std::string &playerName(uint32_t player) const { return players[player].name; }
+
+    // Games are ranked by score, earlier games first among equal scores. Rank 1 is the best.
+    // Rank a new game with this score would take: one more than the games that beat it
+    size_t rankForScore(int score) const;
+    size_t rankOf(uint32_t index) const;
+    int bestScore() const; // 0 when empty
+    // Indices of the n best games, best first
+    void top(size_t n, std::vector<uint32_t> &result) const;
+    // The player's best game, or false if the name has no games
+    bool playerBest(const std::string &name, uint32_t &index) const;
+
+    Stats stats() const;
+
+private:
+    // Order-statistics treap over (score descending, index ascending), nodes pooled in one vector
+    struct Node {
+        int32_t score;
+        uint32_t index; // Into entries; the node for entry i is nodes[i]
+        uint32_t priority;
+        uint32_t size; // Nodes in this subtree
+        int32_t left;
+        int32_t right;
+    };
+
+    struct Player {
+        std::string name;
+        uint32_t best; // Entry index
+        uint32_t games;
+    };
+
+    void reset();
+    uint32_t insert(const TetrixScoreRecord &record); // Index only, no log write
+    uint32_t playerId(const std::string &name);
+    static bool before(int scoreA, uint32_t indexA, int scoreB, uint32_t indexB) {
+        return scoreA != scoreB ? scoreA > scoreB : indexA < indexB;
+    }
+    // Splits tree into the nodes ranked before (score, index) and the rest
+    void split(int32_t tree, int score, uint32_t index, int32_t &left, int32_t &right);
+    int32_t insertNode(int32_t tree, int32_t node);
+    int32_t buildBalanced(const uint32_t *order, size_t count, int depth);
+    uint32_t nodeSize(int32_t node) const { return node < 0 ? 0 : nodes[node].size; }
+    uint32_t nextPriority();
+
+    bool loadSnapshot(const std::string &path, uint64_t &logBytes);
+    bool writeSnapshot(const std::string &path) const;
+    void flushLoop();
+
+    std::vector<TetrixLeaderboardEntry> entries; // Log order
+    std::vector<Node> nodes;
+    int32_t root;
+    std::vector<Player> players;
+    std::unordered_map<std::string, uint32_t> playerIds;
+    uint64_t randomState;
+    std::string basePath;
+    LoadInfo info;
+
+    FILE *log; // Flusher thread only while it runs
+    std::thread flusher;
+    mutable std::mutex mutex; // Guards the queue, the counters below and stopping
+    std::condition_variable wake; // Records queued, or stopping
+    std::condition_variable flushed; // A batch reached the disk
+    std::vector<TetrixScoreRecord> queue;
+    uint64_t queuedRecords; // Ever queued
+    uint64_t writtenRecords; // Ever handled by the flusher, written or failed
+    bool stopping;
+    bool flushNow; // flush() is waiting: skip the batching delay
+    Stats counters;
+};
+
+#endif // TETRIXLEADERBOARD_H
@@ -1,31 +1,120 @@
 #ifndef TETRIXPIECE_H
 #define TETRIXPIECE_H
 
-enum class TetrixShape { NoShape, ZShape, SShape, LineShape, TShape, SquareShape, LShape, MirroredLShape };
+#include <cstdint>
+#include <type_traits>
 
+class TetrixRandomizer;
+
+enum class TetrixShape : uint8_t { NoShape, ZShape, SShape, LineShape, TShape, SquareShape, LShape, MirroredLShape };
+
+// Precomputed geometry of one (shape, rotation): cell offsets, bounding box and one
+// bitmask per occupied row (row k holds the cells with y == minY + k, bit 0 at minX).
+struct TetrixPieceLayout {
+    int8_t coords[4][2];
+    int8_t minX, maxX, minY, maxY;
+    int8_t rowCount;
+    uint8_t rowMasks[4];
+};
+
+namespace TetrixPieceTables {
+
+constexpr int8_t baseCoords[8][4][2] = {
+    { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } }, // NoShape
+    { { 0, -1 }, { 0, 0 }, { -1, 0 }, { -1, 1 } }, // ZShape
+    { { 0, -1 }, { 0, 0 }, { 1, 0 }, { 1, 1 } }, // SShape
+    { { 0, -1 }, { 0, 0 }, { 0, 1 }, { 0, 2 } }, // LineShape
+    { { -1, 0 }, { 0, 0 }, { 1, 0 }, { 0, 1 } }, // TShape
+    { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } }, // SquareShape
+    { { -1, -1 }, { 0, -1 }, { 0, 0 }, { 0, 1 } }, // LShape
+    { { 1, -1 }, { 0, -1 }, { 0, 0 }, { 0, 1 } } // MirroredLShape
+};
+
+// Applies `rotation` right turns, (x, y) -> (-y, x) each; the square never rotates
+constexpr TetrixPieceLayout makeLayout(int shape, int rotation) {
+    TetrixPieceLayout layout{};
+    int turns = shape == static_cast<int>(TetrixShape::SquareShape) ? 0 : rotation;
+    for (int i = 0; i < 4; ++i) {
+        int x = baseCoords[shape][i][0];
+        int y = baseCoords[shape][i][1];
+        for (int t = 0; t < turns; ++t) {
+            int rx = -y;
+            y = x;
+            x = rx;
+        }
+        layout.coords[i][0] = static_cast<int8_t>(x);
+        layout.coords[i][1] = static_cast<int8_t>(y);
+    }
+
+    layout.minX = layout.maxX = layout.coords[0][0];
+    layout.minY = layout.maxY = layout.coords[0][1];
+    for (int i = 1; i < 4; ++i) {
+        layout.minX = layout.coords[i][0] < layout.minX ? layout.coords[i][0] : layout.minX;
+        layout.maxX = layout.coords[i][0] > layout.maxX ? layout.coords[i][0] : layout.maxX;
+        layout.minY = layout.coords[i][1] < layout.minY ? layout.coords[i][1] : layout.minY;
+        layout.maxY = layout.coords[i][1] > layout.maxY ? layout.coords[i][1] : layout.maxY;
+    }
+
+    layout.rowCount = static_cast<int8_t>(layout.maxY - layout.minY + 1);
+    for (int i = 0; i < 4; ++i) {
+        int row = layout.coords[i][1] - layout.minY;
+        layout.rowMasks[row] = static_cast<uint8_t>(layout.rowMasks[row] | (1u << (layout.coords[i][0] - layout.minX)));
+    }
+    return layout;
+}
+
+struct LayoutTable {
+    TetrixPieceLayout layouts[8][4];
+};
+
+constexpr LayoutTable makeLayoutTable() {
+    LayoutTable table{};
+    for (int shape = 0; shape < 8; ++shape) {
+        for (int rotation = 0; rotation < 4; ++rotation) {
+            table.layouts[shape][rotation] = makeLayout(shape, rotation);
+        }
+    }
+    return table;
+}
+
+inline constexpr LayoutTable layoutTable = makeLayoutTable();
+
+} // namespace TetrixPieceTables
+
+// A piece is just (shape, rotation); all geometry comes from the compile-time layout table
 class TetrixPiece {
 public:
-    TetrixPiece() { setShape(TetrixShape::NoShape); }
+    constexpr TetrixPiece() : pieceShape(TetrixShape::NoShape), pieceRotation(0) {}
+    constexpr TetrixPiece(TetrixShape shape, int rotation)
+        : pieceShape(shape), pieceRotation(static_cast<uint8_t>(shape == TetrixShape::SquareShape ? 0 : rotation & 3)) {}
 
-    void setShape(TetrixShape shape);
-    void setRandomShape();
+    void setShape(TetrixShape shape) { pieceShape = shape; pieceRotation = 0; }
+    void setRandomShape(TetrixRandomizer &randomizer);
 
     TetrixShape shape() const { return pieceShape; }
-    int x(int index) const { return coords[index][0]; }
-    int y(int index) const { return coords[index][1]; }
-    int minX() const;
-    int maxX() const;
-    int minY() const;
-    int maxY() const;
-    TetrixPiece rotatedLeft() const;
-    TetrixPiece rotatedRight() const;
+    int rotation() const { return pieceRotation; }
+    const TetrixPieceLayout &layout() const { return TetrixPieceTables::layoutTable.layouts[static_cast<int>(pieceShape)][pieceRotation]; }
+    int x(int index) const { return layout().coords[index][0]; }
+    int y(int index) const { return layout().coords[index][1]; }
+    int minX() const { return layout().minX; }
+    int maxX() const { return layout().maxX; }
+    int minY() const { return layout().minY; }
+    int maxY() const { return layout().maxY; }
+    int rowCount() const { return layout().rowCount; }
+    // Cells of row minY() + index, bit 0 at minX()
+    unsigned rowMask(int index) const { return layout().rowMasks[index]; }
+    TetrixPiece rotatedLeft() const { return TetrixPiece(pieceShape, pieceRotation + 3); }
+    TetrixPiece rotatedRight() const { return TetrixPiece(pieceShape, pieceRotation + 1); }
 
-private:
-    void setX(int index, int x) { coords[index][0] = x; }
-    void setY(int index, int y) { coords[index][1] = y; }
+    bool operator==(const TetrixPiece &other) const { return pieceShape == other.pieceShape && pieceRotation == other.pieceRotation; }
+    bool operator!=(const TetrixPiece &other) const { return !(*this == other); }
 
+private:
     TetrixShape pieceShape;
-    int coords[4][2];
+    uint8_t pieceRotation; // Number of right turns from the spawn orientation, 0-3
 };
 
-#endif // TETRIXPIECE_H
\ No newline at end of file
+static_assert(sizeof(TetrixPiece) == 2, "TetrixPiece must stay a packed (shape, rotation) pair");
+static_assert(std::is_trivially_copyable<TetrixPiece>::value, "TetrixPiece must be trivially copyable");
+
+#endif // TETRIXPIECE_H
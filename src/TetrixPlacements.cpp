@@ -0,0 +1,156 @@
+#include "TetrixPlacements.h"
+#include <cstring>
+
+TetrixPlacementGenerator::TetrixPlacementGenerator()
+    : shape(TetrixShape::NoShape)
+{
+    results.reserve(StateCount);
+    paths.reserve(StateCount * 4);
+}
+
+int TetrixPlacementGenerator::restingY(const TetrixGrid &grid, const TetrixPiece &piece, int x, int y) {
+    while (grid.fits(piece, x, y - 1)) {
+        --y;
+    }
+    return y;
+}
+
+int TetrixPlacementGenerator::cachedRestingY(const TetrixGrid &grid, const TetrixPiece &piece, int x, int y) {
+    // Fall until a row whose landing spot is already known, then share the answer with every row passed
+    int base = stateIndex(x, 0, piece.rotation());
+    int landing = y;
+    while (restY[base + landing] < 0 && grid.fits(piece, x, landing - 1)) {
+        --landing;
+    }
+    int result = restY[base + landing] >= 0 ? restY[base + landing] : landing;
+    for (int row = y; row >= landing; --row) {
+        restY[base + row] = static_cast<int8_t>(result);
+    }
+    return result;
+}
+
+void TetrixPlacementGenerator::addPlacement(int x, int y, int rotation, int state) {
+    TetrixPlacement placement;
+    placement.x = static_cast<int8_t>(x);
+    placement.y = static_cast<int8_t>(y);
+    placement.rotation = static_cast<uint8_t>(rotation);
+    placement.pathLength = static_cast<uint16_t>(depth[state] + 1);
+    placement.pathOffset = static_cast<uint32_t>(paths.size());
+
+    // Walk the parent chain back to the start, writing the inputs back to front
+    paths.resize(paths.size() + placement.pathLength);
+    TetrixInput *out = paths.data() + placement.pathOffset;
+    out[depth[state]] = TetrixInput::HardDrop;
+    for (int s = state, i = depth[state] - 1; i >= 0; s = parent[s], --i) {
+        out[i] = parentInput[s];
+    }
+    results.push_back(placement);
+}
+
+int TetrixPlacementGenerator::generate(const TetrixGrid &grid, const TetrixPiece &piece, int x, int y) {
+    results.clear();
+    paths.clear();
+    visited.reset();
+    found.reset();
+    std::memset(restY, -1, sizeof(restY));
+    shape = piece.shape();
+    if (shape == TetrixShape::NoShape || !grid.fits(piece, x, y)) {
+        return 0;
+    }
+
+    int head = 0;
+    int tail = 0;
+    int start = stateIndex(x, y, piece.rotation());
+    visited.set(start);
+    depth[start] = 0;
+    queue[tail++] = static_cast<uint16_t>(start);
+
+    while (head < tail) {
+        int state = queue[head++];
+        int rotation = state / (Width * Height);
+        int sx = (state / Height) % Width;
+        int sy = state % Height;
+        TetrixPiece current(shape, rotation);
+
+        // Space from here locks at the resting row below; BFS order makes the first path the shortest
+        int landing = cachedRestingY(grid, current, sx, sy);
+        int rest = stateIndex(sx, landing, rotation);
+        if (!found.test(rest)) {
+            found.set(rest);
+            addPlacement(sx, landing, rotation, state);
+        }
+
+        struct Move { int dx; int dy; int turns; TetrixInput input; };
+        static const Move moves[] = {
+            { -1, 0, 0, TetrixInput::Left },
+            { 1, 0, 0, TetrixInput::Right },
+            { 0, 0, 1, TetrixInput::RotateRight },
+            { 0, -1, 0, TetrixInput::SoftDrop }
+        };
+        for (const Move &move : moves) {
+            TetrixPiece next = move.turns ? current.rotatedRight() : current;
+            int nx = sx + move.dx;
+            int ny = sy + move.dy;
+            if (!grid.fits(next, nx, ny)) {
+                continue;
+            }
+            int nextState = stateIndex(nx, ny, next.rotation());
+            if (visited.test(nextState)) {
+                continue;
+            }
+            visited.set(nextState);
+            parent[nextState] = static_cast<uint16_t>(state);
+            parentInput[nextState] = move.input;
+            depth[nextState] = static_cast<uint16_t>(depth[state] + 1);
+            queue[tail++] = static_cast<uint16_t>(nextState);
+        }
+    }
+    return count();
+}
+
+int TetrixPlacementGenerator::generateNaive(const TetrixGrid &grid, const TetrixPiece &piece, int x, int y) {
+    results.clear();
+    paths.clear();
+    found.reset();
+    shape = piece.shape();
+    if (shape == TetrixShape::NoShape || !grid.fits(piece, x, y)) {
+        return 0;
+    }
+
+    TetrixPiece rotated = piece;
+    for (int turns = 0; turns < Rotations; ++turns) {
+        if (turns > 0) {
+            TetrixPiece next = rotated.rotatedRight();
+            if (next == rotated) {
+                break; // The square has a single orientation
+            }
+            if (!grid.fits(next, x, y)) {
+                break;
+            }
+            rotated = next;
+        }
+        for (int dir = -1; dir <= 1; dir += 2) {
+            for (int nx = (dir < 0 ? x : x + 1); grid.fits(rotated, nx, y); nx += dir) {
+                int restY = restingY(grid, rotated, nx, y);
+                int rest = stateIndex(nx, restY, rotated.rotation());
+                if (found.test(rest)) {
+                    continue;
+                }
+                found.set(rest);
+
+                TetrixPlacement placement;
+                placement.x = static_cast<int8_t>(nx);
+                placement.y = static_cast<int8_t>(restY);
+                placement.rotation = static_cast<uint8_t>(rotated.rotation());
+                placement.pathOffset = static_cast<uint32_t>(paths.size());
+                paths.insert(paths.end(), turns, TetrixInput::RotateRight);
+                int shift = nx - x;
+                paths.insert(paths.end(), shift < 0 ? -shift : shift, shift < 0 ? TetrixInput::Left : TetrixInput::Right);
+                paths.push_back(TetrixInput::HardDrop);
+                placement.pathLength = static_cast<uint16_t>(paths.size() - placement.pathOffset);
+                results.push_back(placement);
+            }
+        }
+    }
+    return count();
+}
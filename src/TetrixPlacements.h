@@ -0,0 +1,58 @@
+#ifndef TETRIXPLACEMENTS_H
+#define TETRIXPLACEMENTS_H
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+#include "TetrixEngine.h"
+
+// A final resting position of a piece plus the shortest key sequence reaching it,
+// stored as a slice of the generator's shared path buffer
+struct TetrixPlacement {
+    int8_t x;
+    int8_t y;
+    uint8_t rotation;
+    uint16_t pathLength; // Includes the closing HardDrop
+    uint32_t pathOffset;
+};
+
+// Enumerates every reachable resting placement of a piece with a breadth-first search over
+// (x, y, rotation) using the TetrixBoard key semantics: Left, Right, Up (rotate right), Down
+// (one row) and Space (hard drop). All search state lives in fixed arrays reused between calls,
+// so generating placements allocates nothing once the result buffers have grown.
+class TetrixPlacementGenerator {
+public:
+    enum { Width = TetrixGrid::Width, Height = TetrixGrid::Height, Rotations = 4, StateCount = Rotations * Width * Height };
+
+    TetrixPlacementGenerator();
+
+    // Searches from the piece at (x, y), usually the spawn position; returns the number of placements
+    int generate(const TetrixGrid &grid, const TetrixPiece &piece, int x, int y);
+    // Reference enumerator: rotate at spawn, shift straight sideways, hard drop. Misses tucks and spins.
+    int generateNaive(const TetrixGrid &grid, const TetrixPiece &piece, int x, int y);
+
+    int count() const { return static_cast<int>(results.size()); }
+    const TetrixPlacement &placement(int index) const { return results[index]; }
+    const TetrixInput *path(const TetrixPlacement &placement) const { return paths.data() + placement.pathOffset; }
+    // Board piece for a placement, using the piece shape of the last search
+    TetrixPiece piece(const TetrixPlacement &placement) const { return TetrixPiece(shape, placement.rotation); }
+
+private:
+    static int stateIndex(int x, int y, int rotation) { return (rotation * Width + x) * Height + y; }
+    static int restingY(const TetrixGrid &grid, const TetrixPiece &piece, int x, int y);
+    int cachedRestingY(const TetrixGrid &grid, const TetrixPiece &piece, int x, int y);
+    void addPlacement(int x, int y, int rotation, int state);
+
+    TetrixShape shape;
+    std::bitset<StateCount> visited;
+    std::bitset<StateCount> found; // Resting states already reported
+    uint16_t parent[StateCount];
+    TetrixInput parentInput[StateCount];
+    uint16_t depth[StateCount];
+    uint16_t queue[StateCount];
+    int8_t restY[StateCount]; // Memoized landing row per state, -1 until computed
+    std::vector<TetrixPlacement> results;
+    std::vector<TetrixInput> paths;
+};
+
+#endif // TETRIXPLACEMENTS_H
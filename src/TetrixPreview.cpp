@@ -0,0 +1,112 @@
+#include "TetrixPreview.h"
+#include "TetrixTrace.h"
+#include <QPaintEvent>
+#include <QPainter>
+#include <QtMath>
+#include <algorithm>
+
+namespace {
+
+const QColor shapeColors[] = { Qt::black, Qt::red, Qt::green, Qt::blue, Qt::cyan, Qt::magenta, Qt::yellow, Qt::gray };
+
+} // namespace
+
+TetrixPreview::TetrixPreview(QWidget *parent) : QWidget(parent), count(1), squareSize(15) {
+    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+    setFixedSize(sizeHint());
+}
+
+void TetrixPreview::setPieceCount(int pieceCount) {
+    pieceCount = qBound(1, pieceCount, int(MaxPieces));
+    if (pieceCount == count) {
+        return;
+    }
+    count = pieceCount;
+    setFixedSize(sizeHint());
+    update();
+}
+
+void TetrixPreview::setSquareSize(int size) {
+    if (size == squareSize) {
+        return;
+    }
+    squareSize = size;
+    setFixedSize(sizeHint());
+    update();
+}
+
+void TetrixPreview::showPieces(const TetrixEngine &engine) {
+    bool changed = false;
+    for (int i = 0; i < count; ++i) {
+        const TetrixPiece &piece = engine.upcomingPiece(i);
+        if (pieces[i] != piece) {
+            pieces[i] = piece;
+            changed = true;
+        }
+    }
+    if (changed) {
+        update();
+    }
+}
+
+void TetrixPreview::clear() {
+    std::fill(pieces, pieces + MaxPieces, TetrixPiece());
+    update();
+}
+
+QSize TetrixPreview::sizeHint() const {
+    return QSize(SlotColumns * squareSize, SlotRows * (squareSize + (count - 1) * smallSquareSize()));
+}
+
+QRect TetrixPreview::slotRect(int index) const {
+    if (index == 0) {
+        return QRect(0, 0, width(), SlotRows * squareSize);
+    }
+    int slotHeight = SlotRows * smallSquareSize();
+    return QRect(0, SlotRows * squareSize + (index - 1) * slotHeight, width(), slotHeight);
+}
+
+void TetrixPreview::paintEvent(QPaintEvent *event) {
+    TETRIX_TRACE_SCOPE_DEBUG(TetrixTraceId::NextPiece, width(), height(), squareSize);
+    QPainter painter(this);
+    qreal pixelRatio = devicePixelRatioF();
+    for (int i = 0; i < count; ++i) {
+        int shape = static_cast<int>(pieces[i].shape());
+        QRect slot = slotRect(i);
+        if (shape == 0 || !event->rect().intersects(slot)) {
+            continue;
+        }
+        SpriteSet &set = i == 0 ? large : small;
+        ensureSprites(set, i == 0 ? squareSize : smallSquareSize(), pixelRatio);
+        const QPixmap &sprite = set.sprites[shape];
+        QSizeF size = sprite.deviceIndependentSize();
+        painter.drawPixmap(QPointF(slot.left() + (slot.width() - size.width()) / 2, slot.top() + (slot.height() - size.height()) / 2), sprite);
+    }
+}
+
+void TetrixPreview::ensureSprites(SpriteSet &set, int squareSize, qreal pixelRatio) {
+    if (set.squareSize == squareSize && set.pixelRatio == pixelRatio) {
+        return;
+    }
+    for (int shape = 1; shape < ShapeCount; ++shape) {
+        TetrixPiece piece(static_cast<TetrixShape>(shape), 0);
+        int columns = piece.maxX() - piece.minX() + 1;
+        int rows = piece.maxY() - piece.minY() + 1;
+        QPixmap sprite(qCeil(columns * squareSize * pixelRatio), qCeil(rows * squareSize * pixelRatio));
+        sprite.setDevicePixelRatio(pixelRatio);
+        sprite.fill(Qt::transparent);
+        QPainter painter(&sprite);
+        painter.setPen(QPen(Qt::black, 1));
+        for (int i = 0; i < 4; ++i) {
+            // Same cell look as the board's tile atlas
+            int x = (piece.x(i) - piece.minX()) * squareSize;
+            int y = (piece.maxY() - piece.y(i)) * squareSize;
+            painter.fillRect(x + 1, y + 1, squareSize - 2, squareSize - 2, shapeColors[shape]);
+            painter.drawRect(x, y, squareSize - 1, squareSize - 1);
+        }
+        painter.end();
+        set.sprites[shape] = sprite;
+    }
+    set.squareSize = squareSize;
+    set.pixelRatio = pixelRatio;
+}
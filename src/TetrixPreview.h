@@ -0,0 +1,55 @@
+#ifndef TETRIXPREVIEW_H
+#define TETRIXPREVIEW_H
+
+#include <QPixmap>
+#include <QWidget>
+#include "TetrixEngine.h"
+
+// Upcoming pieces from the engine's queue, stacked top to bottom: the next one at full square size,
+// the rest at half. The geometry depends only on the piece count and square size, so a spawn only
+// repaints, blitting one cached sprite per piece.
+class TetrixPreview : public QWidget {
+    Q_OBJECT
+
+public:
+    enum { MaxPieces = TetrixEngine::PreviewCapacity };
+    enum { SlotColumns = 4, SlotRows = 4 }; // Any piece fits in any rotation
+
+    explicit TetrixPreview(QWidget *parent = nullptr);
+
+    // Both relayout the panel, so call them on setup and resize only
+    void setPieceCount(int count); // Clamped to 1..MaxPieces
+    int pieceCount() const { return count; }
+    void setSquareSize(int squareSize);
+
+    // Copies the queue's head; repaints only if it changed
+    void showPieces(const TetrixEngine &engine);
+    void clear();
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    enum { ShapeCount = 8 }; // TetrixShape values; NoShape is never drawn
+
+    // One sprite per shape in its spawn rotation, rows counting up as on the board
+    struct SpriteSet {
+        QPixmap sprites[ShapeCount];
+        int squareSize = 0;
+        qreal pixelRatio = 0;
+    };
+
+    int smallSquareSize() const { return qMax(1, squareSize / 2); }
+    QRect slotRect(int index) const;
+    static void ensureSprites(SpriteSet &set, int squareSize, qreal pixelRatio);
+
+    int count;
+    int squareSize;
+    TetrixPiece pieces[MaxPieces];
+    SpriteSet large; // The next piece
+    SpriteSet small; // The ones after it
+};
+
+#endif // TETRIXPREVIEW_H
@@ -0,0 +1,104 @@
+#include "TetrixRandom.h"
+
+namespace {
+
+inline uint32_t rotl(uint32_t value, int shift) {
+    return (value << shift) | (value >> (32 - shift));
+}
+
+uint64_t splitMix64(uint64_t &x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+} // namespace
+
+void TetrixRandomizer::seed(uint64_t seed, Mode mode) {
+    initialSeed = seed;
+    randomMode = mode;
+    uint64_t x = seed;
+    uint64_t a = splitMix64(x);
+    uint64_t b = splitMix64(x);
+    state[0] = static_cast<uint32_t>(a);
+    state[1] = static_cast<uint32_t>(a >> 32);
+    state[2] = static_cast<uint32_t>(b);
+    state[3] = static_cast<uint32_t>(b >> 32);
+    bagIndex = 7; // Empty; the first draw fills it
+    for (int i = 0; i < 7; ++i) {
+        bag[i] = static_cast<TetrixShape>(i + 1); // Unused until then, but saved states must be deterministic
+    }
+}
+
+uint32_t TetrixRandomizer::nextUInt() {
+    // xoshiro128**
+    uint32_t result = rotl(state[1] * 5, 7) * 9;
+    uint32_t t = state[1] << 9;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl(state[3], 11);
+    return result;
+}
+
+void TetrixRandomizer::refillBag() {
+    for (int i = 0; i < 7; ++i) {
+        bag[i] = static_cast<TetrixShape>(i + 1);
+    }
+    // Fisher-Yates
+    for (int i = 6; i > 0; --i) {
+        int j = static_cast<int>(nextBelow(i + 1));
+        TetrixShape swap = bag[i];
+        bag[i] = bag[j];
+        bag[j] = swap;
+    }
+    bagIndex = 0;
+}
+
+TetrixShape TetrixRandomizer::next() {
+    if (randomMode == Mode::Uniform) {
+        return static_cast<TetrixShape>(1 + nextBelow(7));
+    }
+    if (bagIndex >= 7) {
+        refillBag();
+    }
+    return bag[bagIndex++];
+}
+
+TetrixRandomizerState TetrixRandomizer::saveState() const {
+    TetrixRandomizerState saved{};
+    saved.seed = initialSeed;
+    for (int i = 0; i < 4; ++i) {
+        saved.words[i] = state[i];
+    }
+    saved.mode = static_cast<uint8_t>(randomMode);
+    saved.bagIndex = bagIndex;
+    for (int i = 0; i < 7; ++i) {
+        saved.bag[i] = static_cast<uint8_t>(bag[i]);
+    }
+    return saved;
+}
+
+bool TetrixRandomizer::restoreState(const TetrixRandomizerState &saved) {
+    if (saved.mode > static_cast<uint8_t>(Mode::SevenBag) || saved.bagIndex > 7) {
+        return false;
+    }
+    for (int i = saved.bagIndex; i < 7 && saved.mode == static_cast<uint8_t>(Mode::SevenBag); ++i) {
+        if (saved.bag[i] < 1 || saved.bag[i] > 7) {
+            return false;
+        }
+    }
+    initialSeed = saved.seed;
+    for (int i = 0; i < 4; ++i) {
+        state[i] = saved.words[i];
+    }
+    randomMode = static_cast<Mode>(saved.mode);
+    bagIndex = saved.bagIndex;
+    for (int i = 0; i < 7; ++i) {
+        bag[i] = static_cast<TetrixShape>(saved.bag[i]);
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef TETRIXRANDOM_H
+#define TETRIXRANDOM_H
+
+#include <cstdint>
+#include "TetrixPiece.h"
+
+// Fixed-layout copy of a randomizer's stream position, for keyframes and save files
+struct TetrixRandomizerState {
+    uint64_t seed;
+    uint32_t words[4];
+    uint8_t mode;
+    uint8_t bagIndex;
+    uint8_t bag[7];
+    uint8_t reserved[7];
+};
+
+static_assert(sizeof(TetrixRandomizerState) == 40, "TetrixRandomizerState is a fixed on-disk layout");
+
+// Per-game piece randomizer: xoshiro128** seeded through splitmix64, either uniform over the
+// seven shapes or dealing shuffled bags of all seven. Plain data, so copying it snapshots the stream.
+class TetrixRandomizer {
+public:
+    enum class Mode : uint8_t { Uniform, SevenBag };
+
+    TetrixRandomizer() { seed(0); }
+
+    void seed(uint64_t seed, Mode mode = Mode::Uniform);
+    uint64_t seedValue() const { return initialSeed; }
+    Mode mode() const { return randomMode; }
+    TetrixShape next();
+
+    TetrixRandomizerState saveState() const;
+    // False (and unchanged) if the state is not one a randomizer could have saved
+    bool restoreState(const TetrixRandomizerState &saved);
+
+private:
+    uint32_t nextUInt();
+    // Uniform in [0, bound) by multiply-shift; the bias for bounds this small is negligible
+    uint32_t nextBelow(uint32_t bound) { return static_cast<uint32_t>((uint64_t(nextUInt()) * bound) >> 32); }
+    void refillBag();
+
+    uint32_t state[4];
+    uint64_t initialSeed;
+    Mode randomMode;
+    uint8_t bagIndex;
+    TetrixShape bag[7];
+};
+
+#endif // TETRIXRANDOM_H
@@ -0,0 +1,258 @@
+#include "TetrixReplay.h"
+#include <cstring>
+
+namespace {
+
+const char Magic[4] = { 'T', 'X', 'R', 'P' };
+
+void putVarint(std::vector<uint8_t> &bytes, uint64_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+} // namespace
+
+void TetrixReplayRecorder::begin(uint64_t seed, TetrixRandomizer::Mode mode, int lineClearDelayMs) {
+    bytes.assign(Magic, Magic + 4);
+    bytes.push_back(TetrixReplay::Version);
+    bytes.push_back(static_cast<uint8_t>(mode));
+    putVarint(bytes, seed);
+    putVarint(bytes, static_cast<uint64_t>(lineClearDelayMs));
+    lastTimeMs = 0;
+    pendingTicks = 0;
+    pendingTickTimeMs = 0;
+    finished = false;
+}
+
+bool TetrixReplayRecorder::resume(const uint8_t *data, size_t size, const Progress &progress) {
+    // Only a recording in the current version can be continued in it
+    TetrixReplayReader reader;
+    if (!reader.open(data, size) || data[4] != TetrixReplay::Version) {
+        return false;
+    }
+    bytes.assign(data, data + size);
+    lastTimeMs = progress.lastTimeMs;
+    pendingTicks = progress.pendingTicks;
+    pendingTickTimeMs = progress.pendingTickTimeMs;
+    finished = false;
+    return true;
+}
+
+void TetrixReplayRecorder::putEvent(TetrixReplay::EventType type, uint32_t timeMs) {
+    // Clocks are monotonic, but never let a delta go negative
+    uint32_t delta = timeMs >= lastTimeMs ? timeMs - lastTimeMs : 0;
+    lastTimeMs += delta;
+    putVarint(bytes, (uint64_t(delta) << 3) | static_cast<uint8_t>(type));
+}
+
+void TetrixReplayRecorder::flushTicks() {
+    if (pendingTicks == 0) {
+        return;
+    }
+    putEvent(TetrixReplay::EventType::Tick, pendingTickTimeMs);
+    putVarint(bytes, pendingTicks);
+    pendingTicks = 0;
+}
+
+void TetrixReplayRecorder::recordInput(TetrixInput input, uint32_t timeMs) {
+    if (finished) {
+        return;
+    }
+    flushTicks();
+    putEvent(TetrixReplay::eventFor(input), timeMs);
+}
+
+void TetrixReplayRecorder::recordTick(uint32_t timeMs) {
+    if (finished) {
+        return;
+    }
+    // Back-to-back ticks share one event; only the first one's time is kept
+    if (pendingTicks++ == 0) {
+        pendingTickTimeMs = timeMs;
+    }
+}
+
+const std::vector<uint8_t> &TetrixReplayRecorder::finish(const TetrixEngine &engine, uint32_t timeMs) {
+    if (finished) {
+        return bytes;
+    }
+    flushTicks();
+    putEvent(TetrixReplay::EventType::End, timeMs);
+    putVarint(bytes, static_cast<uint64_t>(engine.score()));
+    putVarint(bytes, static_cast<uint64_t>(engine.linesRemoved()));
+    putVarint(bytes, static_cast<uint64_t>(engine.piecesDropped()));
+    putVarint(bytes, lastTimeMs);
+    uint64_t checksum = engine.grid().checksum();
+    for (int i = 0; i < 8; ++i) {
+        bytes.push_back(static_cast<uint8_t>(checksum >> (8 * i)));
+    }
+    finished = true;
+    return bytes;
+}
+
+bool TetrixReplayReader::readVarint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && cursor < end; shift += 7) {
+        uint8_t byte = *cursor++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    valid = false;
+    return false;
+}
+
+bool TetrixReplayReader::open(const uint8_t *data, size_t size) {
+    begin = cursor = data;
+    end = data + size;
+    timeMs = 0;
+    atEnd = false;
+    info = TetrixReplay::Summary();
+    valid = size >= 6 && std::memcmp(data, Magic, 4) == 0 && data[4] >= 1 && data[4] <= TetrixReplay::Version && data[5] <= 1;
+    if (!valid) {
+        return false;
+    }
+    info.mode = static_cast<TetrixRandomizer::Mode>(data[5]);
+    cursor += 6;
+    if (!readVarint(info.seed)) {
+        return false;
+    }
+    if (data[4] >= 2) {
+        uint64_t delay;
+        if (!readVarint(delay) || delay > TetrixEngine::MaxLineClearDelayMs) {
+            valid = false;
+            return false;
+        }
+        info.lineClearDelayMs = static_cast<int>(delay);
+    }
+    return true;
+}
+
+bool TetrixReplayReader::readFooter() {
+    uint64_t score, lines, pieces, duration;
+    if (!readVarint(score) || !readVarint(lines) || !readVarint(pieces) || !readVarint(duration) || end - cursor < 8) {
+        valid = false;
+        return false;
+    }
+    info.score = static_cast<int>(score);
+    info.lines = static_cast<int>(lines);
+    info.pieces = static_cast<int>(pieces);
+    info.durationMs = static_cast<uint32_t>(duration);
+    info.boardChecksum = 0;
+    for (int i = 0; i < 8; ++i) {
+        info.boardChecksum |= uint64_t(*cursor++) << (8 * i);
+    }
+    return true;
+}
+
+bool TetrixReplayReader::next(TetrixReplay::Event &event) {
+    if (!valid || atEnd) {
+        return false;
+    }
+    uint64_t packed;
+    if (!readVarint(packed)) {
+        return false;
+    }
+    timeMs += static_cast<uint32_t>(packed >> 3);
+    event.type = static_cast<TetrixReplay::EventType>(packed & 7);
+    event.timeMs = timeMs;
+    event.count = 1;
+    switch (event.type) {
+    case TetrixReplay::EventType::Left:
+    case TetrixReplay::EventType::Right:
+    case TetrixReplay::EventType::RotateRight:
+    case TetrixReplay::EventType::SoftDrop:
+    case TetrixReplay::EventType::HardDrop:
+        return true;
+    case TetrixReplay::EventType::Tick: {
+        uint64_t count;
+        if (!readVarint(count) || count == 0) {
+            valid = false;
+            return false;
+        }
+        event.count = static_cast<uint32_t>(count);
+        return true;
+    }
+    case TetrixReplay::EventType::End:
+        atEnd = true;
+        readFooter();
+        return false;
+    }
+    valid = false;
+    return false;
+}
+
+bool TetrixReplayReader::seek(size_t position, uint32_t eventTimeMs) {
+    if (!begin || position < 6 || position > static_cast<size_t>(end - begin)) {
+        valid = false;
+        return false;
+    }
+    cursor = begin + position;
+    timeMs = eventTimeMs;
+    atEnd = false;
+    valid = true;
+    return true;
+}
+
+namespace TetrixReplay {
+
+unsigned start(TetrixEngine &engine, const Summary &summary) {
+    engine.setLineClearDelay(summary.lineClearDelayMs);
+    return engine.start(summary.seed, summary.mode);
+}
+
+unsigned apply(TetrixEngine &engine, const Event &event) {
+    if (event.type != EventType::Tick) {
+        return engine.input(inputFor(event.type));
+    }
+    unsigned events = TetrixEngine::NoEvent;
+    for (uint32_t i = 0; i < event.count; ++i) {
+        events |= engine.tick();
+    }
+    return events;
+}
+
+VerifyResult verify(const uint8_t *data, size_t size, Summary *summary) {
+    TetrixReplayReader reader;
+    if (!reader.open(data, size)) {
+        return VerifyResult::Malformed;
+    }
+
+    TetrixEngine engine(reader.summary().seed);
+    start(engine, reader.summary());
+    Event event;
+    while (reader.next(event)) {
+        apply(engine, event);
+    }
+    if (!reader.isValid()) {
+        return VerifyResult::Malformed;
+    }
+
+    const Summary &recorded = reader.summary();
+    if (summary) {
+        *summary = recorded;
+    }
+    if (engine.score() != recorded.score || engine.linesRemoved() != recorded.lines || engine.piecesDropped() != recorded.pieces) {
+        return VerifyResult::ScoreMismatch;
+    }
+    if (engine.grid().checksum() != recorded.boardChecksum) {
+        return VerifyResult::BoardMismatch;
+    }
+    return VerifyResult::Ok;
+}
+
+const char *resultName(VerifyResult result) {
+    switch (result) {
+    case VerifyResult::Ok: return "ok";
+    case VerifyResult::Malformed: return "malformed";
+    case VerifyResult::ScoreMismatch: return "score mismatch";
+    case VerifyResult::BoardMismatch: return "board mismatch";
+    }
+    return "unknown";
+}
+
+} // namespace TetrixReplay
@@ -0,0 +1,117 @@
+#ifndef TETRIXREPLAY_H
+#define TETRIXREPLAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "TetrixEngine.h"
+
+// Compact game recording: the seed plus every input and gravity tick with its time since the start.
+// Layout (integers are LEB128 varints):
+//   "TXRP", version byte, randomizer mode byte, seed, line clear delay in ms (version 2 on)
+//   events: (deltaMs << 3) | type; a Tick event is followed by the number of back-to-back ticks
+//   End event, then the footer: score, lines, pieces, duration in ms, board checksum (8 bytes, little endian)
+// Inputs and tick runs mostly take one or two bytes, so a game costs a few bytes per piece.
+namespace TetrixReplay {
+
+enum { Version = 2 }; // Version 1 replays play with the default line clear delay
+
+enum class EventType : uint8_t { Left, Right, RotateRight, SoftDrop, HardDrop, Tick, End = 7 };
+
+struct Event {
+    EventType type;
+    uint32_t timeMs;
+    uint32_t count; // Ticks in the run for Tick events, 1 otherwise
+};
+
+struct Summary {
+    uint64_t seed = 0;
+    TetrixRandomizer::Mode mode = TetrixRandomizer::Mode::Uniform;
+    int lineClearDelayMs = TetrixEngine::LegacyLineClearDelayMs;
+    int score = 0;
+    int lines = 0;
+    int pieces = 0;
+    uint32_t durationMs = 0;
+    uint64_t boardChecksum = 0;
+};
+
+enum class VerifyResult { Ok, Malformed, ScoreMismatch, BoardMismatch };
+
+inline EventType eventFor(TetrixInput input) { return static_cast<EventType>(input); }
+inline TetrixInput inputFor(EventType type) { return static_cast<TetrixInput>(type); }
+
+// Starts a game with the replay's seed, randomizer mode and line clear delay
+unsigned start(TetrixEngine &engine, const Summary &summary);
+
+// Feeds one event (a single input, or a whole tick run) to the engine
+unsigned apply(TetrixEngine &engine, const Event &event);
+
+// Re-simulates the replay headlessly and checks the recorded score, lines, pieces and board
+VerifyResult verify(const uint8_t *data, size_t size, Summary *summary = nullptr);
+const char *resultName(VerifyResult result);
+
+} // namespace TetrixReplay
+
+class TetrixReplayRecorder {
+public:
+    TetrixReplayRecorder() : lastTimeMs(0), pendingTicks(0), pendingTickTimeMs(0), finished(false) {}
+
+    void begin(uint64_t seed, TetrixRandomizer::Mode mode, int lineClearDelayMs);
+    void recordInput(TetrixInput input, uint32_t timeMs);
+    void recordTick(uint32_t timeMs);
+    // Closes the event stream and appends the footer taken from the engine's final state
+    const std::vector<uint8_t> &finish(const TetrixEngine &engine, uint32_t timeMs);
+    const std::vector<uint8_t> &data() const { return bytes; }
+    bool isFinished() const { return finished; }
+
+    // Where an unfinished recording stands, so a suspended game can continue it (TetrixSaveGame)
+    struct Progress {
+        uint32_t lastTimeMs;
+        uint32_t pendingTicks;
+        uint32_t pendingTickTimeMs;
+    };
+    Progress progress() const { return { lastTimeMs, pendingTicks, pendingTickTimeMs }; }
+    // Continues the recording data() and progress() described; false (recorder untouched) unless data
+    // starts with a replay header
+    bool resume(const uint8_t *data, size_t size, const Progress &progress);
+
+private:
+    void flushTicks();
+    void putEvent(TetrixReplay::EventType type, uint32_t timeMs);
+
+    std::vector<uint8_t> bytes;
+    uint32_t lastTimeMs;
+    uint32_t pendingTicks; // Tick run not yet written
+    uint32_t pendingTickTimeMs;
+    bool finished;
+};
+
+class TetrixReplayReader {
+public:
+    // Parses the header; false if it is not a replay of a supported version
+    bool open(const uint8_t *data, size_t size);
+    // Next event, or false at the End event or on malformed data (see isValid())
+    bool next(TetrixReplay::Event &event);
+    // Continues from a position() and event time saved earlier on the same replay (keyframes)
+    bool seek(size_t position, uint32_t eventTimeMs);
+    uint32_t eventTime() const { return timeMs; }
+    bool isValid() const { return valid; }
+    // Filled in once next() has returned false on a well-formed replay
+    const TetrixReplay::Summary &summary() const { return info; }
+    // Bytes consumed so far; after the footer this is the replay's total size
+    size_t position() const { return static_cast<size_t>(cursor - begin); }
+
+private:
+    bool readVarint(uint64_t &value);
+    bool readFooter();
+
+    const uint8_t *begin = nullptr;
+    const uint8_t *cursor = nullptr;
+    const uint8_t *end = nullptr;
+    uint32_t timeMs = 0;
+    bool valid = false;
+    bool atEnd = false;
+    TetrixReplay::Summary info;
+};
+
+#endif // TETRIXREPLAY_H
@@ -0,0 +1,104 @@
+#include "TetrixRewind.h"
+
+namespace {
+
+// Record bits: rotation 0-1, x + CoordinateBias 2-5, y + CoordinateBias 6-10, drop height 11-15 and the
+// cleared rows 16-19, bit i for board row y - maxY() + i, the piece's lowest (a lock can only complete rows
+// it touches, and the piece fills rows y - maxY() to y - minY())
+enum { CoordinateBias = 2 };
+
+const uint32_t NoRecord = ~0u; // A lock the bits cannot hold; never stored
+
+uint32_t packLock(const TetrixEngine &engine) {
+    const TetrixPiece &piece = engine.lockedPiece();
+    int x = engine.lockedX() + CoordinateBias;
+    int y = engine.lockedY() + CoordinateBias;
+    int dropHeight = engine.lockedDropHeight();
+    if (x < 0 || x > 15 || y < 0 || y > 31 || dropHeight < 0 || dropHeight > 31) {
+        return NoRecord;
+    }
+    uint32_t cleared = 0;
+    for (int i = 0; i < engine.clearedLineCount(); ++i) {
+        int row = engine.clearedLine(i) - (engine.lockedY() - piece.maxY());
+        if (row < 0 || row >= TetrixGrid::MaxLinesPerLock) {
+            return NoRecord;
+        }
+        cleared |= 1u << row;
+    }
+    return uint32_t(piece.rotation()) | uint32_t(x) << 2 | uint32_t(y) << 6 | uint32_t(dropHeight) << 11 | cleared << 16;
+}
+
+} // namespace
+
+TetrixRewind::TetrixRewind()
+    : records(Capacity), snapshots(SnapshotSlots), started(false), basePosition(0), firstPosition(0), lastPosition(0)
+{
+}
+
+void TetrixRewind::begin(const TetrixEngine &engine) {
+    started = true;
+    basePosition = firstPosition = lastPosition = engine.piecesDropped();
+    engine.saveState(snapshots[0]);
+}
+
+void TetrixRewind::recordLock(const TetrixEngine &engine) {
+    uint32_t record = packLock(engine);
+    if (!started || engine.piecesDropped() != lastPosition + 1 || record == NoRecord) {
+        begin(engine);
+        return;
+    }
+    if (lastPosition - firstPosition == Capacity) {
+        firstPosition += SnapshotInterval; // The oldest snapshot and the locks after it
+    }
+    records[(lastPosition - basePosition) % Capacity] = record;
+    ++lastPosition;
+    int index = lastPosition - basePosition;
+    if (index % SnapshotInterval == 0) {
+        // Taken at the lock; a piece held back by the line-clear delay spawns when seek() gets here
+        engine.saveState(snapshots[(index / SnapshotInterval) % SnapshotSlots]);
+    }
+}
+
+void TetrixRewind::truncate(int position) {
+    if (started && position >= firstPosition && position < lastPosition) {
+        lastPosition = position;
+    }
+}
+
+bool TetrixRewind::seek(int position, TetrixEngine &engine) const {
+    if (!started || position < firstPosition || position > lastPosition) {
+        return false;
+    }
+    int index = position - basePosition;
+    int block = index / SnapshotInterval;
+    if (!engine.restoreState(snapshots[block % SnapshotSlots])) {
+        return false;
+    }
+    if (engine.isWaitingAfterLine()) {
+        engine.tick();
+    }
+    for (int i = block * SnapshotInterval; i < index; ++i) {
+        if (!relock(records[i % Capacity], engine)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TetrixRewind::relock(uint32_t record, TetrixEngine &engine) {
+    int rotation = record & 3;
+    int x = int(record >> 2 & 15) - CoordinateBias;
+    int y = int(record >> 6 & 31) - CoordinateBias;
+    int dropHeight = record >> 11 & 31;
+    if (!(engine.lockPiece(rotation, x, y, dropHeight) & TetrixEngine::PieceLocked)) {
+        return false;
+    }
+    // The same rows have to go, or this is not the game the history was recorded from
+    if (packLock(engine) != record) {
+        return false;
+    }
+    if (engine.isWaitingAfterLine()) {
+        engine.tick();
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef TETRIXREWIND_H
+#define TETRIXREWIND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "TetrixEngine.h"
+
+// Practice-mode history of one game: the last Capacity locks, to step back through and play on from any
+// of them. A position is a piece count, the board after that many locks with the next piece just spawned.
+// Each lock is one 4-byte record of what pieceDropped() wrote: the piece's rotation and place (its cells),
+// the rows it cleared, relative to the piece, and its drop height, which with the lines makes up the score
+// change. Every SnapshotInterval positions a full TetrixEngineState is kept, and a position is rebuilt from
+// the snapshot before it by relocking at most SnapshotInterval - 1 records, a few microseconds. Storage
+// (about 27 KB) is allocated once by the constructor; recording and seeking never allocate.
+// Single-player only: versus garbage is not recorded.
+class TetrixRewind {
+public:
+    enum { Capacity = 4096, SnapshotInterval = 128 };
+
+    TetrixRewind();
+
+    // Forgets the history and starts it at the engine's position (a game just started or resumed)
+    void begin(const TetrixEngine &engine);
+    // Records the engine's latest lock; TetrixGameLoop calls it after every input or tick that locked a piece.
+    // A lock out of step with the history (not fed every lock), or one a record cannot hold, starts it over.
+    void recordLock(const TetrixEngine &engine);
+    // Forgets the positions after position, to play on from it
+    void truncate(int position);
+
+    bool isEmpty() const { return !started; }
+    // Positions held; once Capacity locks are held, the oldest SnapshotInterval go at once
+    int first() const { return firstPosition; }
+    int last() const { return lastPosition; }
+    // Puts engine at position; false when it is not held, or a lock would not replay on the engine
+    bool seek(int position, TetrixEngine &engine) const;
+    size_t memoryBytes() const { return records.size() * sizeof(uint32_t) + snapshots.size() * sizeof(TetrixEngineState); }
+
+private:
+    enum { SnapshotSlots = Capacity / SnapshotInterval + 1 };
+
+    static bool relock(uint32_t record, TetrixEngine &engine);
+
+    std::vector<uint32_t> records; // Lock of position i (to i + 1) at (i - basePosition) % Capacity
+    std::vector<TetrixEngineState> snapshots; // Every SnapshotInterval positions from basePosition, a ring
+    bool started;
+    int basePosition; // Where begin() started, a snapshot
+    int firstPosition;
+    int lastPosition;
+};
+
+#endif // TETRIXREWIND_H
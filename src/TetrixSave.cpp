@@ -0,0 +1,194 @@
+#include "TetrixSave.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char SaveMagic[4] = { 'T', 'X', 'S', 'V' };
+
+uint64_t fnv1a(const void *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+int64_t fileSize(FILE *file) {
+#ifdef _WIN32
+    if (_fseeki64(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    return _ftelli64(file);
+#else
+    if (fseeko(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    return static_cast<int64_t>(ftello(file));
+#endif
+}
+
+// Down to the device, not just the OS cache
+bool syncFile(FILE *file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+const size_t ChecksummedOffset = offsetof(TetrixSaveHeader, savedAtMs);
+
+} // namespace
+
+TetrixSaveGame::TetrixSaveGame() {
+    std::memset(&saved, 0, sizeof(saved));
+}
+
+void TetrixSaveGame::capture(const TetrixEngine &engine, const TetrixGameLoop &loop, const TetrixReplayRecorder *recorder,
+                             uint32_t flags) {
+    captureCommon(engine, recorder, flags);
+    TetrixGameLoopState state;
+    loop.saveState(state);
+    saved.simNs = state.simNs;
+    saved.gravityNs = state.gravityNs;
+    saved.checksum = checksum();
+}
+
+void TetrixSaveGame::capture(const TetrixEngine &engine, uint32_t timeMs, const TetrixReplayRecorder *recorder, uint32_t flags) {
+    captureCommon(engine, recorder, flags);
+    saved.simNs = int64_t(timeMs) * 1000000;
+    saved.checksum = checksum();
+}
+
+void TetrixSaveGame::captureCommon(const TetrixEngine &engine, const TetrixReplayRecorder *recorder, uint32_t flags) {
+    std::memset(&saved, 0, sizeof(saved));
+    std::memcpy(saved.magic, SaveMagic, sizeof(saved.magic));
+    saved.version = TetrixSaveFormat::Version;
+    saved.headerSize = sizeof(TetrixSaveHeader);
+    saved.flags = flags;
+    saved.savedAtMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    engine.saveState(saved.engine);
+    for (int i = 0; i < engine.clearedLineCount(); ++i) {
+        std::memcpy(saved.clearedCells + i * TetrixGrid::Width, engine.clearedRow(i), TetrixGrid::Width * sizeof(TetrixShape));
+    }
+    replay.clear();
+    if (recorder && !recorder->isFinished() && !recorder->data().empty()) {
+        replay = recorder->data();
+        TetrixReplayRecorder::Progress progress = recorder->progress();
+        saved.replaySize = static_cast<uint32_t>(replay.size());
+        saved.replayLastTimeMs = progress.lastTimeMs;
+        saved.replayPendingTicks = progress.pendingTicks;
+        saved.replayPendingTickTimeMs = progress.pendingTickTimeMs;
+    }
+}
+
+uint64_t TetrixSaveGame::checksumOf(const uint8_t *data, size_t size) {
+    return fnv1a(data + ChecksummedOffset, size - ChecksummedOffset);
+}
+
+uint64_t TetrixSaveGame::checksum() const {
+    const uint8_t *header = reinterpret_cast<const uint8_t *>(&saved);
+    uint64_t hash = fnv1a(header + ChecksummedOffset, sizeof(saved) - ChecksummedOffset);
+    return fnv1a(replay.data(), replay.size(), hash);
+}
+
+bool TetrixSaveGame::write(const std::string &path) const {
+    // Never leave a half-written save under the real name
+    std::string temporary = path + ".tmp";
+    FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(&saved, sizeof(saved), 1, file) == 1
+        && (replay.empty() || std::fwrite(replay.data(), 1, replay.size(), file) == replay.size()) && syncFile(file);
+    ok = std::fclose(file) == 0 && ok;
+#ifdef _WIN32
+    if (ok) {
+        std::remove(path.c_str());
+    }
+#endif
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+TetrixSaveGame::Status TetrixSaveGame::read(const std::string &path) {
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return Status::Missing;
+    }
+    int64_t size = fileSize(file);
+    std::vector<uint8_t> bytes(size > 0 ? static_cast<size_t>(size) : 0);
+    bool ok = size > 0 && std::fseek(file, 0, SEEK_SET) == 0 && std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    std::fclose(file);
+    return ok ? parse(bytes.data(), bytes.size()) : Status::Corrupt;
+}
+
+TetrixSaveGame::Status TetrixSaveGame::parse(const uint8_t *data, size_t size) {
+    // Magic, version and header size come first in every version
+    if (size < offsetof(TetrixSaveHeader, checksum) || std::memcmp(data, SaveMagic, sizeof(SaveMagic)) != 0) {
+        return Status::Corrupt;
+    }
+    uint16_t version;
+    uint16_t headerSize;
+    std::memcpy(&version, data + offsetof(TetrixSaveHeader, version), sizeof(version));
+    std::memcpy(&headerSize, data + offsetof(TetrixSaveHeader, headerSize), sizeof(headerSize));
+    bool isVersion1 = version == 1 && headerSize == TetrixSaveFormat::Version1HeaderSize;
+    if (!isVersion1 && (version != TetrixSaveFormat::Version || headerSize != sizeof(TetrixSaveHeader))) {
+        return Status::Unsupported;
+    }
+    // Fields a version 1 header lacks stay zero
+    TetrixSaveHeader header;
+    std::memset(&header, 0, sizeof(header));
+    if (size < headerSize) {
+        return Status::Corrupt;
+    }
+    std::memcpy(&header, data, headerSize);
+    if (size != size_t(headerSize) + header.replaySize || header.simNs < 0 || header.gravityNs < 0) {
+        return Status::Corrupt;
+    }
+    if (checksumOf(data, size) != header.checksum) {
+        return Status::Corrupt;
+    }
+    saved = header;
+    replay.assign(data + headerSize, data + size);
+    if (isVersion1) {
+        // Written back, if at all, as the current version
+        saved.version = TetrixSaveFormat::Version;
+        saved.headerSize = sizeof(TetrixSaveHeader);
+        saved.checksum = checksum();
+    }
+    return Status::Loaded;
+}
+
+bool TetrixSaveGame::restoreEngine(TetrixEngine &engine) const {
+    return engine.restoreState(saved.engine, saved.clearedCells);
+}
+
+void TetrixSaveGame::restoreLoop(TetrixGameLoop &loop, int64_t nowNs) const {
+    TetrixGameLoopState state{};
+    state.simNs = saved.simNs;
+    state.gravityNs = saved.gravityNs;
+    state.shiftDirection = TetrixInput::Left;
+    loop.restoreState(state);
+    loop.resync(nowNs);
+}
+
+bool TetrixSaveGame::restoreReplay(TetrixReplayRecorder &recorder) const {
+    TetrixReplayRecorder::Progress progress = { saved.replayLastTimeMs, saved.replayPendingTicks, saved.replayPendingTickTimeMs };
+    return !replay.empty() && recorder.resume(replay.data(), replay.size(), progress);
+}
@@ -0,0 +1,96 @@
+#ifndef TETRIXSAVE_H
+#define TETRIXSAVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "TetrixEngine.h"
+#include "TetrixGameLoop.h"
+#include "TetrixReplay.h"
+
+// A suspended game: one fixed-layout header (little endian, 8-byte aligned) followed by the replay
+// recorded so far, so a resumed game still saves a replay that verifies. The header holds the full
+// engine state (board, pieces, counters, randomizer), the loop's clock and gravity, and the cells of
+// rows being flashed; it is read with the rest of the file in one read, or used in place from a mapping.
+// A file of another version or header size is refused rather than misread; version 1 (no flags) is a
+// prefix of version 2 and still loads.
+namespace TetrixSaveFormat {
+
+enum { Version = 2, Version1HeaderSize = 432 };
+
+} // namespace TetrixSaveFormat
+
+struct TetrixSaveHeader {
+    enum : uint32_t { Rewound = 1 }; // flags
+
+    char magic[4]; // "TXSV"
+    uint16_t version;
+    uint16_t headerSize; // sizeof(TetrixSaveHeader) of that version
+    uint64_t checksum; // FNV-1a of the file after this field
+    int64_t savedAtMs; // Wall clock, ms since the Unix epoch
+    TetrixEngineState engine;
+    int64_t simNs; // TetrixGameLoop clock; held keys are not saved
+    int64_t gravityNs;
+    uint32_t replaySize; // Bytes right after the header; 0 without a replay
+    uint32_t replayLastTimeMs; // TetrixReplayRecorder::Progress
+    uint32_t replayPendingTicks;
+    uint32_t replayPendingTickTimeMs;
+    TetrixShape clearedCells[TetrixGrid::MaxLinesPerLock * TetrixGrid::Width]; // TetrixEngine::clearedRow()
+    uint32_t flags; // Version 2 on
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TetrixSaveHeader) == 440, "TetrixSaveHeader is a fixed on-disk layout");
+static_assert(offsetof(TetrixSaveHeader, flags) == TetrixSaveFormat::Version1HeaderSize, "Version 1 is a prefix of version 2");
+
+class TetrixSaveGame {
+public:
+    enum class Status {
+        Loaded,
+        Missing, // No file
+        Unsupported, // Another version, never misread; the GUI keeps the file aside for a build that reads it
+        Corrupt // Torn or damaged
+    };
+
+    TetrixSaveGame();
+
+    // Snapshot of a game driven by a loop; recorder may be null (nothing to continue). flags are
+    // TetrixSaveHeader's, e.g. Rewound for a practice game that went back.
+    void capture(const TetrixEngine &engine, const TetrixGameLoop &loop, const TetrixReplayRecorder *recorder, uint32_t flags = 0);
+    // For drivers that keep their own millisecond clock (tetrix_cli)
+    void capture(const TetrixEngine &engine, uint32_t timeMs, const TetrixReplayRecorder *recorder, uint32_t flags = 0);
+
+    // Whole file at once: a temporary file, flushed to the device, then renamed over path. Touches nothing
+    // but this object and the file, so a copy can be written on another thread.
+    bool write(const std::string &path) const;
+    // One read of the whole file, then parse()
+    Status read(const std::string &path);
+    // Checks and takes a snapshot that is already in memory (a buffer or a mapping)
+    Status parse(const uint8_t *data, size_t size);
+    // What the checksum field of a whole file of size bytes (at least a header) has to hold
+    static uint64_t checksumOf(const uint8_t *data, size_t size);
+
+    // False (engine untouched) when the saved state is not one an engine could have reached
+    bool restoreEngine(TetrixEngine &engine) const;
+    // The loop carries on from the saved clock at nowNs, with no key held
+    void restoreLoop(TetrixGameLoop &loop, int64_t nowNs) const;
+    // False without a replay this version can continue
+    bool restoreReplay(TetrixReplayRecorder &recorder) const;
+
+    const TetrixSaveHeader &header() const { return saved; }
+    // Only a game recorded from its start and never rewound goes on the leaderboard; one saved without
+    // a replay cannot show it was not
+    bool isRanked() const { return !(saved.flags & TetrixSaveHeader::Rewound) && !replay.empty(); }
+    uint32_t timeMs() const { return static_cast<uint32_t>(saved.simNs / 1000000); }
+    size_t size() const { return sizeof(saved) + replay.size(); }
+
+private:
+    void captureCommon(const TetrixEngine &engine, const TetrixReplayRecorder *recorder, uint32_t flags);
+    uint64_t checksum() const;
+
+    TetrixSaveHeader saved;
+    std::vector<uint8_t> replay;
+};
+
+#endif // TETRIXSAVE_H
@@ -0,0 +1,323 @@
+#include "TetrixSocket.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+using Socket = SOCKET;
+using PollDescriptor = WSAPOLLFD;
+
+bool startNetworking() {
+    static const bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+}
+
+void closeSocket(Socket socket) { closesocket(socket); }
+bool wouldBlock() {
+    int error = WSAGetLastError();
+    return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+}
+bool setNonBlocking(Socket socket) {
+    u_long enabled = 1;
+    return ioctlsocket(socket, FIONBIO, &enabled) == 0;
+}
+int pollSockets(PollDescriptor *descriptors, unsigned count, int timeoutMs) { return WSAPoll(descriptors, count, timeoutMs); }
+#else
+using Socket = int;
+using PollDescriptor = pollfd;
+
+bool startNetworking() { return true; }
+void closeSocket(Socket socket) { ::close(socket); }
+bool wouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS; }
+bool setNonBlocking(Socket socket) {
+    int flags = fcntl(socket, F_GETFL, 0);
+    return flags != -1 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+int pollSockets(PollDescriptor *descriptors, unsigned count, int timeoutMs) { return poll(descriptors, count, timeoutMs); }
+#endif
+
+Socket native(intptr_t handle) { return static_cast<Socket>(handle); }
+
+#ifdef MSG_NOSIGNAL
+const int SendFlags = MSG_NOSIGNAL; // A closed peer fails the call instead of raising SIGPIPE
+#else
+const int SendFlags = 0;
+#endif
+
+void configure(Socket socket) {
+    int enabled = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&enabled), sizeof(enabled));
+#ifdef SO_NOSIGPIPE
+    setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#endif
+}
+
+bool waitFor(intptr_t handle, short events, int timeoutMs) {
+    if (handle == -1) {
+        return false;
+    }
+    PollDescriptor descriptor{};
+    descriptor.fd = native(handle);
+    descriptor.events = events;
+    return pollSockets(&descriptor, 1, timeoutMs) > 0;
+}
+
+} // namespace
+
+TetrixConnection::TetrixConnection()
+    : handle(-1), outgoingStart(0), outgoingReady(0), latencyNs(0), sentBytes(0), receivedBytes(0)
+{
+}
+
+TetrixConnection::~TetrixConnection() {
+    close();
+}
+
+bool TetrixConnection::connect(const std::string &host, uint16_t port, int timeoutMs) {
+    close();
+    if (!startNetworking()) {
+        return false;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+        return false;
+    }
+    for (addrinfo *address = addresses; address && handle == -1; address = address->ai_next) {
+        Socket socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (static_cast<intptr_t>(socket) == -1) {
+            continue;
+        }
+        // Non-blocking connect, so the wait is bounded by timeoutMs rather than the system's timeout
+        bool connected = setNonBlocking(socket)
+            && (::connect(socket, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0 || wouldBlock());
+        if (connected) {
+            PollDescriptor descriptor{};
+            descriptor.fd = socket;
+            descriptor.events = POLLOUT;
+            int error = 0;
+            socklen_t length = sizeof(error);
+            connected = pollSockets(&descriptor, 1, timeoutMs) > 0
+                && getsockopt(socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&error), &length) == 0 && error == 0;
+        }
+        if (connected) {
+            adopt(static_cast<intptr_t>(socket));
+        } else {
+            closeSocket(socket);
+        }
+    }
+    freeaddrinfo(addresses);
+    return handle != -1;
+}
+
+void TetrixConnection::adopt(intptr_t socket) {
+    close();
+    handle = socket;
+    configure(native(handle));
+    setNonBlocking(native(handle));
+}
+
+void TetrixConnection::close() {
+    if (handle != -1) {
+        closeSocket(native(handle));
+        handle = -1;
+    }
+    outgoing.clear();
+    outgoingStart = 0;
+    outgoingReady = 0;
+    releases.clear();
+}
+
+void TetrixConnection::send(const void *data, size_t size, int64_t nowNs) {
+    if (handle == -1 || size == 0) {
+        return;
+    }
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    outgoing.insert(outgoing.end(), bytes, bytes + size);
+    if (latencyNs > 0) {
+        releases.push_back({ nowNs + latencyNs, outgoing.size() });
+    } else if (releases.empty()) {
+        outgoingReady = outgoing.size();
+    } else {
+        // Latency turned off with data still held: keep the order
+        releases.push_back({ nowNs, outgoing.size() });
+    }
+}
+
+bool TetrixConnection::flush(int64_t nowNs) {
+    if (handle == -1) {
+        return false;
+    }
+    while (!releases.empty() && releases.front().dueNs <= nowNs) {
+        outgoingReady = releases.front().end;
+        releases.pop_front();
+    }
+    while (outgoingStart < outgoingReady) {
+        size_t chunk = std::min<size_t>(outgoingReady - outgoingStart, 1 << 20);
+        auto written = ::send(native(handle), reinterpret_cast<const char *>(outgoing.data() + outgoingStart), static_cast<int>(chunk), SendFlags);
+        if (written < 0) {
+            if (wouldBlock()) {
+                break;
+            }
+            close();
+            return false;
+        }
+        outgoingStart += static_cast<size_t>(written);
+        sentBytes += static_cast<uint64_t>(written);
+    }
+    // Drop what was written once it is most of the buffer, so the queue does not grow with the session
+    if (outgoingStart > 0 && outgoingStart * 2 >= outgoing.size()) {
+        outgoing.erase(outgoing.begin(), outgoing.begin() + static_cast<std::ptrdiff_t>(outgoingStart));
+        outgoingReady -= outgoingStart;
+        for (Release &release : releases) {
+            release.end -= outgoingStart;
+        }
+        outgoingStart = 0;
+    }
+    return true;
+}
+
+long TetrixConnection::write(const void *data, size_t size) {
+    if (handle == -1) {
+        return -1;
+    }
+    auto written = ::send(native(handle), static_cast<const char *>(data), static_cast<int>(std::min<size_t>(size, 1 << 20)), SendFlags);
+    if (written < 0) {
+        if (wouldBlock()) {
+            return 0;
+        }
+        close();
+        return -1;
+    }
+    sentBytes += static_cast<uint64_t>(written);
+    return static_cast<long>(written);
+}
+
+bool TetrixConnection::setBufferSizes(int sendBytes, int receiveBytes) {
+    if (handle == -1) {
+        return false;
+    }
+    bool ok = true;
+    if (sendBytes > 0) {
+        ok = setsockopt(native(handle), SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char *>(&sendBytes), sizeof(sendBytes)) == 0;
+    }
+    if (receiveBytes > 0) {
+        ok = setsockopt(native(handle), SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char *>(&receiveBytes), sizeof(receiveBytes)) == 0 && ok;
+    }
+    return ok;
+}
+
+bool TetrixConnection::receive(std::vector<uint8_t> &buffer) {
+    if (handle == -1) {
+        return false;
+    }
+    uint8_t chunk[4096];
+    for (;;) {
+        auto received = ::recv(native(handle), reinterpret_cast<char *>(chunk), sizeof(chunk), 0);
+        if (received > 0) {
+            buffer.insert(buffer.end(), chunk, chunk + received);
+            receivedBytes += static_cast<uint64_t>(received);
+            continue;
+        }
+        if (received < 0 && wouldBlock()) {
+            return true;
+        }
+        // 0: orderly shutdown by the peer
+        close();
+        return false;
+    }
+}
+
+bool TetrixConnection::waitReadable(int timeoutMs) const {
+    return waitFor(handle, POLLIN, timeoutMs);
+}
+
+bool TetrixConnection::waitWritable(int timeoutMs) const {
+    return waitFor(handle, POLLOUT, timeoutMs);
+}
+
+TetrixListener::TetrixListener()
+    : handle(-1), boundPort(0)
+{
+}
+
+TetrixListener::~TetrixListener() {
+    close();
+}
+
+bool TetrixListener::listen(uint16_t port) {
+    close();
+    if (!startNetworking()) {
+        return false;
+    }
+    Socket socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (static_cast<intptr_t>(socket) == -1) {
+        return false;
+    }
+    int enabled = 1;
+    setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&enabled), sizeof(enabled));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    socklen_t length = sizeof(address);
+    if (bind(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(socket, 64) != 0
+        || !setNonBlocking(socket) || getsockname(socket, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+        closeSocket(socket);
+        return false;
+    }
+    handle = static_cast<intptr_t>(socket);
+    boundPort = ntohs(address.sin_port);
+    return true;
+}
+
+void TetrixListener::close() {
+    if (handle != -1) {
+        closeSocket(native(handle));
+        handle = -1;
+    }
+    boundPort = 0;
+}
+
+bool TetrixListener::accept(TetrixConnection &connection) {
+    if (handle == -1) {
+        return false;
+    }
+    Socket socket = ::accept(native(handle), nullptr, nullptr);
+    if (static_cast<intptr_t>(socket) == -1) {
+        return false;
+    }
+    connection.adopt(static_cast<intptr_t>(socket));
+    return true;
+}
+
+bool TetrixListener::waitAcceptable(int timeoutMs) const {
+    return waitFor(handle, POLLIN, timeoutMs);
+}
@@ -0,0 +1,91 @@
+#ifndef TETRIXSOCKET_H
+#define TETRIXSOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Non-blocking TCP stream for versus play. Nagle is off, so small messages go out at once. send() only
+// queues; flush() hands the socket what it takes and keeps the rest for the next call, so a slow peer
+// never blocks the caller. setLatency() holds outgoing bytes back to simulate a distant peer on
+// loopback. Times are steady-clock nanoseconds supplied by the caller, as in TetrixGameLoop.
+class TetrixConnection {
+public:
+    TetrixConnection();
+    ~TetrixConnection();
+    TetrixConnection(const TetrixConnection &) = delete;
+    TetrixConnection &operator=(const TetrixConnection &) = delete;
+
+    // Blocks for at most timeoutMs; host is a name or a numeric address
+    bool connect(const std::string &host, uint16_t port, int timeoutMs);
+    void close();
+    bool isOpen() const { return handle != -1; }
+
+    // Data sent from now on reaches the socket oneWayMs after send()
+    void setLatency(int oneWayMs) { latencyNs = int64_t(oneWayMs < 0 ? 0 : oneWayMs) * 1000000; }
+    void send(const void *data, size_t size, int64_t nowNs);
+    // False once the connection failed; what is not due yet or did not fit stays queued
+    bool flush(int64_t nowNs);
+    // Appends what arrived to buffer; false when the peer closed the stream or it failed
+    bool receive(std::vector<uint8_t> &buffer);
+    // Waits up to timeoutMs for data to read
+    bool waitReadable(int timeoutMs) const;
+    // Waits up to timeoutMs for room to write
+    bool waitWritable(int timeoutMs) const;
+    // Queued bytes not handed to the socket yet
+    size_t pendingBytes() const { return outgoing.size() - outgoingStart; }
+    // Writes straight to the socket, bypassing the send() queue, for callers that keep their own (the
+    // broadcast server sends one shared buffer to every spectator): bytes taken, 0 when full, -1 on failure
+    long write(const void *data, size_t size);
+    // Kernel buffer sizes, 0 keeps one; small buffers bound how far a stalled reader can fall behind
+    bool setBufferSizes(int sendBytes, int receiveBytes);
+
+    uint64_t bytesSent() const { return sentBytes; }
+    uint64_t bytesReceived() const { return receivedBytes; }
+
+private:
+    friend class TetrixListener;
+    void adopt(intptr_t socket);
+
+    // Bytes before end may go out at dueNs
+    struct Release {
+        int64_t dueNs;
+        size_t end;
+    };
+
+    intptr_t handle; // Native socket, -1 when closed
+    std::vector<uint8_t> outgoing;
+    size_t outgoingStart; // Already written
+    size_t outgoingReady; // May be written now
+    std::deque<Release> releases; // Held back by the simulated latency, in send order
+    int64_t latencyNs;
+    uint64_t sentBytes;
+    uint64_t receivedBytes;
+};
+
+// Accepts connections on a port, without blocking
+class TetrixListener {
+public:
+    TetrixListener();
+    ~TetrixListener();
+    TetrixListener(const TetrixListener &) = delete;
+    TetrixListener &operator=(const TetrixListener &) = delete;
+
+    // Every local address; port 0 picks a free one (see port())
+    bool listen(uint16_t port);
+    void close();
+    bool isListening() const { return handle != -1; }
+    uint16_t port() const { return boundPort; }
+    // Takes one waiting connection; false when there is none
+    bool accept(TetrixConnection &connection);
+    // Waits up to timeoutMs for a connection to accept
+    bool waitAcceptable(int timeoutMs) const;
+
+private:
+    intptr_t handle;
+    uint16_t boundPort;
+};
+
+#endif // TETRIXSOCKET_H
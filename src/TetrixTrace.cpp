@@ -0,0 +1,239 @@
+#include "TetrixTrace.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct EventInfo {
+    const char *name;
+    const char *category;
+    const char *argNames[3];
+};
+
+const EventInfo eventInfo[] = {
+    { "tryMove", "engine", { "x", "y", "accepted" } },
+    { "pieceLocked", "engine", { "pieces", "score", nullptr } },
+    { "linesCleared", "engine", { "lines", "totalLines", nullptr } },
+    { "gameOver", "engine", { "score", "pieces", nullptr } },
+    { "botMove", "bot", { "beamWidth", nullptr, nullptr } },
+    { "audioMix", "audio", { "voices", nullptr, nullptr } },
+    { "paintEvent", "gui", { "width", "height", "squareSize" } },
+    { "keyPressEvent", "gui", { "key", "accepted", nullptr } },
+    { "sizeHint", "gui", { "width", "height", nullptr } },
+    { "resizeEvent", "gui", { "width", "height", "fontSize" } },
+    { "windowInit", "gui", { "width", "height", nullptr } },
+    { "previewPaint", "gui", { "width", "height", "squareSize" } },
+    { "assetDecode", "gui", { "asset", "bytes", nullptr } },
+    { "backgroundScale", "gui", { "width", "height", nullptr } },
+    { "startup", "gui", { "milestone", "us", nullptr } },
+    { "game", "tools", { "seed", "index", nullptr } },
+};
+
+static_assert(sizeof(eventInfo) / sizeof(eventInfo[0]) == static_cast<size_t>(TetrixTraceId::Count), "one entry per TetrixTraceId");
+
+// Single producer (the owning thread), single consumer (the flusher)
+struct ThreadRing {
+    enum { Capacity = 1 << 14 };
+
+    alignas(64) std::atomic<uint32_t> head{ 0 };
+    alignas(64) std::atomic<uint32_t> tail{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<bool> inUse{ true };
+    uint32_t threadId = 0;
+    TetrixTraceEvent events[Capacity];
+};
+
+struct Registry {
+    std::mutex mutex; // Guards rings (registration only) and the output file
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    uint32_t nextThreadId = 1;
+
+    std::mutex flusherMutex;
+    std::condition_variable wake;
+    std::thread flusher;
+    bool stopping = false;
+
+    FILE *file = nullptr;
+    uint64_t written = 0;
+    std::string text;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+// Never destroyed, so threads exiting after main() can still release their rings
+Registry &registry() {
+    static Registry *instance = new Registry;
+    return *instance;
+}
+
+// Hands the ring back for reuse when the thread exits; events already in it are still flushed
+struct RingHandle {
+    ThreadRing *ring = nullptr;
+    ~RingHandle() {
+        if (ring) {
+            ring->inUse.store(false, std::memory_order_release);
+        }
+    }
+};
+
+ThreadRing *threadRing() {
+    thread_local RingHandle handle;
+    if (!handle.ring) {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (std::unique_ptr<ThreadRing> &ring : reg.rings) {
+            bool expected = false;
+            if (ring->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                handle.ring = ring.get();
+                break;
+            }
+        }
+        if (!handle.ring) {
+            reg.rings.push_back(std::make_unique<ThreadRing>());
+            handle.ring = reg.rings.back().get();
+        }
+        handle.ring->threadId = reg.nextThreadId++;
+    }
+    return handle.ring;
+}
+
+void appendEvent(std::string &text, const TetrixTraceEvent &event, bool first) {
+    const EventInfo &info = eventInfo[event.id];
+    char buffer[320];
+    int length = std::snprintf(buffer, sizeof(buffer), "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,", first ? "" : ",\n",
+                               info.name, info.category, event.phase, event.timestampNs / 1000.0);
+    text.append(buffer, static_cast<size_t>(length));
+    if (event.phase == 'X') {
+        length = std::snprintf(buffer, sizeof(buffer), "\"dur\":%.3f,", event.durationNs / 1000.0);
+    } else {
+        length = std::snprintf(buffer, sizeof(buffer), "\"s\":\"t\",");
+    }
+    text.append(buffer, static_cast<size_t>(length));
+    length = std::snprintf(buffer, sizeof(buffer), "\"pid\":1,\"tid\":%u,\"args\":{", event.threadId);
+    text.append(buffer, static_cast<size_t>(length));
+    for (int i = 0; i < 3 && info.argNames[i]; ++i) {
+        length = std::snprintf(buffer, sizeof(buffer), "%s\"%s\":%d", i ? "," : "", info.argNames[i], event.args[i]);
+        text.append(buffer, static_cast<size_t>(length));
+    }
+    text.append("}}");
+}
+
+// Moves everything currently in the rings to the file; formatting happens only here
+void drain(Registry &reg) {
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (std::unique_ptr<ThreadRing> &ring : reg.rings) {
+        uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint32_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            appendEvent(reg.text, ring->events[tail & (ThreadRing::Capacity - 1)], reg.written == 0);
+            ++reg.written;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+    if (!reg.text.empty()) {
+        std::fwrite(reg.text.data(), 1, reg.text.size(), reg.file);
+        reg.text.clear();
+    }
+}
+
+void flushLoop() {
+    Registry &reg = registry();
+    std::unique_lock<std::mutex> lock(reg.flusherMutex);
+    while (!reg.stopping) {
+        reg.wake.wait_for(lock, std::chrono::milliseconds(20));
+        lock.unlock();
+        drain(reg);
+        lock.lock();
+    }
+}
+
+} // namespace
+
+namespace TetrixTrace {
+
+std::atomic<bool> recording{ false };
+
+uint64_t now() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().epoch).count());
+}
+
+void push(TetrixTraceId id, uint8_t phase, uint64_t timestampNs, uint32_t durationNs, int32_t a, int32_t b, int32_t c) {
+    ThreadRing *ring = threadRing();
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= ThreadRing::Capacity) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TetrixTraceEvent &event = ring->events[head & (ThreadRing::Capacity - 1)];
+    event.timestampNs = timestampNs;
+    event.durationNs = durationNs;
+    event.id = static_cast<uint16_t>(id);
+    event.phase = phase;
+    event.reserved = 0;
+    event.threadId = ring->threadId;
+    event.args[0] = a;
+    event.args[1] = b;
+    event.args[2] = c;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool start(const std::string &path) {
+    Registry &reg = registry();
+    if (recording.load() || reg.flusher.joinable()) {
+        return false;
+    }
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        // Discard anything left from an earlier session
+        for (std::unique_ptr<ThreadRing> &ring : reg.rings) {
+            ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+            ring->dropped.store(0, std::memory_order_relaxed);
+        }
+        reg.file = file;
+        reg.written = 0;
+        reg.text.clear();
+        reg.epoch = std::chrono::steady_clock::now();
+        std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    }
+    reg.stopping = false;
+    reg.flusher = std::thread(flushLoop);
+    recording.store(true);
+    return true;
+}
+
+Stats stop() {
+    Registry &reg = registry();
+    Stats stats;
+    if (!reg.flusher.joinable()) {
+        return stats;
+    }
+    recording.store(false);
+    {
+        std::lock_guard<std::mutex> lock(reg.flusherMutex);
+        reg.stopping = true;
+    }
+    reg.wake.notify_one();
+    reg.flusher.join();
+    drain(reg);
+
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::fputs("\n]}\n", reg.file);
+    std::fclose(reg.file);
+    reg.file = nullptr;
+    stats.written = reg.written;
+    for (std::unique_ptr<ThreadRing> &ring : reg.rings) {
+        stats.dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+} // namespace TetrixTrace
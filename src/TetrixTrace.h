@@ -0,0 +1,130 @@
+#ifndef TETRIXTRACE_H
+#define TETRIXTRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Low-overhead tracing for hot paths. Call sites record fixed-size binary events (timestamp, event id,
+// up to three integers) into a lock-free ring owned by the calling thread; a background flusher drains
+// the rings and formats them as Chrome trace JSON (chrome://tracing, Perfetto).
+//
+// TETRIX_TRACE_LEVEL picks what is compiled in: 0 off, 1 errors, 2 info, 3 debug. Macros above the
+// level expand to nothing, arguments included. Compiled-in events cost one relaxed load until
+// TetrixTrace::start() is called.
+#ifndef TETRIX_TRACE_LEVEL
+#define TETRIX_TRACE_LEVEL 2
+#endif
+
+enum class TetrixTraceId : uint16_t {
+    // Engine
+    TryMove, // x, y, accepted
+    PieceLocked, // pieces, score
+    LinesCleared, // lines, total lines
+    GameOver, // score, pieces
+    // Bot
+    BotMove, // beam width
+    // Audio
+    AudioMix, // active voices
+    // GUI
+    Paint, // exposed width, exposed height, square size
+    KeyPress, // key, accepted
+    SizeHint, // width, height
+    Resize, // width, height, font size
+    WindowInit, // width, height
+    NextPiece, // width, height, square size
+    AssetDecode, // asset, bytes
+    BackgroundScale, // width, height (device pixels)
+    Startup, // milestone (0 first paint, 1 playable), microseconds since main()
+    // Headless tools
+    Game, // seed, index
+    Count
+};
+
+struct TetrixTraceEvent {
+    uint64_t timestampNs; // Since TetrixTrace::start()
+    uint32_t durationNs; // Complete events only
+    uint16_t id;
+    uint8_t phase; // 'i' instant or 'X' complete, as in the Chrome format
+    uint8_t reserved;
+    uint32_t threadId;
+    int32_t args[3];
+};
+
+static_assert(sizeof(TetrixTraceEvent) == 32, "trace events are two per cache line");
+
+namespace TetrixTrace {
+
+enum Level { Off = 0, Error = 1, Info = 2, Debug = 3 };
+
+struct Stats {
+    uint64_t written = 0;
+    uint64_t dropped = 0; // Ring full; the flusher fell behind
+};
+
+extern std::atomic<bool> recording;
+
+// Starts recording and the flusher thread writing Chrome trace JSON to path
+bool start(const std::string &path);
+// Stops recording, drains every ring and closes the file
+Stats stop();
+inline bool isRecording() { return recording.load(std::memory_order_relaxed); }
+
+uint64_t now();
+void push(TetrixTraceId id, uint8_t phase, uint64_t timestampNs, uint32_t durationNs, int32_t a, int32_t b, int32_t c);
+
+inline void instant(TetrixTraceId id, int32_t a = 0, int32_t b = 0, int32_t c = 0) {
+    if (isRecording()) {
+        push(id, 'i', now(), 0, a, b, c);
+    }
+}
+
+} // namespace TetrixTrace
+
+// Records one complete event spanning its lifetime
+class TetrixTraceScope {
+public:
+    explicit TetrixTraceScope(TetrixTraceId id, int32_t a = 0, int32_t b = 0, int32_t c = 0)
+        : traceId(id), beginNs(TetrixTrace::isRecording() ? TetrixTrace::now() : 0), args{ a, b, c } {}
+    ~TetrixTraceScope() {
+        if (beginNs != 0 && TetrixTrace::isRecording()) {
+            uint64_t endNs = TetrixTrace::now();
+            TetrixTrace::push(traceId, 'X', beginNs, static_cast<uint32_t>(endNs - beginNs), args[0], args[1], args[2]);
+        }
+    }
+    TetrixTraceScope(const TetrixTraceScope &) = delete;
+    TetrixTraceScope &operator=(const TetrixTraceScope &) = delete;
+
+private:
+    TetrixTraceId traceId;
+    uint64_t beginNs; // 0 when not recording at construction
+    int32_t args[3];
+};
+
+#define TETRIX_TRACE_CONCAT_(a, b) a##b
+#define TETRIX_TRACE_CONCAT(a, b) TETRIX_TRACE_CONCAT_(a, b)
+#define TETRIX_TRACE_SCOPE_(...) TetrixTraceScope TETRIX_TRACE_CONCAT(tetrixTraceScope, __LINE__)(__VA_ARGS__)
+
+#if TETRIX_TRACE_LEVEL >= 1
+#define TETRIX_TRACE_ERROR(...) TetrixTrace::instant(__VA_ARGS__)
+#else
+#define TETRIX_TRACE_ERROR(...) ((void)0)
+#endif
+
+#if TETRIX_TRACE_LEVEL >= 2
+#define TETRIX_TRACE_INFO(...) TetrixTrace::instant(__VA_ARGS__)
+#define TETRIX_TRACE_SCOPE_INFO(...) TETRIX_TRACE_SCOPE_(__VA_ARGS__)
+#else
+#define TETRIX_TRACE_INFO(...) ((void)0)
+#define TETRIX_TRACE_SCOPE_INFO(...) ((void)0)
+#endif
+
+#if TETRIX_TRACE_LEVEL >= 3
+#define TETRIX_TRACE_DEBUG(...) TetrixTrace::instant(__VA_ARGS__)
+#define TETRIX_TRACE_SCOPE_DEBUG(...) TETRIX_TRACE_SCOPE_(__VA_ARGS__)
+#else
+#define TETRIX_TRACE_DEBUG(...) ((void)0)
+#define TETRIX_TRACE_SCOPE_DEBUG(...) ((void)0)
+#endif
+
+#endif // TETRIXTRACE_H
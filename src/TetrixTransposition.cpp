@@ -0,0 +1,70 @@
+#include "TetrixTransposition.h"
+#include <cstring>
+
+TetrixTranspositionTable::TetrixTranspositionTable(size_t sizeBytes) : generation(1) {
+    size_t count = 1;
+    while (count * 2 * sizeof(Bucket) <= sizeBytes) {
+        count *= 2;
+    }
+    buckets.resize(count);
+    mask = count - 1;
+    clear();
+}
+
+void TetrixTranspositionTable::clear() {
+    std::memset(static_cast<void *>(buckets.data()), 0, buckets.size() * sizeof(Bucket));
+    generation = 1;
+}
+
+void TetrixTranspositionTable::newSearch() {
+    // Generations are 8 bits; start over rather than let an old entry pass for a current one
+    if (generation == 255) {
+        clear();
+    }
+    ++generation;
+}
+
+TetrixTranspositionTable::Probe TetrixTranspositionTable::probe(uint64_t key, double &value) {
+    ++counters.probes;
+    Bucket &bucket = bucketFor(key);
+    for (int way = 0; way < Ways; ++way) {
+        if (bucket.generations[way] != 0 && bucket.keys[way] == key) {
+            ++counters.hits;
+            value = bucket.values[way];
+            if (bucket.generations[way] == generation) {
+                return Probe::HitThisSearch;
+            }
+            bucket.generations[way] = generation;
+            return Probe::Hit;
+        }
+    }
+    return Probe::Miss;
+}
+
+void TetrixTranspositionTable::store(uint64_t key, double value, int depth) {
+    ++counters.stores;
+    Bucket &bucket = bucketFor(key);
+    int victim = 0;
+    int victimRank = -1;
+    for (int way = 0; way < Ways; ++way) {
+        if (bucket.generations[way] != 0 && bucket.keys[way] == key) {
+            victim = way;
+            victimRank = 1 << 10; // Same position: always overwrite in place
+            break;
+        }
+        // Higher rank is a better victim: empty, then stale, then shallow
+        int rank = bucket.generations[way] == 0 ? 1 << 9 : (bucket.generations[way] != generation ? 1 << 8 : 0);
+        rank += 255 - bucket.depths[way];
+        if (rank > victimRank) {
+            victim = way;
+            victimRank = rank;
+        }
+    }
+    if (victimRank < (1 << 9)) {
+        ++counters.replacements;
+    }
+    bucket.keys[victim] = key;
+    bucket.values[victim] = value;
+    bucket.depths[victim] = static_cast<uint8_t>(depth);
+    bucket.generations[victim] = generation;
+}
@@ -0,0 +1,54 @@
+#ifndef TETRIXTRANSPOSITION_H
+#define TETRIXTRANSPOSITION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed-size cache of search results keyed by Zobrist hash (see TetrixZobrist.h). Three entries share
+// one 64-byte bucket, so a probe touches a single cache line. A store overwrites the entry with the
+// same key, else an empty entry, else one left over from an earlier search, else the shallowest one.
+class TetrixTranspositionTable {
+public:
+    enum class Probe { Miss, Hit, HitThisSearch };
+
+    struct Stats {
+        uint64_t probes = 0;
+        uint64_t hits = 0;
+        uint64_t stores = 0;
+        uint64_t replacements = 0; // Stores that evicted another live position
+    };
+
+    // Rounded down to a power-of-two number of buckets
+    explicit TetrixTranspositionTable(size_t sizeBytes = size_t(1) << 20);
+
+    void clear();
+    // Starts a new search generation; entries from older searches stay usable but are replaced first
+    void newSearch();
+    // A hit also marks the entry as part of the current search
+    Probe probe(uint64_t key, double &value);
+    void store(uint64_t key, double value, int depth);
+
+    const Stats &stats() const { return counters; }
+    void resetStats() { counters = Stats(); }
+    size_t capacity() const { return buckets.size() * Ways; }
+
+private:
+    enum { Ways = 3 };
+
+    struct alignas(64) Bucket {
+        uint64_t keys[Ways];
+        double values[Ways];
+        uint8_t depths[Ways];
+        uint8_t generations[Ways]; // 0 marks an empty entry
+    };
+
+    Bucket &bucketFor(uint64_t key) { return buckets[static_cast<size_t>(key) & mask]; }
+
+    std::vector<Bucket> buckets;
+    size_t mask;
+    uint8_t generation;
+    Stats counters;
+};
+
+#endif // TETRIXTRANSPOSITION_H
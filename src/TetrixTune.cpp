@@ -0,0 +1,276 @@
+#include "TetrixBot.h"
+#include "TetrixEngine.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Self-play tuner for TetrixBot evaluation weights. Each generation the cross-entropy method samples
+// candidate weight vectors, every candidate plays the same seeded headless games on all cores, and
+// the elite candidates move the sampling distribution. Workers each own an engine and a bot and only
+// write their own result slots; idle workers steal unclaimed games from the others.
+
+namespace {
+
+enum { WeightCount = 7 };
+
+struct TuneOptions {
+    int generations = 10;
+    int population = 32;
+    int games = 8; // Games per candidate, same seeds for every candidate
+    int maxPieces = 500;
+    int beamWidth = 1;
+    int threads = 0;
+    double eliteFraction = 0.25;
+    uint32_t seed = 1;
+};
+
+struct GameResult {
+    int lines;
+    int score;
+    int pieces;
+};
+
+// One contiguous range of task indices per worker; the owner and thieves both claim through next
+struct alignas(64) TaskRange {
+    std::atomic<int> next;
+    int end;
+};
+
+struct WorkerStats {
+    long long games = 0;
+    double busySeconds = 0.0;
+};
+
+TetrixEvalWeights toWeights(const double *v) {
+    TetrixEvalWeights w;
+    w.aggregateHeight = v[0];
+    w.lines = v[1];
+    w.holes = v[2];
+    w.bumpiness = v[3];
+    w.rowTransitions = v[4];
+    w.columnTransitions = v[5];
+    w.wellDepth = v[6];
+    return w;
+}
+
+void fromWeights(const TetrixEvalWeights &w, double *v) {
+    v[0] = w.aggregateHeight;
+    v[1] = w.lines;
+    v[2] = w.holes;
+    v[3] = w.bumpiness;
+    v[4] = w.rowTransitions;
+    v[5] = w.columnTransitions;
+    v[6] = w.wellDepth;
+}
+
+GameResult playGame(TetrixEngine &engine, TetrixBot &bot, uint32_t seed, int maxPieces) {
+    engine.start(seed);
+    while (engine.isStarted() && engine.piecesDropped() < maxPieces) {
+        TetrixBotMove move = bot.chooseMove(engine.grid(), engine.currentPiece(), engine.currentX(), engine.currentY(),
+                                            engine.nextPiece());
+        if (!move.valid) {
+            break;
+        }
+        for (TetrixInput input : move.inputs) {
+            engine.input(input);
+        }
+        if (engine.isWaitingAfterLine()) {
+            engine.tick();
+        }
+    }
+    return { engine.linesRemoved(), engine.score(), engine.piecesDropped() };
+}
+
+// Claims the next task from the worker's own range, or steals one from another worker
+int claimTask(std::vector<TaskRange> &ranges, int self) {
+    int count = static_cast<int>(ranges.size());
+    for (int k = 0; k < count; ++k) {
+        TaskRange &range = ranges[(self + k) % count];
+        if (range.next.load(std::memory_order_relaxed) >= range.end) {
+            continue;
+        }
+        int task = range.next.fetch_add(1, std::memory_order_relaxed);
+        if (task < range.end) {
+            return task;
+        }
+    }
+    return -1;
+}
+
+// Plays every (candidate, game) pair across the worker threads; results[candidate * games + game]
+void runGeneration(const std::vector<TetrixEvalWeights> &candidates, const TuneOptions &options, uint32_t generationSeed,
+                   std::vector<GameResult> &results, std::vector<WorkerStats> &workerStats) {
+    int taskCount = static_cast<int>(candidates.size()) * options.games;
+    int threadCount = static_cast<int>(workerStats.size());
+    results.assign(taskCount, GameResult{ 0, 0, 0 });
+
+    std::vector<TaskRange> ranges(threadCount);
+    for (int t = 0; t < threadCount; ++t) {
+        ranges[t].next.store(taskCount * t / threadCount);
+        ranges[t].end = taskCount * (t + 1) / threadCount;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount);
+    for (int t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&, t]() {
+            TetrixEngine engine;
+            TetrixBot bot(TetrixEvalWeights(), options.beamWidth);
+            auto begin = std::chrono::steady_clock::now();
+            long long played = 0;
+            for (int task = claimTask(ranges, t); task >= 0; task = claimTask(ranges, t)) {
+                int candidate = task / options.games;
+                int game = task % options.games;
+                bot.setWeights(candidates[candidate]);
+                results[task] = playGame(engine, bot, generationSeed + static_cast<uint32_t>(game), options.maxPieces);
+                ++played;
+            }
+            workerStats[t].games += played;
+            workerStats[t].busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void printUsage(const char *program) {
+    std::printf("Usage: %s [--generations N] [--population N] [--games N] [--max-pieces N] [--beam N] [--threads N] [--seed S]\n",
+                program);
+}
+
+bool parseOptions(int argc, char *argv[], TuneOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char *value = argv[i + 1];
+        if (std::strcmp(argv[i], "--generations") == 0) {
+            options.generations = std::atoi(value);
+        } else if (std::strcmp(argv[i], "--population") == 0) {
+            options.population = std::atoi(value);
+        } else if (std::strcmp(argv[i], "--games") == 0) {
+            options.games = std::atoi(value);
+        } else if (std::strcmp(argv[i], "--max-pieces") == 0) {
+            options.maxPieces = std::atoi(value);
+        } else if (std::strcmp(argv[i], "--beam") == 0) {
+            options.beamWidth = std::atoi(value);
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            options.threads = std::atoi(value);
+        } else if (std::strcmp(argv[i], "--seed") == 0) {
+            options.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else {
+            return false;
+        }
+        ++i;
+    }
+    return options.generations > 0 && options.population > 1 && options.games > 0 && options.maxPieces > 0
+        && options.beamWidth > 0 && options.threads >= 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    TuneOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    int threadCount = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+    threadCount = std::max(1, threadCount);
+    int eliteCount = std::max(1, static_cast<int>(options.population * options.eliteFraction));
+
+    // Sampling distribution starts at the default weights
+    double mean[WeightCount];
+    double sigma[WeightCount];
+    fromWeights(TetrixEvalWeights(), mean);
+    for (int k = 0; k < WeightCount; ++k) {
+        sigma[k] = 0.5;
+    }
+
+    std::mt19937 gen(options.seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<TetrixEvalWeights> candidates(options.population);
+    std::vector<double> samples(options.population * WeightCount);
+    std::vector<GameResult> results;
+    std::vector<WorkerStats> workerStats(threadCount);
+
+    std::printf("threads: %d, population: %d, games/candidate: %d, max pieces: %d, beam: %d\n",
+                threadCount, options.population, options.games, options.maxPieces, options.beamWidth);
+
+    for (int generation = 0; generation < options.generations; ++generation) {
+        for (int c = 0; c < options.population; ++c) {
+            double *v = &samples[c * WeightCount];
+            for (int k = 0; k < WeightCount; ++k) {
+                v[k] = c == 0 ? mean[k] : mean[k] + sigma[k] * normal(gen); // Candidate 0 re-tests the mean
+            }
+            candidates[c] = toWeights(v);
+        }
+
+        std::vector<WorkerStats> generationStats(threadCount);
+        auto begin = std::chrono::steady_clock::now();
+        runGeneration(candidates, options, options.seed + generation * 7919u, results, generationStats);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        // Fitness is mean lines cleared; score and survival are reported alongside
+        std::vector<int> order(options.population);
+        std::vector<double> fitness(options.population, 0.0);
+        std::vector<double> score(options.population, 0.0);
+        std::vector<double> pieces(options.population, 0.0);
+        for (int c = 0; c < options.population; ++c) {
+            for (int g = 0; g < options.games; ++g) {
+                const GameResult &result = results[c * options.games + g];
+                fitness[c] += result.lines;
+                score[c] += result.score;
+                pieces[c] += result.pieces;
+            }
+            fitness[c] /= options.games;
+            score[c] /= options.games;
+            pieces[c] /= options.games;
+            order[c] = c;
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return fitness[a] > fitness[b]; });
+
+        for (int k = 0; k < WeightCount; ++k) {
+            double sum = 0.0;
+            for (int e = 0; e < eliteCount; ++e) {
+                sum += samples[order[e] * WeightCount + k];
+            }
+            double newMean = sum / eliteCount;
+            double variance = 0.0;
+            for (int e = 0; e < eliteCount; ++e) {
+                double d = samples[order[e] * WeightCount + k] - newMean;
+                variance += d * d;
+            }
+            mean[k] = newMean;
+            // Extra noise keeps the distribution from collapsing too early
+            sigma[k] = std::sqrt(variance / eliteCount) + 0.05 / (generation + 1);
+        }
+
+        long long games = 0;
+        for (int t = 0; t < threadCount; ++t) {
+            games += generationStats[t].games;
+            workerStats[t].games += generationStats[t].games;
+            workerStats[t].busySeconds += generationStats[t].busySeconds;
+        }
+        int best = order[0];
+        std::printf("gen %2d: best lines %.1f (score %.0f, pieces %.0f), mean-candidate lines %.1f, %.0f games/s\n",
+                    generation, fitness[best], score[best], pieces[best], fitness[0], games / seconds);
+    }
+
+    std::printf("weights: height %.4f lines %.4f holes %.4f bumpiness %.4f rowTransitions %.4f columnTransitions %.4f wells %.4f\n",
+                mean[0], mean[1], mean[2], mean[3], mean[4], mean[5], mean[6]);
+    for (int t = 0; t < threadCount; ++t) {
+        const WorkerStats &stats = workerStats[t];
+        std::printf("thread %2d: %lld games, %.1f games/s\n", t, stats.games,
+                    stats.busySeconds > 0.0 ? stats.games / stats.busySeconds : 0.0);
+    }
+    return 0;
+}
@@ -0,0 +1,635 @@
+#include "TetrixVersus.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+const char HelloMagic[4] = { 'T', 'X', 'V', 'S' };
+
+// Garbage rows sent per lock by lines cleared: singles send nothing, a tetris sends four
+const int GarbageForLines[TetrixGrid::MaxLinesPerLock + 1] = { 0, 0, 1, 2, 4 };
+
+const int MaxRepeatMs = 1000;
+
+void putVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool getVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && data < end; shift += 7) {
+        uint8_t byte = *data++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool getVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value, uint64_t limit) {
+    return getVarint(data, end, value) && value <= limit;
+}
+
+void putFixed64(std::vector<uint8_t> &out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+bool getFixed64(const uint8_t *&data, const uint8_t *end, uint64_t &value) {
+    if (end - data < 8) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= uint64_t(data[i]) << (8 * i);
+    }
+    data += 8;
+    return true;
+}
+
+uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+int64_t microseconds(int64_t ns) { return ns / 1000; }
+
+} // namespace
+
+TetrixVersusMatch::TetrixVersusMatch()
+    : currentPhase(Phase::Handshake), hosting(false), helloReceived(false), handshakePongs(0), startNs(0), viewEvents{ 0, 0 },
+      localFinal(0), sentThrough(0), unsentInput(0), remoteThrough(0), lastInputsNs(0), lastPingNs(0), finishFrame(0),
+      winnerIndex(-1), finishHash(0), byeSent(false), byeReceived(false), byeSentNs(0)
+{
+}
+
+int64_t TetrixVersusMatch::clockNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TetrixVersusMatch::host(const Settings &settings, const TetrixRepeatSettings &localRepeat, int64_t nowNs) {
+    hosting = true;
+    game = settings;
+    game.lineClearDelayMs = std::clamp(game.lineClearDelayMs, 0, int(TetrixEngine::MaxLineClearDelayMs));
+    repeat[0] = localRepeat;
+    sendHello(nowNs);
+}
+
+void TetrixVersusMatch::join(const TetrixRepeatSettings &localRepeat, int64_t nowNs) {
+    hosting = false;
+    repeat[1] = localRepeat;
+    sendHello(nowNs);
+}
+
+void TetrixVersusMatch::startTimelines() {
+    for (Timeline *timeline : { &live, &confirmed }) {
+        for (int p = 0; p < 2; ++p) {
+            Player &player = timeline->players[p];
+            player.engine.setLineClearDelay(game.lineClearDelayMs);
+            player.loop.setRepeatSettings(repeat[p]);
+            player.loop.start(game.seed, game.mode, 0);
+            timeline->outgoingGarbage[p] = 0;
+            timeline->garbageSent[p] = 0;
+        }
+        timeline->frame = 0;
+    }
+    viewEvents[0] = viewEvents[1] = TetrixEngine::PieceSpawned | Resimulated;
+    currentPhase = Phase::Playing;
+}
+
+void TetrixVersusMatch::copyTimeline(const Timeline &from, Timeline &to) {
+    for (int p = 0; p < 2; ++p) {
+        to.players[p].engine = from.players[p].engine;
+        TetrixGameLoopState state;
+        from.players[p].loop.saveState(state);
+        to.players[p].loop.restoreState(state);
+        to.outgoingGarbage[p] = from.outgoingGarbage[p];
+        to.garbageSent[p] = from.garbageSent[p];
+    }
+    to.frame = from.frame;
+}
+
+// Within a frame the boards do not affect each other, so each one's inputs apply in any order against
+// the other's; only garbage couples them, and it moves at the start of the next frame.
+void TetrixVersusMatch::simulate(Timeline &timeline, uint32_t toFrame, unsigned *events) {
+    size_t cursor[2];
+    for (int p = 0; p < 2; ++p) {
+        cursor[p] = std::lower_bound(inputs[p].begin(), inputs[p].end(), timeline.frame + 1,
+                                     [](const Input &input, uint32_t frame) { return input.frame < frame; })
+            - inputs[p].begin();
+    }
+    while (timeline.frame < toFrame) {
+        uint32_t frame = timeline.frame + 1;
+        exchangeGarbage(timeline);
+        for (int p = 0; p < 2; ++p) {
+            unsigned stepEvents = timeline.players[p].loop.advance(int64_t(frame) * TetrixGameLoop::StepNs);
+            if (stepEvents & TetrixEngine::LinesCleared) {
+                timeline.outgoingGarbage[p] += GarbageForLines[timeline.players[p].engine.clearedLineCount()];
+            }
+            for (; cursor[p] < inputs[p].size() && inputs[p][cursor[p]].frame == frame; ++cursor[p]) {
+                stepEvents |= applyInput(timeline, p, inputs[p][cursor[p]].code, frame);
+            }
+            if (events) {
+                events[p] |= stepEvents;
+            }
+        }
+        timeline.frame = frame;
+    }
+}
+
+unsigned TetrixVersusMatch::applyInput(Timeline &timeline, int player, uint8_t code, uint32_t frame) {
+    TetrixGameLoop &loop = timeline.players[player].loop;
+    TetrixInput input = static_cast<TetrixInput>(code >> 1);
+    int64_t nowNs = int64_t(frame) * TetrixGameLoop::StepNs;
+    unsigned events = (code & 1) ? loop.press(input, nowNs) : loop.release(input, nowNs);
+    if (events & TetrixEngine::LinesCleared) {
+        timeline.outgoingGarbage[player] += GarbageForLines[timeline.players[player].engine.clearedLineCount()];
+    }
+    return events;
+}
+
+void TetrixVersusMatch::exchangeGarbage(Timeline &timeline) {
+    // Both boards cancel first, so neither side's rows depend on the order of the two sends
+    int rows[2];
+    for (int p = 0; p < 2; ++p) {
+        rows[p] = timeline.players[p].engine.cancelGarbage(timeline.outgoingGarbage[p]);
+        timeline.outgoingGarbage[p] = 0;
+    }
+    for (int p = 0; p < 2; ++p) {
+        if (rows[p] > 0) {
+            uint64_t batch = (uint64_t(p + 1) << 32) | timeline.garbageSent[p]++;
+            int hole = static_cast<int>(splitmix64(game.seed ^ splitmix64(batch)) % TetrixEngine::BoardWidth);
+            timeline.players[1 - p].engine.addGarbage(rows[p], hole);
+        }
+    }
+}
+
+void TetrixVersusMatch::advance(int64_t nowNs) {
+    if (!isPlaying(nowNs)) {
+        return;
+    }
+    uint32_t target = static_cast<uint32_t>((nowNs - startNs) / TetrixGameLoop::StepNs);
+    uint32_t limit = remoteThrough + MaxPredictionFrames;
+    if (target > limit) {
+        target = limit;
+        ++counters.stalls;
+    }
+    if (game.frameLimit > 0) {
+        target = std::min(target, game.frameLimit + 1);
+    }
+    if (target > live.frame) {
+        simulate(live, target, viewEvents);
+        localFinal = live.frame - 1;
+        confirm();
+    }
+}
+
+void TetrixVersusMatch::press(TetrixInput input, int64_t nowNs) {
+    localInput(input, true, nowNs);
+}
+
+void TetrixVersusMatch::release(TetrixInput input, int64_t nowNs) {
+    localInput(input, false, nowNs);
+}
+
+void TetrixVersusMatch::releaseAll(int64_t nowNs) {
+    for (TetrixInput input : { TetrixInput::Left, TetrixInput::Right, TetrixInput::SoftDrop }) {
+        localInput(input, false, nowNs);
+    }
+}
+
+void TetrixVersusMatch::localInput(TetrixInput input, bool pressed, int64_t nowNs) {
+    advance(nowNs);
+    // Frame 0 is the start position; inputs begin with the first step
+    if (!isPlaying(nowNs) || live.frame == 0) {
+        return;
+    }
+    uint8_t code = static_cast<uint8_t>((static_cast<unsigned>(input) << 1) | (pressed ? 1 : 0));
+    int local = localPlayer();
+    inputs[local].push_back({ live.frame, code });
+    viewEvents[local] |= applyInput(live, local, code, live.frame);
+}
+
+unsigned TetrixVersusMatch::takeEvents(int player) {
+    unsigned events = viewEvents[player];
+    viewEvents[player] = 0;
+    return events;
+}
+
+void TetrixVersusMatch::confirm() {
+    if (currentPhase != Phase::Playing) {
+        return;
+    }
+    uint32_t target = std::min(remoteThrough, localFinal);
+    while (confirmed.frame < target) {
+        simulate(confirmed, confirmed.frame + 1, nullptr);
+        uint32_t frame = confirmed.frame;
+        if (frame % ChecksumIntervalFrames == 0) {
+            uint64_t hash = timelineHash(confirmed);
+            localChecksums.emplace_back(frame, hash);
+            unsentChecksums.emplace_back(frame, hash);
+            compareChecksum(frame);
+        }
+        if (!confirmed.players[0].engine.isStarted() || !confirmed.players[1].engine.isStarted() || frame == game.frameLimit) {
+            finish(frame);
+            return;
+        }
+    }
+    trimInputs();
+}
+
+void TetrixVersusMatch::rollback() {
+    auto begin = std::chrono::steady_clock::now();
+    uint32_t frame = live.frame;
+    uint32_t depth = frame - confirmed.frame;
+    copyTimeline(confirmed, live);
+    simulate(live, frame, nullptr);
+    uint64_t elapsedNs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+    counters.rollbackNs += elapsedNs;
+    counters.maxRollbackNs = std::max(counters.maxRollbackNs, elapsedNs);
+    ++counters.rollbacks;
+    counters.resimulatedFrames += depth;
+    counters.maxRollbackFrames = std::max(counters.maxRollbackFrames, depth);
+    // What the re-simulation changed is already history: the views redraw it without replaying effects
+    viewEvents[0] |= Resimulated;
+    viewEvents[1] |= Resimulated;
+}
+
+void TetrixVersusMatch::finish(uint32_t frame) {
+    finishFrame = frame;
+    finishHash = timelineHash(confirmed);
+    const TetrixEngine &first = confirmed.players[0].engine;
+    const TetrixEngine &second = confirmed.players[1].engine;
+    if (first.isStarted() != second.isStarted()) {
+        winnerIndex = first.isStarted() ? 0 : 1;
+    } else if (first.score() != second.score()) {
+        winnerIndex = first.score() > second.score() ? 0 : 1;
+    } else {
+        winnerIndex = -1;
+    }
+    // The views end on the confirmed boards
+    copyTimeline(confirmed, live);
+    for (int p = 0; p < 2; ++p) {
+        viewEvents[p] |= Resimulated | (live.players[p].engine.isStarted() ? 0u : unsigned(TetrixEngine::GameOver));
+    }
+    currentPhase = Phase::Finished;
+}
+
+void TetrixVersusMatch::trimInputs() {
+    // Inputs up to the confirmed frame are only needed while they wait to be sent
+    enum { TrimBatch = 1024 };
+    for (int p = 0; p < 2; ++p) {
+        std::vector<Input> &list = inputs[p];
+        size_t done = std::lower_bound(list.begin(), list.end(), confirmed.frame + 1,
+                                       [](const Input &input, uint32_t frame) { return input.frame < frame; })
+            - list.begin();
+        if (p == localPlayer()) {
+            done = std::min(done, unsentInput);
+        }
+        if (done >= TrimBatch) {
+            list.erase(list.begin(), list.begin() + static_cast<std::ptrdiff_t>(done));
+            if (p == localPlayer()) {
+                unsentInput -= done;
+            }
+        }
+    }
+}
+
+uint64_t TetrixVersusMatch::timelineHash(const Timeline &timeline) const {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto mix = [&hash](uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            hash ^= (value >> (8 * i)) & 0xFF;
+            hash *= 0x100000001B3ull;
+        }
+    };
+    for (const Player &player : timeline.players) {
+        const TetrixEngine &engine = player.engine;
+        mix(engine.grid().checksum());
+        mix(engine.positionHash());
+        mix((uint64_t(uint32_t(engine.score())) << 32) | uint32_t(engine.linesRemoved()));
+        mix((uint64_t(uint32_t(engine.piecesDropped())) << 32) | uint32_t(engine.level()));
+        mix((uint64_t(uint32_t(engine.currentX())) << 32) | uint32_t(engine.currentY()));
+        mix((uint64_t(engine.currentPiece().rotation()) << 32) | uint32_t(engine.pendingGarbage()));
+        mix(engine.isStarted());
+    }
+    return hash;
+}
+
+void TetrixVersusMatch::compareChecksum(uint32_t frame) {
+    auto matchesFrame = [frame](const std::pair<uint32_t, uint64_t> &entry) { return entry.first == frame; };
+    auto local = std::find_if(localChecksums.begin(), localChecksums.end(), matchesFrame);
+    auto remote = std::find_if(remoteChecksums.begin(), remoteChecksums.end(), matchesFrame);
+    if (local == localChecksums.end() || remote == remoteChecksums.end()) {
+        return;
+    }
+    ++counters.checksums;
+    if (local->second != remote->second) {
+        ++counters.desyncs;
+    }
+    localChecksums.erase(local);
+    remoteChecksums.erase(remote);
+}
+
+TetrixVersusMatch::Stats TetrixVersusMatch::stats() const {
+    Stats result = counters;
+    result.bytesSent = link.bytesSent();
+    result.bytesReceived = link.bytesReceived();
+    return result;
+}
+
+void TetrixVersusMatch::poll(int64_t nowNs) {
+    using namespace TetrixVersusProtocol;
+    if (currentPhase == Phase::Closed || currentPhase == Phase::Failed) {
+        return;
+    }
+
+    bool open = link.receive(received);
+    const uint8_t *data = received.data();
+    const uint8_t *end = data + received.size();
+    while (data < end && currentPhase != Phase::Failed) {
+        const uint8_t *cursor = data + 1;
+        uint64_t size = 0;
+        if (!getVarint(cursor, end, size)) {
+            if (end - data > 10) {
+                fail("malformed message header");
+            }
+            break;
+        }
+        if (size > MaxPayload) {
+            fail("message too large");
+            break;
+        }
+        if (uint64_t(end - cursor) < size) {
+            break; // The rest has not arrived yet
+        }
+        if (!handleMessage(data[0], cursor, static_cast<size_t>(size), nowNs)) {
+            fail("malformed message " + std::to_string(data[0]));
+            break;
+        }
+        data = cursor + size;
+    }
+    if (currentPhase == Phase::Failed) {
+        return;
+    }
+    received.erase(received.begin(), received.begin() + (data - received.data()));
+
+    if (currentPhase == Phase::Playing && nowNs >= startNs) {
+        sendInputs(nowNs);
+        for (const auto &checksum : unsentChecksums) {
+            payload.clear();
+            putVarint(payload, checksum.first);
+            putFixed64(payload, checksum.second);
+            sendMessage(Checksum, payload, nowNs);
+        }
+        unsentChecksums.clear();
+        if (nowNs - lastPingNs >= int64_t(PingIntervalMs) * 1000000) {
+            sendPing(nowNs);
+        }
+    } else if (currentPhase == Phase::Finished) {
+        // Everything the peer needs to reach the same result, then goodbye
+        sendInputs(nowNs);
+        if (!byeSent) {
+            payload.clear();
+            sendMessage(Bye, payload, nowNs);
+            byeSent = true;
+            byeSentNs = nowNs;
+        }
+    }
+
+    bool flushed = link.flush(nowNs);
+    if (currentPhase == Phase::Finished && byeSent
+        && ((byeReceived && link.pendingBytes() == 0) || !open || nowNs - byeSentNs > int64_t(ByeTimeoutMs) * 1000000)) {
+        link.close();
+        currentPhase = Phase::Closed;
+    } else if (!open || !flushed) {
+        fail("connection lost");
+    }
+}
+
+void TetrixVersusMatch::sendMessage(uint8_t type, const std::vector<uint8_t> &body, int64_t nowNs) {
+    message.clear();
+    message.push_back(type);
+    putVarint(message, body.size());
+    message.insert(message.end(), body.begin(), body.end());
+    link.send(message.data(), message.size(), nowNs);
+    ++counters.messagesSent;
+}
+
+void TetrixVersusMatch::sendHello(int64_t nowNs) {
+    payload.assign(HelloMagic, HelloMagic + 4);
+    payload.push_back(TetrixVersusProtocol::Version);
+    const TetrixRepeatSettings &local = repeat[localPlayer()];
+    putVarint(payload, static_cast<uint64_t>(local.dasMs));
+    putVarint(payload, static_cast<uint64_t>(local.arrMs));
+    putVarint(payload, static_cast<uint64_t>(local.softDropMs));
+    if (hosting) {
+        putFixed64(payload, game.seed);
+        payload.push_back(static_cast<uint8_t>(game.mode));
+        putVarint(payload, static_cast<uint64_t>(game.lineClearDelayMs));
+        putVarint(payload, game.frameLimit);
+    }
+    sendMessage(TetrixVersusProtocol::Hello, payload, nowNs);
+}
+
+void TetrixVersusMatch::sendPing(int64_t nowNs) {
+    payload.clear();
+    putVarint(payload, static_cast<uint64_t>(microseconds(nowNs)));
+    sendMessage(TetrixVersusProtocol::Ping, payload, nowNs);
+    lastPingNs = nowNs;
+}
+
+void TetrixVersusMatch::sendInputs(int64_t nowNs) {
+    std::vector<Input> &local = inputs[localPlayer()];
+    size_t ready = unsentInput;
+    while (ready < local.size() && local[ready].frame <= localFinal) {
+        ++ready;
+    }
+    int64_t sinceLastNs = nowNs - lastInputsNs;
+    bool due = (ready > unsentInput && sinceLastNs >= int64_t(InputIntervalMs) * 1000000)
+        || (localFinal > sentThrough && (sinceLastNs >= int64_t(KeepaliveMs) * 1000000 || currentPhase == Phase::Finished));
+    if (!due) {
+        return;
+    }
+    payload.clear();
+    putVarint(payload, localFinal);
+    uint32_t previous = sentThrough;
+    for (size_t i = unsentInput; i < ready; ++i) {
+        putVarint(payload, local[i].frame - previous);
+        payload.push_back(local[i].code);
+        previous = local[i].frame;
+    }
+    sendMessage(TetrixVersusProtocol::Inputs, payload, nowNs);
+    unsentInput = ready;
+    sentThrough = localFinal;
+    lastInputsNs = nowNs;
+}
+
+bool TetrixVersusMatch::handleMessage(uint8_t type, const uint8_t *data, size_t size, int64_t nowNs) {
+    using namespace TetrixVersusProtocol;
+    const uint8_t *end = data + size;
+    uint64_t value = 0;
+    switch (type) {
+    case Hello:
+        if (helloReceived || !handleHello(data, end)) {
+            return false;
+        }
+        helloReceived = true;
+        if (hosting) {
+            sendPing(nowNs);
+        }
+        return true;
+    case Start: {
+        uint64_t delayMs = 0;
+        uint64_t rttUs = 0;
+        if (hosting || !helloReceived || currentPhase != Phase::Handshake || !getVarint(data, end, delayMs, 60000)
+            || !getVarint(data, end, rttUs, 60000000)) {
+            return false;
+        }
+        // The host starts delayMs after sending; this arrived half a round trip later
+        startNs = nowNs + int64_t(delayMs) * 1000000 - int64_t(rttUs) * 1000 / 2;
+        startTimelines();
+        lastPingNs = nowNs;
+        return true;
+    }
+    case Inputs:
+        return currentPhase != Phase::Handshake && handleInputs(data, end);
+    case Ping:
+        payload.assign(data, end);
+        sendMessage(Pong, payload, nowNs);
+        return true;
+    case Pong: {
+        if (!getVarint(data, end, value)) {
+            return false;
+        }
+        int64_t rttNs = std::max<int64_t>(0, microseconds(nowNs) - int64_t(value)) * 1000;
+        counters.rttNs = rttNs;
+        counters.minRttNs = counters.rttSamples ? std::min(counters.minRttNs, rttNs) : rttNs;
+        counters.maxRttNs = std::max(counters.maxRttNs, rttNs);
+        counters.totalRttNs += rttNs;
+        ++counters.rttSamples;
+        if (hosting && currentPhase == Phase::Handshake) {
+            if (++handshakePongs < HandshakePings) {
+                sendPing(nowNs);
+            } else {
+                payload.clear();
+                putVarint(payload, StartDelayMs);
+                putVarint(payload, static_cast<uint64_t>(microseconds(counters.totalRttNs / int64_t(counters.rttSamples))));
+                sendMessage(Start, payload, nowNs);
+                startNs = nowNs + int64_t(StartDelayMs) * 1000000;
+                startTimelines();
+            }
+        }
+        return true;
+    }
+    case Checksum: {
+        uint64_t frame = 0;
+        uint64_t hash = 0;
+        if (!getVarint(data, end, frame, UINT32_MAX) || !getFixed64(data, end, hash)) {
+            return false;
+        }
+        remoteChecksums.emplace_back(static_cast<uint32_t>(frame), hash);
+        compareChecksum(static_cast<uint32_t>(frame));
+        return true;
+    }
+    case Bye:
+        byeReceived = true;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool TetrixVersusMatch::handleHello(const uint8_t *data, const uint8_t *end) {
+    if (end - data < 5 || std::memcmp(data, HelloMagic, 4) != 0 || data[4] != TetrixVersusProtocol::Version) {
+        return false;
+    }
+    data += 5;
+    uint64_t das = 0;
+    uint64_t arr = 0;
+    uint64_t softDrop = 0;
+    if (!getVarint(data, end, das, MaxRepeatMs) || !getVarint(data, end, arr, MaxRepeatMs) || !getVarint(data, end, softDrop, MaxRepeatMs)) {
+        return false;
+    }
+    TetrixRepeatSettings &remote = repeat[remotePlayer()];
+    remote.dasMs = static_cast<int>(das);
+    remote.arrMs = static_cast<int>(arr);
+    remote.softDropMs = static_cast<int>(softDrop);
+    if (hosting) {
+        return data == end;
+    }
+    uint64_t seed = 0;
+    uint64_t delayMs = 0;
+    uint64_t frameLimit = 0;
+    if (!getFixed64(data, end, seed) || data == end || *data > static_cast<uint8_t>(TetrixRandomizer::Mode::SevenBag)) {
+        return false;
+    }
+    game.mode = static_cast<TetrixRandomizer::Mode>(*data++);
+    if (!getVarint(data, end, delayMs, TetrixEngine::MaxLineClearDelayMs) || !getVarint(data, end, frameLimit, UINT32_MAX)) {
+        return false;
+    }
+    game.seed = seed;
+    game.lineClearDelayMs = static_cast<int>(delayMs);
+    game.frameLimit = static_cast<uint32_t>(frameLimit);
+    return data == end;
+}
+
+bool TetrixVersusMatch::handleInputs(const uint8_t *data, const uint8_t *end) {
+    uint64_t through = 0;
+    if (!getVarint(data, end, through, UINT32_MAX) || through < remoteThrough) {
+        return false;
+    }
+    int remote = remotePlayer();
+    std::vector<Input> &list = inputs[remote];
+    uint32_t frame = remoteThrough;
+    uint32_t earliest = UINT32_MAX;
+    size_t first = list.size();
+    while (data < end) {
+        uint64_t delta = 0;
+        if (!getVarint(data, end, delta, UINT32_MAX) || data == end) {
+            return false;
+        }
+        uint8_t code = *data++;
+        // Frames ascend, the first one past the previous message's
+        if ((list.size() == first && delta == 0) || frame + delta > through
+            || (code >> 1) > static_cast<unsigned>(TetrixInput::HardDrop)) {
+            return false;
+        }
+        frame += static_cast<uint32_t>(delta);
+        list.push_back({ frame, code });
+        earliest = std::min(earliest, frame);
+    }
+    remoteThrough = static_cast<uint32_t>(through);
+    if (currentPhase != Phase::Playing) {
+        return true;
+    }
+
+    bool mispredicted = earliest < live.frame;
+    if (!mispredicted) {
+        // Inputs for the frame on screen apply on top of it, in order; later ones wait for their frame
+        for (size_t i = first; i < list.size() && list[i].frame == live.frame; ++i) {
+            viewEvents[remote] |= applyInput(live, remote, list[i].code, live.frame);
+        }
+    }
+    confirm();
+    if (mispredicted && currentPhase == Phase::Playing) {
+        rollback();
+    }
+    return true;
+}
+
+void TetrixVersusMatch::fail(const std::string &reason) {
+    failure = reason;
+    currentPhase = Phase::Failed;
+    link.close();
+}
@@ -0,0 +1,197 @@
+#ifndef TETRIXVERSUS_H
+#define TETRIXVERSUS_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "TetrixEngine.h"
+#include "TetrixGameLoop.h"
+#include "TetrixSocket.h"
+
+// Versus wire format: each message is a type byte, a varint payload length and the payload. Peers send
+// only the game settings (the host's seed drives both piece streams) and their key presses and
+// releases, stamped with the 1 ms loop step ("frame") they happened in; each side simulates both boards.
+namespace TetrixVersusProtocol {
+
+enum { Version = 1, DefaultPort = 7650, MaxPayload = 1 << 16 };
+
+enum Message : uint8_t {
+    Hello = 1, // "TXVS", version, key repeat settings; from the host also seed, mode, line-clear delay, frame limit
+    Start = 2, // Host to joiner: first frame in this many ms, round trip in us
+    Inputs = 3, // Frame the sender's inputs are final through, then per input: frame delta, input << 1 | pressed
+    Ping = 4, // Sender's clock in us, echoed back in a Pong
+    Pong = 5,
+    Checksum = 6, // Confirmed frame and the hash of both boards there
+    Bye = 7 // The sender has the result and sent every input it needs
+};
+
+} // namespace TetrixVersusProtocol
+
+// Two-player match over a TetrixConnection, with prediction and rollback. Local inputs take effect at
+// once; the opponent is predicted to press nothing new. When its inputs arrive for frames already
+// simulated, the boards go back to the last confirmed frame and are re-simulated to the present. The
+// confirmed timeline only advances over frames whose inputs both sides have, so the two peers' copies
+// agree bit for bit (exchanged checksums check it). Lines cleared send garbage rows to the other
+// board. Qt-free and single-threaded: the owner calls poll() and advance() from its frame timer.
+class TetrixVersusMatch {
+public:
+    enum { MaxPredictionFrames = 500 }; // Further ahead of the opponent's inputs the match waits for them
+    enum { StartDelayMs = 300, HandshakePings = 4 }; // The host measures the round trip before starting
+    enum { PingIntervalMs = 250, KeepaliveMs = 50, InputIntervalMs = 8 }; // Inputs wait at most this long for company
+    enum { ChecksumIntervalFrames = 1000, ByeTimeoutMs = 2000 };
+    enum : unsigned { Resimulated = 1u << 16 }; // Event flag: the board was rolled back or replaced, redraw all of it
+
+    enum class Phase { Handshake, Playing, Finished, Closed, Failed };
+
+    // Chosen by the host
+    struct Settings {
+        uint64_t seed = 0;
+        TetrixRandomizer::Mode mode = TetrixRandomizer::Mode::Uniform;
+        int lineClearDelayMs = 0;
+        uint32_t frameLimit = 0; // 0 plays until a board tops out
+    };
+
+    struct Stats {
+        int64_t rttNs = 0; // Latest ping
+        int64_t minRttNs = 0;
+        int64_t maxRttNs = 0;
+        int64_t totalRttNs = 0;
+        uint64_t rttSamples = 0;
+        uint64_t bytesSent = 0; // Payload bytes handed to TCP, headers not included
+        uint64_t bytesReceived = 0;
+        uint64_t messagesSent = 0;
+        uint64_t rollbacks = 0;
+        uint64_t resimulatedFrames = 0;
+        uint32_t maxRollbackFrames = 0;
+        uint64_t rollbackNs = 0; // Spent restoring and re-simulating
+        uint64_t maxRollbackNs = 0;
+        uint64_t stalls = 0; // advance() calls held back by MaxPredictionFrames
+        uint64_t checksums = 0; // Confirmed frames compared with the peer
+        uint64_t desyncs = 0;
+    };
+
+    TetrixVersusMatch();
+    TetrixVersusMatch(const TetrixVersusMatch &) = delete;
+    TetrixVersusMatch &operator=(const TetrixVersusMatch &) = delete;
+
+    // Steady clock in nanoseconds, for owners without a clock of their own
+    static int64_t clockNs();
+
+    // Open it (TetrixListener::accept or TetrixConnection::connect) before host() or join()
+    TetrixConnection &connection() { return link; }
+    // The host is player 0 and picks the settings; each side brings its own key repeat
+    void host(const Settings &settings, const TetrixRepeatSettings &repeat, int64_t nowNs);
+    void join(const TetrixRepeatSettings &repeat, int64_t nowNs);
+
+    // Reads and sends messages; call after advance() so fresh inputs go out
+    void poll(int64_t nowNs);
+    // Simulates both boards up to nowNs
+    void advance(int64_t nowNs);
+    // Local keys, applied at once
+    void press(TetrixInput input, int64_t nowNs);
+    void release(TetrixInput input, int64_t nowNs);
+    void releaseAll(int64_t nowNs);
+    // Events of a board since the last call: engine events of newly simulated frames, plus Resimulated
+    unsigned takeEvents(int player);
+
+    Phase phase() const { return currentPhase; }
+    bool isPlaying(int64_t nowNs) const { return currentPhase == Phase::Playing && nowNs >= startNs; }
+    int localPlayer() const { return hosting ? 0 : 1; }
+    int remotePlayer() const { return hosting ? 1 : 0; }
+    const Settings &settings() const { return game; }
+    // The boards as predicted, for drawing; the objects live as long as the match
+    TetrixEngine &engine(int player) { return live.players[player].engine; }
+    TetrixGameLoop &loop(int player) { return live.players[player].loop; }
+    // Time to the first frame, 0 once the match runs
+    int64_t countdownNs(int64_t nowNs) const { return currentPhase == Phase::Playing && nowNs < startNs ? startNs - nowNs : 0; }
+    uint32_t frame() const { return live.frame; }
+    uint32_t confirmedFrame() const { return confirmed.frame; }
+    // From Finished on: the winning player, or -1 for a draw
+    int winner() const { return winnerIndex; }
+    // Hash of both boards at the final frame; the same on both peers
+    uint64_t finalChecksum() const { return finishHash; }
+    Stats stats() const;
+    const std::string &error() const { return failure; }
+
+private:
+    struct Player {
+        Player() : loop(engine) {}
+        Player(const Player &) = delete;
+        Player &operator=(const Player &) = delete;
+        TetrixEngine engine;
+        TetrixGameLoop loop;
+    };
+
+    struct Timeline {
+        Player players[2];
+        uint32_t frame = 0; // Last simulated
+        int outgoingGarbage[2] = {}; // Rows earned in this frame, sent at the start of the next
+        uint32_t garbageSent[2] = {}; // Batches sent so far; numbers the hole column
+    };
+
+    struct Input {
+        uint32_t frame;
+        uint8_t code; // input << 1 | pressed
+    };
+
+    void startTimelines();
+    static void copyTimeline(const Timeline &from, Timeline &to);
+    void simulate(Timeline &timeline, uint32_t toFrame, unsigned *events);
+    unsigned applyInput(Timeline &timeline, int player, uint8_t code, uint32_t frame);
+    void exchangeGarbage(Timeline &timeline);
+    void localInput(TetrixInput input, bool pressed, int64_t nowNs);
+    void confirm();
+    void rollback();
+    void finish(uint32_t frame);
+    void trimInputs();
+    uint64_t timelineHash(const Timeline &timeline) const;
+    void compareChecksum(uint32_t frame);
+
+    void sendMessage(uint8_t type, const std::vector<uint8_t> &payload, int64_t nowNs);
+    void sendHello(int64_t nowNs);
+    void sendPing(int64_t nowNs);
+    void sendInputs(int64_t nowNs);
+    bool handleMessage(uint8_t type, const uint8_t *data, size_t size, int64_t nowNs);
+    bool handleHello(const uint8_t *data, const uint8_t *end);
+    bool handleInputs(const uint8_t *data, const uint8_t *end);
+    void fail(const std::string &reason);
+
+    TetrixConnection link;
+    Phase currentPhase;
+    bool hosting;
+    Settings game;
+    TetrixRepeatSettings repeat[2];
+    bool helloReceived;
+    int handshakePongs;
+    int64_t startNs; // Wall-clock time of frame 0
+
+    Timeline live; // Predicted, shown
+    Timeline confirmed; // Exact inputs only
+    std::vector<Input> inputs[2]; // By frame, from the first frame after confirmed.frame on (and unsent local ones)
+    unsigned viewEvents[2];
+    uint32_t localFinal; // Local inputs are final through this frame
+    uint32_t sentThrough;
+    size_t unsentInput; // First local input not sent yet
+    uint32_t remoteThrough; // Remote inputs are known through this frame
+    int64_t lastInputsNs;
+    int64_t lastPingNs;
+
+    uint32_t finishFrame;
+    int winnerIndex;
+    uint64_t finishHash;
+    std::vector<std::pair<uint32_t, uint64_t>> localChecksums; // Not compared yet
+    std::vector<std::pair<uint32_t, uint64_t>> remoteChecksums;
+    std::vector<std::pair<uint32_t, uint64_t>> unsentChecksums;
+    bool byeSent;
+    bool byeReceived;
+    int64_t byeSentNs;
+
+    std::vector<uint8_t> received;
+    std::vector<uint8_t> payload; // Reused for every message sent
+    std::vector<uint8_t> message; // Header and payload of the message being sent
+    Stats counters;
+    std::string failure;
+};
+
+#endif // TETRIXVERSUS_H
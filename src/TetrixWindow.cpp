@@ -1,13 +1,27 @@
 #include "TetrixWindow.h"
+#include "TetrixAssets.h"
+#include "TetrixBackground.h"
 #include "TetrixBoard.h"
+#include "TetrixBroadcast.h"
+#include "TetrixLeaderboard.h"
+#include "TetrixPreview.h"
+#include "TetrixSave.h"
+#include "TetrixSocket.h"
+#include "TetrixTrace.h"
+#include "TetrixVersus.h"
 #include <QApplication>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QThreadPool>
+#include <QTimer>
 #include <QLabel>
 #include <QPushButton>
 #include <QGridLayout>
 #include <QStackedWidget>
 #include <QLineEdit>
 #include <QFile>
-#include <QTextStream>
 #include <QPropertyAnimation>
 #include <QEasingCurve>
 #include <QDebug>
@@ -15,14 +29,14 @@
 #include <QVBoxLayout>
 
 TetrixWindow::TetrixWindow(QWidget *parent)
-    : QWidget(parent)
+    : QWidget(parent), opponentBoard(nullptr), lastGameRecorded(true), buttonFontSize(0), labelFontSize(0)
 {
     // Initialize stacked widget to switch between game and game-over screens
     stackedWidget = new QStackedWidget(this);
     stackedWidget->setObjectName("stackedWidget");
 
     // Create game widget with island.jpg background
-    gameWidget = new QWidget(this);
+    gameWidget = new TetrixBackground(this);
     gameWidget->setObjectName("gameWidget");
     gameWidget->setAutoFillBackground(true);
     
@@ -44,11 +58,15 @@ TetrixWindow::TetrixWindow(QWidget *parent)
 
     // Create buttons with minimum size and dynamic font scaling
     startButton = new QPushButton(tr("&Start"), gameWidget);
+    startButton->setObjectName("startButton");
     startButton->setMinimumSize(100, 30);
     quitButton = new QPushButton(tr("&Quit"), gameWidget);
     quitButton->setMinimumSize(100, 30);
     pauseButton = new QPushButton(tr("&Pause"), gameWidget);
     pauseButton->setMinimumSize(100, 30);
+    aiButton = new QPushButton(tr("&AI Play"), gameWidget);
+    aiButton->setMinimumSize(100, 30);
+    aiButton->setCheckable(true);
 
     // Disable pause button initially
     pauseButton->setEnabled(false);
@@ -57,6 +75,7 @@ TetrixWindow::TetrixWindow(QWidget *parent)
     connect(startButton, &QPushButton::clicked, board, &TetrixBoard::start);
     connect(quitButton, &QPushButton::clicked, qApp, &QApplication::quit);
     connect(pauseButton, &QPushButton::clicked, board, &TetrixBoard::pause);
+    connect(aiButton, &QPushButton::toggled, board, &TetrixBoard::setAiPlay);
 
     // Connect board signals to update labels
     connect(board, &TetrixBoard::scoreChanged, this, [this](int score) {
@@ -76,21 +95,23 @@ TetrixWindow::TetrixWindow(QWidget *parent)
         qDebug() << "Pause button updated: enabled=" << pauseButton->isEnabled() << ", text=" << pauseButton->text();
     });
 
-    // Set next piece label with dynamic sizing and explicit centering
-    board->nextPieceLabel = createLabel("");
-    board->nextPieceLabel->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
-    board->nextPieceLabel->setAlignment(Qt::AlignCenter);
-    board->nextPieceLabel->setMinimumSize(60, 60);
+    // Upcoming pieces; TETRIX_PREVIEW_PIECES (1-6) sets how many, 3 by default
+    preview = new TetrixPreview(gameWidget);
+    bool ok;
+    int previewPieces = qEnvironmentVariableIntValue("TETRIX_PREVIEW_PIECES", &ok);
+    preview->setPieceCount(ok ? previewPieces : 3);
+    board->setPreview(preview);
 
     // Create right panel for buttons and labels
     QWidget *rightPanel = new QWidget(gameWidget);
     rightPanel->setObjectName("rightPanel");
     QVBoxLayout *rightLayout = new QVBoxLayout;
     rightLayout->addWidget(nextLabel, 0, Qt::AlignCenter);
-    rightLayout->addWidget(board->nextPieceLabel, 0, Qt::AlignCenter);
+    rightLayout->addWidget(preview, 0, Qt::AlignCenter);
     rightLayout->addWidget(startButton, 0, Qt::AlignCenter);
     rightLayout->addWidget(quitButton, 0, Qt::AlignCenter);
     rightLayout->addWidget(pauseButton, 0, Qt::AlignCenter);
+    rightLayout->addWidget(aiButton, 0, Qt::AlignCenter);
     rightLayout->addWidget(scoreLabel, 0, Qt::AlignCenter);
     rightLayout->addWidget(levelLabel, 0, Qt::AlignCenter);
     rightLayout->addWidget(linesLabel, 0, Qt::AlignCenter);
@@ -99,7 +120,7 @@ TetrixWindow::TetrixWindow(QWidget *parent)
     rightPanel->setLayout(rightLayout);
 
     // Layout setup for game widget
-    QGridLayout *gameLayout = new QGridLayout;
+    gameLayout = new QGridLayout;
     gameLayout->addWidget(board, 0, 0, 8, 1);
     gameLayout->addWidget(rightPanel, 0, 1, 8, 1);
     gameLayout->setColumnStretch(0, 7);
@@ -112,7 +133,7 @@ TetrixWindow::TetrixWindow(QWidget *parent)
     stackedWidget->addWidget(gameWidget);
 
     // Create game over widget
-    gameOverWidget = new QWidget(this);
+    gameOverWidget = new TetrixBackground(this);
     gameOverWidget->setObjectName("gameOverWidget");
     QVBoxLayout *gameOverLayout = new QVBoxLayout;
     gameOverMessageLabel = new QLabel("", gameOverWidget);
@@ -122,6 +143,7 @@ TetrixWindow::TetrixWindow(QWidget *parent)
     nameEdit->setPlaceholderText(tr("Enter your name"));
     nameEdit->setMinimumHeight(30);
     restartButton = new QPushButton(tr("&Restart"), gameOverWidget);
+    restartButton->setObjectName("restartButton");
     restartButton->setMinimumSize(100, 30);
     gameOverLayout->addWidget(gameOverMessageLabel);
     gameOverLayout->addWidget(nameEdit);
@@ -138,26 +160,35 @@ TetrixWindow::TetrixWindow(QWidget *parent)
     qDebug() << "Stacked widget contains gameOverWidget:" << stackedWidget->indexOf(gameOverWidget);
 
     // Connect game over signal
+    // Every game goes on the leaderboard once the player has had the chance to name it; the rank and
+    // high score shown here come from the in-memory index, never the disk
     connect(board, &TetrixBoard::gameOver, this, [this](int score) {
-        currentScore = score;
-        int highScore = 0;
-        QFile file("highscores.txt");
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QTextStream in(&file);
-            QStringList scores;
-            while (!in.atEnd()) {
-                scores << in.readLine();
-            }
-            file.close();
-            if (!scores.isEmpty()) {
-                highScore = scores.first().split(",").last().toInt();
-            }
+        if (!lastGameRecorded) {
+            recordGame(); // The previous game ended with no restart in between
         }
-        gameOverMessageLabel->setText(tr("Game Over!\nFinal Score: %1\nHigh Score: %2")
-                                     .arg(score).arg(highScore));
-        disconnect(restartButton, &QPushButton::clicked, this, &TetrixWindow::saveHighScore);
-        if (score > highScore) {
-            connect(restartButton, &QPushButton::clicked, this, &TetrixWindow::saveHighScore);
+        // Nothing left to resume
+        QString path = savePath;
+        savePool.start([path] { QFile::remove(path); });
+        if (board->wasRewound()) {
+            // Practice: a game played on from rewound positions stays off the leaderboard
+            gameOverMessageLabel->setText(tr("Practice Over!\nFinal Score: %1").arg(score));
+            nameEdit->hide();
+        } else {
+            lastGame = GameResult();
+            lastGame.score = score;
+            lastGame.lines = board->linesRemoved();
+            lastGame.level = board->level();
+            lastGame.pieces = board->piecesDropped();
+            lastGame.timeMs = QDateTime::currentMSecsSinceEpoch();
+            lastGameRecorded = false;
+            if (leaderboard) {
+                int highScore = qMax(leaderboard->bestScore(), score);
+                gameOverMessageLabel->setText(tr("Game Over!\nFinal Score: %1\nHigh Score: %2\nRank: %3 of %4")
+                                             .arg(score).arg(highScore).arg(leaderboard->rankForScore(score))
+                                             .arg(leaderboard->count() + 1));
+            } else {
+                gameOverMessageLabel->setText(tr("Game Over!\nFinal Score: %1").arg(score));
+            }
         }
         qDebug() << "Switching to gameOverWidget, index:" << stackedWidget->indexOf(gameOverWidget);
         stackedWidget->setCurrentWidget(gameOverWidget);
@@ -169,8 +200,13 @@ TetrixWindow::TetrixWindow(QWidget *parent)
         animation->start(QAbstractAnimation::DeleteWhenStopped);
     });
 
-    // Connect restart button to stop game-over sound and switch back to game
+    // Connect restart button to record the game, stop game-over sound and switch back to game
+    connect(restartButton, &QPushButton::clicked, this, &TetrixWindow::recordGame);
     connect(restartButton, &QPushButton::clicked, this, [this]() {
+        if (versus) {
+            endVersus(); // Back to single-player
+        }
+        nameEdit->show(); // Hidden for practice games
         board->stopGameOverSound();
         qDebug() << "Switching to gameWidget, index:" << stackedWidget->indexOf(gameWidget);
         stackedWidget->setCurrentWidget(gameWidget);
@@ -184,36 +220,55 @@ TetrixWindow::TetrixWindow(QWidget *parent)
     mainLayout->setSpacing(0);
     setLayout(mainLayout);
 
-    // Verify image paths
-    QString gameBackgroundPath = "/home/time/introCode/c++/TetrixGame/images/island.jpg";
-    QString gameOverBackgroundPath = "/home/time/introCode/c++/TetrixGame/images/gray.jpg";
-    if (!QFile::exists(gameBackgroundPath)) {
-        qDebug() << "WARNING: Game background image not found:" << gameBackgroundPath;
+    // Backgrounds and sounds are decoded off the GUI thread and installed as they arrive; the window
+    // shows before any of them is ready
+    assets = new TetrixAssets(this);
+    connect(assets, &TetrixAssets::imageDecoded, this, [this](TetrixAssets::Image image, const QImage &decoded) {
+        (image == TetrixAssets::Image::GameBackground ? gameWidget : gameOverWidget)->setImage(decoded);
+    });
+    connect(assets, &TetrixAssets::soundDecoded, this, [this](TetrixSound sound, std::shared_ptr<TetrixAudioClip> clip) {
+        board->installSound(sound, std::move(*clip));
+    });
+    connect(assets, &TetrixAssets::loaded, this, [] { TetrixStartup::markAssetsLoaded(); });
+    assets->load();
+    loadLeaderboard();
+    connect(board, &TetrixBoard::versusEnded, this, &TetrixWindow::versusEnded);
+    bool broadcastPortSet = false;
+    int broadcastPort = qEnvironmentVariableIntValue("TETRIX_BROADCAST", &broadcastPortSet);
+    if (broadcastPortSet) {
+        // Spectators are served from the server's own thread; the board only encodes frames
+        broadcast = std::make_unique<TetrixBroadcastServer>();
+        if (broadcast->listen(static_cast<uint16_t>(broadcastPort)) && broadcast->start()) {
+            qDebug() << "Broadcasting to spectators on port" << broadcast->port();
+            board->setBroadcast(broadcast.get());
+        } else {
+            qDebug() << "Broadcast: cannot listen on port" << broadcastPort;
+            broadcast.reset();
+        }
     }
-    if (!QFile::exists(gameOverBackgroundPath)) {
-        qDebug() << "WARNING: Game-over background image not found:" << gameOverBackgroundPath;
+    savePath = qEnvironmentVariable("TETRIX_SAVE", QStringLiteral("savegame.txsv"));
+    savePool.setMaxThreadCount(1);
+    QString versusAddress = qEnvironmentVariable("TETRIX_VERSUS");
+    if (!versusAddress.isEmpty()) {
+        startVersus(versusAddress);
+    } else {
+        resumeSavedGame();
     }
+    // Pausing saves; connected after the resume, which comes back paused and is already on disk
+    connect(board, &TetrixBoard::pauseStateChanged, this, [this](bool isPaused) {
+        if (isPaused) {
+            saveGame();
+        }
+    });
 
     // Apply stylesheet to ensure full background coverage and transparency
     setStyleSheet(R"(
-        QWidget#gameWidget {
-            background-image: url(/home/time/introCode/c++/TetrixGame/images/island.jpg);
-            background-position: center;
-            background-repeat: no-repeat;
-            background-size: cover;
-        }
         TetrixBoard {
             background: transparent;
         }
         QWidget#rightPanel {
             background: transparent;
         }
-        QWidget#gameOverWidget {
-            background-image: url(/home/time/introCode/c++/TetrixGame/images/gray.jpg);
-            background-position: center;
-            background-repeat: no-repeat;
-            background-size: cover;
-        }
         QWidget#stackedWidget {
             background: transparent; /* Ensure stacked widget is transparent */
         }
@@ -235,6 +290,9 @@ TetrixWindow::TetrixWindow(QWidget *parent)
         QPushButton:pressed {
             background-color: rgb(85, 0, 20);
         }
+        QPushButton:checked {
+            background-color: rgb(85, 0, 20);
+        }
         QLabel {
             color: #cdd6f4;
             font-family: Arial;
@@ -253,19 +311,7 @@ TetrixWindow::TetrixWindow(QWidget *parent)
         }
     )");
 
-    // Debug stylesheet and widget properties
-    qDebug() << "Window initialized: size=" << size()
-             << ", game background path=" << gameBackgroundPath
-             << ", game-over background path=" << gameOverBackgroundPath
-             << ", main window stylesheet=" << styleSheet()
-             << ", gameWidget stylesheet=" << gameWidget->styleSheet()
-             << ", rightPanel stylesheet=" << gameWidget->findChild<QWidget*>("rightPanel")->styleSheet()
-             << ", gameOverWidget stylesheet=" << gameOverWidget->styleSheet()
-             << ", TetrixBoard stylesheet=" << board->styleSheet()
-             << ", startButton stylesheet=" << startButton->styleSheet()
-             << ", nextLabel stylesheet=" << nextLabel->styleSheet()
-             << ", gameWidget autoFillBackground=" << gameWidget->autoFillBackground()
-             << ", TetrixBoard autoFillBackground=" << board->autoFillBackground();
+    TETRIX_TRACE_INFO(TetrixTraceId::WindowInit, width(), height());
 }
 
 QLabel *TetrixWindow::createLabel(const QString &text) {
@@ -275,37 +321,261 @@ QLabel *TetrixWindow::createLabel(const QString &text) {
     return label;
 }
 
-void TetrixWindow::saveHighScore() {
-    QFile file("highscores.txt");
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream out(&file);
-        out << nameEdit->text() << "," << currentScore << "\n";
-        file.close();
-        qDebug() << "High score saved:" << nameEdit->text() << "," << currentScore;
+TetrixWindow::~TetrixWindow() {
+    if (versus) {
+        endVersus(); // The boards let go of the match before it closes
+    }
+    if (broadcast) {
+        board->setBroadcast(nullptr);
+        broadcast->stop();
+        TetrixBroadcastServer::Stats stats = broadcast->stats();
+        qDebug() << "Broadcast:" << stats.peakSubscribers << "spectators at most," << stats.framesPublished << "frames,"
+                 << stats.bytesSent << "bytes sent," << stats.resyncs << "resyncs," << stats.cutOff << "cut off";
+    }
+    saveGame();
+    savePool.waitForDone();
+    // Quitting from the game-over screen still keeps the game; the leaderboard is flushed and
+    // snapshotted when the last reference to it goes
+    if (!lastGameRecorded) {
+        recordGame();
+    }
+}
+
+void TetrixWindow::resumeSavedGame() {
+    // Under a kilobyte plus the replay: read and checked on the GUI thread in well under a millisecond
+    TetrixSaveGame save;
+    TetrixSaveGame::Status status = save.read(savePath.toStdString());
+    if (status == TetrixSaveGame::Status::Missing) {
+        return;
+    }
+    if (status == TetrixSaveGame::Status::Loaded && board->resumeGame(save)) {
+        qDebug() << "Resumed the game saved in" << savePath;
+        return;
+    }
+    // Kept aside rather than overwritten by the next save: another build may still read it
+    QString aside = savePath + ".old";
+    QFile::remove(aside);
+    QFile::rename(savePath, aside);
+    qDebug() << "Cannot resume" << savePath
+             << (status == TetrixSaveGame::Status::Unsupported ? "(another version)" : "(damaged)") << ", moved to" << aside;
+}
+
+void TetrixWindow::saveGame() {
+    // Captured here, written on the save thread: the game never waits for the disk
+    TetrixSaveGame save;
+    if (!board->captureGame(save)) {
+        return;
+    }
+    QString path = savePath;
+    savePool.start([save, path] {
+        if (!save.write(path.toStdString())) {
+            qDebug() << "Failed to save the game to" << path;
+        }
+    });
+}
+
+void TetrixWindow::loadLeaderboard() {
+    // TETRIX_LEADERBOARD sets the files' path prefix; .log and .snap are added to it
+    QString path = qEnvironmentVariable("TETRIX_LEADERBOARD", QStringLiteral("leaderboard"));
+    auto loading = std::make_shared<TetrixLeaderboard>();
+    QPointer<TetrixWindow> window(this);
+    QThreadPool::globalInstance()->start([window, loading, path] {
+        if (!loading->open(path.toStdString())) {
+            qDebug() << "Failed to open the leaderboard at" << path;
+            return;
+        }
+        QMetaObject::invokeMethod(qApp, [window, loading] {
+            if (window) {
+                window->leaderboardLoaded(loading);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void TetrixWindow::leaderboardLoaded(std::shared_ptr<TetrixLeaderboard> loaded) {
+    leaderboard = std::move(loaded);
+    const TetrixLeaderboard::LoadInfo &info = leaderboard->loadInfo();
+    qDebug() << "Leaderboard:" << leaderboard->count() << "games," << leaderboard->playerCount() << "players,"
+             << (info.snapshotUsed ? "snapshot plus" : "no snapshot,") << info.replayedRecords << "logged games read,"
+             << info.discardedBytes << "torn bytes dropped";
+
+    // One-time import of the single score the old highscores.txt kept
+    QFile legacy("highscores.txt");
+    if (leaderboard->count() == 0 && legacy.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QStringList fields = QString::fromUtf8(legacy.readLine()).trimmed().split(",");
+        if (fields.size() >= 2) {
+            GameResult imported;
+            imported.score = fields.last().toInt();
+            fields.removeLast();
+            imported.name = fields.join(",");
+            imported.timeMs = QFileInfo(legacy).lastModified().toMSecsSinceEpoch();
+            addToLeaderboard(imported);
+        }
+    }
+    for (const GameResult &result : unrecordedGames) {
+        addToLeaderboard(result);
+    }
+    unrecordedGames.clear();
+}
+
+void TetrixWindow::addToLeaderboard(const GameResult &result) {
+    uint32_t index = leaderboard->add(result.name.toStdString(), result.score, result.lines, result.level, result.pieces,
+                                      result.timeMs);
+    uint32_t best = index;
+    leaderboard->playerBest(result.name.toStdString(), best);
+    qDebug() << "Leaderboard: recorded" << result.name << result.score << "at rank" << leaderboard->rankOf(index) << "of"
+             << leaderboard->count() << "- best" << leaderboard->entry(best).score << "at rank" << leaderboard->rankOf(best);
+}
+
+void TetrixWindow::startVersus(const QString &address) {
+    // TETRIX_VERSUS_LATENCY_MS delays what this side sends, to try the rollback on a local network
+    int port = TetrixVersusProtocol::DefaultPort;
+    QString host = address;
+    int colon = address.lastIndexOf(':');
+    if (colon >= 0) {
+        host = address.left(colon);
+        port = address.mid(colon + 1).toInt();
+    }
+    auto match = std::make_shared<TetrixVersusMatch>();
+    match->connection().setLatency(qEnvironmentVariableIntValue("TETRIX_VERSUS_LATENCY_MS"));
+
+    if (host == QLatin1String("host")) {
+        versusListener = std::make_unique<TetrixListener>();
+        if (!versusListener->listen(static_cast<uint16_t>(port))) {
+            qDebug() << "Versus: cannot listen on port" << port;
+            versusListener.reset();
+            return;
+        }
+        qDebug() << "Versus: waiting for a player on port" << versusListener->port();
+        // accept() does not block; a light poll keeps the GUI thread free while nobody comes
+        QTimer *acceptTimer = new QTimer(this);
+        connect(acceptTimer, &QTimer::timeout, this, [this, acceptTimer, match] {
+            if (versusListener && versusListener->accept(match->connection())) {
+                acceptTimer->deleteLater();
+                versusListener.reset();
+                versusConnected(match, true);
+            }
+        });
+        acceptTimer->start(100);
+        return;
+    }
+
+    // Connecting can take seconds; it runs on a worker and hands the match back
+    QPointer<TetrixWindow> window(this);
+    QThreadPool::globalInstance()->start([window, match, host, port] {
+        if (!match->connection().connect(host.toStdString(), static_cast<uint16_t>(port), 5000)) {
+            qDebug() << "Versus: cannot connect to" << host << port;
+            return;
+        }
+        QMetaObject::invokeMethod(qApp, [window, match] {
+            if (window) {
+                window->versusConnected(match, false);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void TetrixWindow::versusConnected(std::shared_ptr<TetrixVersusMatch> match, bool hosting) {
+    versus = std::move(match);
+    int64_t nowNs = TetrixVersusMatch::clockNs();
+    if (hosting) {
+        TetrixVersusMatch::Settings settings;
+        settings.seed = QRandomGenerator::global()->generate64();
+        settings.lineClearDelayMs = board->lineClearDelay();
+        versus->host(settings, board->repeatSettings(), nowNs);
     } else {
-        qDebug() << "Failed to open highscores.txt for writing";
+        versus->join(board->repeatSettings(), nowNs);
+    }
+
+    if (!opponentBoard) {
+        opponentBoard = new TetrixBoard(gameWidget, TetrixBoard::Role::Opponent);
+        opponentBoard->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+        opponentBoard->setMinimumSize(150, 330);
+        gameLayout->addWidget(opponentBoard, 0, 2, 8, 1);
+        gameLayout->setColumnStretch(2, 7);
+        connect(board, &TetrixBoard::versusUpdated, opponentBoard, &TetrixBoard::refreshVersus);
+    }
+    opponentBoard->show();
+    board->setVersus(versus.get(), versus->localPlayer());
+    opponentBoard->setVersus(versus.get(), versus->remotePlayer());
+    startButton->setEnabled(false);
+    pauseButton->setEnabled(false);
+    stackedWidget->setCurrentWidget(gameWidget);
+    board->setFocus();
+    qDebug() << "Versus: connected as" << (hosting ? "host" : "guest");
+}
+
+void TetrixWindow::versusEnded() {
+    TetrixVersusMatch::Stats stats = versus->stats();
+    double seconds = qMax(versus->confirmedFrame() / 1000.0, 0.001);
+    QString result;
+    if (versus->phase() == TetrixVersusMatch::Phase::Failed) {
+        result = tr("Connection lost:\n%1").arg(QString::fromStdString(versus->error()));
+    } else if (versus->winner() < 0) {
+        result = tr("Draw!");
+    } else {
+        result = versus->winner() == versus->localPlayer() ? tr("You Win!") : tr("You Lose!");
+    }
+    gameOverMessageLabel->setText(tr("%1\nScore: %2 vs %3\nPing: %4 ms")
+                                      .arg(result)
+                                      .arg(versus->engine(versus->localPlayer()).score())
+                                      .arg(versus->engine(versus->remotePlayer()).score())
+                                      .arg(stats.rttNs / 1e6, 0, 'f', 1));
+    nameEdit->hide(); // Versus games stay off the leaderboard
+    qDebug() << "Versus:" << result << "- rtt avg"
+             << (stats.rttSamples ? stats.totalRttNs / 1e6 / stats.rttSamples : 0.0) << "ms, sent"
+             << stats.bytesSent / seconds << "B/s, received" << stats.bytesReceived / seconds << "B/s," << stats.rollbacks
+             << "rollbacks (max" << stats.maxRollbackFrames << "frames)," << stats.desyncs << "desyncs";
+    stackedWidget->setCurrentWidget(gameOverWidget);
+}
+
+void TetrixWindow::endVersus() {
+    board->setVersus(nullptr, 0);
+    if (opponentBoard) {
+        opponentBoard->setVersus(nullptr, 0);
+        opponentBoard->hide();
+    }
+    versus.reset();
+    startButton->setEnabled(true);
+    nameEdit->show();
+}
+
+void TetrixWindow::recordGame() {
+    if (lastGameRecorded) {
+        return;
+    }
+    lastGameRecorded = true;
+    lastGame.name = nameEdit->text().trimmed();
+    if (lastGame.name.isEmpty()) {
+        lastGame.name = tr("Anonymous");
+    }
+    if (leaderboard) {
+        addToLeaderboard(lastGame); // Queued for the log's flusher thread; returns at once
+    } else {
+        unrecordedGames.append(lastGame);
     }
 }
 
 void TetrixWindow::resizeEvent(QResizeEvent *event) {
     QWidget::resizeEvent(event);
+    // Fonts change in steps of many pixels; setting one relayouts its widget, so most resizes skip it
     int fontSize = qMax(10, height() / 30);
-    QFont buttonFont("Arial", fontSize, QFont::Bold);
-    startButton->setFont(buttonFont);
-    quitButton->setFont(buttonFont);
-    pauseButton->setFont(buttonFont);
-    QFont labelFont("Arial", qMax(12, height() / 35));
-    scoreLabel->setFont(labelFont);
-    levelLabel->setFont(labelFont);
-    linesLabel->setFont(labelFont);
-    nextLabel->setFont(labelFont);
-    board->nextPieceLabel->setFont(labelFont);
-    qDebug() << "Window resized: new size=" << event->size()
-             << ", button font size=" << fontSize
-             << ", label font size=" << labelFont.pointSize()
-             << ", nextLabel geometry=" << nextLabel->geometry()
-             << ", nextPieceLabel geometry=" << board->nextPieceLabel->geometry()
-             << ", gameWidget geometry=" << gameWidget->geometry()
-             << ", rightPanel geometry=" << gameWidget->findChild<QWidget*>("rightPanel")->geometry()
-             << ", TetrixBoard geometry=" << board->geometry();
+    if (fontSize != buttonFontSize) {
+        buttonFontSize = fontSize;
+        QFont buttonFont("Arial", fontSize, QFont::Bold);
+        startButton->setFont(buttonFont);
+        quitButton->setFont(buttonFont);
+        pauseButton->setFont(buttonFont);
+        aiButton->setFont(buttonFont);
+    }
+    int labelSize = qMax(12, height() / 35);
+    if (labelSize != labelFontSize) {
+        labelFontSize = labelSize;
+        QFont labelFont("Arial", labelSize);
+        scoreLabel->setFont(labelFont);
+        levelLabel->setFont(labelFont);
+        linesLabel->setFont(labelFont);
+        nextLabel->setFont(labelFont);
+    }
+    TETRIX_TRACE_DEBUG(TetrixTraceId::Resize, event->size().width(), event->size().height(), fontSize);
 }
\ No newline at end of file
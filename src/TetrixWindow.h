@@ -2,9 +2,20 @@
 #define TETRIXWINDOW_H
 
 #include <QWidget>
+#include <QThreadPool>
 #include <QStackedWidget>
+#include <QVector>
+#include <memory>
 
+class TetrixAssets;
+class TetrixBackground;
 class TetrixBoard;
+class TetrixBroadcastServer;
+class TetrixLeaderboard;
+class TetrixListener;
+class TetrixPreview;
+class TetrixVersusMatch;
+class QGridLayout;
 class QLabel;
 class QPushButton;
 class QLineEdit;
@@ -16,18 +27,43 @@ class TetrixWindow : public QWidget
 
 public:
     explicit TetrixWindow(QWidget *parent = nullptr);
+    ~TetrixWindow();
 
 private:
+    // A finished game waiting for the player's name
+    struct GameResult {
+        QString name;
+        int score = 0;
+        int lines = 0;
+        int level = 0;
+        int pieces = 0;
+        qint64 timeMs = 0;
+    };
+
     QLabel *createLabel(const QString &text);
+    void loadLeaderboard();
+    void leaderboardLoaded(std::shared_ptr<TetrixLeaderboard> loaded);
+    void addToLeaderboard(const GameResult &result);
+    // Versus over TCP, from TETRIX_VERSUS: "host[:PORT]" waits for a player, "HOST[:PORT]" joins one
+    void startVersus(const QString &address);
+    void versusConnected(std::shared_ptr<TetrixVersusMatch> match, bool hosting);
+    void versusEnded();
+    void endVersus();
+    // The game in play survives quitting: TETRIX_SAVE sets the file, savegame.txsv by default
+    void resumeSavedGame();
+    void saveGame();
 
 private slots:
-    void saveHighScore();
+    void recordGame();
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
 
 private:
     TetrixBoard *board;
+    TetrixBoard *opponentBoard; // Created for the first versus match
+    QGridLayout *gameLayout;
+    TetrixPreview *preview;
     QLabel *scoreLabel;
     QLabel *levelLabel;
     QLabel *linesLabel;
@@ -36,14 +72,24 @@ private:
     QPushButton *startButton;
     QPushButton *quitButton;
     QPushButton *pauseButton;
+    QPushButton *aiButton;
     QPushButton *restartButton;
     QLineEdit *nameEdit;
     QStackedWidget *stackedWidget;
-    QWidget *gameWidget;
-    QWidget *gameOverWidget;
-    QLabel *gameBackgroundLabel; // Background for game screen
-    QLabel *gameOverBackgroundLabel; // Background for game-over screen
-    int currentScore;
+    TetrixBackground *gameWidget; // island.jpg behind the board and panel
+    TetrixBackground *gameOverWidget; // gray.jpg behind the game-over form
+    TetrixAssets *assets;
+    std::shared_ptr<TetrixLeaderboard> leaderboard; // Null until loaded off the GUI thread
+    GameResult lastGame;
+    bool lastGameRecorded;
+    QVector<GameResult> unrecordedGames; // Finished before the leaderboard was loaded
+    std::shared_ptr<TetrixVersusMatch> versus; // Shown by both boards while set
+    std::unique_ptr<TetrixListener> versusListener; // Polled until a player connects
+    std::unique_ptr<TetrixBroadcastServer> broadcast; // TETRIX_BROADCAST=PORT: spectators watch the board
+    QString savePath;
+    QThreadPool savePool; // One thread, so saves and removals reach the disk in order
+    int buttonFontSize; // Last sizes applied by resizeEvent(); 0 before the first
+    int labelFontSize;
 };
 
 #endif // TETRIXWINDOW_H
\ No newline at end of file
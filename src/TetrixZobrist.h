@@ -0,0 +1,65 @@
+#ifndef TETRIXZOBRIST_H
+#define TETRIXZOBRIST_H
+
+#include <cstdint>
+#include "TetrixPiece.h"
+
+// Zobrist keys for search positions: one random 64-bit key per board cell, per active shape and per
+// preview shape. A position's hash is the XOR of the keys of its occupied cells and its pieces, so
+// placing or removing a cell is one XOR. Cell colors are not hashed; they never affect play.
+namespace TetrixZobrist {
+
+enum { Width = 10, Height = 22, ShapeCount = 8 };
+
+struct KeyTable {
+    uint64_t cells[Height][Width];
+    uint64_t activeShapes[ShapeCount];
+    uint64_t previewShapes[ShapeCount];
+    uint64_t expanded[ShapeCount]; // Marks search results that already include a lookahead with this shape
+};
+
+constexpr uint64_t splitMix64(uint64_t &x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+constexpr KeyTable makeKeyTable() {
+    KeyTable table{};
+    uint64_t state = 0x54455452495821ull; // Fixed, so hashes are stable between runs
+    for (int y = 0; y < Height; ++y) {
+        for (int x = 0; x < Width; ++x) {
+            table.cells[y][x] = splitMix64(state);
+        }
+    }
+    // NoShape keeps a zero key, so an empty slot does not change the hash
+    for (int shape = 1; shape < ShapeCount; ++shape) {
+        table.activeShapes[shape] = splitMix64(state);
+        table.previewShapes[shape] = splitMix64(state);
+        table.expanded[shape] = splitMix64(state);
+    }
+    return table;
+}
+
+inline constexpr KeyTable keyTable = makeKeyTable();
+
+inline uint64_t cellKey(int x, int y) { return keyTable.cells[y][x]; }
+inline uint64_t activeKey(TetrixShape shape) { return keyTable.activeShapes[static_cast<int>(shape)]; }
+inline uint64_t previewKey(TetrixShape shape) { return keyTable.previewShapes[static_cast<int>(shape)]; }
+inline uint64_t expandedKey(TetrixShape shape) { return keyTable.expanded[static_cast<int>(shape)]; }
+
+// Hash contribution of one row's occupancy bits
+inline uint64_t rowKey(int y, unsigned bits) {
+    uint64_t key = 0;
+    for (int x = 0; bits != 0; ++x, bits >>= 1) {
+        if (bits & 1) {
+            key ^= keyTable.cells[y][x];
+        }
+    }
+    return key;
+}
+
+} // namespace TetrixZobrist
+
+#endif // TETRIXZOBRIST_H
@@ -1,9 +1,35 @@
+#include "TetrixAssets.h"
+#include "TetrixInputInjector.h"
 #include "TetrixWindow.h"
+#include "TetrixTrace.h"
 #include <QApplication>
+#include <QDebug>
 
 int main(int argc, char *argv[]) {
-    QApplication app(argc, argv);
-    TetrixWindow window;
-    window.show();
-    return app.exec();
+    TetrixStartup::begin();
+
+    // TETRIX_TRACE=file.json records a Chrome trace of the session
+    QByteArray tracePath = qgetenv("TETRIX_TRACE");
+    if (!tracePath.isEmpty() && !TetrixTrace::start(tracePath.toStdString())) {
+        qDebug() << "Cannot write trace to" << tracePath;
+    }
+
+    int result;
+    {
+        QApplication app(argc, argv);
+        TetrixWindow window;
+        window.show();
+        // TETRIX_INJECT_INPUTS=N plays N synthetic key presses and quits, for unattended latency runs
+        int injectedPresses = qEnvironmentVariableIntValue("TETRIX_INJECT_INPUTS");
+        if (injectedPresses > 0) {
+            new TetrixInputInjector(&window, injectedPresses, &app);
+        }
+        result = app.exec();
+    }
+
+    if (TetrixTrace::isRecording()) {
+        TetrixTrace::Stats stats = TetrixTrace::stop();
+        qDebug() << "Trace written to" << tracePath << ":" << stats.written << "events," << stats.dropped << "dropped";
+    }
+    return result;
 }
\ No newline at end of file